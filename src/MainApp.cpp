@@ -39,7 +39,7 @@ namespace app
 
         dlg.m_Config.m_Settings.Init(dlg.m_Config.FileSystem.get());
 
-        dlg.m_Config.Log = std::make_unique<util::FileLog>(dlg.m_Config.m_Settings.szLogFile);
+        dlg.m_Config.Log = std::make_unique<worker::CAsyncLog>(std::make_unique<util::FileLog>(dlg.m_Config.m_Settings.szLogFile));
         dlg.m_Config.Log->Open();
 
         std::wstring szConfigMode = dlg.m_Config.m_Settings.IsPortable(dlg.m_Config.FileSystem.get()) ? L"Portable" : L"Roaming";
@@ -7,15 +7,54 @@
 #include "mainapp.h"
 #include "utilities\ArgvParser.h"
 
+int RunDaemon(config::CConfig& m_Config, int nThreadCount, int nJobs, const std::wstring& szPipeName)
+{
+    // config, registries and workers stay loaded between submitted jobs
+    worker::CDaemon m_Daemon;
+    m_Daemon.pConfig = &m_Config;
+    m_Daemon.pFactory = std::make_shared<worker::Win32WorkerFactory>();
+    m_Daemon.CreateFileSystem = []() { return std::make_unique<worker::Win32FileSystem>(); };
+    m_Daemon.nThreadCount = nThreadCount;
+    m_Daemon.Start(nJobs);
+
+    CDaemonServer m_Server;
+    if (m_Server.Open(&m_Daemon, szPipeName) == false)
+    {
+        m_Config.Log->Log(L"[Error] Failed to open daemon pipe: " + szPipeName);
+        m_Daemon.Stop();
+        return -1;
+    }
+
+    m_Config.Log->Log(L"[Info] Daemon listening on " + szPipeName + L", concurrent jobs: " + std::to_wstring(nJobs) + L", item slots: " + std::to_wstring(nThreadCount));
+    m_Daemon.WaitForShutdown();
+
+    m_Server.Close();
+    m_Daemon.Stop();
+    return m_Server.bFailed == true ? -1 : 0;
+}
+
 int wmain(int argc, wchar_t *argv[])
 {
     config::CConfig m_Config;
 
+    bool bDaemon = false;
+    int nJobs = 8;
+    std::wstring szPipeName = L"\\\\.\\pipe\\BatchEncoder";
+    for (int i = 1; i < argc; i++)
+    {
+        if (_wcsicmp(argv[i], L"--daemon") == 0)
+            bDaemon = true;
+        else if (_wcsicmp(argv[i], L"--pipe") == 0 && i + 1 < argc)
+            szPipeName = argv[++i];
+        else if (_wcsicmp(argv[i], L"--jobs") == 0 && i + 1 < argc)
+            nJobs = (std::max)(1, _wtoi(argv[++i]));
+    }
+
     m_Config.FileSystem = std::make_unique<worker::Win32FileSystem>();
 
     m_Config.m_Settings.Init(m_Config.FileSystem.get());
 
-    m_Config.Log = std::make_unique<util::ConsoleLog>();
+    m_Config.Log = std::make_unique<worker::CAsyncLog>(std::make_unique<util::ConsoleLog>());
     m_Config.Log->Open();
 
     std::wstring szConfigMode = m_Config.m_Settings.IsPortable(m_Config.FileSystem.get()) ? L"Portable" : L"Roaming";
@@ -34,7 +73,8 @@ int wmain(int argc, wchar_t *argv[])
         if (m_Config.LoadOptions(m_Config.m_Settings.szOptionsFile) == false)
             m_Config.m_Options.Defaults();
 
-        m_Config.LoadItems(m_Config.m_Settings.szItemsFile);
+        if (bDaemon == false)
+            m_Config.LoadItems(m_Config.m_Settings.szItemsFile);
     }
     catch (...)
     {
@@ -46,6 +86,24 @@ int wmain(int argc, wchar_t *argv[])
     worker::Win32WorkerFactory m_Factory;
     CConsoleWorkerContext ctx;
 
+    int nThreadCount = m_Config.m_Options.nThreadCount;
+    if (nThreadCount < 1)
+    {
+        worker::CProcessorTopology topology;
+        if (ctx.pFactory->CreateProcessorTopologyPtr()->Query(topology) == true)
+            nThreadCount = topology.DefaultThreadCount();
+        else
+            nThreadCount = 1;
+    }
+
+    if (bDaemon == true)
+    {
+        int nResult = RunDaemon(m_Config, nThreadCount, nJobs, szPipeName);
+        m_Config.Log->Log(L"[Info] Program exited: " + szConfigMode);
+        m_Config.Log->Close();
+        return nResult;
+    }
+
     size_t nItems = m_Config.m_Items.size();
     if (nItems <= 0)
     {
@@ -79,18 +137,14 @@ int wmain(int argc, wchar_t *argv[])
 
     ctx.Init();
 
-    ctx.nThreadCount = m_Config.m_Options.nThreadCount;
-    if (ctx.nThreadCount < 1)
-    {
-        util::LogicalProcessorInformation info;
-        if (util::GetLogicalProcessorInformation(&info) == 0)
-            ctx.nThreadCount = info.processorCoreCount;
-        else
-            ctx.nThreadCount = 1;
-    }
+    ctx.nThreadCount = nThreadCount;
 
     ctx.pConfig = &m_Config;
 
+    CConsoleControl m_Control;
+    if (m_Control.Open(&ctx) == true)
+        m_Config.Log->Log(L"[Info] Ctrl+Break pauses and resumes, control pipe: " + m_Control.szPipeName);
+
     auto m_WorkerThread = std::thread([&ctx, &m_Config]()
     {
         auto pWorker = std::make_unique<worker::CWorker>();
@@ -101,6 +155,7 @@ int wmain(int argc, wchar_t *argv[])
     });
     m_WorkerThread.join();
 
+    m_Control.Close();
     ctx.bRunning = false;
 
     m_Config.Log->Log(L"[Info] Program exited: " + szConfigMode);
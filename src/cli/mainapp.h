@@ -7,7 +7,9 @@
 #include <array>
 #include <vector>
 #include <thread>
+#include <mutex>
 #include <algorithm>
+#include <atomic>
 
 #include "utilities\FileSystem.h"
 #include "utilities\Log.h"
@@ -24,10 +26,11 @@
 #include "worker\ToolDownloader.h"
 #include "worker\Worker.h"
 #include "worker\Win32.h"
+#include "worker\Daemon.h"
 
 class CConsoleWorkerContext : public worker::IWorkerContext
 {
-    volatile bool bSafeCheck;
+    std::atomic<bool> bSafeCheck;
 public:
     CConsoleWorkerContext()
     {
@@ -51,6 +54,9 @@ public:
         this->nProcessedFiles = 0;
         this->nErrors = 0;
         this->nLastItemId = -1;
+        this->nRunningFiles = 0;
+        this->nActiveProcesses = 0;
+        this->bPaused = false;
     }
     void Start()
     {
@@ -66,7 +72,7 @@ public:
         {
             config::CItem &item = this->pConfig->m_Items[nItemId];
             item.bFinished = true;
-            if (this->pConfig->m_Options.bStopOnErrors == true)
+            if (this->StopOnError(nItemId) == true)
             {
                 this->bRunning = false;
             }
@@ -94,7 +100,7 @@ public:
                 {
                     if (nItemProgress > 0 && nItemProgress < 100 && nItemProgress > nItemPreviousProgress)
                     {
-                        item.szStatus = std::to_wstring(nItemProgress) + L"%";
+                        item.SetProgressStatus(nItemProgress);
                         item.nPreviousProgress = nItemProgress;
                     }
                     else if (nItemProgress == 100 && nItemProgress > nItemPreviousProgress)
@@ -104,9 +110,8 @@ public:
                 }
             }
 
-            if (this->bSafeCheck == false)
+            if (this->bSafeCheck.exchange(true) == false)
             {
-                this->bSafeCheck = true;
                 if (nItemId > this->nLastItemId)
                 {
                     this->nLastItemId = nItemId;
@@ -124,9 +129,8 @@ public:
         config::CItem &item = this->pConfig->m_Items[nItemId];
         item.szTime = szTime;
         item.szStatus = szStatus;
-        if (bSafeCheck == false)
+        if (bSafeCheck.exchange(true) == false)
         {
-            bSafeCheck = true;
             if (nItemId > this->nLastItemId)
             {
                 this->nLastItemId = nItemId;
@@ -150,3 +154,380 @@ public:
         int nPos = (int)(100.0f * ((double)nProcessedFiles / (double)nTotalFiles));
     }
 };
+
+class CConsoleControl
+{
+    static inline worker::IWorkerContext* ctx = nullptr;
+    std::thread pipeThread;
+    HANDLE hStop;
+public:
+    std::wstring szPipeName;
+public:
+    CConsoleControl()
+    {
+        this->hStop = nullptr;
+    }
+    virtual ~CConsoleControl()
+    {
+        this->Close();
+    }
+public:
+    static void SetPaused(worker::IWorkerContext* ctx, bool bPaused)
+    {
+        if (ctx->bPaused == bPaused)
+            return;
+
+        if (bPaused == true)
+            ctx->Pause();
+        else
+            ctx->Resume();
+
+        if (ctx->pConfig != nullptr)
+            ctx->pConfig->Log->Log(bPaused ? L"[Info] Batch paused." : L"[Info] Batch resumed.");
+    }
+    static std::string Execute(worker::IWorkerContext* ctx, const std::string& szCommand)
+    {
+        if (szCommand == "pause")
+            SetPaused(ctx, true);
+        else if (szCommand == "resume")
+            SetPaused(ctx, false);
+        else if (szCommand == "stop")
+            ctx->bRunning = false;
+        else if (szCommand != "status")
+            return "error unknown command\n";
+
+        const char* szState = ctx->bRunning == false ? "stopped" : (ctx->bPaused == true ? "paused" : "running");
+        return std::string(szState) + " " + std::to_string((int)ctx->nProcessedFiles) + "/" + std::to_string((int)ctx->nTotalFiles) + "\n";
+    }
+    bool Open(worker::IWorkerContext* ctx)
+    {
+        CConsoleControl::ctx = ctx;
+        ::SetConsoleCtrlHandler(CtrlHandler, TRUE);
+
+        this->szPipeName = L"\\\\.\\pipe\\BatchEncoder-" + std::to_wstring(::GetCurrentProcessId());
+        this->hStop = ::CreateEventW(nullptr, TRUE, FALSE, nullptr);
+        if (this->hStop == nullptr)
+            return false;
+
+        this->pipeThread = std::thread([this]() { this->PipeLoop(); });
+        return true;
+    }
+    void Close()
+    {
+        if (this->hStop != nullptr)
+        {
+            ::SetEvent(this->hStop);
+            if (this->pipeThread.joinable())
+                this->pipeThread.join();
+            ::CloseHandle(this->hStop);
+            this->hStop = nullptr;
+        }
+
+        ::SetConsoleCtrlHandler(CtrlHandler, FALSE);
+        CConsoleControl::ctx = nullptr;
+    }
+private:
+    static BOOL WINAPI CtrlHandler(DWORD dwCtrlType)
+    {
+        // ctrl+break toggles pause, ctrl+c keeps its default behavior
+        worker::IWorkerContext* ctx = CConsoleControl::ctx;
+        if (dwCtrlType != CTRL_BREAK_EVENT || ctx == nullptr)
+            return FALSE;
+
+        SetPaused(ctx, ctx->bPaused == false);
+        return TRUE;
+    }
+public:
+    static bool Complete(HANDLE hPipe, OVERLAPPED* ov, BOOL bResult, DWORD* pBytes, HANDLE hStop)
+    {
+        DWORD dwBytes = 0;
+        if (bResult == FALSE)
+        {
+            DWORD dwError = ::GetLastError();
+            if (dwError == ERROR_PIPE_CONNECTED)
+                return true;
+            if (dwError != ERROR_IO_PENDING)
+                return false;
+
+            // pending i/o is cancelled when the control is closed
+            HANDLE handles[2] = { ov->hEvent, hStop };
+            if (::WaitForMultipleObjects(2, handles, FALSE, INFINITE) != WAIT_OBJECT_0)
+            {
+                ::CancelIo(hPipe);
+                ::GetOverlappedResult(hPipe, ov, &dwBytes, TRUE);
+                return false;
+            }
+        }
+
+        if (::GetOverlappedResult(hPipe, ov, &dwBytes, FALSE) == FALSE)
+            return false;
+        if (pBytes != nullptr)
+            *pBytes = dwBytes;
+        return true;
+    }
+private:
+    void PipeLoop()
+    {
+        // one client at a time, one command per line and one reply per command
+        OVERLAPPED ov;
+        ::ZeroMemory(&ov, sizeof(ov));
+        ov.hEvent = ::CreateEventW(nullptr, TRUE, FALSE, nullptr);
+        if (ov.hEvent == nullptr)
+            return;
+
+        while (::WaitForSingleObject(this->hStop, 0) != WAIT_OBJECT_0)
+        {
+            // default security only lets the owner and administrators write commands
+            HANDLE hPipe = ::CreateNamedPipeW(this->szPipeName.c_str(),
+                PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED | FILE_FLAG_FIRST_PIPE_INSTANCE,
+                PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+                1, 4096, 4096, 0, nullptr);
+            if (hPipe == INVALID_HANDLE_VALUE)
+                break;
+
+            if (Complete(hPipe, &ov, ::ConnectNamedPipe(hPipe, &ov), nullptr, this->hStop) == true)
+            {
+                std::string szBuffer;
+                char szRead[256];
+                DWORD dwRead = 0;
+                while (Complete(hPipe, &ov, ::ReadFile(hPipe, szRead, sizeof(szRead), nullptr, &ov), &dwRead, this->hStop) == true && dwRead > 0)
+                {
+                    szBuffer.append(szRead, dwRead);
+
+                    size_t nEnd;
+                    while ((nEnd = szBuffer.find('\n')) != std::string::npos)
+                    {
+                        std::string szCommand = szBuffer.substr(0, nEnd);
+                        szBuffer.erase(0, nEnd + 1);
+                        while (szCommand.empty() == false && (szCommand.back() == '\r' || szCommand.back() == ' '))
+                            szCommand.pop_back();
+
+                        std::string szReply = Execute(CConsoleControl::ctx, szCommand);
+                        DWORD dwWritten = 0;
+                        Complete(hPipe, &ov, ::WriteFile(hPipe, szReply.c_str(), (DWORD)szReply.length(), nullptr, &ov), &dwWritten, this->hStop);
+                    }
+                }
+            }
+
+            ::DisconnectNamedPipe(hPipe);
+            ::CloseHandle(hPipe);
+        }
+
+        ::CloseHandle(ov.hEvent);
+    }
+};
+
+class CDaemonServer
+{
+    worker::CDaemon* daemon;
+    std::thread pipeThread;
+    std::mutex m_Clients;
+    std::vector<std::pair<std::thread, std::shared_ptr<std::atomic<bool>>>> m_ClientThreads;
+    HANDLE hStop;
+public:
+    std::wstring szPipeName;
+    std::atomic<bool> bFailed;
+public:
+    CDaemonServer()
+    {
+        this->daemon = nullptr;
+        this->hStop = nullptr;
+        this->bFailed = false;
+    }
+    virtual ~CDaemonServer()
+    {
+        this->Close();
+    }
+public:
+    bool Open(worker::CDaemon* daemon, const std::wstring& szPipeName)
+    {
+        this->daemon = daemon;
+        this->szPipeName = szPipeName;
+        this->hStop = ::CreateEventW(nullptr, TRUE, FALSE, nullptr);
+        if (this->hStop == nullptr)
+            return false;
+
+        // first instance fails when another daemon already owns the pipe name
+        HANDLE hPipe = this->CreateInstance(true);
+        if (hPipe == INVALID_HANDLE_VALUE)
+        {
+            ::CloseHandle(this->hStop);
+            this->hStop = nullptr;
+            return false;
+        }
+
+        this->pipeThread = std::thread([this, hPipe]() { this->ListenLoop(hPipe); });
+        return true;
+    }
+    void Close()
+    {
+        if (this->hStop == nullptr)
+            return;
+
+        ::SetEvent(this->hStop);
+        if (this->pipeThread.joinable())
+            this->pipeThread.join();
+
+        this->JoinClients(true);
+
+        ::CloseHandle(this->hStop);
+        this->hStop = nullptr;
+    }
+private:
+    HANDLE CreateInstance(bool bFirst)
+    {
+        // default security only lets the owner and administrators submit jobs
+        return ::CreateNamedPipeW(this->szPipeName.c_str(),
+            PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED | (bFirst == true ? FILE_FLAG_FIRST_PIPE_INSTANCE : 0),
+            PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+            PIPE_UNLIMITED_INSTANCES, 4096, 4096, 0, nullptr);
+    }
+    HANDLE RecreateInstance()
+    {
+        // without a listening instance the daemon is unreachable, retry and shut it down if that keeps failing
+        const int nMaxAttempts = 10;
+        DWORD dwDelay = 100;
+        for (int nAttempt = 1; nAttempt <= nMaxAttempts; nAttempt++)
+        {
+            HANDLE hPipe = this->CreateInstance(false);
+            if (hPipe != INVALID_HANDLE_VALUE)
+                return hPipe;
+
+            DWORD dwError = ::GetLastError();
+            this->daemon->pConfig->Log->Log(L"[Error] Failed to create daemon pipe instance, error " + std::to_wstring(dwError) +
+                L", attempt " + std::to_wstring(nAttempt) + L" of " + std::to_wstring(nMaxAttempts));
+
+            if (nAttempt == nMaxAttempts || ::WaitForSingleObject(this->hStop, dwDelay) == WAIT_OBJECT_0)
+                break;
+
+            dwDelay = (std::min)(dwDelay * 2, (DWORD)5000);
+        }
+
+        // stop requested while waiting
+        if (::WaitForSingleObject(this->hStop, 0) == WAIT_OBJECT_0)
+            return INVALID_HANDLE_VALUE;
+
+        this->daemon->pConfig->Log->Log(L"[Error] Daemon pipe is unavailable, shutting down: " + this->szPipeName);
+        this->bFailed = true;
+        this->daemon->Shutdown();
+        return INVALID_HANDLE_VALUE;
+    }
+    void ListenLoop(HANDLE hPipe)
+    {
+        // every connected client is served on its own thread so batches run and stream concurrently
+        OVERLAPPED ov;
+        ::ZeroMemory(&ov, sizeof(ov));
+        ov.hEvent = ::CreateEventW(nullptr, TRUE, FALSE, nullptr);
+        if (ov.hEvent == nullptr)
+        {
+            ::CloseHandle(hPipe);
+            return;
+        }
+
+        while (hPipe != INVALID_HANDLE_VALUE)
+        {
+            ::ResetEvent(ov.hEvent);
+            if (CConsoleControl::Complete(hPipe, &ov, ::ConnectNamedPipe(hPipe, &ov), nullptr, this->hStop) == false)
+            {
+                ::CloseHandle(hPipe);
+                break;
+            }
+
+            this->JoinClients(false);
+            {
+                auto bFinished = std::make_shared<std::atomic<bool>>(false);
+                std::lock_guard<std::mutex> lock(this->m_Clients);
+                this->m_ClientThreads.emplace_back(std::thread([this, hPipe, bFinished]()
+                {
+                    this->ClientLoop(hPipe);
+                    *bFinished = true;
+                }), bFinished);
+            }
+
+            hPipe = this->RecreateInstance();
+        }
+
+        ::CloseHandle(ov.hEvent);
+    }
+    void JoinClients(bool bAll)
+    {
+        // threads of disconnected clients are joined as new clients arrive
+        std::lock_guard<std::mutex> lock(this->m_Clients);
+        for (auto it = this->m_ClientThreads.begin(); it != this->m_ClientThreads.end();)
+        {
+            if (bAll == true || *it->second == true)
+            {
+                if (it->first.joinable())
+                    it->first.join();
+                it = this->m_ClientThreads.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+    bool Write(HANDLE hPipe, OVERLAPPED* ov, const std::string& szText)
+    {
+        DWORD dwWritten = 0;
+        return CConsoleControl::Complete(hPipe, ov, ::WriteFile(hPipe, szText.c_str(), (DWORD)szText.length(), nullptr, ov), &dwWritten, this->hStop);
+    }
+    bool Stream(HANDLE hPipe, OVERLAPPED* ov, std::shared_ptr<worker::CJobContext> job, std::shared_ptr<worker::CJobSubscriber> subscriber)
+    {
+        // events are written until the job finishes, a failed write means the client went away
+        std::string szEvent;
+        bool bConnected = true;
+        while (bConnected == true && job->Next(subscriber, szEvent, 250) == true)
+        {
+            if (::WaitForSingleObject(this->hStop, 0) == WAIT_OBJECT_0)
+                bConnected = false;
+            else if (szEvent.empty() == false)
+                bConnected = this->Write(hPipe, ov, szEvent);
+        }
+
+        job->Detach(subscriber);
+        return bConnected;
+    }
+    void ClientLoop(HANDLE hPipe)
+    {
+        OVERLAPPED ov;
+        ::ZeroMemory(&ov, sizeof(ov));
+        ov.hEvent = ::CreateEventW(nullptr, TRUE, FALSE, nullptr);
+        if (ov.hEvent != nullptr)
+        {
+            std::string szBuffer;
+            char szRead[4096];
+            DWORD dwRead = 0;
+            bool bConnected = true;
+            while (bConnected == true && CConsoleControl::Complete(hPipe, &ov, ::ReadFile(hPipe, szRead, sizeof(szRead), nullptr, &ov), &dwRead, this->hStop) == true && dwRead > 0)
+            {
+                szBuffer.append(szRead, dwRead);
+
+                size_t nEnd;
+                while (bConnected == true && (nEnd = szBuffer.find('\n')) != std::string::npos)
+                {
+                    std::string szCommand = szBuffer.substr(0, nEnd);
+                    szBuffer.erase(0, nEnd + 1);
+                    while (szCommand.empty() == false && (szCommand.back() == '\r' || szCommand.back() == ' '))
+                        szCommand.pop_back();
+
+                    std::shared_ptr<worker::CJobContext> job;
+                    std::shared_ptr<worker::CJobSubscriber> subscriber;
+                    std::string szReply = this->daemon->Execute(szCommand, job, subscriber);
+                    bConnected = this->Write(hPipe, &ov, szReply);
+                    if (bConnected == true && job != nullptr)
+                        bConnected = this->Stream(hPipe, &ov, job, subscriber);
+                    else if (job != nullptr)
+                        job->Detach(subscriber);
+                }
+            }
+
+            ::CloseHandle(ov.hEvent);
+        }
+
+        if (::WaitForSingleObject(this->hStop, 0) != WAIT_OBJECT_0)
+            ::FlushFileBuffers(hPipe);
+        ::DisconnectNamedPipe(hPipe);
+        ::CloseHandle(hPipe);
+    }
+};
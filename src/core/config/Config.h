@@ -336,6 +336,26 @@ namespace config::xml
             GetChildValueInt(element, "RenameExistingFilesLimit", &m_Options.nRenameExistingFilesLimit);
             GetChildValueBool(element, "TryToDownloadTools", &m_Options.bTryToDownloadTools);
             GetChildValueInt(element, "ThreadCount", &m_Options.nThreadCount);
+            GetChildValueInt(element, "MemoryBudget", &m_Options.nMemoryBudget);
+            GetChildValueBool(element, "AdaptiveThreadCount", &m_Options.bAdaptiveThreadCount);
+            GetChildValueInt(element, "MinThreadCount", &m_Options.nMinThreadCount);
+            GetChildValueBool(element, "PinWorkerSlots", &m_Options.bPinWorkerSlots);
+            GetChildValueInt(element, "ProcessNice", &m_Options.nProcessNice);
+            GetChildValueInt(element, "ProcessIoClass", &m_Options.nProcessIoClass);
+            GetChildValueInt(element, "ProcessMemoryLimit", &m_Options.nProcessMemoryLimit);
+            GetChildValueInt(element, "ProcessWorkingSetLimit", &m_Options.nProcessWorkingSetLimit);
+            GetChildValueInt(element, "ProcessWallTime", &m_Options.nProcessWallTime);
+            GetChildValueInt(element, "StallTimeout", &m_Options.nStallTimeout);
+            GetChildValueInt(element, "WallTimeout", &m_Options.nWallTimeout);
+            GetChildValueInt(element, "RetryCount", &m_Options.nRetryCount);
+            GetChildValueInt(element, "RetryDelay", &m_Options.nRetryDelay);
+            GetChildValueInt(element, "RetryMaxDelay", &m_Options.nRetryMaxDelay);
+            GetChildValueString(element, "RetryPatterns", &m_Options.szRetryPatterns);
+            GetChildValueString(element, "MetricsFile", &m_Options.szMetricsFile);
+            GetChildValueString(element, "TraceFile", &m_Options.szTraceFile);
+            GetChildValueString(element, "PrometheusFile", &m_Options.szPrometheusFile);
+            GetChildValueBool(element, "LogToolOutput", &m_Options.bLogToolOutput);
+            GetChildValueInt(element, "StderrTailSize", &m_Options.nStderrTailSize);
             GetChildValueString(element, "OutputBrowse", &m_Options.szOutputBrowse);
             GetChildValueString(element, "DirectoryBrowse", &m_Options.szDirectoryBrowse);
             GetChildValueString(element, "MainWindowResize", &m_Options.szMainWindowResize);
@@ -370,6 +390,26 @@ namespace config::xml
             SetChildValueInt(element, "RenameExistingFilesLimit", m_Options.nRenameExistingFilesLimit);
             SetChildValueBool(element, "TryToDownloadTools", m_Options.bTryToDownloadTools);
             SetChildValueInt(element, "ThreadCount", m_Options.nThreadCount);
+            SetChildValueInt(element, "MemoryBudget", m_Options.nMemoryBudget);
+            SetChildValueBool(element, "AdaptiveThreadCount", m_Options.bAdaptiveThreadCount);
+            SetChildValueInt(element, "MinThreadCount", m_Options.nMinThreadCount);
+            SetChildValueBool(element, "PinWorkerSlots", m_Options.bPinWorkerSlots);
+            SetChildValueInt(element, "ProcessNice", m_Options.nProcessNice);
+            SetChildValueInt(element, "ProcessIoClass", m_Options.nProcessIoClass);
+            SetChildValueInt(element, "ProcessMemoryLimit", m_Options.nProcessMemoryLimit);
+            SetChildValueInt(element, "ProcessWorkingSetLimit", m_Options.nProcessWorkingSetLimit);
+            SetChildValueInt(element, "ProcessWallTime", m_Options.nProcessWallTime);
+            SetChildValueInt(element, "StallTimeout", m_Options.nStallTimeout);
+            SetChildValueInt(element, "WallTimeout", m_Options.nWallTimeout);
+            SetChildValueInt(element, "RetryCount", m_Options.nRetryCount);
+            SetChildValueInt(element, "RetryDelay", m_Options.nRetryDelay);
+            SetChildValueInt(element, "RetryMaxDelay", m_Options.nRetryMaxDelay);
+            SetChildValueString(element, "RetryPatterns", m_Options.szRetryPatterns);
+            SetChildValueString(element, "MetricsFile", m_Options.szMetricsFile);
+            SetChildValueString(element, "TraceFile", m_Options.szTraceFile);
+            SetChildValueString(element, "PrometheusFile", m_Options.szPrometheusFile);
+            SetChildValueBool(element, "LogToolOutput", m_Options.bLogToolOutput);
+            SetChildValueInt(element, "StderrTailSize", m_Options.nStderrTailSize);
             SetChildValueString(element, "OutputBrowse", m_Options.szOutputBrowse);
             SetChildValueString(element, "DirectoryBrowse", m_Options.szDirectoryBrowse);
             SetChildValueString(element, "MainWindowResize", m_Options.szMainWindowResize);
@@ -774,6 +814,20 @@ namespace config::xml
             VALIDATE(GetAttributeValueString(element, "extension", &m_Format.szOutputExtension));
             VALIDATE(GetAttributeValueSizeT(element, "default", &m_Format.nDefaultPreset));
 
+            // optional, older format files do not have memory estimate
+            GetAttributeValueInt(element, "memory", &m_Format.nMemory);
+
+            // optional, process limits, missing attribute uses global option
+            GetAttributeValueInt(element, "nice", &m_Format.nNice);
+            GetAttributeValueInt(element, "ioclass", &m_Format.nIoClass);
+            GetAttributeValueInt(element, "memorylimit", &m_Format.nMemoryLimit);
+            GetAttributeValueInt(element, "workingsetlimit", &m_Format.nWorkingSetLimit);
+            GetAttributeValueInt(element, "walltime", &m_Format.nWallTime);
+
+            // optional, watchdog timeouts
+            GetAttributeValueInt(element, "stalltimeout", &m_Format.nStallTimeout);
+            GetAttributeValueInt(element, "walltimeout", &m_Format.nWallTimeout);
+
             auto parent = element->FirstChildElement("Presets");
             if (parent != nullptr)
             {
@@ -801,6 +855,22 @@ namespace config::xml
             SetAttributeValueString(element, "formats", m_Format.szInputExtensions);
             SetAttributeValueString(element, "extension", m_Format.szOutputExtension);
             SetAttributeValueSizeT(element, "default", m_Format.nDefaultPreset);
+            if (m_Format.nMemory > 0)
+                SetAttributeValueInt(element, "memory", m_Format.nMemory);
+            if (m_Format.nNice != config::CFormat::nInherit)
+                SetAttributeValueInt(element, "nice", m_Format.nNice);
+            if (m_Format.nIoClass != config::CFormat::nInherit)
+                SetAttributeValueInt(element, "ioclass", m_Format.nIoClass);
+            if (m_Format.nMemoryLimit != config::CFormat::nInherit)
+                SetAttributeValueInt(element, "memorylimit", m_Format.nMemoryLimit);
+            if (m_Format.nWorkingSetLimit != config::CFormat::nInherit)
+                SetAttributeValueInt(element, "workingsetlimit", m_Format.nWorkingSetLimit);
+            if (m_Format.nWallTime != config::CFormat::nInherit)
+                SetAttributeValueInt(element, "walltime", m_Format.nWallTime);
+            if (m_Format.nStallTimeout > 0)
+                SetAttributeValueInt(element, "stalltimeout", m_Format.nStallTimeout);
+            if (m_Format.nWallTimeout > 0)
+                SetAttributeValueInt(element, "walltimeout", m_Format.nWallTimeout);
 
             auto parent = this->NewElement("Presets");
             element->LinkEndChild(parent);
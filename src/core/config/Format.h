@@ -6,6 +6,7 @@
 #include <string>
 #include <algorithm>
 #include <vector>
+#include <climits>
 #include "utilities\String.h"
 #include "Preset.h"
 
@@ -21,6 +22,9 @@ namespace config
     {
     private:
         static const wchar_t token = ',';
+    public:
+        // process limit value that uses the global option, any other value including 0 overrides it
+        static const int nInherit = INT_MIN;
     public:
         std::wstring szId;
         std::wstring szName;
@@ -38,6 +42,18 @@ namespace config
     public:
         size_t nDefaultPreset;
         std::vector<CPreset> m_Presets;
+    public:
+        // expected peak memory of one item in MB, 0 is unknown
+        int nMemory = 0;
+        // process limits, nInherit uses global option
+        int nNice = nInherit;
+        int nIoClass = nInherit;
+        int nMemoryLimit = nInherit;
+        int nWorkingSetLimit = nInherit;
+        int nWallTime = nInherit;
+        // watchdog timeouts of one item in seconds, 0 uses global option
+        int nStallTimeout = 0;
+        int nWallTimeout = 0;
     public:
         static inline int ToInt(const FormatType value)
         {
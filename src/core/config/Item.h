@@ -6,6 +6,7 @@
 #include <string>
 #include <algorithm>
 #include <vector>
+#include <cstdio>
 #include "Path.h"
 
 namespace config
@@ -36,6 +37,13 @@ namespace config
             this->nProgress = 0;
             this->nPreviousProgress = 0;
         }
+        void SetProgressStatus(int nProgress)
+        {
+            // formats in place so status capacity is reused between progress events
+            wchar_t szProgress[16];
+            int nLength = _snwprintf_s(szProgress, _TRUNCATE, L"%d%%", nProgress);
+            this->szStatus.assign(szProgress, nLength > 0 ? nLength : 0);
+        }
     public:
         static inline void SetIds(std::vector<CItem>& items)
         {
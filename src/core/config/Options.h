@@ -28,6 +28,26 @@ namespace config
         int nRenameExistingFilesLimit;
         bool bTryToDownloadTools;
         int nThreadCount;
+        int nMemoryBudget;
+        bool bAdaptiveThreadCount;
+        int nMinThreadCount;
+        bool bPinWorkerSlots;
+        int nProcessNice;
+        int nProcessIoClass;
+        int nProcessMemoryLimit;
+        int nProcessWorkingSetLimit;
+        int nProcessWallTime;
+        int nStallTimeout;
+        int nWallTimeout;
+        int nRetryCount;
+        int nRetryDelay;
+        int nRetryMaxDelay;
+        std::wstring szRetryPatterns;
+        std::wstring szMetricsFile;
+        std::wstring szTraceFile;
+        std::wstring szPrometheusFile;
+        bool bLogToolOutput;
+        int nStderrTailSize;
         std::wstring szOutputBrowse;
         std::wstring szDirectoryBrowse;
         std::wstring szMainWindowResize;
@@ -61,6 +81,26 @@ namespace config
             this->nRenameExistingFilesLimit = 100;
             this->bTryToDownloadTools = true;
             this->nThreadCount = 0;
+            this->nMemoryBudget = 0;
+            this->bAdaptiveThreadCount = false;
+            this->nMinThreadCount = 1;
+            this->bPinWorkerSlots = false;
+            this->nProcessNice = 0;
+            this->nProcessIoClass = 0;
+            this->nProcessMemoryLimit = 0;
+            this->nProcessWorkingSetLimit = 0;
+            this->nProcessWallTime = 0;
+            this->nStallTimeout = 0;
+            this->nWallTimeout = 0;
+            this->nRetryCount = 0;
+            this->nRetryDelay = 1000;
+            this->nRetryMaxDelay = 30000;
+            this->szRetryPatterns = L"network|i/o error|sharing violation|used by another process|timed out|temporarily unavailable|device is not ready";
+            this->szMetricsFile = L"";
+            this->szTraceFile = L"";
+            this->szPrometheusFile = L"";
+            this->bLogToolOutput = false;
+            this->nStderrTailSize = 8192;
             this->szOutputBrowse = L"";
             this->szDirectoryBrowse = L"";
             this->szMainWindowResize = L"";
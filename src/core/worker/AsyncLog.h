@@ -0,0 +1,233 @@
+﻿// Copyright (c) Wiesław Šoltés. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#pragma once
+
+#include <string>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <cstdio>
+#include <cwchar>
+#include "utilities\Log.h"
+
+namespace worker
+{
+    class CLogRecord
+    {
+    public:
+        static const int nMaxLength = 256;
+    public:
+        std::atomic<size_t> nSequence;
+        int nItemId;
+        bool bNewLine;
+        wchar_t szText[nMaxLength];
+        // messages that do not fit the record are kept on the heap
+        std::wstring szLong;
+    public:
+        const wchar_t* Text() const
+        {
+            return this->szLong.empty() == false ? this->szLong.c_str() : this->szText;
+        }
+    };
+
+    class CAsyncLog : public util::ILog
+    {
+        std::unique_ptr<util::ILog> Sink;
+        std::unique_ptr<CLogRecord[]> m_Records;
+        size_t nMask;
+        std::atomic<size_t> nEnqueue;
+        size_t nDequeue;
+        std::atomic<size_t> nDropped;
+        std::atomic<bool> bRunning;
+        std::atomic<bool> bClosed;
+        std::mutex m_Flush;
+        std::thread flushThread;
+    public:
+        CAsyncLog(std::unique_ptr<util::ILog> sink, size_t nCapacity = 4096)
+        {
+            size_t nSize = 2;
+            while (nSize < nCapacity)
+                nSize <<= 1;
+
+            this->Sink = std::move(sink);
+            this->m_Records = std::make_unique<CLogRecord[]>(nSize);
+            for (size_t i = 0; i < nSize; i++)
+                this->m_Records[i].nSequence.store(i, std::memory_order_relaxed);
+            this->nMask = nSize - 1;
+            this->nEnqueue = 0;
+            this->nDequeue = 0;
+            this->nDropped = 0;
+            this->bRunning = false;
+            this->bClosed = false;
+        }
+        virtual ~CAsyncLog()
+        {
+            this->Close();
+        }
+    public:
+        bool Open()
+        {
+            if (this->bRunning == true)
+                return true;
+
+            if (this->Sink->Open() == false)
+                return false;
+
+            this->bClosed = false;
+            this->bRunning = true;
+            this->flushThread = std::thread([this]() { this->FlushLoop(); });
+            return true;
+        }
+        void Close()
+        {
+            if (this->bRunning == false)
+                return;
+
+            // records logged from now on are flushed by their producer
+            this->bClosed = true;
+            this->bRunning = false;
+            if (this->flushThread.joinable())
+                this->flushThread.join();
+
+            this->Flush();
+            this->Sink->Close();
+        }
+        void Log(const std::wstring& szMessage, bool bNewLine = true)
+        {
+            this->Log(-1, szMessage.c_str(), bNewLine);
+        }
+    public:
+        size_t Capacity() const
+        {
+            return this->nMask + 1;
+        }
+        size_t Dropped() const
+        {
+            return this->nDropped;
+        }
+        bool Log(int nItemId, const wchar_t* szText, bool bNewLine = true)
+        {
+            CLogRecord* pRecord = this->Acquire();
+            if (pRecord == nullptr)
+                return false;
+
+            pRecord->nItemId = nItemId;
+            pRecord->bNewLine = bNewLine;
+
+            size_t nLength = wcslen(szText);
+            if (nLength < CLogRecord::nMaxLength)
+                wcsncpy_s(pRecord->szText, CLogRecord::nMaxLength, szText, nLength);
+            else
+                pRecord->szLong.assign(szText, nLength);
+
+            this->Publish(pRecord);
+            return true;
+        }
+        bool Log(int nItemId, const char* szText, bool bNewLine = true)
+        {
+            CLogRecord* pRecord = this->Acquire();
+            if (pRecord == nullptr)
+                return false;
+
+            pRecord->nItemId = nItemId;
+            pRecord->bNewLine = bNewLine;
+
+            int nLength = (int)strlen(szText);
+            int nWide = ::MultiByteToWideChar(CP_ACP, 0, szText, nLength, nullptr, 0);
+            if (nWide < CLogRecord::nMaxLength)
+            {
+                int nResult = ::MultiByteToWideChar(CP_ACP, 0, szText, nLength, pRecord->szText, CLogRecord::nMaxLength - 1);
+                pRecord->szText[nResult > 0 ? nResult : 0] = L'\0';
+            }
+            else
+            {
+                pRecord->szLong.resize(nWide);
+                ::MultiByteToWideChar(CP_ACP, 0, szText, nLength, &pRecord->szLong[0], nWide);
+            }
+
+            this->Publish(pRecord);
+            return true;
+        }
+        size_t Flush()
+        {
+            std::lock_guard<std::mutex> lock(this->m_Flush);
+            size_t nCount = 0;
+            std::wstring szMessage;
+
+            while (true)
+            {
+                CLogRecord* pRecord = &this->m_Records[this->nDequeue & this->nMask];
+                size_t nSequence = pRecord->nSequence.load(std::memory_order_acquire);
+                if (nSequence != this->nDequeue + 1)
+                    break;
+
+                if (pRecord->nItemId >= 0)
+                    szMessage = L"[Item " + std::to_wstring(pRecord->nItemId) + L"] " + pRecord->Text();
+                else
+                    szMessage = pRecord->Text();
+
+                bool bNewLine = pRecord->bNewLine;
+                if (pRecord->szLong.empty() == false)
+                    std::wstring().swap(pRecord->szLong);
+
+                pRecord->nSequence.store(this->nDequeue + this->nMask + 1, std::memory_order_release);
+                this->nDequeue++;
+
+                this->Sink->Log(szMessage, bNewLine);
+                nCount++;
+            }
+
+            size_t nDropped = this->nDropped.exchange(0);
+            if (nDropped > 0)
+                this->Sink->Log(L"[Warning] Dropped " + std::to_wstring(nDropped) + L" log records.");
+
+            return nCount;
+        }
+    private:
+        CLogRecord* Acquire()
+        {
+            size_t nPosition = this->nEnqueue.load(std::memory_order_relaxed);
+            while (true)
+            {
+                CLogRecord* pRecord = &this->m_Records[nPosition & this->nMask];
+                size_t nSequence = pRecord->nSequence.load(std::memory_order_acquire);
+                intptr_t nDiff = (intptr_t)nSequence - (intptr_t)nPosition;
+                if (nDiff == 0)
+                {
+                    if (this->nEnqueue.compare_exchange_weak(nPosition, nPosition + 1, std::memory_order_relaxed))
+                        return pRecord;
+                }
+                else if (nDiff < 0)
+                {
+                    // buffer is full, drop record instead of blocking producer
+                    this->nDropped++;
+                    return nullptr;
+                }
+                else
+                {
+                    nPosition = this->nEnqueue.load(std::memory_order_relaxed);
+                }
+            }
+        }
+        void Publish(CLogRecord* pRecord)
+        {
+            size_t nPosition = pRecord->nSequence.load(std::memory_order_relaxed);
+            pRecord->nSequence.store(nPosition + 1, std::memory_order_release);
+
+            // without the flush thread a late record would wait for the next open
+            if (this->bClosed == true)
+                this->Flush();
+        }
+        void FlushLoop()
+        {
+            while (this->bRunning == true)
+            {
+                if (this->Flush() == 0)
+                    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            }
+        }
+    };
+}
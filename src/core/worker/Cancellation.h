@@ -0,0 +1,177 @@
+﻿// Copyright (c) Wiesław Šoltés. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <condition_variable>
+#include "WorkerContext.h"
+
+namespace worker
+{
+    class CCancellation
+    {
+        std::mutex m_Lock;
+        std::condition_variable m_Changed;
+        std::thread monitorThread;
+        bool bMonitoring;
+        bool bCancelled;
+        bool bSuspended;
+        std::vector<std::shared_ptr<IProcess>> m_Processes;
+    public:
+        int nInterval;
+    public:
+        CCancellation()
+        {
+            this->bMonitoring = false;
+            this->bCancelled = false;
+            this->bSuspended = false;
+            this->nInterval = 50;
+        }
+        virtual ~CCancellation()
+        {
+            this->Stop();
+        }
+    public:
+        bool Cancelled()
+        {
+            std::lock_guard<std::mutex> lock(this->m_Lock);
+            return this->bCancelled;
+        }
+        bool Suspended()
+        {
+            std::lock_guard<std::mutex> lock(this->m_Lock);
+            return this->bSuspended;
+        }
+        int Count()
+        {
+            std::lock_guard<std::mutex> lock(this->m_Lock);
+            return (int)this->m_Processes.size();
+        }
+        void Register(std::shared_ptr<IProcess> process)
+        {
+            std::unique_lock<std::mutex> lock(this->m_Lock);
+            this->m_Processes.push_back(process);
+
+            // process started while batch was paused, suspended under the lock so resume can not be missed
+            if (this->bSuspended == true)
+                process->Suspend();
+
+            // process started while batch was being cancelled
+            if (this->bCancelled == true)
+            {
+                lock.unlock();
+                process->Terminate(-1);
+            }
+        }
+        void Unregister(IProcess* process)
+        {
+            std::lock_guard<std::mutex> lock(this->m_Lock);
+            auto it = std::find_if(this->m_Processes.begin(), this->m_Processes.end(),
+                [process](const std::shared_ptr<IProcess>& p) { return p.get() == process; });
+            if (it != this->m_Processes.end())
+                this->m_Processes.erase(it);
+        }
+        void Cancel()
+        {
+            std::vector<std::shared_ptr<IProcess>> processes;
+            {
+                std::lock_guard<std::mutex> lock(this->m_Lock);
+                this->bCancelled = true;
+                processes = this->m_Processes;
+            }
+
+            // killed process trees close their pipes so blocked reads and writes return
+            for (auto& process : processes)
+                process->Terminate(-1);
+
+            this->m_Changed.notify_all();
+        }
+        void Suspend()
+        {
+            std::lock_guard<std::mutex> lock(this->m_Lock);
+            if (this->bSuspended == true)
+                return;
+
+            // whole process trees are frozen, their pipes stay open and in-flight work is kept
+            this->bSuspended = true;
+            for (auto& process : this->m_Processes)
+                process->Suspend();
+        }
+        void Resume()
+        {
+            std::lock_guard<std::mutex> lock(this->m_Lock);
+            if (this->bSuspended == false)
+                return;
+
+            this->bSuspended = false;
+            for (auto& process : this->m_Processes)
+                process->Resume();
+        }
+        void Start(IWorkerContext* ctx)
+        {
+            this->bCancelled = false;
+            this->bSuspended = false;
+            this->bMonitoring = true;
+            this->monitorThread = std::thread([this, ctx]() { this->MonitorLoop(ctx); });
+        }
+        void Stop()
+        {
+            {
+                std::lock_guard<std::mutex> lock(this->m_Lock);
+                this->bMonitoring = false;
+            }
+            this->m_Changed.notify_all();
+            if (this->monitorThread.joinable())
+                this->monitorThread.join();
+        }
+    private:
+        void MonitorLoop(IWorkerContext* ctx)
+        {
+            // stop and pause are signalled by ctx->bRunning and ctx->bPaused, polling bounds the latency
+            std::unique_lock<std::mutex> lock(this->m_Lock);
+            while (this->bMonitoring == true)
+            {
+                this->m_Changed.wait_for(lock, std::chrono::milliseconds(this->nInterval));
+                if (this->bMonitoring == false || this->bCancelled == true)
+                    continue;
+
+                bool bStop = ctx->bRunning == false;
+                bool bPause = ctx->bPaused == true;
+                if (bStop == false && bPause == this->bSuspended)
+                    continue;
+
+                lock.unlock();
+                if (bStop == true)
+                    this->Cancel();
+                else if (bPause == true)
+                    this->Suspend();
+                else
+                    this->Resume();
+                lock.lock();
+            }
+        }
+    };
+
+    class CCancelRegistration
+    {
+        CCancellation* cancellation;
+        std::shared_ptr<IProcess> process;
+    public:
+        CCancelRegistration(CCancellation* cancellation, std::shared_ptr<IProcess> process) : cancellation(cancellation), process(process)
+        {
+            if (this->cancellation != nullptr)
+                this->cancellation->Register(this->process);
+        }
+        ~CCancelRegistration()
+        {
+            if (this->cancellation != nullptr)
+                this->cancellation->Unregister(this->process.get());
+        }
+    };
+}
@@ -0,0 +1,821 @@
+﻿// Copyright (c) Wiesław Šoltés. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <algorithm>
+#include <condition_variable>
+#include "utilities\FileSystem.h"
+#include "utilities\Log.h"
+#include "utilities\Utf8String.h"
+#include "config\Config.h"
+#include "AsyncLog.h"
+#include "WorkerContext.h"
+#include "JobScheduler.h"
+#include "MemoryBudget.h"
+#include "LoadController.h"
+#include "Worker.h"
+
+namespace worker
+{
+    enum class JobState : int
+    {
+        Queued,
+        Running,
+        Done,
+        Failed,
+        Stopped
+    };
+
+    class CJobRequest
+    {
+    public:
+        std::wstring szFormatId;
+        int nPreset = -1;
+        std::wstring szOutputPath;
+        std::vector<std::wstring> m_Files;
+    public:
+        std::wstring szSubmitter;
+        int nPriority = 0;
+        int nWeight = 1;
+        int nDeadline = 0;
+        bool bInteractive = false;
+    public:
+        static std::vector<std::string> Split(const std::string& szLine)
+        {
+            // fields are tab separated so paths may contain spaces, short commands may use spaces
+            char chSeparator = szLine.find('\t') != std::string::npos ? '\t' : ' ';
+            std::vector<std::string> fields;
+            size_t nStart = 0;
+            while (nStart <= szLine.length())
+            {
+                size_t nEnd = szLine.find(chSeparator, nStart);
+                if (nEnd == std::string::npos)
+                    nEnd = szLine.length();
+
+                std::string szField = szLine.substr(nStart, nEnd - nStart);
+                if (chSeparator == '\t' || szField.empty() == false)
+                    fields.emplace_back(std::move(szField));
+
+                nStart = nEnd + 1;
+            }
+            return fields;
+        }
+        static bool ParseInt(const std::string& szValue, int& nValue)
+        {
+            char* pEnd = nullptr;
+            long nResult = std::strtol(szValue.c_str(), &pEnd, 10);
+            if (szValue.empty() == true || pEnd == nullptr || *pEnd != '\0')
+                return false;
+            nValue = (int)nResult;
+            return true;
+        }
+        static bool ParseOption(const std::string& szOption, CJobRequest& request)
+        {
+            size_t nEqual = szOption.find('=');
+            std::string szName = szOption.substr(2, nEqual == std::string::npos ? std::string::npos : nEqual - 2);
+            std::string szValue = nEqual == std::string::npos ? "" : szOption.substr(nEqual + 1);
+
+            if (szName == "interactive")
+            {
+                request.bInteractive = true;
+                return nEqual == std::string::npos;
+            }
+            if (szName == "submitter")
+            {
+                request.szSubmitter = util::ToUnicode(szValue.c_str());
+                return true;
+            }
+            if (szName == "priority")
+                return ParseInt(szValue, request.nPriority);
+            if (szName == "weight")
+                return ParseInt(szValue, request.nWeight) && request.nWeight > 0;
+            if (szName == "deadline")
+                return ParseInt(szValue, request.nDeadline) && request.nDeadline >= 0;
+            return false;
+        }
+        static bool Parse(const std::vector<std::string>& fields, CJobRequest& request)
+        {
+            // submit [--option=value]... <format> <preset> <output> <file>...
+            if (fields.empty() == true || fields[0] != "submit")
+                return false;
+
+            request.szSubmitter.clear();
+            request.nPriority = 0;
+            request.nWeight = 1;
+            request.nDeadline = 0;
+            request.bInteractive = false;
+
+            size_t nField = 1;
+            while (nField < fields.size() && fields[nField].compare(0, 2, "--") == 0)
+            {
+                if (ParseOption(fields[nField], request) == false)
+                    return false;
+                nField++;
+            }
+
+            if (fields.size() < nField + 4 || fields[nField].empty() == true)
+                return false;
+
+            request.szFormatId = util::ToUnicode(fields[nField].c_str());
+
+            request.nPreset = -1;
+            if (fields[nField + 1].empty() == false && fields[nField + 1] != "-")
+            {
+                if (ParseInt(fields[nField + 1], request.nPreset) == false || request.nPreset < 0)
+                    return false;
+            }
+
+            request.szOutputPath.clear();
+            if (fields[nField + 2] != "-")
+                request.szOutputPath = util::ToUnicode(fields[nField + 2].c_str());
+
+            request.m_Files.clear();
+            for (size_t i = nField + 3; i < fields.size(); i++)
+            {
+                if (fields[i].empty() == false)
+                    request.m_Files.emplace_back(util::ToUnicode(fields[i].c_str()));
+            }
+            return request.m_Files.empty() == false;
+        }
+    };
+
+    class CJobLog : public util::ILog
+    {
+        util::ILog* Sink;
+        std::wstring szPrefix;
+    public:
+        CJobLog(util::ILog* sink, int nJobId)
+        {
+            this->Sink = sink;
+            this->szPrefix = L"[Job " + std::to_wstring(nJobId) + L"] ";
+        }
+        virtual ~CJobLog() { }
+    public:
+        bool Open()
+        {
+            return true;
+        }
+        void Close()
+        {
+        }
+        void Log(const std::wstring& szMessage, bool bNewLine = true)
+        {
+            if (this->Sink != nullptr)
+                this->Sink->Log(this->szPrefix + szMessage, bNewLine);
+        }
+    };
+
+    class CJobSubscriber
+    {
+    public:
+        std::deque<std::string> m_Events;
+    };
+
+    class CJobContext : public IWorkerContext
+    {
+        std::mutex m_Lock;
+        std::condition_variable m_Changed;
+        std::vector<std::shared_ptr<CJobSubscriber>> m_Subscribers;
+        bool bFinished;
+        std::atomic<int> nReportedFiles;
+    public:
+        int nJobId;
+        std::atomic<JobState> nState;
+        std::atomic<bool> bStopRequested;
+        config::CConfig m_Config;
+        CJobShare share;
+    public:
+        CJobContext(int nJobId, std::shared_ptr<IWorkerFactory> pFactory)
+        {
+            this->bDone = true;
+            this->bRunning = false;
+            this->pConfig = &this->m_Config;
+            this->pFactory = pFactory;
+            this->bFinished = false;
+            this->nReportedFiles = 0;
+            this->nJobId = nJobId;
+            this->nState = JobState::Queued;
+            this->bStopRequested = false;
+        }
+        virtual ~CJobContext() { }
+    public:
+        std::wstring GetString(int nKey)
+        {
+            return this->m_Config.GetString(nKey);
+        }
+        void Init()
+        {
+            this->bRunning = true;
+            this->bDone = false;
+            this->nTotalFiles = 0;
+            this->nProcessedFiles = 0;
+            this->nErrors = 0;
+            this->nLastItemId = -1;
+            this->nRunningFiles = 0;
+            this->nActiveProcesses = 0;
+            this->bPaused = false;
+            this->nReportedFiles = 0;
+        }
+        void Start()
+        {
+        }
+        void Stop()
+        {
+            this->bRunning = false;
+        }
+        bool ItemProgress(int nItemId, int nProgress, bool bFinished, bool bError = false)
+        {
+            config::CItem &item = this->m_Config.m_Items[nItemId];
+            if (bError == true)
+            {
+                item.bFinished = true;
+                if (this->StopOnError(nItemId) == true)
+                {
+                    this->bRunning = false;
+                }
+                return this->bRunning;
+            }
+
+            if (bFinished == true)
+            {
+                item.bFinished = true;
+            }
+
+            if ((bFinished == false) && (this->bRunning == true))
+            {
+                item.nProgress = nProgress;
+            }
+
+            return this->bRunning;
+        }
+        void ItemStatus(int nItemId, const std::wstring& szTime, const std::wstring& szStatus)
+        {
+            config::CItem &item = this->m_Config.m_Items[nItemId];
+            item.szTime = szTime;
+            item.szStatus = szStatus;
+
+            this->Post("item\t" + std::to_string(this->nJobId) + "\t" + std::to_string(nItemId) + "\t" +
+                util::ToUtf8(item.szName) + "\t" + util::ToUtf8(szTime) + "\t" + util::ToUtf8(szStatus) + "\n");
+        }
+        void TotalProgress(int nItemId)
+        {
+            if (nItemId > this->nLastItemId)
+                this->nLastItemId = nItemId;
+
+            int nProcessed = this->nProcessedFiles;
+            if (this->nReportedFiles.exchange(nProcessed) != nProcessed)
+            {
+                this->Post("progress\t" + std::to_string(this->nJobId) + "\t" + std::to_string(nProcessed) + "\t" +
+                    std::to_string((int)this->nTotalFiles) + "\n");
+            }
+        }
+    public:
+        const char* State()
+        {
+            switch (this->nState.load())
+            {
+            case JobState::Queued: return this->bPaused == true ? "paused" : "queued";
+            case JobState::Running: return this->bPaused == true ? "paused" : "running";
+            case JobState::Done: return "done";
+            case JobState::Failed: return "failed";
+            case JobState::Stopped: return "stopped";
+            default: return "unknown";
+            }
+        }
+        std::string Status()
+        {
+            return "job\t" + std::to_string(this->nJobId) + "\t" + this->State() + "\t" +
+                std::to_string((int)this->nProcessedFiles) + "\t" + std::to_string(this->m_Config.m_Items.size()) + "\t" +
+                std::to_string((int)this->nErrors) + "\n";
+        }
+        void Post(const std::string& szEvent)
+        {
+            {
+                // events are only buffered for clients that stream them, each into its own queue
+                std::lock_guard<std::mutex> lock(this->m_Lock);
+                if (this->m_Subscribers.empty() == true)
+                    return;
+                for (auto& subscriber : this->m_Subscribers)
+                    subscriber->m_Events.emplace_back(szEvent);
+            }
+            this->m_Changed.notify_all();
+        }
+        std::shared_ptr<CJobSubscriber> Attach()
+        {
+            std::lock_guard<std::mutex> lock(this->m_Lock);
+            auto subscriber = std::make_shared<CJobSubscriber>();
+            this->m_Subscribers.emplace_back(subscriber);
+            return subscriber;
+        }
+        void Detach(const std::shared_ptr<CJobSubscriber>& subscriber)
+        {
+            // only the leaving client stops receiving events, buffering ends with the last one
+            std::lock_guard<std::mutex> lock(this->m_Lock);
+            auto it = std::find(this->m_Subscribers.begin(), this->m_Subscribers.end(), subscriber);
+            if (it != this->m_Subscribers.end())
+                this->m_Subscribers.erase(it);
+            subscriber->m_Events.clear();
+        }
+        size_t Subscribers()
+        {
+            std::lock_guard<std::mutex> lock(this->m_Lock);
+            return this->m_Subscribers.size();
+        }
+        bool Next(const std::shared_ptr<CJobSubscriber>& subscriber, std::string& szEvent, int nTimeout)
+        {
+            // returns false once the job has finished and all events were read, timeout gives an empty event
+            std::unique_lock<std::mutex> lock(this->m_Lock);
+            szEvent.clear();
+            if (subscriber->m_Events.empty() == true && this->bFinished == false)
+                this->m_Changed.wait_for(lock, std::chrono::milliseconds(nTimeout));
+
+            if (subscriber->m_Events.empty() == false)
+            {
+                szEvent = std::move(subscriber->m_Events.front());
+                subscriber->m_Events.pop_front();
+                return true;
+            }
+            return this->bFinished == false;
+        }
+        bool Finished()
+        {
+            std::lock_guard<std::mutex> lock(this->m_Lock);
+            return this->bFinished;
+        }
+        void Finish(JobState nState)
+        {
+            this->nState = nState;
+            this->bRunning = false;
+            this->bDone = true;
+            this->Post(this->Status());
+            {
+                std::lock_guard<std::mutex> lock(this->m_Lock);
+                this->bFinished = true;
+            }
+            this->m_Changed.notify_all();
+        }
+    };
+
+    class CDaemon
+    {
+        std::mutex m_Lock;
+        std::condition_variable m_Changed;
+        std::deque<std::shared_ptr<CJobContext>> m_Queue;
+        std::vector<std::shared_ptr<CJobContext>> m_Jobs;
+        std::vector<std::thread> m_Runners;
+        std::thread interactiveRunner;
+        bool bRunning;
+        bool bShutdown;
+        int nNextJobId;
+    public:
+        config::CConfig* pConfig;
+        std::shared_ptr<IWorkerFactory> pFactory;
+        std::function<std::unique_ptr<util::IFileSystem>()> CreateFileSystem;
+        int nThreadCount;
+        size_t nKeepFinished;
+        CJobScheduler Scheduler;
+        std::shared_ptr<CMemoryBudget> MemoryBudget;
+        std::unique_ptr<CLoadController> LoadController;
+    public:
+        CDaemon()
+        {
+            this->bRunning = false;
+            this->bShutdown = false;
+            this->nNextJobId = 1;
+            this->pConfig = nullptr;
+            this->nThreadCount = 1;
+            this->nKeepFinished = 64;
+        }
+        virtual ~CDaemon()
+        {
+            this->Stop();
+        }
+    public:
+        static std::wstring JobFile(const std::wstring& szFile, int nJobId)
+        {
+            // concurrent jobs append to their own metrics files
+            if (szFile.empty() == true)
+                return szFile;
+
+            std::wstring szSuffix = L"-job" + std::to_wstring(nJobId);
+            size_t nDot = szFile.find_last_of(L'.');
+            size_t nSlash = szFile.find_last_of(L"\\/");
+            if (nDot == std::wstring::npos || (nSlash != std::wstring::npos && nDot < nSlash))
+                return szFile + szSuffix;
+
+            return szFile.substr(0, nDot) + szSuffix + szFile.substr(nDot);
+        }
+        std::shared_ptr<CJobContext> Create(const CJobRequest& request, std::wstring& szError)
+        {
+            if (request.m_Files.empty() == true)
+            {
+                szError = L"No files to convert.";
+                return nullptr;
+            }
+
+            if (request.bInteractive == true && request.m_Files.size() != 1)
+            {
+                szError = L"Interactive jobs convert one file.";
+                return nullptr;
+            }
+
+            int nFormat = (int)config::CFormat::GetFormatById(this->pConfig->m_Formats, request.szFormatId);
+            if (nFormat == -1)
+            {
+                szError = L"Unknown format: " + request.szFormatId;
+                return nullptr;
+            }
+
+            auto& format = this->pConfig->m_Formats[nFormat];
+            size_t nPreset = request.nPreset < 0 ? format.nDefaultPreset : (size_t)request.nPreset;
+            if (nPreset >= format.m_Presets.size())
+            {
+                szError = L"Invalid preset: " + std::to_wstring(nPreset);
+                return nullptr;
+            }
+
+            int nJobId;
+            {
+                std::lock_guard<std::mutex> lock(this->m_Lock);
+                nJobId = this->nNextJobId++;
+            }
+
+            // loaded registries are copied so jobs never reload config files
+            auto job = std::make_shared<CJobContext>(nJobId, this->pFactory);
+            auto& config = job->m_Config;
+            config.FileSystem = this->CreateFileSystem();
+            config.Log = std::make_unique<CAsyncLog>(std::make_unique<CJobLog>(this->pConfig->Log.get(), nJobId), 256);
+            config.m_Settings = this->pConfig->m_Settings;
+            config.m_Options = this->pConfig->m_Options;
+            config.m_Formats = this->pConfig->m_Formats;
+            config.m_Tools = this->pConfig->m_Tools;
+            config.nLangId = this->pConfig->nLangId;
+            config.m_Languages = this->pConfig->m_Languages;
+            config.m_Outputs = this->pConfig->m_Outputs;
+
+            if (request.szOutputPath.empty() == false)
+                config.m_Options.szOutputPath = request.szOutputPath;
+
+            // tracer is process wide and can only follow one batch
+            config.m_Options.szTraceFile.clear();
+            config.m_Options.szMetricsFile = JobFile(config.m_Options.szMetricsFile, nJobId);
+            config.m_Options.szPrometheusFile = JobFile(config.m_Options.szPrometheusFile, nJobId);
+
+            std::wstring szDefaultTime = config.GetString(0x00150001);
+            std::wstring szDefaultStatus = config.GetString(0x00210001);
+            for (auto& szFile : request.m_Files)
+            {
+                int nItem = config.AddItem(szFile, nFormat, (int)nPreset);
+                auto& item = config.m_Items[nItem];
+                item.szFormatId = format.szId;
+                item.nPreset = nPreset;
+                item.szTime = szDefaultTime;
+                item.szStatus = szDefaultStatus;
+            }
+            config::CItem::SetIds(config.m_Items);
+
+            job->share.szSubmitter = request.szSubmitter;
+            job->share.nPriority = request.nPriority;
+            job->share.nWeight = request.nWeight;
+            job->share.fDeadline = request.nDeadline > 0 ? this->Scheduler.Now() + request.nDeadline * 1000.0 : 0.0;
+            job->share.bInteractive = request.bInteractive;
+
+            // small submissions do not spawn idle worker threads
+            job->nThreadCount = (std::max)(1, (std::min)(this->nThreadCount, (int)config.m_Items.size()));
+            job->Init();
+            return job;
+        }
+        void Enqueue(std::shared_ptr<CJobContext> job)
+        {
+            {
+                std::lock_guard<std::mutex> lock(this->m_Lock);
+                this->Prune();
+                this->m_Jobs.push_back(job);
+                this->m_Queue.push_back(job);
+            }
+            this->m_Changed.notify_all();
+        }
+        std::shared_ptr<CJobContext> Find(int nJobId)
+        {
+            std::lock_guard<std::mutex> lock(this->m_Lock);
+            for (auto& job : this->m_Jobs)
+            {
+                if (job->nJobId == nJobId)
+                    return job;
+            }
+            return nullptr;
+        }
+        std::vector<std::shared_ptr<CJobContext>> Jobs()
+        {
+            std::lock_guard<std::mutex> lock(this->m_Lock);
+            return this->m_Jobs;
+        }
+        size_t Queued()
+        {
+            std::lock_guard<std::mutex> lock(this->m_Lock);
+            return this->m_Queue.size();
+        }
+        void Cancel(std::shared_ptr<CJobContext> job)
+        {
+            job->bStopRequested = true;
+            job->bRunning = false;
+
+            bool bQueued = false;
+            {
+                std::lock_guard<std::mutex> lock(this->m_Lock);
+                auto it = std::find(this->m_Queue.begin(), this->m_Queue.end(), job);
+                if (it != this->m_Queue.end())
+                {
+                    this->m_Queue.erase(it);
+                    bQueued = true;
+                }
+            }
+
+            // running jobs are finished by their runner once the worker returns
+            if (bQueued == true)
+                job->Finish(JobState::Stopped);
+        }
+        std::string Execute(const std::string& szLine, std::shared_ptr<CJobContext>& stream, std::shared_ptr<CJobSubscriber>& subscriber)
+        {
+            stream = nullptr;
+            subscriber = nullptr;
+
+            std::vector<std::string> fields = CJobRequest::Split(szLine);
+            if (fields.empty() == true)
+                return "error\tEmpty command.\n";
+
+            const std::string& szCommand = fields[0];
+            if (szCommand == "submit")
+            {
+                CJobRequest request;
+                if (CJobRequest::Parse(fields, request) == false)
+                    return "error\tInvalid submit command.\n";
+
+                std::wstring szError;
+                auto job = this->Create(request, szError);
+                if (job == nullptr)
+                    return "error\t" + util::ToUtf8(szError) + "\n";
+
+                // submitter streams status of its job until it finishes or the client disconnects
+                subscriber = job->Attach();
+                this->Enqueue(job);
+                stream = job;
+                return "queued\t" + std::to_string(job->nJobId) + "\t" + std::to_string(job->m_Config.m_Items.size()) + "\n";
+            }
+
+            if (szCommand == "jobs")
+            {
+                std::string szReply;
+                for (auto& job : this->Jobs())
+                    szReply += job->Status();
+                return szReply + "end\n";
+            }
+
+            if (szCommand == "shutdown")
+            {
+                this->Shutdown();
+                return "ok\n";
+            }
+
+            if (fields.size() != 2)
+                return "error\tMissing job id.\n";
+
+            auto job = this->Find(std::atoi(fields[1].c_str()));
+            if (job == nullptr)
+                return "error\tUnknown job.\n";
+
+            if (szCommand == "status")
+            {
+            }
+            else if (szCommand == "stop")
+            {
+                this->Cancel(job);
+            }
+            else if (szCommand == "pause")
+            {
+                if (job->Finished() == false)
+                    job->Pause();
+            }
+            else if (szCommand == "resume")
+            {
+                job->Resume();
+            }
+            else if (szCommand == "watch")
+            {
+                subscriber = job->Attach();
+                stream = job;
+            }
+            else
+            {
+                return "error\tUnknown command.\n";
+            }
+
+            return job->Status();
+        }
+        bool Start(int nRunners)
+        {
+            std::lock_guard<std::mutex> lock(this->m_Lock);
+            if (this->bRunning == true)
+                return true;
+
+            this->bRunning = true;
+            this->bShutdown = false;
+            this->Scheduler.nSlots = (std::max)(1, this->nThreadCount);
+            this->OpenMemoryBudget();
+            this->StartLoadController();
+            for (int i = 0; i < (std::max)(1, nRunners); i++)
+                this->m_Runners.emplace_back([this]() { this->RunLoop(false); });
+
+            // interactive jobs never wait for a runner that is busy with a batch
+            this->interactiveRunner = std::thread([this]() { this->RunLoop(true); });
+            return true;
+        }
+        void Stop()
+        {
+            std::vector<std::shared_ptr<CJobContext>> queued;
+            {
+                std::lock_guard<std::mutex> lock(this->m_Lock);
+                this->bRunning = false;
+                queued.assign(this->m_Queue.begin(), this->m_Queue.end());
+                this->m_Queue.clear();
+                for (auto& job : this->m_Jobs)
+                {
+                    job->bStopRequested = true;
+                    job->bRunning = false;
+                }
+            }
+            this->m_Changed.notify_all();
+
+            for (auto& job : queued)
+                job->Finish(JobState::Stopped);
+
+            for (auto& runner : this->m_Runners)
+            {
+                if (runner.joinable())
+                    runner.join();
+            }
+            this->m_Runners.clear();
+
+            if (this->interactiveRunner.joinable())
+                this->interactiveRunner.join();
+
+            if (this->LoadController != nullptr)
+            {
+                this->LoadController->Stop();
+                this->LoadController = nullptr;
+            }
+        }
+        void Shutdown()
+        {
+            {
+                std::lock_guard<std::mutex> lock(this->m_Lock);
+                this->bShutdown = true;
+            }
+            this->m_Changed.notify_all();
+        }
+        void WaitForShutdown()
+        {
+            std::unique_lock<std::mutex> lock(this->m_Lock);
+            this->m_Changed.wait(lock, [this]() { return this->bShutdown == true; });
+        }
+    private:
+        void Prune()
+        {
+            // finished jobs are kept for status queries, oldest are dropped first
+            size_t nFinished = 0;
+            for (auto& job : this->m_Jobs)
+            {
+                if (job->Finished() == true)
+                    nFinished++;
+            }
+
+            for (auto it = this->m_Jobs.begin(); it != this->m_Jobs.end() && nFinished > this->nKeepFinished;)
+            {
+                if ((*it)->Finished() == true)
+                {
+                    it = this->m_Jobs.erase(it);
+                    nFinished--;
+                }
+                else
+                {
+                    ++it;
+                }
+            }
+        }
+        std::deque<std::shared_ptr<CJobContext>>::iterator Next(bool bInteractive)
+        {
+            // queued jobs start by priority and deadline, equal jobs in submission order
+            auto best = this->m_Queue.end();
+            for (auto it = this->m_Queue.begin(); it != this->m_Queue.end(); ++it)
+            {
+                if (bInteractive == true && (*it)->share.bInteractive == false)
+                    continue;
+                if (best == this->m_Queue.end() || CJobScheduler::Before((*it)->share, (*best)->share) == true)
+                    best = it;
+            }
+            return best;
+        }
+        void OpenMemoryBudget()
+        {
+            // one budget for all runners, so concurrent batches can not each claim the whole memory
+            auto& options = this->pConfig->m_Options;
+            if (options.nMemoryBudget <= 0)
+            {
+                this->MemoryBudget = nullptr;
+                return;
+            }
+
+            if (this->MemoryBudget == nullptr)
+            {
+                this->MemoryBudget = std::make_shared<CMemoryBudget>();
+                this->MemoryBudget->pStatus = this->pFactory->CreateMemoryStatusPtr();
+            }
+
+            this->MemoryBudget->nBudget = (unsigned __int64)options.nMemoryBudget * 1024 * 1024;
+            this->MemoryBudget->nDefaultEstimate = this->MemoryBudget->nBudget / (std::max)(1, this->nThreadCount);
+        }
+        void StartLoadController()
+        {
+            // host load is sampled once and sizes the scheduler slots of every batch
+            auto& options = this->pConfig->m_Options;
+            if (options.bAdaptiveThreadCount == false || this->nThreadCount <= 1)
+                return;
+
+            this->LoadController = std::make_unique<CLoadController>();
+            this->LoadController->nMaxSlots = this->nThreadCount;
+            this->LoadController->nMinSlots = options.nMinThreadCount < 1 ? 1 : (std::min)(options.nMinThreadCount, this->nThreadCount);
+            this->LoadController->pLoad = this->pFactory->CreateSystemLoadPtr();
+            this->LoadController->Scheduler = &this->Scheduler;
+            this->LoadController->Start(nullptr);
+        }
+        void RunLoop(bool bInteractive)
+        {
+            // each runner keeps its worker and converters between jobs
+            auto pWorker = std::make_unique<CWorker>();
+            pWorker->ConsoleConverter = std::make_unique<CConsoleConverter>();
+            pWorker->PipesConverter = std::make_unique<CPipesConverter>();
+            pWorker->PipesTranscoder = std::make_unique<CPipesTranscoder>();
+            pWorker->Scheduler = &this->Scheduler;
+            pWorker->MemoryBudget = this->MemoryBudget;
+            pWorker->bSharedLimits = true;
+
+            while (true)
+            {
+                std::shared_ptr<CJobContext> job;
+                {
+                    std::unique_lock<std::mutex> lock(this->m_Lock);
+                    this->m_Changed.wait(lock, [this, bInteractive]() { return this->bRunning == false || this->Next(bInteractive) != this->m_Queue.end(); });
+                    if (this->bRunning == false)
+                        return;
+
+                    auto it = this->Next(bInteractive);
+                    job = *it;
+                    this->m_Queue.erase(it);
+                }
+
+                this->Run(pWorker.get(), job);
+            }
+        }
+        void Run(CWorker* pWorker, std::shared_ptr<CJobContext> job)
+        {
+            auto& config = job->m_Config;
+            job->nState = JobState::Running;
+            job->Post(job->Status());
+
+            bool bResult = true;
+            config.Log->Open();
+            this->Scheduler.Register(job.get(), job->share);
+            try
+            {
+                if (job->share.bInteractive == true)
+                    pWorker->Convert(job.get(), config.m_Items[0]);
+                else
+                    pWorker->Convert(job.get(), config.m_Items);
+            }
+            catch (...)
+            {
+                bResult = false;
+            }
+            this->Scheduler.Unregister(job.get());
+            config.Log->Close();
+
+            if (job->bStopRequested == true)
+                job->Finish(JobState::Stopped);
+            else if (bResult == false || job->nErrors > 0 || job->nProcessedFiles < job->nTotalFiles)
+                job->Finish(JobState::Failed);
+            else
+                job->Finish(JobState::Done);
+        }
+    };
+}
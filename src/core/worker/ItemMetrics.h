@@ -0,0 +1,308 @@
+﻿// Copyright (c) Wiesław Šoltés. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#pragma once
+
+#include <string>
+#include <chrono>
+#include <mutex>
+#include <cstdio>
+#include "utilities\Utf8String.h"
+
+namespace worker
+{
+    class CMetricsTimer
+    {
+        std::chrono::steady_clock::time_point tStart;
+    public:
+        CMetricsTimer()
+        {
+            this->Start();
+        }
+    public:
+        void Start()
+        {
+            this->tStart = std::chrono::steady_clock::now();
+        }
+        double ElapsedMilliseconds() const
+        {
+            auto tNow = std::chrono::steady_clock::now();
+            return std::chrono::duration<double, std::milli>(tNow - this->tStart).count();
+        }
+    };
+
+    class CProcessUsage
+    {
+    public:
+        double fUserTime;
+        double fKernelTime;
+        unsigned __int64 nPeakMemory;
+        unsigned __int64 nReadBytes;
+        unsigned __int64 nWriteBytes;
+    public:
+        CProcessUsage()
+        {
+            this->Reset();
+        }
+    public:
+        void Reset()
+        {
+            this->fUserTime = 0.0;
+            this->fKernelTime = 0.0;
+            this->nPeakMemory = 0;
+            this->nReadBytes = 0;
+            this->nWriteBytes = 0;
+        }
+        void Combine(const CProcessUsage& usage)
+        {
+            // processes running at the same time, peak memory adds up
+            this->fUserTime += usage.fUserTime;
+            this->fKernelTime += usage.fKernelTime;
+            this->nPeakMemory += usage.nPeakMemory;
+            this->nReadBytes += usage.nReadBytes;
+            this->nWriteBytes += usage.nWriteBytes;
+        }
+    };
+
+    class CItemMetrics
+    {
+    public:
+        int nItemId;
+        std::wstring szFormatId;
+        std::wstring szMode;
+        double fQueueWait;
+        double fDownloadWait;
+        double fSpawnTime;
+        double fDecodeTime;
+        double fEncodeTime;
+        double fStallTime;
+        double fTotalTime;
+        unsigned __int64 nBytesIn;
+        unsigned __int64 nBytesOut;
+        int nExitCode;
+        bool bSuccess;
+        std::wstring szStderrTail;
+        std::wstring szTimeout;
+        std::wstring szFailure;
+        int nAttempts;
+        bool bStartFailed;
+        bool bIoFailed;
+        bool bRetryable;
+        bool bRetry;
+        double fRetryDelay;
+        double fUserTime;
+        double fKernelTime;
+        unsigned __int64 nPeakMemory;
+        unsigned __int64 nReadBytes;
+        unsigned __int64 nWriteBytes;
+        unsigned __int64 nAffinity;
+    public:
+        CMetricsTimer queueTimer;
+    public:
+        CItemMetrics()
+        {
+            this->Reset(-1);
+        }
+    public:
+        void Reset(int nItemId)
+        {
+            this->nItemId = nItemId;
+            this->szFormatId = L"";
+            this->szMode = L"";
+            this->fQueueWait = 0.0;
+            this->fDownloadWait = 0.0;
+            this->fSpawnTime = 0.0;
+            this->fDecodeTime = 0.0;
+            this->fEncodeTime = 0.0;
+            this->fStallTime = 0.0;
+            this->fTotalTime = 0.0;
+            this->nBytesIn = 0;
+            this->nBytesOut = 0;
+            this->nExitCode = -1;
+            this->bSuccess = false;
+            this->szStderrTail = L"";
+            this->szTimeout = L"";
+            this->szFailure = L"";
+            this->nAttempts = 0;
+            this->bStartFailed = false;
+            this->bIoFailed = false;
+            this->bRetryable = false;
+            this->bRetry = false;
+            this->fRetryDelay = 0.0;
+            this->fUserTime = 0.0;
+            this->fKernelTime = 0.0;
+            this->nPeakMemory = 0;
+            this->nReadBytes = 0;
+            this->nWriteBytes = 0;
+            this->nAffinity = 0;
+            this->queueTimer.Start();
+        }
+        void BeginAttempt(bool bRetryable)
+        {
+            // outcome of the previous attempt is replaced, times and usage add up
+            this->nAttempts++;
+            this->nExitCode = -1;
+            this->bSuccess = false;
+            this->szStderrTail = L"";
+            this->szTimeout = L"";
+            this->szFailure = L"";
+            this->bStartFailed = false;
+            this->bIoFailed = false;
+            this->bRetryable = bRetryable;
+            this->bRetry = false;
+            this->fRetryDelay = 0.0;
+        }
+        bool RetryReady() const
+        {
+            return this->bRetry == false || this->queueTimer.ElapsedMilliseconds() >= this->fRetryDelay;
+        }
+        double RetryWait() const
+        {
+            double fWait = this->fRetryDelay - this->queueTimer.ElapsedMilliseconds();
+            return fWait > 0.0 ? fWait : 0.0;
+        }
+        void AddUsage(const CProcessUsage& usage)
+        {
+            // processes of one item run one after another, peak memory is the largest one
+            this->fUserTime += usage.fUserTime;
+            this->fKernelTime += usage.fKernelTime;
+            if (usage.nPeakMemory > this->nPeakMemory)
+                this->nPeakMemory = usage.nPeakMemory;
+            this->nReadBytes += usage.nReadBytes;
+            this->nWriteBytes += usage.nWriteBytes;
+        }
+    public:
+        static inline std::string Escape(const std::wstring& szValue)
+        {
+            std::string szUtf8 = util::ToUtf8(szValue);
+            std::string szResult;
+            szResult.reserve(szUtf8.length());
+            for (char c : szUtf8)
+            {
+                if (c == '"' || c == '\\')
+                {
+                    szResult += '\\';
+                    szResult += c;
+                }
+                else if ((unsigned char)c < 0x20)
+                {
+                    char szHex[8];
+                    _snprintf_s(szHex, sizeof(szHex), _TRUNCATE, "\\u%04x", (unsigned char)c);
+                    szResult += szHex;
+                }
+                else
+                {
+                    szResult += c;
+                }
+            }
+            return szResult;
+        }
+        static inline void Field(std::string& szJson, const char* szName, const std::string& szValue)
+        {
+            szJson += ",\"";
+            szJson += szName;
+            szJson += "\":";
+            szJson += szValue;
+        }
+        static inline void Field(std::string& szJson, const char* szName, double fValue)
+        {
+            // large enough for any double in fixed notation, so the value is never cut
+            char szValue[512];
+            _snprintf_s(szValue, sizeof(szValue), _TRUNCATE, "%.3f", fValue);
+            Field(szJson, szName, std::string(szValue));
+        }
+        std::string ToJson() const
+        {
+            // strings are escaped into the line as they are appended, so the line has no length limit
+            std::string szJson;
+            szJson.reserve(512 + this->szStderrTail.length());
+            szJson += "{\"item\":" + std::to_string(this->nItemId);
+            Field(szJson, "format", "\"" + Escape(this->szFormatId) + "\"");
+            Field(szJson, "mode", "\"" + Escape(this->szMode) + "\"");
+            Field(szJson, "success", this->bSuccess ? "true" : "false");
+            Field(szJson, "attempt", std::to_string(this->nAttempts));
+            Field(szJson, "exit_code", std::to_string(this->nExitCode));
+            Field(szJson, "queue_wait_ms", this->fQueueWait);
+            Field(szJson, "download_wait_ms", this->fDownloadWait);
+            Field(szJson, "spawn_ms", this->fSpawnTime);
+            Field(szJson, "decode_ms", this->fDecodeTime);
+            Field(szJson, "encode_ms", this->fEncodeTime);
+            Field(szJson, "stall_ms", this->fStallTime);
+            Field(szJson, "total_ms", this->fTotalTime);
+            Field(szJson, "bytes_in", std::to_string(this->nBytesIn));
+            Field(szJson, "bytes_out", std::to_string(this->nBytesOut));
+            Field(szJson, "user_ms", this->fUserTime);
+            Field(szJson, "kernel_ms", this->fKernelTime);
+            Field(szJson, "peak_memory", std::to_string(this->nPeakMemory));
+            Field(szJson, "io_read_bytes", std::to_string(this->nReadBytes));
+            Field(szJson, "io_write_bytes", std::to_string(this->nWriteBytes));
+            if (this->szTimeout.empty() == false)
+                Field(szJson, "timeout", "\"" + Escape(this->szTimeout) + "\"");
+            if (this->szFailure.empty() == false)
+            {
+                Field(szJson, "failure", "\"" + Escape(this->szFailure) + "\"");
+                Field(szJson, "retry", this->bRetry ? "true" : "false");
+            }
+            if (this->szStderrTail.empty() == false)
+                Field(szJson, "stderr_tail", "\"" + Escape(this->szStderrTail) + "\"");
+            szJson += "}";
+            return szJson;
+        }
+    };
+
+    class CItemMetricsWriter
+    {
+        std::mutex m_Lock;
+        FILE *fs;
+    public:
+        CItemMetricsWriter()
+        {
+            this->fs = nullptr;
+        }
+        virtual ~CItemMetricsWriter()
+        {
+            this->Close();
+        }
+    public:
+        bool Open(const std::wstring& szFileName)
+        {
+            std::lock_guard<std::mutex> lock(this->m_Lock);
+            if (this->fs != nullptr)
+                return true;
+
+            errno_t error = _wfopen_s(&this->fs, szFileName.c_str(), L"ab");
+            if (error != 0 || this->fs == nullptr)
+            {
+                this->fs = nullptr;
+                return false;
+            }
+            return true;
+        }
+        void Close()
+        {
+            std::lock_guard<std::mutex> lock(this->m_Lock);
+            if (this->fs != nullptr)
+            {
+                fclose(this->fs);
+                this->fs = nullptr;
+            }
+        }
+        bool IsOpen()
+        {
+            std::lock_guard<std::mutex> lock(this->m_Lock);
+            return this->fs != nullptr;
+        }
+        void Write(const CItemMetrics& metrics)
+        {
+            std::string szLine = metrics.ToJson();
+            szLine += '\n';
+
+            std::lock_guard<std::mutex> lock(this->m_Lock);
+            if (this->fs != nullptr)
+            {
+                fwrite(szLine.c_str(), 1, szLine.length(), this->fs);
+                fflush(this->fs);
+            }
+        }
+    };
+}
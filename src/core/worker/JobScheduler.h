@@ -0,0 +1,269 @@
+﻿// Copyright (c) Wiesław Šoltés. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#pragma once
+
+#include <string>
+#include <map>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+#include "ItemMetrics.h"
+#include "WorkerContext.h"
+
+namespace worker
+{
+    class CJobShare
+    {
+    public:
+        std::wstring szSubmitter;
+        int nPriority = 0;
+        int nWeight = 1;
+        // absolute time on the scheduler clock in ms, 0 is no deadline
+        double fDeadline = 0.0;
+        bool bInteractive = false;
+    };
+
+    class CJobSlots
+    {
+    public:
+        CJobShare share;
+        int nWaiting = 0;
+        int nRunning = 0;
+        double fUsage = 0.0;
+        unsigned __int64 nOrder = 0;
+    };
+
+    class CJobScheduler
+    {
+        std::mutex m_Lock;
+        std::condition_variable m_Changed;
+        std::map<IWorkerContext*, CJobSlots> m_Jobs;
+        std::map<std::wstring, double> m_Submitters;
+        int nRunning;
+        unsigned __int64 nOrder;
+        CMetricsTimer clock;
+    public:
+        int nSlots;
+        int nInteractiveSlots;
+        int nInterval;
+    public:
+        CJobScheduler()
+        {
+            this->nRunning = 0;
+            this->nOrder = 0;
+            this->nSlots = 1;
+            this->nInteractiveSlots = 1;
+            this->nInterval = 50;
+        }
+        virtual ~CJobScheduler() { }
+    public:
+        static bool Before(const CJobShare& a, const CJobShare& b)
+        {
+            // interactive items first, then priority, then earliest deadline
+            if (a.bInteractive != b.bInteractive)
+                return a.bInteractive == true;
+            if (a.nPriority != b.nPriority)
+                return a.nPriority > b.nPriority;
+            if ((a.fDeadline > 0.0) != (b.fDeadline > 0.0))
+                return a.fDeadline > 0.0;
+            if (a.fDeadline > 0.0 && a.fDeadline != b.fDeadline)
+                return a.fDeadline < b.fDeadline;
+            return false;
+        }
+        double Now()
+        {
+            return this->clock.ElapsedMilliseconds();
+        }
+        int Running()
+        {
+            std::lock_guard<std::mutex> lock(this->m_Lock);
+            return this->nRunning;
+        }
+        int Waiting()
+        {
+            std::lock_guard<std::mutex> lock(this->m_Lock);
+            int nWaiting = 0;
+            for (auto& job : this->m_Jobs)
+                nWaiting += job.second.nWaiting;
+            return nWaiting;
+        }
+        double Usage(IWorkerContext* ctx)
+        {
+            std::lock_guard<std::mutex> lock(this->m_Lock);
+            auto it = this->m_Jobs.find(ctx);
+            return it != this->m_Jobs.end() ? it->second.fUsage : 0.0;
+        }
+        double Usage(const std::wstring& szSubmitter)
+        {
+            std::lock_guard<std::mutex> lock(this->m_Lock);
+            auto it = this->m_Submitters.find(szSubmitter);
+            return it != this->m_Submitters.end() ? it->second : 0.0;
+        }
+        void Resize(int nSlots)
+        {
+            std::lock_guard<std::mutex> lock(this->m_Lock);
+            this->nSlots = nSlots;
+            this->m_Changed.notify_all();
+        }
+        void Register(IWorkerContext* ctx, const CJobShare& share)
+        {
+            std::lock_guard<std::mutex> lock(this->m_Lock);
+            this->Add(ctx, share);
+            this->m_Changed.notify_all();
+        }
+        void Interactive(IWorkerContext* ctx)
+        {
+            std::lock_guard<std::mutex> lock(this->m_Lock);
+            auto it = this->m_Jobs.find(ctx);
+            if (it == this->m_Jobs.end())
+                it = this->Add(ctx, CJobShare());
+            it->second.share.bInteractive = true;
+            this->m_Changed.notify_all();
+        }
+        void Unregister(IWorkerContext* ctx)
+        {
+            std::lock_guard<std::mutex> lock(this->m_Lock);
+            auto it = this->m_Jobs.find(ctx);
+            if (it == this->m_Jobs.end())
+                return;
+
+            std::wstring szSubmitter = it->second.share.szSubmitter;
+            this->nRunning -= it->second.nRunning;
+            this->m_Jobs.erase(it);
+
+            bool bActive = false;
+            for (auto& job : this->m_Jobs)
+            {
+                if (job.second.share.szSubmitter == szSubmitter)
+                    bActive = true;
+            }
+            if (bActive == false)
+                this->m_Submitters.erase(szSubmitter);
+
+            this->m_Changed.notify_all();
+        }
+        bool Acquire(IWorkerContext* ctx)
+        {
+            // items of all batches wait here, so lower ranked batches yield at item boundaries
+            std::unique_lock<std::mutex> lock(this->m_Lock);
+            auto it = this->m_Jobs.find(ctx);
+            if (it == this->m_Jobs.end())
+                it = this->Add(ctx, CJobShare());
+
+            CJobSlots& slots = it->second;
+            slots.nWaiting++;
+            while (true)
+            {
+                if (ctx->bRunning == false)
+                {
+                    slots.nWaiting--;
+                    this->m_Changed.notify_all();
+                    return false;
+                }
+
+                if (this->Select() == ctx)
+                {
+                    slots.nWaiting--;
+                    slots.nRunning++;
+                    this->nRunning++;
+
+                    // fair share is charged per started item and scaled by weight
+                    double fCharge = 1.0 / (slots.share.nWeight > 0 ? slots.share.nWeight : 1);
+                    slots.fUsage += fCharge;
+                    this->m_Submitters[slots.share.szSubmitter] += fCharge;
+
+                    this->m_Changed.notify_all();
+                    return true;
+                }
+
+                // polling picks up stop and pause of waiting batches
+                this->m_Changed.wait_for(lock, std::chrono::milliseconds(this->nInterval));
+            }
+        }
+        void Release(IWorkerContext* ctx)
+        {
+            std::lock_guard<std::mutex> lock(this->m_Lock);
+            auto it = this->m_Jobs.find(ctx);
+            if (it != this->m_Jobs.end() && it->second.nRunning > 0)
+            {
+                it->second.nRunning--;
+                this->nRunning--;
+            }
+            this->m_Changed.notify_all();
+        }
+    private:
+        std::map<IWorkerContext*, CJobSlots>::iterator Add(IWorkerContext* ctx, const CJobShare& share)
+        {
+            auto it = this->m_Jobs.find(ctx);
+            if (it != this->m_Jobs.end())
+            {
+                it->second.share = share;
+                return it;
+            }
+
+            // newcomers start level with active peers instead of claiming all slots until they catch up
+            double fJobUsage = -1.0;
+            for (auto& job : this->m_Jobs)
+            {
+                if (job.second.share.szSubmitter == share.szSubmitter && (fJobUsage < 0.0 || job.second.fUsage < fJobUsage))
+                    fJobUsage = job.second.fUsage;
+            }
+
+            if (this->m_Submitters.count(share.szSubmitter) == 0)
+            {
+                double fSubmitterUsage = -1.0;
+                for (auto& submitter : this->m_Submitters)
+                {
+                    if (fSubmitterUsage < 0.0 || submitter.second < fSubmitterUsage)
+                        fSubmitterUsage = submitter.second;
+                }
+                this->m_Submitters[share.szSubmitter] = fSubmitterUsage > 0.0 ? fSubmitterUsage : 0.0;
+            }
+
+            CJobSlots slots;
+            slots.share = share;
+            slots.fUsage = fJobUsage > 0.0 ? fJobUsage : 0.0;
+            slots.nOrder = this->nOrder++;
+            return this->m_Jobs.emplace(ctx, slots).first;
+        }
+        bool Ahead(const CJobSlots& a, const CJobSlots& b)
+        {
+            if (Before(a.share, b.share) == true)
+                return true;
+            if (Before(b.share, a.share) == true)
+                return false;
+
+            // weighted fair share between submitters, then between batches of one submitter
+            double fA = this->m_Submitters[a.share.szSubmitter];
+            double fB = this->m_Submitters[b.share.szSubmitter];
+            if (fA != fB)
+                return fA < fB;
+            if (a.fUsage != b.fUsage)
+                return a.fUsage < b.fUsage;
+            return a.nOrder < b.nOrder;
+        }
+        IWorkerContext* Select()
+        {
+            const CJobSlots* pBest = nullptr;
+            IWorkerContext* pContext = nullptr;
+            for (auto& job : this->m_Jobs)
+            {
+                if (job.second.nWaiting <= 0 || job.first->bPaused == true || job.first->bRunning == false)
+                    continue;
+                if (pBest == nullptr || this->Ahead(job.second, *pBest) == true)
+                {
+                    pBest = &job.second;
+                    pContext = job.first;
+                }
+            }
+
+            if (pBest == nullptr)
+                return nullptr;
+
+            // interactive items may use reserved slots so they never wait behind running batches
+            int nLimit = this->nSlots + (pBest->share.bInteractive == true ? this->nInteractiveSlots : 0);
+            return this->nRunning < nLimit ? pContext : nullptr;
+        }
+    };
+}
@@ -0,0 +1,138 @@
+﻿// Copyright (c) Wiesław Šoltés. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
+#include "WorkerContext.h"
+#include "JobScheduler.h"
+
+namespace worker
+{
+    class CLoadController
+    {
+        std::mutex m_Lock;
+        std::condition_variable m_Changed;
+        std::thread monitorThread;
+        bool bMonitoring;
+    public:
+        int nMinSlots;
+        int nMaxSlots;
+        std::atomic<int> nActiveSlots;
+        double fLowBusy;
+        double fHighQueue;
+        int nInterval;
+        std::shared_ptr<ISystemLoad> pLoad;
+        CJobScheduler* Scheduler;
+    public:
+        CLoadController()
+        {
+            this->bMonitoring = false;
+            this->Scheduler = nullptr;
+            this->nMinSlots = 1;
+            this->nMaxSlots = 1;
+            this->nActiveSlots = 1;
+            this->fLowBusy = 0.75;
+            this->fHighQueue = 2.0;
+            this->nInterval = 1000;
+        }
+        virtual ~CLoadController()
+        {
+            this->Stop();
+        }
+    public:
+        int Next(int nActive, const CSystemLoad& load, int nRemaining) const
+        {
+            int nProcessors = load.nProcessors > 0 ? load.nProcessors : 1;
+
+            // runnable threads waiting for a cpu means other work is competing for cores
+            if (load.fQueueLength / nProcessors > this->fHighQueue && nActive > this->nMinSlots)
+                return nActive - 1;
+
+            // one slot at a time so the next sample sees the effect
+            if (load.fBusy < this->fLowBusy && load.fQueueLength < nProcessors && nActive < this->nMaxSlots && nRemaining > nActive)
+                return nActive + 1;
+
+            return nActive;
+        }
+        void Update(int nActive)
+        {
+            {
+                std::lock_guard<std::mutex> lock(this->m_Lock);
+                this->nActiveSlots = nActive;
+            }
+            this->m_Changed.notify_all();
+
+            // a daemon wide controller sizes the scheduler shared by all batches instead of parking slots
+            if (this->Scheduler != nullptr)
+                this->Scheduler->Resize(nActive);
+        }
+        bool WaitForSlot(IWorkerContext* ctx, int nSlot)
+        {
+            // slots above active count park between items, running items are never interrupted
+            std::unique_lock<std::mutex> lock(this->m_Lock);
+            while (nSlot >= this->nActiveSlots && ctx->bRunning == true && HasQueued(ctx) == true)
+                this->m_Changed.wait_for(lock, std::chrono::milliseconds(100));
+            return ctx->bRunning;
+        }
+        void Start(IWorkerContext* ctx)
+        {
+            this->Update(this->nMaxSlots);
+            this->bMonitoring = true;
+            this->monitorThread = std::thread([this, ctx]() { this->MonitorLoop(ctx); });
+        }
+        void Stop()
+        {
+            {
+                std::lock_guard<std::mutex> lock(this->m_Lock);
+                this->bMonitoring = false;
+            }
+            this->m_Changed.notify_all();
+            if (this->monitorThread.joinable())
+                this->monitorThread.join();
+        }
+    private:
+        int Demand()
+        {
+            // items running or waiting in any batch of the scheduler
+            if (this->Scheduler == nullptr)
+                return this->nMaxSlots;
+            return this->Scheduler->Running() + this->Scheduler->Waiting();
+        }
+        static bool HasQueued(IWorkerContext* ctx)
+        {
+            // parked slots leave once every item was taken so the batch can finish
+            return ctx->nProcessedFiles + ctx->nRunningFiles < ctx->nTotalFiles;
+        }
+        void MonitorLoop(IWorkerContext* ctx)
+        {
+            CSystemLoad load;
+            if (this->pLoad != nullptr)
+                this->pLoad->Sample(load);
+
+            std::unique_lock<std::mutex> lock(this->m_Lock);
+            while (this->bMonitoring == true)
+            {
+                this->m_Changed.wait_for(lock, std::chrono::milliseconds(this->nInterval));
+                if (this->bMonitoring == false || this->pLoad == nullptr)
+                    continue;
+
+                lock.unlock();
+                if (this->pLoad->Sample(load) == true)
+                {
+                    int nRemaining = ctx != nullptr ? ctx->nTotalFiles - ctx->nProcessedFiles : this->Demand();
+                    int nActive = this->nActiveSlots;
+                    int nNext = this->Next(nActive, load, nRemaining);
+                    if (nNext != nActive)
+                        this->Update(nNext);
+                }
+                lock.lock();
+            }
+        }
+    };
+}
@@ -0,0 +1,107 @@
+﻿// Copyright (c) Wiesław Šoltés. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#pragma once
+
+#include <string>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+#include "WorkerContext.h"
+
+namespace worker
+{
+    class CMemoryBudget
+    {
+        std::mutex m_Lock;
+        std::condition_variable m_Released;
+        std::map<std::wstring, unsigned __int64> m_History;
+        unsigned __int64 nReserved;
+        int nAdmitted;
+    public:
+        unsigned __int64 nBudget;
+        unsigned __int64 nDefaultEstimate;
+        int nPollInterval;
+        std::shared_ptr<IMemoryStatus> pStatus;
+    public:
+        CMemoryBudget()
+        {
+            this->nReserved = 0;
+            this->nAdmitted = 0;
+            this->nBudget = 0;
+            this->nDefaultEstimate = 0;
+            this->nPollInterval = 100;
+        }
+    public:
+        unsigned __int64 Reserved()
+        {
+            std::lock_guard<std::mutex> lock(this->m_Lock);
+            return this->nReserved;
+        }
+        int Admitted()
+        {
+            std::lock_guard<std::mutex> lock(this->m_Lock);
+            return this->nAdmitted;
+        }
+        unsigned __int64 Estimate(const std::wstring& szFormatId, unsigned __int64 nFormatEstimate)
+        {
+            std::lock_guard<std::mutex> lock(this->m_Lock);
+            return this->EstimateLocked(szFormatId, nFormatEstimate);
+        }
+        bool Acquire(IWorkerContext* ctx, const std::wstring& szFormatId, unsigned __int64 nFormatEstimate, unsigned __int64& nEstimate)
+        {
+            std::unique_lock<std::mutex> lock(this->m_Lock);
+            nEstimate = this->EstimateLocked(szFormatId, nFormatEstimate);
+
+            // available memory is polled so external pressure is noticed without a release
+            while (this->CanAdmit(nEstimate) == false)
+            {
+                if (ctx->bRunning == false)
+                    return false;
+                this->m_Released.wait_for(lock, std::chrono::milliseconds(this->nPollInterval));
+            }
+
+            this->nReserved += nEstimate;
+            this->nAdmitted++;
+            return true;
+        }
+        void Release(const std::wstring& szFormatId, unsigned __int64 nEstimate, unsigned __int64 nPeakMemory)
+        {
+            {
+                std::lock_guard<std::mutex> lock(this->m_Lock);
+                this->nReserved -= nEstimate;
+                this->nAdmitted--;
+
+                auto& nMeasured = this->m_History[szFormatId];
+                if (nPeakMemory > nMeasured)
+                    nMeasured = nPeakMemory;
+            }
+            this->m_Released.notify_all();
+        }
+    private:
+        unsigned __int64 EstimateLocked(const std::wstring& szFormatId, unsigned __int64 nFormatEstimate)
+        {
+            unsigned __int64 nEstimate = nFormatEstimate;
+            auto history = this->m_History.find(szFormatId);
+            if (history != this->m_History.end() && history->second > nEstimate)
+                nEstimate = history->second;
+            return nEstimate > 0 ? nEstimate : this->nDefaultEstimate;
+        }
+        bool CanAdmit(unsigned __int64 nEstimate)
+        {
+            // a single item always runs even when it is larger than the budget
+            if (this->nAdmitted == 0)
+                return true;
+
+            if (this->nReserved + nEstimate > this->nBudget)
+                return false;
+
+            if (this->pStatus != nullptr && this->pStatus->AvailableMemory() < nEstimate)
+                return false;
+
+            return true;
+        }
+    };
+}
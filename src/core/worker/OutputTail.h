@@ -0,0 +1,143 @@
+﻿// Copyright (c) Wiesław Šoltés. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#pragma once
+
+#include <string>
+#include <memory>
+#include <cstring>
+
+namespace worker
+{
+    class COutputTail
+    {
+        std::unique_ptr<char[]> m_Buffer;
+        size_t nCapacity;
+        size_t nPosition;
+        size_t nLength;
+        size_t nLine;
+    public:
+        static const size_t nLineSize = 4096;
+    public:
+        COutputTail()
+        {
+            this->nCapacity = 0;
+            this->nPosition = 0;
+            this->nLength = 0;
+            this->nLine = 0;
+        }
+    public:
+        void Resize(size_t nCapacity)
+        {
+            if (this->nCapacity != nCapacity)
+            {
+                this->m_Buffer = nCapacity > 0 ? std::make_unique<char[]>(nCapacity) : nullptr;
+                this->nCapacity = nCapacity;
+            }
+            this->Clear();
+        }
+        void Clear()
+        {
+            this->nPosition = 0;
+            this->nLength = 0;
+            this->nLine = 0;
+        }
+        size_t Capacity() const
+        {
+            return this->nCapacity;
+        }
+        size_t Length() const
+        {
+            return this->nLength;
+        }
+        void Append(const char* szText, size_t nSize)
+        {
+            if (this->nCapacity == 0)
+                return;
+
+            // only the last nCapacity bytes can survive
+            if (nSize > this->nCapacity)
+            {
+                szText += nSize - this->nCapacity;
+                nSize = this->nCapacity;
+            }
+
+            size_t nFirst = this->nCapacity - this->nPosition;
+            if (nFirst > nSize)
+                nFirst = nSize;
+
+            std::memcpy(&this->m_Buffer[this->nPosition], szText, nFirst);
+            std::memcpy(&this->m_Buffer[0], szText + nFirst, nSize - nFirst);
+
+            this->nPosition = (this->nPosition + nSize) % this->nCapacity;
+            this->nLength = this->nLength + nSize > this->nCapacity ? this->nCapacity : this->nLength + nSize;
+        }
+        void AppendLine(const char* szLine)
+        {
+            this->Append(szLine, strlen(szLine));
+            this->Append("\n", 1);
+        }
+        void Write(const char* szData, size_t nSize)
+        {
+            // split raw output into lines, lines longer than nLineSize are broken up
+            size_t nStart = 0;
+            for (size_t i = 0; i <= nSize; i++)
+            {
+                bool bEnd = i == nSize;
+                char c = bEnd ? '\0' : szData[i];
+                bool bBreak = (c == '\r') || (c == '\n') || (c == '\b');
+                if ((bEnd == true) || (bBreak == true) || (c == '\t') || (this->nLine + (i - nStart) == nLineSize))
+                {
+                    if (i > nStart)
+                    {
+                        this->Append(szData + nStart, i - nStart);
+                        this->nLine += i - nStart;
+                    }
+                    if ((bBreak == true) || (this->nLine == nLineSize))
+                        this->EndLine();
+                    nStart = (bBreak == true) || (c == '\t') ? i + 1 : i;
+                }
+            }
+        }
+        void EndLine()
+        {
+            if (this->nLine > 0)
+            {
+                this->Append("\n", 1);
+                this->nLine = 0;
+            }
+        }
+        std::string ToString() const
+        {
+            std::string szText;
+            if (this->nLength == 0)
+                return szText;
+
+            size_t nStart = (this->nPosition + this->nCapacity - this->nLength) % this->nCapacity;
+            szText.reserve(this->nLength);
+            for (size_t i = 0; i < this->nLength; i++)
+                szText += this->m_Buffer[(nStart + i) % this->nCapacity];
+
+            // drop partial first line after the buffer wrapped
+            if (this->nLength == this->nCapacity)
+            {
+                size_t nFirstLine = szText.find('\n');
+                if (nFirstLine != std::string::npos && nFirstLine + 1 < szText.length())
+                    szText.erase(0, nFirstLine + 1);
+            }
+
+            while (szText.empty() == false && szText.back() == '\n')
+                szText.pop_back();
+
+            return szText;
+        }
+        std::string LastLine() const
+        {
+            std::string szText = this->ToString();
+            size_t nLastLine = szText.rfind('\n');
+            if (nLastLine != std::string::npos)
+                szText.erase(0, nLastLine + 1);
+            return szText;
+        }
+    };
+}
@@ -0,0 +1,59 @@
+﻿// Copyright (c) Wiesław Šoltés. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#pragma once
+
+#include "config\Options.h"
+#include "config\Format.h"
+
+namespace worker
+{
+    class CProcessLimits
+    {
+    public:
+        // nice level, -20 is highest and 19 is lowest priority
+        int nNice = 0;
+        // 0 is normal, 1 is low and 2 is very low i/o priority
+        int nIoClass = 0;
+        // committed memory of one process in bytes, 0 is no limit
+        unsigned __int64 nMemoryLimit = 0;
+        // resident memory of one process in bytes, 0 is no limit
+        unsigned __int64 nWorkingSetLimit = 0;
+        // wall clock time in seconds, 0 is no limit
+        int nWallTime = 0;
+    public:
+        bool HasMemoryLimits() const
+        {
+            return this->nMemoryLimit > 0 || this->nWorkingSetLimit > 0;
+        }
+        int PriorityLevel() const
+        {
+            // -2 idle, -1 below normal, 0 normal, 1 above normal, 2 high
+            if (this->nNice >= 15)
+                return -2;
+            if (this->nNice > 0)
+                return -1;
+            if (this->nNice <= -10)
+                return 2;
+            if (this->nNice < 0)
+                return 1;
+            return 0;
+        }
+    public:
+        static inline int Select(int nFormat, int nGlobal)
+        {
+            return nFormat != config::CFormat::nInherit ? nFormat : nGlobal;
+        }
+        static inline CProcessLimits Get(const config::COptions& options, const config::CFormat& format)
+        {
+            // format values override global options, a format can set 0 to lift a global limit
+            CProcessLimits limits;
+            limits.nNice = Select(format.nNice, options.nProcessNice);
+            limits.nIoClass = Select(format.nIoClass, options.nProcessIoClass);
+            limits.nMemoryLimit = (unsigned __int64)Select(format.nMemoryLimit, options.nProcessMemoryLimit) * 1024 * 1024;
+            limits.nWorkingSetLimit = (unsigned __int64)Select(format.nWorkingSetLimit, options.nProcessWorkingSetLimit) * 1024 * 1024;
+            limits.nWallTime = Select(format.nWallTime, options.nProcessWallTime);
+            return limits;
+        }
+    };
+}
@@ -0,0 +1,233 @@
+﻿// Copyright (c) Wiesław Šoltés. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#pragma once
+
+#include <string>
+#include <map>
+#include <mutex>
+#include <cstdio>
+#include "ItemMetrics.h"
+#include "WorkerContext.h"
+
+namespace worker
+{
+    class CFormatCounters
+    {
+    public:
+        int nItems;
+        int nFailed;
+        unsigned __int64 nBytesIn;
+        unsigned __int64 nBytesOut;
+        double fTotalTime;
+        double fCpuTime;
+        unsigned __int64 nPeakMemory;
+    public:
+        CFormatCounters()
+        {
+            this->nItems = 0;
+            this->nFailed = 0;
+            this->nBytesIn = 0;
+            this->nBytesOut = 0;
+            this->fTotalTime = 0.0;
+            this->fCpuTime = 0.0;
+            this->nPeakMemory = 0;
+        }
+    };
+
+    class CPrometheusExporter
+    {
+        std::mutex m_Lock;
+        std::mutex m_WriteLock;
+        std::map<std::wstring, CFormatCounters> m_Formats;
+        std::map<std::wstring, int> m_Failures;
+        int nRetries;
+        std::wstring szFileName;
+        unsigned __int64 nBytesIn;
+        unsigned __int64 nBytesOut;
+        double fBusyTime;
+        CMetricsTimer batchTimer;
+        CMetricsTimer writeTimer;
+    public:
+        double fInterval;
+    public:
+        CPrometheusExporter()
+        {
+            this->nBytesIn = 0;
+            this->nBytesOut = 0;
+            this->fBusyTime = 0.0;
+            this->nRetries = 0;
+            this->fInterval = 1000.0;
+        }
+    public:
+        void Open(const std::wstring& szFileName)
+        {
+            std::lock_guard<std::mutex> lock(this->m_Lock);
+            this->szFileName = szFileName;
+            this->m_Formats.clear();
+            this->m_Failures.clear();
+            this->nRetries = 0;
+            this->nBytesIn = 0;
+            this->nBytesOut = 0;
+            this->fBusyTime = 0.0;
+            this->batchTimer.Start();
+            this->writeTimer.Start();
+        }
+        void Finished(const CItemMetrics& metrics)
+        {
+            std::lock_guard<std::mutex> lock(this->m_Lock);
+            auto& counters = this->m_Formats[metrics.szFormatId];
+            counters.nItems++;
+            if (metrics.bSuccess == false)
+            {
+                counters.nFailed++;
+                if (metrics.szFailure.empty() == false)
+                    this->m_Failures[metrics.szFailure]++;
+            }
+            counters.nBytesIn += metrics.nBytesIn;
+            counters.nBytesOut += metrics.nBytesOut;
+            counters.fTotalTime += metrics.fTotalTime;
+            counters.fCpuTime += metrics.fUserTime + metrics.fKernelTime;
+            if (metrics.nPeakMemory > counters.nPeakMemory)
+                counters.nPeakMemory = metrics.nPeakMemory;
+            this->nBytesIn += metrics.nBytesIn;
+            this->nBytesOut += metrics.nBytesOut;
+            this->fBusyTime += metrics.fTotalTime;
+        }
+        void Retried(const CItemMetrics& metrics)
+        {
+            // failed attempt that will be retried, the item is not finished yet
+            std::lock_guard<std::mutex> lock(this->m_Lock);
+            this->nRetries++;
+            if (metrics.szFailure.empty() == false)
+                this->m_Failures[metrics.szFailure]++;
+        }
+        std::string ToText(IWorkerContext* ctx)
+        {
+            std::lock_guard<std::mutex> lock(this->m_Lock);
+            std::string szText;
+            char szLine[512];
+
+            int nTotal = ctx->nTotalFiles;
+            int nProcessed = ctx->nProcessedFiles;
+            int nErrors = ctx->nErrors;
+            int nRunning = ctx->nRunningFiles;
+            int nQueued = nTotal - nProcessed - nRunning;
+            if (nQueued < 0)
+                nQueued = 0;
+
+            double fElapsed = this->batchTimer.ElapsedMilliseconds() / 1000.0;
+            double fBusy = this->fBusyTime / 1000.0;
+            double fUtilization = 0.0;
+            if (fElapsed > 0.0 && ctx->nThreadCount > 0)
+                fUtilization = fBusy / (fElapsed * ctx->nThreadCount);
+
+            auto metric = [&](const char* szName, const char* szHelp, const char* szType, double fValue)
+            {
+                _snprintf_s(szLine, sizeof(szLine), _TRUNCATE,
+                    "# HELP %s %s\n# TYPE %s %s\n%s %.17g\n",
+                    szName, szHelp, szName, szType, szName, fValue);
+                szText += szLine;
+            };
+
+            metric("batchencoder_items_total", "Number of items in the batch.", "gauge", nTotal);
+            metric("batchencoder_items_queued", "Number of items waiting for a worker slot.", "gauge", nQueued);
+            metric("batchencoder_items_running", "Number of items being converted.", "gauge", nRunning);
+            metric("batchencoder_items_done_total", "Number of converted items.", "counter", nProcessed - nErrors);
+            metric("batchencoder_items_failed_total", "Number of failed items.", "counter", nErrors);
+            metric("batchencoder_progress_percent", "Batch progress in percent.", "gauge", nTotal > 0 ? (100.0 * nProcessed) / nTotal : 0.0);
+            metric("batchencoder_bytes_in_total", "Number of input bytes of finished items.", "counter", (double)this->nBytesIn);
+            metric("batchencoder_bytes_out_total", "Number of output bytes of finished items.", "counter", (double)this->nBytesOut);
+            metric("batchencoder_processes_active", "Number of running tool processes.", "gauge", ctx->nActiveProcesses);
+            metric("batchencoder_slots_total", "Number of worker slots.", "gauge", ctx->nThreadCount);
+            metric("batchencoder_slots_busy", "Number of busy worker slots.", "gauge", nRunning);
+            metric("batchencoder_slot_busy_seconds_total", "Time worker slots spent on finished items.", "counter", fBusy);
+            metric("batchencoder_slot_utilization", "Fraction of worker slot time spent on finished items.", "gauge", fUtilization);
+            metric("batchencoder_batch_seconds", "Time since the batch was started.", "gauge", fElapsed);
+            metric("batchencoder_paused", "Whether the batch is paused.", "gauge", ctx->bPaused == true ? 1.0 : 0.0);
+            metric("batchencoder_retries_total", "Number of failed attempts that were retried.", "counter", this->nRetries);
+
+            _snprintf_s(szLine, sizeof(szLine), _TRUNCATE, "# HELP %s %s\n# TYPE %s %s\n",
+                "batchencoder_failures_total", "Number of failed attempts per failure class.", "batchencoder_failures_total", "counter");
+            szText += szLine;
+            for (auto& failure : this->m_Failures)
+            {
+                _snprintf_s(szLine, sizeof(szLine), _TRUNCATE, "batchencoder_failures_total{class=\"%s\"} %d\n",
+                    CItemMetrics::Escape(failure.first).c_str(), failure.second);
+                szText += szLine;
+            }
+
+            auto family = [&](const char* szName, const char* szHelp, const char* szType, int nField)
+            {
+                _snprintf_s(szLine, sizeof(szLine), _TRUNCATE, "# HELP %s %s\n# TYPE %s %s\n", szName, szHelp, szName, szType);
+                szText += szLine;
+
+                for (auto& format : this->m_Formats)
+                {
+                    auto& counters = format.second;
+                    double fSeconds = counters.fTotalTime / 1000.0;
+                    double fValue = 0.0;
+                    switch (nField)
+                    {
+                    case 0: fValue = counters.nItems; break;
+                    case 1: fValue = counters.nFailed; break;
+                    case 2: fValue = (double)counters.nBytesIn; break;
+                    case 3: fValue = fSeconds; break;
+                    case 4: fValue = fSeconds > 0.0 ? (double)counters.nBytesIn / fSeconds : 0.0; break;
+                    case 5: fValue = counters.fCpuTime / 1000.0; break;
+                    case 6: fValue = (double)counters.nPeakMemory; break;
+                    }
+
+                    _snprintf_s(szLine, sizeof(szLine), _TRUNCATE, "%s{format=\"%s\"} %.17g\n",
+                        szName, CItemMetrics::Escape(format.first).c_str(), fValue);
+                    szText += szLine;
+                }
+            };
+
+            family("batchencoder_format_items_total", "Number of finished items per format.", "counter", 0);
+            family("batchencoder_format_failed_total", "Number of failed items per format.", "counter", 1);
+            family("batchencoder_format_bytes_in_total", "Number of input bytes per format.", "counter", 2);
+            family("batchencoder_format_seconds_total", "Conversion time per format.", "counter", 3);
+            family("batchencoder_format_throughput_bytes_per_second", "Input bytes per second of conversion time per format.", "gauge", 4);
+            family("batchencoder_format_cpu_seconds_total", "User and kernel time of tool processes per format.", "counter", 5);
+            family("batchencoder_format_peak_memory_bytes", "Largest peak working set of a tool process per format.", "gauge", 6);
+
+            return szText;
+        }
+        bool Write(IWorkerContext* ctx, bool bForce)
+        {
+            if (bForce == false)
+            {
+                if (this->m_WriteLock.try_lock() == false)
+                    return false;
+                if (this->writeTimer.ElapsedMilliseconds() < this->fInterval)
+                {
+                    this->m_WriteLock.unlock();
+                    return false;
+                }
+            }
+            else
+            {
+                this->m_WriteLock.lock();
+            }
+
+            std::lock_guard<std::mutex> lock(this->m_WriteLock, std::adopt_lock);
+            this->writeTimer.Start();
+
+            // write to temporary file and rename so collectors never read partial files
+            std::wstring szTempFileName = this->szFileName + L".tmp";
+            FILE *fs = nullptr;
+            errno_t error = _wfopen_s(&fs, szTempFileName.c_str(), L"wb");
+            if (error != 0 || fs == nullptr)
+                return false;
+
+            std::string szText = this->ToText(ctx);
+            size_t nWritten = fwrite(szText.c_str(), 1, szText.length(), fs);
+            fclose(fs);
+            if (nWritten != szText.length())
+                return false;
+
+            return ::MoveFileExW(szTempFileName.c_str(), this->szFileName.c_str(), MOVEFILE_REPLACE_EXISTING) != FALSE;
+        }
+    };
+}
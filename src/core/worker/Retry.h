@@ -0,0 +1,187 @@
+﻿// Copyright (c) Wiesław Šoltés. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cwctype>
+#include "ItemMetrics.h"
+
+namespace worker
+{
+    enum class FailureClass : int
+    {
+        None = 0,
+        Cancelled,
+        Start,
+        Exit,
+        Crash,
+        Fault,
+        Io,
+        Stderr,
+        Stall,
+        WallTime,
+        Error
+    };
+
+    class CRetryPolicy
+    {
+        std::vector<std::wstring> m_Patterns;
+    public:
+        int nMaxAttempts;
+        int nBaseDelay;
+        int nMaxDelay;
+    public:
+        CRetryPolicy()
+        {
+            this->nMaxAttempts = 1;
+            this->nBaseDelay = 1000;
+            this->nMaxDelay = 30000;
+        }
+    public:
+        static inline std::wstring ToLower(const std::wstring& szText)
+        {
+            std::wstring szResult = szText;
+            for (auto& c : szResult)
+                c = (wchar_t)std::towlower(c);
+            return szResult;
+        }
+        void SetPatterns(const std::wstring& szPatterns)
+        {
+            // patterns are case insensitive substrings separated by '|'
+            this->m_Patterns.clear();
+            size_t nStart = 0;
+            while (nStart <= szPatterns.length())
+            {
+                size_t nEnd = szPatterns.find(L'|', nStart);
+                if (nEnd == std::wstring::npos)
+                    nEnd = szPatterns.length();
+
+                std::wstring szPattern = szPatterns.substr(nStart, nEnd - nStart);
+                if (szPattern.empty() == false)
+                    this->m_Patterns.emplace_back(ToLower(szPattern));
+
+                nStart = nEnd + 1;
+            }
+        }
+        size_t Patterns() const
+        {
+            return this->m_Patterns.size();
+        }
+        bool Matches(const std::wstring& szText) const
+        {
+            if (szText.empty() == true || this->m_Patterns.empty() == true)
+                return false;
+
+            std::wstring szLower = ToLower(szText);
+            for (auto& szPattern : this->m_Patterns)
+            {
+                if (szLower.find(szPattern) != std::wstring::npos)
+                    return true;
+            }
+            return false;
+        }
+        static inline bool IsInterrupt(int nExitCode)
+        {
+            // STATUS_CONTROL_C_EXIT, the tool was stopped from the console
+            return (unsigned int)nExitCode == 0xC000013A;
+        }
+        static inline bool IsCrash(int nExitCode)
+        {
+            // the process died for lack of resources, the same input may succeed later
+            switch ((unsigned int)nExitCode)
+            {
+            case 0xC0000017: // STATUS_NO_MEMORY
+            case 0xC000009A: // STATUS_INSUFFICIENT_RESOURCES
+            case 0xC000012D: // STATUS_COMMITMENT_LIMIT
+            case 0xC0000142: // STATUS_DLL_INIT_FAILED
+                return true;
+            default:
+                return false;
+            }
+        }
+        static inline bool IsFault(int nExitCode)
+        {
+            // any other error status (access violation, stack overflow, ...) usually repeats on the same input, so it is not retried
+            unsigned int nCode = (unsigned int)nExitCode;
+            return nCode >= 0xC0000000 && nCode <= 0xCFFFFFFF;
+        }
+        FailureClass Classify(const CItemMetrics& metrics, bool bCancelled) const
+        {
+            if (metrics.bSuccess == true)
+                return FailureClass::None;
+            if (bCancelled == true)
+                return FailureClass::Cancelled;
+            if (metrics.szTimeout == L"wall")
+                return FailureClass::WallTime;
+            if (metrics.szTimeout == L"stall")
+                return FailureClass::Stall;
+            if (metrics.bStartFailed == true)
+                return FailureClass::Start;
+            if (IsInterrupt(metrics.nExitCode) == true)
+                return FailureClass::Cancelled;
+            if (IsCrash(metrics.nExitCode) == true)
+                return FailureClass::Crash;
+            if (IsFault(metrics.nExitCode) == true)
+                return FailureClass::Fault;
+            if (metrics.bIoFailed == true)
+                return FailureClass::Io;
+            if (this->Matches(metrics.szStderrTail) == true)
+                return FailureClass::Stderr;
+            if (metrics.nExitCode != -1)
+                return FailureClass::Exit;
+            return FailureClass::Error;
+        }
+        static inline bool IsTransient(FailureClass nClass)
+        {
+            switch (nClass)
+            {
+            case FailureClass::Crash:
+            case FailureClass::Io:
+            case FailureClass::Stderr:
+            case FailureClass::Stall:
+                return true;
+            default:
+                return false;
+            }
+        }
+        bool ShouldRetry(FailureClass nClass, int nAttempts) const
+        {
+            return nAttempts < this->nMaxAttempts && IsTransient(nClass) == true;
+        }
+        int Delay(int nAttempt) const
+        {
+            // exponential backoff after the n-th failed attempt
+            if (this->nBaseDelay <= 0)
+                return 0;
+
+            long long nDelay = this->nBaseDelay;
+            for (int i = 1; i < nAttempt && nDelay < 0x7FFFFFFF; i++)
+                nDelay *= 2;
+
+            if (this->nMaxDelay > 0 && nDelay > this->nMaxDelay)
+                nDelay = this->nMaxDelay;
+            if (nDelay > 0x7FFFFFFF)
+                nDelay = 0x7FFFFFFF;
+            return (int)nDelay;
+        }
+        static inline const wchar_t* ToString(FailureClass nClass)
+        {
+            switch (nClass)
+            {
+            case FailureClass::Cancelled: return L"cancelled";
+            case FailureClass::Start: return L"start";
+            case FailureClass::Exit: return L"exit";
+            case FailureClass::Crash: return L"crash";
+            case FailureClass::Fault: return L"fault";
+            case FailureClass::Io: return L"io";
+            case FailureClass::Stderr: return L"stderr";
+            case FailureClass::Stall: return L"stall";
+            case FailureClass::WallTime: return L"walltime";
+            case FailureClass::Error: return L"error";
+            default: return L"";
+            }
+        }
+    };
+}
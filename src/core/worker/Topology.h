@@ -0,0 +1,96 @@
+﻿// Copyright (c) Wiesław Šoltés. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+
+namespace worker
+{
+    class CProcessorCore
+    {
+    public:
+        unsigned __int64 nMask = 0;
+        int nNode = 0;
+    };
+
+    class CProcessorTopology
+    {
+    public:
+        // physical cores usable by this process, smt siblings share one core mask
+        std::vector<CProcessorCore> m_Cores;
+        // logical processors allowed by cpu rate limit, 0 is no limit
+        int nQuota = 0;
+    public:
+        int Cores() const
+        {
+            return (int)this->m_Cores.size();
+        }
+        int DefaultThreadCount() const
+        {
+            int nCount = this->Cores();
+            if (this->nQuota > 0 && this->nQuota < nCount)
+                nCount = this->nQuota;
+            return nCount > 0 ? nCount : 1;
+        }
+        std::vector<unsigned __int64> SlotMasks(int nSlots) const
+        {
+            std::vector<unsigned __int64> masks;
+            int nCores = this->Cores();
+            if (nSlots < 1 || nCores < 1)
+                return masks;
+
+            // cores grouped by node in processor order so slot core sets are contiguous
+            std::vector<std::vector<int>> nodes;
+            std::vector<int> ids;
+            for (int i = 0; i < nCores; i++)
+            {
+                auto it = std::find(ids.begin(), ids.end(), this->m_Cores[i].nNode);
+                if (it == ids.end())
+                {
+                    ids.push_back(this->m_Cores[i].nNode);
+                    nodes.push_back(std::vector<int>());
+                    it = ids.end() - 1;
+                }
+                nodes[it - ids.begin()].push_back(i);
+            }
+
+            // full core sets never cross a node
+            int nPerSlot = (std::max)(1, nCores / nSlots);
+            std::vector<size_t> used(nodes.size(), 0);
+            for (size_t n = 0; n < nodes.size() && (int)masks.size() < nSlots; n++)
+            {
+                while (used[n] + nPerSlot <= nodes[n].size() && (int)masks.size() < nSlots)
+                {
+                    masks.push_back(this->Mask(nodes[n], used[n], used[n] + nPerSlot));
+                    used[n] += nPerSlot;
+                }
+            }
+
+            // cores left on a node make one smaller set
+            for (size_t n = 0; n < nodes.size() && (int)masks.size() < nSlots; n++)
+            {
+                if (used[n] < nodes[n].size())
+                {
+                    masks.push_back(this->Mask(nodes[n], used[n], nodes[n].size()));
+                    used[n] = nodes[n].size();
+                }
+            }
+
+            // more slots than cores share core sets
+            for (size_t i = 0; (int)masks.size() < nSlots; i++)
+                masks.push_back(masks[i]);
+
+            return masks;
+        }
+    private:
+        unsigned __int64 Mask(const std::vector<int>& node, size_t nBegin, size_t nEnd) const
+        {
+            unsigned __int64 nMask = 0;
+            for (size_t i = nBegin; i < nEnd; i++)
+                nMask |= this->m_Cores[node[i]].nMask;
+            return nMask;
+        }
+    };
+}
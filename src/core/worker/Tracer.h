@@ -0,0 +1,248 @@
+﻿// Copyright (c) Wiesław Šoltés. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+
+// Trace points are compiled in only when BATCHENCODER_TRACE is defined,
+// otherwise all TRACE_* macros expand to nothing (or to a plain lock).
+#ifdef BATCHENCODER_TRACE
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SPAN(category, name) worker::CTraceSpan TRACE_CONCAT(traceSpan, __LINE__)(category, name, -1)
+#define TRACE_SPAN_ITEM(category, name, id) worker::CTraceSpan TRACE_CONCAT(traceSpan, __LINE__)(category, name, id)
+#define TRACE_LOCK(m, name) worker::CTracer::Lock(m, name)
+#define TRACE_THREAD_NAME(name, index) worker::CTracer::Instance().SetThreadName(name, index)
+#define TRACE_BEGIN(file) worker::CTracer::Instance().Start(file)
+#define TRACE_END() worker::CTracer::Instance().Stop()
+#else
+#define TRACE_SPAN(category, name)
+#define TRACE_SPAN_ITEM(category, name, id)
+#define TRACE_LOCK(m, name) m.lock()
+#define TRACE_THREAD_NAME(name, index)
+#define TRACE_BEGIN(file)
+#define TRACE_END()
+#endif
+
+namespace worker
+{
+    class CTraceEvent
+    {
+    public:
+        const char* szCategory;
+        const char* szName;
+        int nItemId;
+        __int64 nStart;
+        __int64 nDuration;
+    };
+
+    class CTraceBuffer
+    {
+    public:
+        unsigned long nThreadId;
+        std::string szThreadName;
+        std::vector<CTraceEvent> m_Events;
+    };
+
+    class CTracer
+    {
+        std::mutex m_Lock;
+        std::vector<std::shared_ptr<CTraceBuffer>> m_Buffers;
+        std::chrono::steady_clock::time_point tStart;
+        std::wstring szFileName;
+        std::atomic<unsigned __int64> nGeneration;
+        std::atomic<bool> bEnabled;
+    public:
+        CTracer()
+        {
+            this->tStart = std::chrono::steady_clock::now();
+            this->nGeneration = NextGeneration();
+            this->bEnabled = false;
+        }
+    public:
+        static unsigned __int64 NextGeneration()
+        {
+            // process wide so a tracer created at the address of a freed one never matches a cached buffer
+            static std::atomic<unsigned __int64> nNext(1);
+            return nNext++;
+        }
+        static CTracer& Instance()
+        {
+            static CTracer tracer;
+            return tracer;
+        }
+        static void Lock(std::mutex& m, const char* szName);
+        static bool IsCompiled()
+        {
+#ifdef BATCHENCODER_TRACE
+            return true;
+#else
+            return false;
+#endif
+        }
+    public:
+        bool IsEnabled() const
+        {
+            return this->bEnabled;
+        }
+        __int64 Now() const
+        {
+            auto tNow = std::chrono::steady_clock::now();
+            return std::chrono::duration_cast<std::chrono::microseconds>(tNow - this->tStart).count();
+        }
+        CTraceBuffer* GetBuffer()
+        {
+            // thread keeps a reference to its buffer, so buffers dropped by Start stay valid until the thread moves on
+            thread_local std::shared_ptr<CTraceBuffer> pBuffer;
+            thread_local unsigned __int64 nBufferGeneration = 0;
+            if (pBuffer == nullptr || nBufferGeneration != this->nGeneration)
+            {
+                auto buffer = std::make_shared<CTraceBuffer>();
+                buffer->nThreadId = ::GetCurrentThreadId();
+                buffer->m_Events.reserve(1024);
+
+                std::lock_guard<std::mutex> lock(this->m_Lock);
+                nBufferGeneration = this->nGeneration;
+                this->m_Buffers.emplace_back(buffer);
+                pBuffer = std::move(buffer);
+            }
+            return pBuffer.get();
+        }
+        void SetThreadName(const char* szName, int nIndex)
+        {
+            if (this->bEnabled == false)
+                return;
+            CTraceBuffer* pBuffer = this->GetBuffer();
+            pBuffer->szThreadName = std::string(szName) + " " + std::to_string(nIndex);
+        }
+        void Add(const char* szCategory, const char* szName, int nItemId, __int64 nStart, __int64 nEnd)
+        {
+            CTraceBuffer* pBuffer = this->GetBuffer();
+            pBuffer->m_Events.push_back({ szCategory, szName, nItemId, nStart, nEnd - nStart });
+        }
+    public:
+        void Start(const std::wstring& szFileName)
+        {
+            if (szFileName.empty())
+                return;
+
+            std::lock_guard<std::mutex> lock(this->m_Lock);
+            this->m_Buffers.clear();
+            this->nGeneration = NextGeneration();
+            this->szFileName = szFileName;
+            this->tStart = std::chrono::steady_clock::now();
+            this->bEnabled = true;
+        }
+        bool Stop()
+        {
+            if (this->bEnabled == false)
+                return false;
+
+            this->bEnabled = false;
+            return this->Save(this->szFileName);
+        }
+        size_t Count()
+        {
+            std::lock_guard<std::mutex> lock(this->m_Lock);
+            size_t nCount = 0;
+            for (auto& buffer : this->m_Buffers)
+                nCount += buffer->m_Events.size();
+            return nCount;
+        }
+        std::string ToJson()
+        {
+            std::lock_guard<std::mutex> lock(this->m_Lock);
+            std::string szJson;
+            char szEvent[512];
+            bool bFirst = true;
+
+            szJson += "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+            for (auto& buffer : this->m_Buffers)
+            {
+                if (buffer->szThreadName.empty() == false)
+                {
+                    _snprintf_s(szEvent, sizeof(szEvent), _TRUNCATE,
+                        "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%lu,\"args\":{\"name\":\"%s\"}}",
+                        bFirst ? "" : ",\n",
+                        buffer->nThreadId,
+                        buffer->szThreadName.c_str());
+                    szJson += szEvent;
+                    bFirst = false;
+                }
+
+                for (auto& e : buffer->m_Events)
+                {
+                    _snprintf_s(szEvent, sizeof(szEvent), _TRUNCATE,
+                        "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%lld,\"pid\":1,\"tid\":%lu,\"args\":{\"item\":%d}}",
+                        bFirst ? "" : ",\n",
+                        e.szName,
+                        e.szCategory,
+                        e.nStart,
+                        e.nDuration,
+                        buffer->nThreadId,
+                        e.nItemId);
+                    szJson += szEvent;
+                    bFirst = false;
+                }
+            }
+
+            szJson += "]}\n";
+            return szJson;
+        }
+        bool Save(const std::wstring& szFileName)
+        {
+            FILE *fs = nullptr;
+            errno_t error = _wfopen_s(&fs, szFileName.c_str(), L"wb");
+            if (error != 0 || fs == nullptr)
+                return false;
+
+            std::string szJson = this->ToJson();
+            fwrite(szJson.c_str(), 1, szJson.length(), fs);
+            fclose(fs);
+            return true;
+        }
+    };
+
+    class CTraceSpan
+    {
+        const char* szCategory;
+        const char* szName;
+        int nItemId;
+        __int64 nStart;
+        bool bEnabled;
+    public:
+        CTraceSpan(const char* szCategory, const char* szName, int nItemId)
+        {
+            this->bEnabled = CTracer::Instance().IsEnabled();
+            if (this->bEnabled == true)
+            {
+                this->szCategory = szCategory;
+                this->szName = szName;
+                this->nItemId = nItemId;
+                this->nStart = CTracer::Instance().Now();
+            }
+        }
+        ~CTraceSpan()
+        {
+            if (this->bEnabled == true)
+            {
+                auto& tracer = CTracer::Instance();
+                tracer.Add(this->szCategory, this->szName, this->nItemId, this->nStart, tracer.Now());
+            }
+        }
+    };
+
+    inline void CTracer::Lock(std::mutex& m, const char* szName)
+    {
+        CTraceSpan span("lock", szName, -1);
+        m.lock();
+    }
+}
@@ -0,0 +1,232 @@
+﻿// Copyright (c) Wiesław Šoltés. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <condition_variable>
+#include "WorkerContext.h"
+
+namespace worker
+{
+    enum class WatchdogReason : int
+    {
+        None = 0,
+        Stall = 1,
+        WallTime = 2
+    };
+
+    class CWatchdogJob
+    {
+    public:
+        int nItemId = -1;
+        double fStallTimeout = 0.0;
+        double fWallTimeout = 0.0;
+        double fStart = 0.0;
+        double fLastActivity = 0.0;
+        int nLastProgress = 0;
+        unsigned __int64 nLastBytes = 0;
+        WatchdogReason nReason = WatchdogReason::None;
+        std::vector<std::shared_ptr<IProcess>> processes;
+    public:
+        WatchdogReason Check(double fNow, int nProgress, unsigned __int64 nBytes)
+        {
+            // progress or i/o of any process of the item counts as activity
+            if (nProgress != this->nLastProgress || nBytes != this->nLastBytes)
+            {
+                this->nLastProgress = nProgress;
+                this->nLastBytes = nBytes;
+                this->fLastActivity = fNow;
+            }
+
+            if (this->fWallTimeout > 0.0 && fNow - this->fStart >= this->fWallTimeout)
+                this->nReason = WatchdogReason::WallTime;
+            else if (this->fStallTimeout > 0.0 && fNow - this->fLastActivity >= this->fStallTimeout)
+                this->nReason = WatchdogReason::Stall;
+
+            return this->nReason;
+        }
+        void Resume(double fPaused, double fNow)
+        {
+            // time spent paused counts neither as wall time nor as a stall
+            this->fStart += fNow - (std::max)(fPaused, this->fStart);
+            this->fLastActivity += fNow - (std::max)(fPaused, this->fLastActivity);
+        }
+    };
+
+    class CWatchdog : public IProgressObserver
+    {
+        std::mutex m_Lock;
+        std::condition_variable m_Changed;
+        std::thread monitorThread;
+        bool bMonitoring;
+        CMetricsTimer clock;
+        double fPaused;
+        std::map<int, CWatchdogJob> m_Jobs;
+        std::unique_ptr<std::atomic<int>[]> m_Progress;
+        size_t nItems;
+    public:
+        int nInterval;
+    public:
+        CWatchdog()
+        {
+            this->bMonitoring = false;
+            this->fPaused = -1.0;
+            this->nItems = 0;
+            this->nInterval = 1000;
+        }
+        virtual ~CWatchdog()
+        {
+            this->Stop();
+        }
+    public:
+        double Now() const
+        {
+            return this->clock.ElapsedMilliseconds();
+        }
+        void Open(size_t nItems)
+        {
+            // one progress slot per item, written by reporting threads without taking the lock
+            this->m_Progress = std::make_unique<std::atomic<int>[]>(nItems);
+            for (size_t i = 0; i < nItems; i++)
+                this->m_Progress[i].store(0, std::memory_order_relaxed);
+            this->nItems = nItems;
+        }
+        void ItemProgress(int nItemId, int nProgress)
+        {
+            if (nItemId >= 0 && (size_t)nItemId < this->nItems)
+                this->m_Progress[nItemId].store(nProgress, std::memory_order_relaxed);
+        }
+        int Progress(int nItemId) const
+        {
+            if (nItemId >= 0 && (size_t)nItemId < this->nItems)
+                return this->m_Progress[nItemId].load(std::memory_order_relaxed);
+            return 0;
+        }
+        void Begin(int nItemId, int nStallTimeout, int nWallTimeout)
+        {
+            this->ItemProgress(nItemId, 0);
+            std::lock_guard<std::mutex> lock(this->m_Lock);
+            CWatchdogJob job;
+            job.nItemId = nItemId;
+            job.fStallTimeout = nStallTimeout * 1000.0;
+            job.fWallTimeout = nWallTimeout * 1000.0;
+            job.fStart = this->Now();
+            job.fLastActivity = job.fStart;
+            this->m_Jobs[nItemId] = job;
+        }
+        void Attach(int nItemId, std::shared_ptr<IProcess> process)
+        {
+            std::lock_guard<std::mutex> lock(this->m_Lock);
+            auto it = this->m_Jobs.find(nItemId);
+            if (it == this->m_Jobs.end())
+                return;
+
+            // time spent waiting for tool downloads is not a stall
+            if (it->second.processes.empty() == true)
+                it->second.fLastActivity = this->Now();
+            it->second.processes.push_back(process);
+        }
+        WatchdogReason End(int nItemId)
+        {
+            std::lock_guard<std::mutex> lock(this->m_Lock);
+            auto it = this->m_Jobs.find(nItemId);
+            if (it == this->m_Jobs.end())
+                return WatchdogReason::None;
+
+            WatchdogReason nReason = it->second.nReason;
+            this->m_Jobs.erase(it);
+            return nReason;
+        }
+        bool Paused()
+        {
+            std::lock_guard<std::mutex> lock(this->m_Lock);
+            return this->fPaused >= 0.0;
+        }
+        void Pause()
+        {
+            std::lock_guard<std::mutex> lock(this->m_Lock);
+            if (this->fPaused < 0.0)
+                this->fPaused = this->Now();
+        }
+        void Resume()
+        {
+            std::lock_guard<std::mutex> lock(this->m_Lock);
+            if (this->fPaused < 0.0)
+                return;
+
+            double fNow = this->Now();
+            for (auto& it : this->m_Jobs)
+                it.second.Resume(this->fPaused, fNow);
+            this->fPaused = -1.0;
+        }
+        void Poll(IWorkerContext* ctx)
+        {
+            // timers are frozen while the batch is paused, a pause is noticed within one interval
+            if (ctx->bPaused == true)
+            {
+                this->Pause();
+                return;
+            }
+            this->Resume();
+
+            std::lock_guard<std::mutex> lock(this->m_Lock);
+            double fNow = this->Now();
+            for (auto& it : this->m_Jobs)
+            {
+                auto& job = it.second;
+                if (job.processes.empty() == true || job.nReason != WatchdogReason::None)
+                    continue;
+
+                unsigned __int64 nBytes = 0;
+                for (auto& process : job.processes)
+                    nBytes += process->IoBytes();
+
+                if (job.Check(fNow, this->Progress(job.nItemId), nBytes) != WatchdogReason::None)
+                {
+                    // killed processes close their pipes so blocked reads and writes return
+                    for (auto& process : job.processes)
+                        process->Terminate(-1);
+                }
+            }
+        }
+        void Start(IWorkerContext* ctx)
+        {
+            this->Open(ctx->pConfig->m_Items.size());
+            this->bMonitoring = true;
+            this->monitorThread = std::thread([this, ctx]() { this->MonitorLoop(ctx); });
+        }
+        void Stop()
+        {
+            {
+                std::lock_guard<std::mutex> lock(this->m_Lock);
+                this->bMonitoring = false;
+            }
+            this->m_Changed.notify_all();
+            if (this->monitorThread.joinable())
+                this->monitorThread.join();
+        }
+    private:
+        void MonitorLoop(IWorkerContext* ctx)
+        {
+            std::unique_lock<std::mutex> lock(this->m_Lock);
+            while (this->bMonitoring == true)
+            {
+                this->m_Changed.wait_for(lock, std::chrono::milliseconds(this->nInterval));
+                if (this->bMonitoring == false)
+                    continue;
+
+                lock.unlock();
+                this->Poll(ctx);
+                lock.lock();
+            }
+        }
+    };
+}
@@ -7,16 +7,23 @@
 #include <utility>
 #include <string>
 #include <cstring>
+#include <vector>
+#include <algorithm>
+#include <mutex>
+#include <Psapi.h>
+#include <Pdh.h>
 #include "utilities\FileSystem.h"
 #include "utilities\Log.h"
 #include "utilities\Pipe.h"
-#include "utilities\Process.h"
 #include "utilities\String.h"
 #include "utilities\Utilities.h"
 #include "ToolDownloader.h"
 #include "LuaProgess.h"
+#include "Tracer.h"
 #include "WorkerContext.h"
 
+#pragma comment(lib, "pdh.lib")
+
 namespace worker
 {
     class Win32Downloader : public IDownloader
@@ -49,43 +56,363 @@ namespace worker
 
     class Win32Process : public IProcess
     {
-        util::CProcess process;
+        STARTUPINFO si;
+        PROCESS_INFORMATION pi;
+        int nExitCode;
+        CProcessUsage usage;
+        unsigned __int64 nAffinity;
+        CProcessLimits limits;
+        HANDLE hJob;
+        HANDLE hWallTimer;
+        std::mutex m_Handle;
+    public:
+        Win32Process()
+        {
+            ::ZeroMemory(&this->si, sizeof(this->si));
+            ::ZeroMemory(&this->pi, sizeof(this->pi));
+            this->si.cb = sizeof(this->si);
+            this->si.dwFlags = STARTF_USESTDHANDLES | STARTF_USESHOWWINDOW;
+            this->si.hStdInput = nullptr;
+            this->si.hStdOutput = nullptr;
+            this->si.hStdError = nullptr;
+            this->pi.hProcess = nullptr;
+            this->pi.hThread = nullptr;
+            this->nExitCode = -1;
+            this->nAffinity = 0;
+            this->hJob = nullptr;
+            this->hWallTimer = nullptr;
+        }
+        virtual ~Win32Process()
+        {
+            this->Close();
+        }
     public:
         void ConnectStdInput(void* hPipeStdin)
         {
-            process.ConnectStdInput(hPipeStdin);
+            this->si.hStdInput = hPipeStdin;
         }
         void ConnectStdOutput(void* hPipeStdout)
         {
-            process.ConnectStdOutput(hPipeStdout);
+            this->si.hStdOutput = hPipeStdout;
         }
         void ConnectStdError(void* hPipeStderr)
         {
-            process.ConnectStdError(hPipeStderr);
+            this->si.hStdError = hPipeStderr;
         }
         bool Start(const std::wstring& szCommandLine, bool bNoWindow)
         {
-            return process.Start(szCommandLine, bNoWindow);
+            TRACE_SPAN("process", "Start");
+
+            std::vector<wchar_t> buffer(szCommandLine.begin(), szCommandLine.end());
+            buffer.push_back(L'\0');
+
+            this->si.wShowWindow = bNoWindow ? SW_HIDE : SW_SHOWNORMAL;
+            this->nExitCode = -1;
+            this->usage.Reset();
+
+            BOOL bResult = ::CreateProcess(nullptr,
+                buffer.data(),
+                nullptr,
+                nullptr,
+                TRUE,
+                PriorityClass(this->limits.PriorityLevel()) | CREATE_NEW_CONSOLE | CREATE_SUSPENDED,
+                nullptr,
+                nullptr,
+                &this->si,
+                &this->pi);
+            if (bResult == FALSE)
+                return false;
+
+            // pinned, limited and in its job before the first instruction runs, processes started by the tool inherit all
+            if (this->nAffinity != 0)
+                ::SetProcessAffinityMask(this->pi.hProcess, (DWORD_PTR)this->nAffinity);
+            this->OpenJob();
+            if (this->limits.nIoClass > 0)
+                SetIoPriority(this->pi.hProcess, this->limits.nIoClass);
+            ::ResumeThread(this->pi.hThread);
+
+            if (this->limits.nWallTime > 0)
+            {
+                ::RegisterWaitForSingleObject(&this->hWallTimer,
+                    this->pi.hProcess,
+                    WallTimeExpired,
+                    this,
+                    (ULONG)this->limits.nWallTime * 1000,
+                    WT_EXECUTEONLYONCE);
+            }
+            return true;
         }
         bool Wait()
         {
-            return process.Wait();
+            if (this->pi.hProcess == nullptr)
+                return false;
+            return ::WaitForSingleObject(this->pi.hProcess, INFINITE) == WAIT_OBJECT_0;
         }
         bool Wait(int milliseconds)
         {
-            return process.Wait(milliseconds);
+            if (this->pi.hProcess == nullptr)
+                return false;
+            return ::WaitForSingleObject(this->pi.hProcess, milliseconds) == WAIT_OBJECT_0;
         }
         bool Terminate(int code = 0)
         {
-            return process.Terminate(code);
+            std::lock_guard<std::mutex> lock(this->m_Handle);
+            if (this->pi.hProcess == nullptr)
+                return false;
+            return TerminateTree(code);
         }
         bool Close()
         {
-            return process.Close();
+            // watchdog may terminate or sample from another thread
+            std::lock_guard<std::mutex> lock(this->m_Handle);
+
+            // waits for a running timeout callback before handles are closed
+            if (this->hWallTimer != nullptr)
+            {
+                ::UnregisterWaitEx(this->hWallTimer, INVALID_HANDLE_VALUE);
+                this->hWallTimer = nullptr;
+            }
+            if (this->hJob != nullptr)
+            {
+                ::CloseHandle(this->hJob);
+                this->hJob = nullptr;
+            }
+            if (this->pi.hThread != nullptr)
+            {
+                ::CloseHandle(this->pi.hThread);
+                this->pi.hThread = nullptr;
+            }
+            if (this->pi.hProcess != nullptr)
+            {
+                ::CloseHandle(this->pi.hProcess);
+                this->pi.hProcess = nullptr;
+            }
+            return true;
         }
         bool Stop(bool bWait, int nExitCodeSucess)
         {
-            return process.Stop(bWait, nExitCodeSucess);
+            if (this->pi.hProcess == nullptr)
+                return false;
+
+            if (bWait == true)
+                this->Wait();
+            else
+                this->Terminate(-1);
+
+            DWORD dwExitCode = (DWORD)-1;
+            BOOL bResult = ::GetExitCodeProcess(this->pi.hProcess, &dwExitCode);
+            this->nExitCode = (int)dwExitCode;
+            this->Sample();
+            this->Close();
+
+            return (bResult != FALSE) && (this->nExitCode == nExitCodeSucess);
+        }
+        int ExitCode()
+        {
+            return this->nExitCode;
+        }
+        CProcessUsage Usage()
+        {
+            return this->usage;
+        }
+        bool SetAffinity(unsigned __int64 nMask)
+        {
+            this->nAffinity = nMask;
+            return true;
+        }
+        bool SetLimits(const CProcessLimits& limits)
+        {
+            this->limits = limits;
+            return true;
+        }
+        unsigned __int64 IoBytes()
+        {
+            std::lock_guard<std::mutex> lock(this->m_Handle);
+            if (this->pi.hProcess == nullptr)
+                return 0;
+
+            // pipe traffic is counted as read and write transfers
+            IO_COUNTERS io;
+            if (::GetProcessIoCounters(this->pi.hProcess, &io) == FALSE)
+                return 0;
+            return io.ReadTransferCount + io.WriteTransferCount + io.OtherTransferCount;
+        }
+        bool Suspend()
+        {
+            std::lock_guard<std::mutex> lock(this->m_Handle);
+            if (this->pi.hProcess == nullptr)
+                return false;
+            return SuspendTree(true);
+        }
+        bool Resume()
+        {
+            std::lock_guard<std::mutex> lock(this->m_Handle);
+            if (this->pi.hProcess == nullptr)
+                return false;
+            return SuspendTree(false);
+        }
+        void* ProcessHandle()
+        {
+            return this->pi.hProcess;
+        }
+    private:
+        static double ToMilliseconds(const FILETIME& ft)
+        {
+            ULARGE_INTEGER value;
+            value.LowPart = ft.dwLowDateTime;
+            value.HighPart = ft.dwHighDateTime;
+            return value.QuadPart / 10000.0;
+        }
+        void Sample()
+        {
+            // process is reaped here so counters are final
+            FILETIME ftCreation, ftExit, ftKernel, ftUser;
+            if (::GetProcessTimes(this->pi.hProcess, &ftCreation, &ftExit, &ftKernel, &ftUser) != FALSE)
+            {
+                this->usage.fUserTime = ToMilliseconds(ftUser);
+                this->usage.fKernelTime = ToMilliseconds(ftKernel);
+            }
+
+            PROCESS_MEMORY_COUNTERS pmc;
+            if (::GetProcessMemoryInfo(this->pi.hProcess, &pmc, sizeof(pmc)) != FALSE)
+                this->usage.nPeakMemory = pmc.PeakWorkingSetSize;
+
+            IO_COUNTERS io;
+            if (::GetProcessIoCounters(this->pi.hProcess, &io) != FALSE)
+            {
+                this->usage.nReadBytes = io.ReadTransferCount;
+                this->usage.nWriteBytes = io.WriteTransferCount;
+            }
+        }
+        static DWORD PriorityClass(int nLevel)
+        {
+            switch (nLevel)
+            {
+            case -2: return IDLE_PRIORITY_CLASS;
+            case -1: return BELOW_NORMAL_PRIORITY_CLASS;
+            case 1: return ABOVE_NORMAL_PRIORITY_CLASS;
+            case 2: return HIGH_PRIORITY_CLASS;
+            default: return NORMAL_PRIORITY_CLASS;
+            }
+        }
+        static bool SetIoPriority(HANDLE hProcess, int nIoClass)
+        {
+            // memory priority needs windows 8, it is resolved at run time so the exe still loads on xp and 7
+            struct CMemoryPriority
+            {
+                ULONG MemoryPriority;
+            };
+            typedef BOOL(WINAPI *SetProcessInformationPtr)(HANDLE, int, LPVOID, DWORD);
+            auto pSetProcessInformation = (SetProcessInformationPtr)::GetProcAddress(::GetModuleHandleW(L"kernel32.dll"), "SetProcessInformation");
+            if (pSetProcessInformation != nullptr)
+            {
+                const int nProcessMemoryPriority = 0;
+                const ULONG nMemoryPriorityVeryLow = 1;
+                const ULONG nMemoryPriorityLow = 2;
+                CMemoryPriority memory;
+                memory.MemoryPriority = nIoClass >= 2 ? nMemoryPriorityVeryLow : nMemoryPriorityLow;
+                pSetProcessInformation(hProcess, nProcessMemoryPriority, &memory, sizeof(memory));
+            }
+
+            // i/o priority of another process is only settable through ntdll
+
+            typedef LONG(NTAPI *NtSetInformationProcessPtr)(HANDLE, ULONG, PVOID, ULONG);
+            auto pNtSetInformationProcess = (NtSetInformationProcessPtr)::GetProcAddress(::GetModuleHandleW(L"ntdll.dll"), "NtSetInformationProcess");
+            if (pNtSetInformationProcess == nullptr)
+                return false;
+
+            const ULONG nProcessIoPriority = 33;
+            ULONG nPriority = nIoClass >= 2 ? 0 : 1;
+            return pNtSetInformationProcess(hProcess, nProcessIoPriority, &nPriority, sizeof(nPriority)) >= 0;
+        }
+        bool TerminateTree(int code)
+        {
+            // job holds the tool and every process it started
+            if (this->hJob != nullptr && ::TerminateJobObject(this->hJob, code) != FALSE)
+                return true;
+            return ::TerminateProcess(this->pi.hProcess, code) != FALSE;
+        }
+        bool SuspendTree(bool bSuspend)
+        {
+            // jobs can not be suspended as a whole and suspending a process is only available through ntdll
+            typedef LONG(NTAPI *NtProcessPtr)(HANDLE);
+            auto pNtProcess = (NtProcessPtr)::GetProcAddress(::GetModuleHandleW(L"ntdll.dll"), bSuspend ? "NtSuspendProcess" : "NtResumeProcess");
+            if (pNtProcess == nullptr)
+                return false;
+
+            // job holds the tool and every process it started
+            if (this->hJob != nullptr)
+            {
+                const DWORD nMaxProcesses = 256;
+                std::vector<BYTE> buffer(sizeof(JOBOBJECT_BASIC_PROCESS_ID_LIST) + nMaxProcesses * sizeof(ULONG_PTR));
+                auto list = (JOBOBJECT_BASIC_PROCESS_ID_LIST*)buffer.data();
+                if (::QueryInformationJobObject(this->hJob, JobObjectBasicProcessIdList, list, (DWORD)buffer.size(), nullptr) != FALSE)
+                {
+                    bool bResult = true;
+                    for (DWORD i = 0; i < list->NumberOfProcessIdsInList; i++)
+                    {
+                        HANDLE hProcess = ::OpenProcess(PROCESS_SUSPEND_RESUME, FALSE, (DWORD)list->ProcessIdList[i]);
+                        if (hProcess == nullptr)
+                        {
+                            bResult = false;
+                            continue;
+                        }
+                        if (pNtProcess(hProcess) < 0)
+                            bResult = false;
+                        ::CloseHandle(hProcess);
+                    }
+                    return bResult;
+                }
+            }
+            return pNtProcess(this->pi.hProcess) >= 0;
+        }
+        bool OpenJob()
+        {
+            this->hJob = ::CreateJobObjectW(nullptr, nullptr);
+            if (this->hJob == nullptr)
+                return false;
+
+            // closing the job handle kills processes left behind by the tool
+            JOBOBJECT_EXTENDED_LIMIT_INFORMATION info;
+            ::ZeroMemory(&info, sizeof(info));
+            info.BasicLimitInformation.LimitFlags = JOB_OBJECT_LIMIT_KILL_ON_JOB_CLOSE;
+            if (this->limits.nMemoryLimit > 0)
+            {
+                info.BasicLimitInformation.LimitFlags |= JOB_OBJECT_LIMIT_PROCESS_MEMORY;
+                info.ProcessMemoryLimit = (SIZE_T)this->limits.nMemoryLimit;
+            }
+            if (this->limits.nWorkingSetLimit > 0)
+            {
+                info.BasicLimitInformation.LimitFlags |= JOB_OBJECT_LIMIT_WORKINGSET;
+                info.BasicLimitInformation.MinimumWorkingSetSize = (SIZE_T)(std::min)(this->limits.nWorkingSetLimit, (unsigned __int64)1024 * 1024);
+                info.BasicLimitInformation.MaximumWorkingSetSize = (SIZE_T)this->limits.nWorkingSetLimit;
+            }
+
+            // limits that can not be set do not cost the process tree kill
+            if (::SetInformationJobObject(this->hJob, JobObjectExtendedLimitInformation, &info, sizeof(info)) == FALSE)
+            {
+                ::ZeroMemory(&info, sizeof(info));
+                info.BasicLimitInformation.LimitFlags = JOB_OBJECT_LIMIT_KILL_ON_JOB_CLOSE;
+                ::SetInformationJobObject(this->hJob, JobObjectExtendedLimitInformation, &info, sizeof(info));
+            }
+
+            // without a job terminate falls back to the tool process only
+            if (::AssignProcessToJobObject(this->hJob, this->pi.hProcess) == FALSE)
+            {
+                ::CloseHandle(this->hJob);
+                this->hJob = nullptr;
+                return false;
+            }
+            return true;
+        }
+        static void CALLBACK WallTimeExpired(PVOID pContext, BOOLEAN bTimerOrWaitFired)
+        {
+            // fired by timeout, not by process exit
+            if (bTimerOrWaitFired == TRUE)
+            {
+                auto process = (Win32Process*)pContext;
+                process->TerminateTree(ERROR_TIMEOUT);
+            }
         }
     public:
         void* StdinHandle()
@@ -149,6 +476,8 @@ namespace worker
     public:
         bool WriteLoop(IWorkerContext* ctx, IPipe* Stdout)
         {
+            TRACE_SPAN_ITEM("io", "WriteLoop", this->nIndex);
+
             HANDLE hPipe = Stdout->ReadHandle();
             HANDLE hFile = INVALID_HANDLE_VALUE;
             BYTE pReadBuff[4096];
@@ -156,14 +485,20 @@ namespace worker
             DWORD dwReadBytes = 0;
             DWORD dwWriteBytes = 0;
             ULONGLONG nTotalBytesWrite = 0;
+            CMetricsTimer stallTimer;
+            bool bStalled = false;
 
             bError = false;
+            bFileError = false;
             bFinished = false;
+            nTotalBytes = 0;
+            fStallTime = 0.0;
 
             hFile = ::CreateFile(szFileName.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, 0, nullptr);
             if (hFile == INVALID_HANDLE_VALUE)
             {
                 bError = true;
+                bFileError = true;
                 bFinished = true;
                 return false;
             }
@@ -178,18 +513,34 @@ namespace worker
 
                 if (dwAvailableBytes > 0)
                 {
+                    if (bStalled == true)
+                    {
+                        fStallTime += stallTimer.ElapsedMilliseconds();
+                        bStalled = false;
+                    }
+
                     bRes = ::ReadFile(hPipe, pReadBuff, 4096, &dwReadBytes, 0);
                     if ((bRes == FALSE) || (dwReadBytes == 0))
                         break;
 
                     bRes = ::WriteFile(hFile, pReadBuff, dwReadBytes, &dwWriteBytes, 0);
                     if ((bRes == FALSE) || (dwWriteBytes == 0) || (dwReadBytes != dwWriteBytes))
+                    {
+                        bFileError = true;
                         break;
+                    }
 
                     nTotalBytesWrite += dwReadBytes;
                 }
                 else
+                {
+                    if (bStalled == false)
+                    {
+                        stallTimer.Start();
+                        bStalled = true;
+                    }
                     bRes = TRUE;
+                }
 
                 if (ctx->bRunning == false)
                     break;
@@ -197,6 +548,11 @@ namespace worker
 
             ::CloseHandle(hFile);
 
+            if (bStalled == true)
+                fStallTime += stallTimer.ElapsedMilliseconds();
+
+            nTotalBytes = nTotalBytesWrite;
+
             if (nTotalBytesWrite <= 0)
             {
                 bError = true;
@@ -212,11 +568,91 @@ namespace worker
         }
     };
 
+    class CPipeToNullWriter : public IFileWriter
+    {
+    public:
+        bool WriteLoop(IWorkerContext* ctx, IPipe* Stdout)
+        {
+            TRACE_SPAN_ITEM("io", "NullWriteLoop", this->nIndex);
+
+            HANDLE hPipe = Stdout->ReadHandle();
+            BYTE pReadBuff[4096];
+            BOOL bRes = FALSE;
+            DWORD dwReadBytes = 0;
+            ULONGLONG nTotalBytesRead = 0;
+            CMetricsTimer stallTimer;
+            bool bStalled = false;
+
+            bError = false;
+            bFileError = false;
+            bFinished = false;
+            nTotalBytes = 0;
+            fStallTime = 0.0;
+
+            // same pipe draining as CPipeToFileWriter but output is discarded
+            do
+            {
+                ::Sleep(0);
+
+                DWORD dwAvailableBytes;
+                if (FALSE == PeekNamedPipe(hPipe, 0, 0, 0, &dwAvailableBytes, 0))
+                    break;
+
+                if (dwAvailableBytes > 0)
+                {
+                    if (bStalled == true)
+                    {
+                        fStallTime += stallTimer.ElapsedMilliseconds();
+                        bStalled = false;
+                    }
+
+                    bRes = ::ReadFile(hPipe, pReadBuff, 4096, &dwReadBytes, 0);
+                    if ((bRes == FALSE) || (dwReadBytes == 0))
+                        break;
+
+                    nTotalBytesRead += dwReadBytes;
+                }
+                else
+                {
+                    if (bStalled == false)
+                    {
+                        stallTimer.Start();
+                        bStalled = true;
+                    }
+                    bRes = TRUE;
+                }
+
+                if (ctx->bRunning == false)
+                    break;
+            } while (bRes != FALSE);
+
+            if (bStalled == true)
+                fStallTime += stallTimer.ElapsedMilliseconds();
+
+            nTotalBytes = nTotalBytesRead;
+
+            if (nTotalBytesRead <= 0)
+            {
+                bError = true;
+                bFinished = true;
+                return false;
+            }
+            else
+            {
+                bError = false;
+                bFinished = true;
+                return true;
+            }
+        }
+    };
+
     class CFileToPipeReader : public IFileReader
     {
     public:
         bool ReadLoop(IWorkerContext* ctx, IPipe* Stdin)
         {
+            TRACE_SPAN_ITEM("io", "ReadLoop", this->nIndex);
+
             HANDLE hPipe = Stdin->WriteHandle();
             HANDLE hFile = INVALID_HANDLE_VALUE;
             BYTE pReadBuff[4096];
@@ -228,14 +664,19 @@ namespace worker
             int nProgress = -1;
             int nPreviousProgress = -1;
             bool bRunning = true;
+            CMetricsTimer stallTimer;
 
             bError = false;
+            bFileError = false;
             bFinished = false;
+            nTotalBytes = 0;
+            fStallTime = 0.0;
 
             hFile = ::CreateFile(szFileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, 0, nullptr);
             if (hFile == INVALID_HANDLE_VALUE)
             {
                 bError = true;
+                bFileError = true;
                 bFinished = true;
                 ::CloseHandle(hPipe);
                 return false;
@@ -254,12 +695,19 @@ namespace worker
             do
             {
                 bRes = ::ReadFile(hFile, pReadBuff, 4096, &dwReadBytes, 0);
-                if ((bRes == FALSE) || (dwReadBytes == 0))
+                if (bRes == FALSE)
+                {
+                    bFileError = true;
+                    break;
+                }
+                if (dwReadBytes == 0)
                     break;
 
                 ::Sleep(0);
 
+                stallTimer.Start();
                 bRes = ::WriteFile(hPipe, pReadBuff, dwReadBytes, &dwWriteBytes, 0);
+                fStallTime += stallTimer.ElapsedMilliseconds();
                 if ((bRes == FALSE) || (dwWriteBytes == 0) || (dwReadBytes != dwWriteBytes))
                     break;
 
@@ -268,7 +716,7 @@ namespace worker
 
                 if (nProgress != nPreviousProgress)
                 {
-                    bRunning = ctx->ItemProgress(nIndex, nProgress, false);
+                    bRunning = ctx->Progress(nIndex, nProgress);
                     nPreviousProgress = nProgress;
                 }
 
@@ -279,6 +727,8 @@ namespace worker
             ::CloseHandle(hFile);
             ::CloseHandle(hPipe);
 
+            nTotalBytes = nTotalBytesRead;
+
             if (nTotalBytesRead != nFileSize)
             {
                 bError = true;
@@ -312,8 +762,6 @@ namespace worker
     class CLuaOutputParser : public IOutputParser
     {
         CLuaProgess luaProgress;
-    //public:
-    //    util::ILog* log = nullptr;
     public:
         bool Open(IWorkerContext* ctx, const std::wstring& szFunction)
         {
@@ -337,13 +785,15 @@ namespace worker
         }
         bool Parse(IWorkerContext* ctx, const char *szLine)
         {
-            //if (log != nullptr)
-            //{
-            //    std::wstring szUnicode = util::string::Convert(szLine);
-            //    log->Log(szUnicode, false);
-            //}
+            if (this->log != nullptr)
+                this->log->Log(this->nIndex, szLine);
+
+            int nRet = -1;
+            {
+                TRACE_SPAN_ITEM("lua", "Parse", this->nIndex);
+                nRet = (int)this->luaProgress.GetProgress(szLine);
+            }
 
-            int nRet = (int)this->luaProgress.GetProgress(szLine);
             if (nRet != -1)
             {
                 this->nProgress = nRet;
@@ -352,7 +802,7 @@ namespace worker
             if (this->nProgress != this->nPreviousProgress)
             {
                 nPreviousProgress = nProgress;
-                return ctx->ItemProgress(nIndex, nProgress, false);
+                return ctx->Progress(nIndex, nProgress);
             }
 
             return ctx->bRunning;
@@ -364,6 +814,8 @@ namespace worker
     public:
         bool WriteLoop(IWorkerContext* ctx, IPipe* Stderr, IOutputParser* parser)
         {
+            TRACE_SPAN_ITEM("io", "WriteLoop", this->nIndex);
+
             const int nBuffSize = 4096;
             char szReadBuff[nBuffSize];
             char szLineBuff[nBuffSize];
@@ -434,7 +886,10 @@ namespace worker
                     {
                         if (strlen(szLineBuff) > 0)
                         {
-                            bRunning = parser->Parse(ctx, szLineBuff);
+                            if (this->tail != nullptr)
+                                this->tail->AppendLine(szLineBuff);
+                            if (parser != nullptr)
+                                bRunning = parser->Parse(ctx, szLineBuff);
                             std::memset(szLineBuff, 0, sizeof(szLineBuff));
                             if ((ctx->bRunning == false) || (bRunning == false))
                                 break;
@@ -453,6 +908,30 @@ namespace worker
             bFinished = true;
             return true;
         }
+        bool DrainLoop(IPipe* Stderr)
+        {
+            TRACE_SPAN_ITEM("io", "DrainLoop", this->nIndex);
+
+            const int nBuffSize = 4096;
+            char szReadBuff[nBuffSize];
+            DWORD dwReadBytes = 0L;
+
+            bError = false;
+            bFinished = false;
+
+            // read until the child closes stderr, otherwise a full pipe blocks the child
+            while (::ReadFile(Stderr->ReadHandle(), szReadBuff, nBuffSize, &dwReadBytes, 0) == TRUE && dwReadBytes > 0)
+            {
+                if (this->tail != nullptr)
+                    this->tail->Write(szReadBuff, dwReadBytes);
+            }
+
+            if (this->tail != nullptr)
+                this->tail->EndLine();
+
+            bFinished = true;
+            return true;
+        }
     };
 
     class Win32FileSystem : public util::IFileSystem
@@ -548,6 +1027,215 @@ namespace worker
         }
     };
 
+    class Win32MemoryStatus : public IMemoryStatus
+    {
+    public:
+        unsigned __int64 AvailableMemory()
+        {
+            MEMORYSTATUSEX status;
+            status.dwLength = sizeof(status);
+            if (::GlobalMemoryStatusEx(&status) == FALSE)
+                return (unsigned __int64)-1;
+            return status.ullAvailPhys;
+        }
+    };
+
+    class Win32SystemLoad : public ISystemLoad
+    {
+        ULONGLONG nIdle;
+        ULONGLONG nTotal;
+        PDH_HQUERY hQuery;
+        PDH_HCOUNTER hQueueLength;
+    public:
+        Win32SystemLoad()
+        {
+            this->nIdle = 0;
+            this->nTotal = 0;
+            this->hQuery = nullptr;
+            this->hQueueLength = nullptr;
+            if (::PdhOpenQueryW(nullptr, 0, &this->hQuery) == ERROR_SUCCESS)
+            {
+                // english counter names need vista, xp falls back to the localized lookup
+                typedef PDH_STATUS(WINAPI *PdhAddEnglishCounterPtr)(PDH_HQUERY, LPCWSTR, DWORD_PTR, PDH_HCOUNTER*);
+                auto pPdhAddEnglishCounter = (PdhAddEnglishCounterPtr)::GetProcAddress(::GetModuleHandleW(L"pdh.dll"), "PdhAddEnglishCounterW");
+                PDH_STATUS nStatus = pPdhAddEnglishCounter != nullptr ?
+                    pPdhAddEnglishCounter(this->hQuery, L"\\System\\Processor Queue Length", 0, &this->hQueueLength) :
+                    ::PdhAddCounterW(this->hQuery, L"\\System\\Processor Queue Length", 0, &this->hQueueLength);
+                if (nStatus != ERROR_SUCCESS)
+                    this->hQueueLength = nullptr;
+            }
+        }
+        virtual ~Win32SystemLoad()
+        {
+            if (this->hQuery != nullptr)
+                ::PdhCloseQuery(this->hQuery);
+        }
+    public:
+        static int ActiveProcessors()
+        {
+            // processor groups need windows 7, older systems have a single group
+            typedef DWORD(WINAPI *GetActiveProcessorCountPtr)(WORD);
+            auto pGetActiveProcessorCount = (GetActiveProcessorCountPtr)::GetProcAddress(::GetModuleHandleW(L"kernel32.dll"), "GetActiveProcessorCount");
+            if (pGetActiveProcessorCount != nullptr)
+                return (int)pGetActiveProcessorCount(0xFFFF);
+
+            SYSTEM_INFO info;
+            ::GetSystemInfo(&info);
+            return (int)info.dwNumberOfProcessors;
+        }
+        static ULONGLONG ToTicks(const FILETIME& ft)
+        {
+            ULARGE_INTEGER value;
+            value.LowPart = ft.dwLowDateTime;
+            value.HighPart = ft.dwHighDateTime;
+            return value.QuadPart;
+        }
+        bool Sample(CSystemLoad& load)
+        {
+            FILETIME ftIdle, ftKernel, ftUser;
+            if (::GetSystemTimes(&ftIdle, &ftKernel, &ftUser) == FALSE)
+                return false;
+
+            // kernel time includes idle time
+            ULONGLONG nIdle = ToTicks(ftIdle);
+            ULONGLONG nTotal = ToTicks(ftKernel) + ToTicks(ftUser);
+            bool bValid = this->nTotal > 0 && nTotal > this->nTotal;
+            if (bValid == true)
+                load.fBusy = 1.0 - (double)(nIdle - this->nIdle) / (double)(nTotal - this->nTotal);
+            this->nIdle = nIdle;
+            this->nTotal = nTotal;
+
+            load.fQueueLength = 0.0;
+            if (this->hQueueLength != nullptr && ::PdhCollectQueryData(this->hQuery) == ERROR_SUCCESS)
+            {
+                PDH_FMT_COUNTERVALUE value;
+                if (::PdhGetFormattedCounterValue(this->hQueueLength, PDH_FMT_DOUBLE, nullptr, &value) == ERROR_SUCCESS)
+                    load.fQueueLength = value.doubleValue;
+            }
+
+            load.nProcessors = ActiveProcessors();
+            return bValid;
+        }
+    };
+
+    class Win32ProcessorTopology : public IProcessorTopology
+    {
+    public:
+        bool Query(CProcessorTopology& topology)
+        {
+            topology.m_Cores.clear();
+            topology.nQuota = 0;
+
+            DWORD_PTR nProcessMask = 0;
+            DWORD_PTR nSystemMask = 0;
+            if (::GetProcessAffinityMask(::GetCurrentProcess(), &nProcessMask, &nSystemMask) == FALSE)
+                return false;
+
+            // resolved at run time, xp before sp3 does not export it
+            typedef BOOL(WINAPI *GetLogicalProcessorInformationPtr)(PSYSTEM_LOGICAL_PROCESSOR_INFORMATION, PDWORD);
+            auto pGetLogicalProcessorInformation = (GetLogicalProcessorInformationPtr)::GetProcAddress(::GetModuleHandleW(L"kernel32.dll"), "GetLogicalProcessorInformation");
+
+            // returned processors are those of the group of the calling thread, affinity masks address the same group
+            std::vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> buffer;
+            DWORD nLength = 0;
+            if (pGetLogicalProcessorInformation != nullptr
+                && pGetLogicalProcessorInformation(nullptr, &nLength) == FALSE
+                && ::GetLastError() == ERROR_INSUFFICIENT_BUFFER)
+            {
+                buffer.resize(nLength / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION) + 1);
+                if (pGetLogicalProcessorInformation(buffer.data(), &nLength) == FALSE)
+                    buffer.clear();
+                else
+                    buffer.resize(nLength / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION));
+            }
+
+            std::vector<std::pair<ULONG_PTR, int>> nodes;
+            for (auto& info : buffer)
+            {
+                if (info.Relationship == RelationNumaNode)
+                    nodes.push_back(std::make_pair(info.ProcessorMask, (int)info.NumaNode.NodeNumber));
+            }
+
+            for (auto& info : buffer)
+            {
+                if (info.Relationship == RelationProcessorCore)
+                {
+                    unsigned __int64 nMask = (unsigned __int64)(info.ProcessorMask & nProcessMask);
+                    if (nMask != 0)
+                    {
+                        CProcessorCore core;
+                        core.nMask = nMask;
+                        for (auto& node : nodes)
+                        {
+                            if ((node.first & info.ProcessorMask) != 0)
+                                core.nNode = node.second;
+                        }
+                        topology.m_Cores.push_back(core);
+                    }
+                }
+            }
+
+            // flat topology with one core per allowed logical processor
+            if (topology.m_Cores.empty() == true)
+            {
+                for (int i = 0; i < (int)(sizeof(DWORD_PTR) * 8); i++)
+                {
+                    DWORD_PTR nBit = (DWORD_PTR)1 << i;
+                    if ((nProcessMask & nBit) != 0)
+                    {
+                        CProcessorCore core;
+                        core.nMask = (unsigned __int64)nBit;
+                        topology.m_Cores.push_back(core);
+                    }
+                }
+            }
+
+            // job object cpu rate cap is the windows equivalent of a container cpu quota,
+            // declared locally as older sdks lack it and older systems fail the query
+            struct CCpuRateControl
+            {
+                DWORD ControlFlags;
+                union
+                {
+                    DWORD CpuRate;
+                    DWORD Weight;
+                    struct
+                    {
+                        WORD MinRate;
+                        WORD MaxRate;
+                    };
+                };
+            };
+            const int nJobObjectCpuRateControlInformation = 15;
+            const DWORD nRateControlEnable = 0x1;
+            const DWORD nRateControlHardCap = 0x4;
+            const DWORD nRateControlMinMaxRate = 0x10;
+
+            CCpuRateControl rate;
+            ::ZeroMemory(&rate, sizeof(rate));
+            if (::QueryInformationJobObject(nullptr, (JOBOBJECTINFOCLASS)nJobObjectCpuRateControlInformation, &rate, sizeof(rate), nullptr) != FALSE)
+            {
+                DWORD nRate = 0;
+                if ((rate.ControlFlags & nRateControlEnable) != 0)
+                {
+                    if ((rate.ControlFlags & nRateControlHardCap) != 0)
+                        nRate = rate.CpuRate;
+                    else if ((rate.ControlFlags & nRateControlMinMaxRate) != 0)
+                        nRate = rate.MaxRate;
+                }
+
+                // rate is in 1/100 percent of all processors
+                if (nRate > 0 && nRate < 10000)
+                {
+                    int nProcessors = Win32SystemLoad::ActiveProcessors();
+                    topology.nQuota = (int)(((unsigned __int64)nRate * nProcessors + 9999) / 10000);
+                }
+            }
+
+            return topology.Cores() > 0;
+        }
+    };
+
     class Win32WorkerFactory : public IWorkerFactory
     {
     public:
@@ -579,5 +1267,17 @@ namespace worker
         {
             return std::make_shared<CPipeToStringWriter>();
         }
+        std::shared_ptr<IMemoryStatus> CreateMemoryStatusPtr()
+        {
+            return std::make_shared<Win32MemoryStatus>();
+        }
+        std::shared_ptr<ISystemLoad> CreateSystemLoadPtr()
+        {
+            return std::make_shared<Win32SystemLoad>();
+        }
+        std::shared_ptr<IProcessorTopology> CreateProcessorTopologyPtr()
+        {
+            return std::make_shared<Win32ProcessorTopology>();
+        }
     };
 }
@@ -4,16 +4,27 @@
 #pragma once
 
 #include <queue>
+#include <algorithm>
 #include <memory>
 #include <utility>
 #include <string>
 #include <mutex>
 #include <thread>
+#include <chrono>
 #include "utilities\FileSystem.h"
 #include "utilities\Log.h"
 #include "utilities\MemoryLog.h"
 #include "utilities\String.h"
 #include "utilities\TimeCount.h"
+#include "ItemMetrics.h"
+#include "Tracer.h"
+#include "PrometheusExporter.h"
+#include "MemoryBudget.h"
+#include "LoadController.h"
+#include "Watchdog.h"
+#include "Cancellation.h"
+#include "Retry.h"
+#include "JobScheduler.h"
 #include "WorkerContext.h"
 #include "CommandLine.h"
 #include "OutputPath.h"
@@ -22,6 +33,9 @@ namespace worker
 {
     class IConverter
     {
+    public:
+        CWatchdog* watchdog = nullptr;
+        CCancellation* cancellation = nullptr;
     public:
         virtual ~IConverter() { };
         virtual bool Run(IWorkerContext* ctx, CCommandLine& cl, std::mutex& m_down) = 0;
@@ -29,6 +43,9 @@ namespace worker
 
     class ITranscoder
     {
+    public:
+        CWatchdog* watchdog = nullptr;
+        CCancellation* cancellation = nullptr;
     public:
         virtual ~ITranscoder() { };
         virtual bool Run(IWorkerContext* ctx, CCommandLine &dcl, CCommandLine& ecl, std::mutex& m_down) = 0;
@@ -42,11 +59,100 @@ namespace worker
         virtual bool Decode(IWorkerContext* ctx, config::CItem& item, CCommandLine& cl, std::mutex& m_down) = 0;
         virtual bool Encode(IWorkerContext* ctx, config::CItem& item, CCommandLine& cl, std::mutex& m_down) = 0;
         virtual bool Convert(IWorkerContext* ctx, config::CItem& item, std::mutex& m_dir, std::mutex& m_down) = 0;
-        virtual bool Convert(IWorkerContext* ctx, std::queue<int>& queue, std::mutex& m_queue, std::mutex &m_dir, std::mutex &m_down) = 0;
+        virtual bool Convert(IWorkerContext* ctx, std::queue<int>& queue, std::mutex& m_queue, std::mutex &m_dir, std::mutex &m_down, int nSlot) = 0;
         virtual void Convert(IWorkerContext* ctx, config::CItem& item) = 0;
         virtual void Convert(IWorkerContext* ctx, std::vector<config::CItem>& items) = 0;
     };
 
+    class CStderrCapture
+    {
+        std::shared_ptr<IPipe> Stderr;
+        std::shared_ptr<IStringWriter> writer;
+        std::thread captureThread;
+        bool bCreated;
+        bool bStarted;
+    public:
+        CStderrCapture()
+        {
+            this->bCreated = false;
+            this->bStarted = false;
+        }
+        virtual ~CStderrCapture()
+        {
+            this->Finish();
+        }
+    public:
+        bool Create(IWorkerContext* ctx, COutputTail& tail)
+        {
+            if (tail.Capacity() == 0)
+                return false;
+
+            this->Stderr = ctx->pFactory->CreatePipePtr();
+            if (this->Stderr->Create() == false)
+                return false;
+
+            // set stderr read pipe inherit flag
+            if (this->Stderr->InheritRead() == false)
+            {
+                this->Stderr->CloseRead();
+                this->Stderr->CloseWrite();
+                return false;
+            }
+
+            this->writer = ctx->pFactory->CreateStringWriterPtr();
+            this->writer->tail = &tail;
+            this->bCreated = true;
+            return true;
+        }
+        void Connect(IProcess* process)
+        {
+            if (this->bCreated == true)
+                process->ConnectStdError(this->Stderr->WriteHandle());
+        }
+        void Start(int nItemId)
+        {
+            if (this->bCreated == false)
+                return;
+
+            // close unused pipe handle
+            this->Stderr->CloseWrite();
+
+            this->writer->nIndex = nItemId;
+            this->writer->bError = false;
+            this->writer->bFinished = false;
+            this->captureThread = std::thread([this]() { this->writer->DrainLoop(this->Stderr.get()); });
+            this->bStarted = true;
+        }
+        void Finish()
+        {
+            if (this->bCreated == false)
+                return;
+
+            if (this->bStarted == true)
+            {
+                this->captureThread.join();
+                this->Stderr->CloseRead();
+            }
+            else
+            {
+                this->Stderr->CloseRead();
+                this->Stderr->CloseWrite();
+            }
+
+            this->bCreated = false;
+            this->bStarted = false;
+        }
+    public:
+        static std::wstring Attach(CItemMetrics& metrics, const std::wstring& szStatus, const COutputTail& tail)
+        {
+            if (tail.Length() == 0)
+                return szStatus;
+
+            metrics.szStderrTail = util::string::Convert(tail.ToString());
+            return szStatus + L": " + util::string::Convert(tail.LastLine());
+        }
+    };
+
     class CConsoleConverter : public IConverter
     {
     public:
@@ -57,7 +163,10 @@ namespace worker
             auto Stderr = ctx->pFactory->CreatePipePtr();
             auto parser = ctx->pFactory->CreateOutputParserPtr();
             auto writer = ctx->pFactory->CreateStringWriterPtr();
+            auto& metrics = ctx->m_ItemMetrics[cl.nItemId];
             util::CTimeCount timer;
+            CMetricsTimer downTimer;
+            CMetricsTimer spawnTimer;
 
             if ((cl.bUseReadPipes == true) || (cl.bUseWritePipes == true))
             {
@@ -86,20 +195,29 @@ namespace worker
             process->ConnectStdInput(nullptr);
             process->ConnectStdOutput(Stderr->WriteHandle());
             process->ConnectStdError(Stderr->WriteHandle());
+            process->SetAffinity(metrics.nAffinity);
+            process->SetLimits(CProcessLimits::Get(config->m_Options, cl.format));
 
-            m_down.lock();
+            downTimer.Start();
+            TRACE_LOCK(m_down, "m_down");
+            metrics.fDownloadWait += downTimer.ElapsedMilliseconds();
             config->FileSystem->SetCurrentDirectory_(config->m_Settings.szSettingsPath);
 
             timer.Start();
+            spawnTimer.Start();
             if (process->Start(cl.szCommandLine, config->m_Options.bHideConsoleWindow) == false)
             {
                 bool bFailed = true;
                 if (config->m_Options.bTryToDownloadTools == true)
                 {
                     auto downloader = ctx->pFactory->CreateDownloaderPtr();
-                    if (downloader->Download(ctx, cl.format, cl.nItemId) == true)
+                    downTimer.Start();
+                    bool bDownloaded = downloader->Download(ctx, cl.format, cl.nItemId);
+                    metrics.fDownloadWait += downTimer.ElapsedMilliseconds();
+                    if (bDownloaded == true)
                     {
                         config->FileSystem->SetCurrentDirectory_(config->m_Settings.szSettingsPath);
+                        spawnTimer.Start();
                         if (process->Start(cl.szCommandLine, config->m_Options.bHideConsoleWindow) == true)
                         {
                             bFailed = false;
@@ -110,6 +228,7 @@ namespace worker
                 if (bFailed == true)
                 {
                     m_down.unlock();
+                    metrics.bStartFailed = true;
 
                     timer.Stop();
 
@@ -123,21 +242,28 @@ namespace worker
                 }
             }
 
+            metrics.fSpawnTime += spawnTimer.ElapsedMilliseconds();
+            CActiveProcesses active(ctx->nActiveProcesses, 1);
+            CCancelRegistration registration(this->cancellation, process);
+            if (this->watchdog != nullptr)
+                this->watchdog->Attach(cl.nItemId, process);
             m_down.unlock();
 
             // close unused pipe handle
             Stderr->CloseWrite();
 
             // init output parser
-            m_down.lock();
+            TRACE_LOCK(m_down, "m_down");
             config->FileSystem->SetCurrentDirectory_(config->m_Settings.szSettingsPath);
 
             parser->nIndex = cl.nItemId;
             parser->nProgress = 0;
             parser->nPreviousProgress = 0;
 
-            //auto log = std::make_unique<util::MemoryLog>();
-            //parser->log = log.get();
+            parser->log = nullptr;
+            if (config->m_Options.bLogToolOutput == true)
+                parser->log = dynamic_cast<CAsyncLog*>(config->Log.get());
+
             if (parser->Open(ctx, cl.format.szFunction) == false)
             {
                 timer.Stop();
@@ -150,9 +276,13 @@ namespace worker
             m_down.unlock();
 
             // console progress loop
+            thread_local COutputTail tail;
+            tail.Resize(config->m_Options.nStderrTailSize > 0 ? config->m_Options.nStderrTailSize : 0);
+
             writer->nIndex = cl.nItemId;
             writer->bError = false;
             writer->bFinished = false;
+            writer->tail = &tail;
 
             if (writer->WriteLoop(ctx, Stderr.get(), parser.get()) == false)
             {
@@ -167,9 +297,13 @@ namespace worker
             if (process->Stop(parser->nProgress == 100, cl.format.nExitCodeSuccess) == false)
                 parser->nProgress = -1;
 
+            metrics.nExitCode = process->ExitCode();
+            metrics.AddUsage(process->Usage());
+
             if (parser->nProgress != 100)
             {
-                ctx->ItemStatus(cl.nItemId, ctx->GetString(0x00150001), ctx->GetString(0x00120005));
+                std::wstring szStatus = CStderrCapture::Attach(metrics, ctx->GetString(0x00120005), tail);
+                ctx->ItemStatus(cl.nItemId, ctx->GetString(0x00150001), szStatus);
                 ctx->ItemProgress(cl.nItemId, -1, true, true);
                 return false;
             }
@@ -196,7 +330,10 @@ namespace worker
             int nProgress = 0;
             std::thread readThread;
             std::thread writeThread;
+            auto& metrics = ctx->m_ItemMetrics[cl.nItemId];
             util::CTimeCount timer;
+            CMetricsTimer downTimer;
+            CMetricsTimer spawnTimer;
 
             if ((cl.bUseReadPipes == false) && (cl.bUseWritePipes == false))
             {
@@ -277,20 +414,37 @@ namespace worker
                 process->ConnectStdOutput(Stdout->WriteHandle());
                 process->ConnectStdError(process->StderrHandle());
             }
+            process->SetAffinity(metrics.nAffinity);
+            process->SetLimits(CProcessLimits::Get(config->m_Options, cl.format));
 
-            m_down.lock();
+            // capture stderr tail, fall back to parent stderr on failure
+            thread_local COutputTail tail;
+            tail.Resize(config->m_Options.nStderrTailSize > 0 ? config->m_Options.nStderrTailSize : 0);
+
+            CStderrCapture capture;
+            capture.Create(ctx, tail);
+            capture.Connect(process.get());
+
+            downTimer.Start();
+            TRACE_LOCK(m_down, "m_down");
+            metrics.fDownloadWait += downTimer.ElapsedMilliseconds();
             config->FileSystem->SetCurrentDirectory_(config->m_Settings.szSettingsPath);
 
             timer.Start();
+            spawnTimer.Start();
             if (process->Start(cl.szCommandLine, config->m_Options.bHideConsoleWindow) == false)
             {
                 bool bFailed = true;
                 if (config->m_Options.bTryToDownloadTools == true)
                 {
                     auto downloader = ctx->pFactory->CreateDownloaderPtr();
-                    if (downloader->Download(ctx, cl.format, cl.nItemId) == true)
+                    downTimer.Start();
+                    bool bDownloaded = downloader->Download(ctx, cl.format, cl.nItemId);
+                    metrics.fDownloadWait += downTimer.ElapsedMilliseconds();
+                    if (bDownloaded == true)
                     {
                         config->FileSystem->SetCurrentDirectory_(config->m_Settings.szSettingsPath);
+                        spawnTimer.Start();
                         if (process->Start(cl.szCommandLine, config->m_Options.bHideConsoleWindow) == true)
                         {
                             bFailed = false;
@@ -301,6 +455,7 @@ namespace worker
                 if (bFailed == true)
                 {
                     m_down.unlock();
+                    metrics.bStartFailed = true;
 
                     timer.Stop();
 
@@ -323,8 +478,15 @@ namespace worker
                 }
             }
 
+            metrics.fSpawnTime += spawnTimer.ElapsedMilliseconds();
+            CActiveProcesses active(ctx->nActiveProcesses, 1);
+            CCancelRegistration registration(this->cancellation, process);
+            if (this->watchdog != nullptr)
+                this->watchdog->Attach(cl.nItemId, process);
             m_down.unlock();
 
+            capture.Start(cl.nItemId);
+
             // close unused pipe handles
             if (cl.bUseReadPipes == true)
                 Stdin->CloseRead();
@@ -336,7 +498,10 @@ namespace worker
             if (cl.bUseReadPipes == true)
             {
                 readContext->bError = false;
+                readContext->bFileError = false;
                 readContext->bFinished = false;
+                readContext->nTotalBytes = 0;
+                readContext->fStallTime = 0.0;
                 readContext->szFileName = cl.szInputFile;
                 readContext->nIndex = cl.nItemId;
 
@@ -362,7 +527,10 @@ namespace worker
             if (cl.bUseWritePipes == true)
             {
                 writeContext->bError = false;
+                writeContext->bFileError = false;
                 writeContext->bFinished = false;
+                writeContext->nTotalBytes = 0;
+                writeContext->fStallTime = 0.0;
                 writeContext->szFileName = cl.szOutputFile;
                 writeContext->nIndex = cl.nItemId;
 
@@ -418,12 +586,33 @@ namespace worker
 
             timer.Stop();
 
+            if (cl.bUseReadPipes == true)
+            {
+                metrics.fStallTime += readContext->fStallTime;
+                if (readContext->bFileError == true)
+                    metrics.bIoFailed = true;
+            }
+
+            if (cl.bUseWritePipes == true)
+            {
+                metrics.fStallTime += writeContext->fStallTime;
+                metrics.nBytesOut = writeContext->nTotalBytes;
+                if (writeContext->bFileError == true)
+                    metrics.bIoFailed = true;
+            }
+
             if (process->Stop(nProgress == 100, cl.format.nExitCodeSuccess) == false)
                 nProgress = -1;
 
+            metrics.nExitCode = process->ExitCode();
+            metrics.AddUsage(process->Usage());
+
+            capture.Finish();
+
             if (nProgress != 100)
             {
-                ctx->ItemStatus(cl.nItemId, ctx->GetString(0x00150001), ctx->GetString(0x00130009));
+                std::wstring szStatus = CStderrCapture::Attach(metrics, ctx->GetString(0x00130009), tail);
+                ctx->ItemStatus(cl.nItemId, ctx->GetString(0x00150001), szStatus);
                 ctx->ItemProgress(cl.nItemId, -1, true, true);
                 return false;
             }
@@ -448,11 +637,14 @@ namespace worker
             auto Stdout = ctx->pFactory->CreatePipePtr();
             auto Bridge = ctx->pFactory->CreatePipePtr();
             auto readContext = ctx->pFactory->CreateFileReaderPtr();
-            auto writeContext = ctx->pFactory->CreateFileWriterPtr();;
+            auto writeContext = ctx->pFactory->CreateFileWriterPtr();
             int nProgress = 0;
             std::thread readThread;
             std::thread writeThread;
+            auto& metrics = ctx->m_ItemMetrics[dcl.nItemId];
             util::CTimeCount timer;
+            CMetricsTimer downTimer;
+            CMetricsTimer spawnTimer;
 
             // create pipes for stdin
             if (Stdin->Create() == false)
@@ -519,21 +711,47 @@ namespace worker
             encoderProcess->ConnectStdOutput(Stdout->WriteHandle());
             encoderProcess->ConnectStdError(encoderProcess->StderrHandle());
 
+            // decoder and encoder of one item share the slot cores
+            decoderProcess->SetAffinity(metrics.nAffinity);
+            encoderProcess->SetAffinity(metrics.nAffinity);
+            decoderProcess->SetLimits(CProcessLimits::Get(config->m_Options, dcl.format));
+            encoderProcess->SetLimits(CProcessLimits::Get(config->m_Options, ecl.format));
+
+            // capture stderr tails, fall back to parent stderr on failure
+            thread_local COutputTail decoderTail;
+            thread_local COutputTail encoderTail;
+            decoderTail.Resize(config->m_Options.nStderrTailSize > 0 ? config->m_Options.nStderrTailSize : 0);
+            encoderTail.Resize(config->m_Options.nStderrTailSize > 0 ? config->m_Options.nStderrTailSize : 0);
+
+            CStderrCapture decoderCapture;
+            CStderrCapture encoderCapture;
+            decoderCapture.Create(ctx, decoderTail);
+            decoderCapture.Connect(decoderProcess.get());
+            encoderCapture.Create(ctx, encoderTail);
+            encoderCapture.Connect(encoderProcess.get());
+
             timer.Start();
 
-            m_down.lock();
+            downTimer.Start();
+            TRACE_LOCK(m_down, "m_down");
+            metrics.fDownloadWait += downTimer.ElapsedMilliseconds();
             config->FileSystem->SetCurrentDirectory_(config->m_Settings.szSettingsPath);
 
             // create decoder process
+            spawnTimer.Start();
             if (decoderProcess->Start(dcl.szCommandLine, config->m_Options.bHideConsoleWindow) == false)
             {
                 bool bFailed = true;
                 if (config->m_Options.bTryToDownloadTools == true)
                 {
                     auto downloader = ctx->pFactory->CreateDownloaderPtr();
-                    if (downloader->Download(ctx, dcl.format, dcl.nItemId) == true)
+                    downTimer.Start();
+                    bool bDownloaded = downloader->Download(ctx, dcl.format, dcl.nItemId);
+                    metrics.fDownloadWait += downTimer.ElapsedMilliseconds();
+                    if (bDownloaded == true)
                     {
                         config->FileSystem->SetCurrentDirectory_(config->m_Settings.szSettingsPath);
+                        spawnTimer.Start();
                         if (decoderProcess->Start(dcl.szCommandLine, config->m_Options.bHideConsoleWindow) == true)
                         {
                             bFailed = false;
@@ -544,6 +762,7 @@ namespace worker
                 if (bFailed == true)
                 {
                     m_down.unlock();
+                    metrics.bStartFailed = true;
 
                     timer.Stop();
 
@@ -563,18 +782,29 @@ namespace worker
                 }
             }
 
+            metrics.fSpawnTime += spawnTimer.ElapsedMilliseconds();
+            CActiveProcesses decoderActive(ctx->nActiveProcesses, 1);
+            CCancelRegistration decoderRegistration(this->cancellation, decoderProcess);
+            if (this->watchdog != nullptr)
+                this->watchdog->Attach(dcl.nItemId, decoderProcess);
+            decoderCapture.Start(dcl.nItemId);
             config->FileSystem->SetCurrentDirectory_(config->m_Settings.szSettingsPath);
 
             // create encoder process
+            spawnTimer.Start();
             if (encoderProcess->Start(ecl.szCommandLine, config->m_Options.bHideConsoleWindow) == false)
             {
                 bool bFailed = true;
                 if (config->m_Options.bTryToDownloadTools == true)
                 {
                     auto downloader = ctx->pFactory->CreateDownloaderPtr();
-                    if (downloader->Download(ctx, ecl.format, ecl.nItemId) == true)
+                    downTimer.Start();
+                    bool bDownloaded = downloader->Download(ctx, ecl.format, ecl.nItemId);
+                    metrics.fDownloadWait += downTimer.ElapsedMilliseconds();
+                    if (bDownloaded == true)
                     {
                         config->FileSystem->SetCurrentDirectory_(config->m_Settings.szSettingsPath);
+                        spawnTimer.Start();
                         if (encoderProcess->Start(ecl.szCommandLine, config->m_Options.bHideConsoleWindow) == true)
                         {
                             bFailed = false;
@@ -585,6 +815,7 @@ namespace worker
                 if (bFailed == true)
                 {
                     m_down.unlock();
+                    metrics.bStartFailed = true;
 
                     timer.Stop();
 
@@ -606,6 +837,12 @@ namespace worker
                 }
             }
 
+            metrics.fSpawnTime += spawnTimer.ElapsedMilliseconds();
+            CActiveProcesses encoderActive(ctx->nActiveProcesses, 1);
+            CCancelRegistration encoderRegistration(this->cancellation, encoderProcess);
+            if (this->watchdog != nullptr)
+                this->watchdog->Attach(ecl.nItemId, encoderProcess);
+            encoderCapture.Start(ecl.nItemId);
             m_down.unlock();
 
             // close unused pipe handles
@@ -616,7 +853,10 @@ namespace worker
 
             // create read thread
             readContext->bError = false;
+            readContext->bFileError = false;
             readContext->bFinished = false;
+            readContext->nTotalBytes = 0;
+            readContext->fStallTime = 0.0;
             readContext->szFileName = dcl.szInputFile;
             readContext->nIndex = dcl.nItemId;
 
@@ -624,7 +864,10 @@ namespace worker
 
             // create write thread
             writeContext->bError = false;
+            writeContext->bFileError = false;
             writeContext->bFinished = false;
+            writeContext->nTotalBytes = 0;
+            writeContext->fStallTime = 0.0;
             writeContext->szFileName = ecl.szOutputFile;
             writeContext->nIndex = ecl.nItemId;
 
@@ -660,15 +903,33 @@ namespace worker
 
             timer.Stop();
 
+            metrics.fStallTime += readContext->fStallTime + writeContext->fStallTime;
+            metrics.nBytesOut = writeContext->nTotalBytes;
+            if ((readContext->bFileError == true) || (writeContext->bFileError == true))
+                metrics.bIoFailed = true;
+
             if (decoderProcess->Stop(nProgress == 100, dcl.format.nExitCodeSuccess) == false)
                 nProgress = -1;
 
             if (encoderProcess->Stop(nProgress == 100, ecl.format.nExitCodeSuccess) == false)
                 nProgress = -1;
 
+            metrics.nExitCode = encoderProcess->ExitCode();
+            if (decoderProcess->ExitCode() != dcl.format.nExitCodeSuccess)
+                metrics.nExitCode = decoderProcess->ExitCode();
+
+            CProcessUsage usage = decoderProcess->Usage();
+            usage.Combine(encoderProcess->Usage());
+            metrics.AddUsage(usage);
+
+            decoderCapture.Finish();
+            encoderCapture.Finish();
+
             if (nProgress != 100)
             {
-                ctx->ItemStatus(dcl.nItemId, ctx->GetString(0x00150001), ctx->GetString(0x00130009));
+                bool bDecoderFailed = decoderProcess->ExitCode() != dcl.format.nExitCodeSuccess;
+                std::wstring szStatus = CStderrCapture::Attach(metrics, ctx->GetString(0x00130009), bDecoderFailed ? decoderTail : encoderTail);
+                ctx->ItemStatus(dcl.nItemId, ctx->GetString(0x00150001), szStatus);
                 ctx->ItemProgress(dcl.nItemId, -1, true, true);
                 return false;
             }
@@ -687,16 +948,31 @@ namespace worker
         std::unique_ptr<IConverter> ConsoleConverter;
         std::unique_ptr<IConverter> PipesConverter;
         std::unique_ptr<ITranscoder> PipesTranscoder;
+        std::unique_ptr<CItemMetricsWriter> MetricsWriter;
+        std::unique_ptr<CPrometheusExporter> PrometheusExporter;
+        std::shared_ptr<CMemoryBudget> MemoryBudget;
+        std::unique_ptr<CLoadController> LoadController;
+        std::vector<unsigned __int64> SlotAffinity;
+        std::unique_ptr<CWatchdog> Watchdog;
+        std::unique_ptr<CCancellation> Cancellation;
+        CRetryPolicy RetryPolicy;
+        CJobScheduler* Scheduler = nullptr;
+        // memory budget and load controller belong to the daemon and are shared by all its batches
+        bool bSharedLimits = false;
     public:
         bool Transcode(IWorkerContext* ctx, config::CItem& item, CCommandLine& dcl, CCommandLine& ecl, std::mutex& m_down)
         {
+            TRACE_SPAN_ITEM("worker", "Transcode", item.nId);
+
             auto config = ctx->pConfig;
             try
             {
                 ctx->ItemStatus(item.nId, ctx->GetString(0x00150001), ctx->GetString(0x0014000C));
                 item.ResetProgress();
 
+                CMetricsTimer timer;
                 bool bResult = PipesTranscoder->Run(ctx, dcl, ecl, m_down);
+                ctx->m_ItemMetrics[item.nId].fEncodeTime += timer.ElapsedMilliseconds();
                 if (bResult == true)
                 {
                     if (config->m_Options.bDeleteSourceFiles == true)
@@ -722,6 +998,8 @@ namespace worker
         }
         bool Decode(IWorkerContext* ctx, config::CItem& item, CCommandLine& cl, std::mutex& m_down)
         {
+            TRACE_SPAN_ITEM("worker", "Decode", item.nId);
+
             auto config = ctx->pConfig;
             try
             {
@@ -730,10 +1008,12 @@ namespace worker
 
                 bool bUseConsole = (cl.bUseReadPipes == false) && (cl.bUseWritePipes == false);
                 bool bResult = false;
+                CMetricsTimer timer;
                 if (bUseConsole)
                     bResult = ConsoleConverter->Run(ctx, cl, m_down);
                 else
                     bResult = PipesConverter->Run(ctx, cl, m_down);
+                ctx->m_ItemMetrics[item.nId].fDecodeTime += timer.ElapsedMilliseconds();
                 if (bResult == false)
                 {
                     if (config->m_Options.bDeleteOnErrors == true)
@@ -762,6 +1042,8 @@ namespace worker
         }
         bool Encode(IWorkerContext* ctx, config::CItem& item, CCommandLine& cl, std::mutex& m_down)
         {
+            TRACE_SPAN_ITEM("worker", "Encode", item.nId);
+
             auto config = ctx->pConfig;
             try
             {
@@ -774,12 +1056,17 @@ namespace worker
 
                 bool bUseConsole = (cl.bUseReadPipes == false) && (cl.bUseWritePipes == false);
                 bool bResult = false;
+                CMetricsTimer timer;
                 if (bUseConsole)
                     bResult = ConsoleConverter->Run(ctx, cl, m_down);
                 else
                     bResult = PipesConverter->Run(ctx, cl, m_down);
+                ctx->m_ItemMetrics[item.nId].fEncodeTime += timer.ElapsedMilliseconds();
                 if (bResult == true)
                 {
+                    if (bUseConsole)
+                        ctx->m_ItemMetrics[item.nId].nBytesOut = config->FileSystem->GetFileSize64(cl.szOutputFile);
+
                     if (config->m_Options.bDeleteSourceFiles == true)
                         config->FileSystem->DeleteFile_(cl.szInputFile);
 
@@ -819,6 +1106,9 @@ namespace worker
                 return false;
             }
 
+            auto& metrics = ctx->m_ItemMetrics[item.nId];
+            metrics.nBytesIn = config->FileSystem->GetFileSize64(szInputFile);
+
             int nEncoder = config::CFormat::GetFormatById(config->m_Formats, item.szFormatId);
             if (nEncoder == -1)
             {
@@ -863,7 +1153,7 @@ namespace worker
                 }
             }
 
-            m_dir.lock();
+            TRACE_LOCK(m_dir, "m_dir");
             if (m_Output.CreateOutputPath(config->FileSystem.get(), szOutputFile) == false)
             {
                 m_dir.unlock();
@@ -911,9 +1201,12 @@ namespace worker
 
                 if (df.bPipeInput && df.bPipeOutput && ef.bPipeInput && ef.bPipeOutput)
                 {
+                    metrics.szMode = L"transcode";
                     return Transcode(ctx, item, dcl, ecl, m_down);
                 }
 
+                metrics.szMode = L"decode+encode";
+
                 if (Decode(ctx, item, dcl, m_down) == false)
                     return false;
 
@@ -936,25 +1229,374 @@ namespace worker
 
             auto cl = CCommandLine(config->FileSystem.get(), ef, item.nPreset, item.nId, szInputFile, szOutputFile, item.szOptions);
 
+            metrics.szMode = L"encode";
             return Encode(ctx, item, cl, m_down);
         }
+        bool ConvertItem(IWorkerContext* ctx, config::CItem& item, std::mutex& m_dir, std::mutex& m_down)
+        {
+            auto config = ctx->pConfig;
+            int nItemId = item.nId;
+            auto& metrics = ctx->m_ItemMetrics[nItemId];
+
+            TRACE_SPAN_ITEM("worker", "Convert", nItemId);
+
+            metrics.BeginAttempt(metrics.nAttempts + 1 < this->RetryPolicy.nMaxAttempts);
+
+            // admission wait is counted as queue wait
+            unsigned __int64 nReserved = 0;
+            bool bScheduled = false;
+            bool bAdmitted = true;
+            if (this->Scheduler != nullptr)
+            {
+                bScheduled = this->Scheduler->Acquire(ctx);
+                bAdmitted = bScheduled;
+            }
+
+            if (this->MemoryBudget != nullptr && bAdmitted == true)
+            {
+                unsigned __int64 nFormatEstimate = 0;
+                int nFormat = config::CFormat::GetFormatById(config->m_Formats, item.szFormatId);
+                if (nFormat != -1)
+                    nFormatEstimate = (unsigned __int64)config->m_Formats[nFormat].nMemory * 1024 * 1024;
+                bAdmitted = this->MemoryBudget->Acquire(ctx, item.szFormatId, nFormatEstimate, nReserved);
+            }
+
+            metrics.fQueueWait += metrics.queueTimer.ElapsedMilliseconds();
+            metrics.szFormatId = item.szFormatId;
+
+            auto log = dynamic_cast<CAsyncLog*>(config->Log.get());
+            if (log != nullptr)
+            {
+                wchar_t szEvent[CLogRecord::nMaxLength];
+                _snwprintf_s(szEvent, _TRUNCATE, L"[Info] Started %ls", item.szFormatId.c_str());
+                log->Log(nItemId, szEvent);
+            }
+
+            ctx->nRunningFiles++;
+            if (this->PrometheusExporter != nullptr)
+                this->PrometheusExporter->Write(ctx, false);
+
+            if (this->Watchdog != nullptr)
+            {
+                auto& options = config->m_Options;
+                int nFormat = config::CFormat::GetFormatById(config->m_Formats, item.szFormatId);
+                int nStallTimeout = nFormat != -1 ? CProcessLimits::Select(config->m_Formats[nFormat].nStallTimeout, options.nStallTimeout) : options.nStallTimeout;
+                int nWallTimeout = nFormat != -1 ? CProcessLimits::Select(config->m_Formats[nFormat].nWallTimeout, options.nWallTimeout) : options.nWallTimeout;
+                this->Watchdog->Begin(nItemId, nStallTimeout, nWallTimeout);
+            }
+
+            CMetricsTimer timer;
+            bool bResult = bAdmitted == true ? Convert(ctx, item, m_dir, m_down) : false;
+            metrics.fTotalTime += timer.ElapsedMilliseconds();
+            metrics.bSuccess = bResult;
+
+            ctx->nRunningFiles--;
+
+            if (this->Watchdog != nullptr)
+            {
+                WatchdogReason nReason = this->Watchdog->End(nItemId);
+                if (nReason != WatchdogReason::None)
+                {
+                    metrics.szTimeout = nReason == WatchdogReason::Stall ? L"stall" : L"wall";
+                    if (log != nullptr)
+                    {
+                        wchar_t szEvent[CLogRecord::nMaxLength];
+                        _snwprintf_s(szEvent, _TRUNCATE, L"[Error] Watchdog killed %ls (%ls timeout)", item.szFormatId.c_str(), metrics.szTimeout.c_str());
+                        log->Log(nItemId, szEvent);
+                    }
+                }
+            }
+
+            if (this->MemoryBudget != nullptr && bAdmitted == true)
+                this->MemoryBudget->Release(item.szFormatId, nReserved, metrics.nPeakMemory);
+
+            if (bScheduled == true)
+                this->Scheduler->Release(ctx);
+
+            if (bResult == false)
+            {
+                // on the last attempt the context stops the batch on errors itself, that is not a cancellation
+                bool bCancelled = ctx->bRunning == false && (metrics.bRetryable == true || config->m_Options.bStopOnErrors == false);
+                FailureClass nFailure = this->RetryPolicy.Classify(metrics, bCancelled);
+                metrics.szFailure = CRetryPolicy::ToString(nFailure);
+                metrics.bRetry = this->RetryPolicy.ShouldRetry(nFailure, metrics.nAttempts);
+                if (metrics.bRetry == true)
+                {
+                    metrics.fRetryDelay = this->RetryPolicy.Delay(metrics.nAttempts);
+                    metrics.queueTimer.Start();
+                    if (log != nullptr)
+                    {
+                        wchar_t szEvent[CLogRecord::nMaxLength];
+                        _snwprintf_s(szEvent, _TRUNCATE, L"[Warning] Retrying %ls after %ls failure in %.0f ms (attempt %d of %d)",
+                            item.szFormatId.c_str(),
+                            metrics.szFailure.c_str(),
+                            metrics.fRetryDelay,
+                            metrics.nAttempts + 1,
+                            this->RetryPolicy.nMaxAttempts);
+                        log->Log(nItemId, szEvent);
+                    }
+                }
+                else if (metrics.bRetryable == true && config->m_Options.bStopOnErrors == true)
+                {
+                    // context deferred stop on errors until the failure was classified
+                    ctx->bRunning = false;
+                }
+            }
+
+            if (log != nullptr)
+            {
+                wchar_t szEvent[CLogRecord::nMaxLength];
+                _snwprintf_s(szEvent, _TRUNCATE, L"%ls %ls in %.0f ms (exit code %d)",
+                    bResult ? L"[Info] Finished" : L"[Error] Failed",
+                    metrics.szMode.c_str(),
+                    metrics.fTotalTime,
+                    metrics.nExitCode);
+                log->Log(nItemId, szEvent);
+            }
+
+            if (this->MetricsWriter != nullptr)
+                this->MetricsWriter->Write(metrics);
+
+            if (this->PrometheusExporter != nullptr)
+            {
+                if (metrics.bRetry == true)
+                    this->PrometheusExporter->Retried(metrics);
+                else
+                    this->PrometheusExporter->Finished(metrics);
+                this->PrometheusExporter->Write(ctx, false);
+            }
+
+            return bResult;
+        }
+        void OpenMetrics(IWorkerContext* ctx)
+        {
+            const std::wstring& szMetricsFile = ctx->pConfig->m_Options.szMetricsFile;
+            if (szMetricsFile.empty() == false)
+            {
+                this->MetricsWriter = std::make_unique<CItemMetricsWriter>();
+                if (this->MetricsWriter->Open(szMetricsFile) == false)
+                    this->MetricsWriter = nullptr;
+            }
+
+            const std::wstring& szPrometheusFile = ctx->pConfig->m_Options.szPrometheusFile;
+            if (szPrometheusFile.empty() == false)
+            {
+                this->PrometheusExporter = std::make_unique<CPrometheusExporter>();
+                this->PrometheusExporter->Open(szPrometheusFile);
+                this->PrometheusExporter->Write(ctx, true);
+            }
+        }
+        void OpenTrace(IWorkerContext* ctx)
+        {
+            const std::wstring& szTraceFile = ctx->pConfig->m_Options.szTraceFile;
+            if (szTraceFile.empty() == false && CTracer::IsCompiled() == false)
+            {
+                // trace points are compiled out, say so instead of ignoring the option
+                if (ctx->pConfig->Log != nullptr)
+                    ctx->pConfig->Log->Log(L"[Warning] Trace file ignored, tracing requires a build with BATCHENCODER_TRACE: " + szTraceFile);
+                return;
+            }
+
+            TRACE_BEGIN(szTraceFile);
+        }
+        void OpenRetryPolicy(IWorkerContext* ctx)
+        {
+            auto& options = ctx->pConfig->m_Options;
+            this->RetryPolicy.nMaxAttempts = options.nRetryCount > 0 ? options.nRetryCount + 1 : 1;
+            this->RetryPolicy.nBaseDelay = options.nRetryDelay;
+            this->RetryPolicy.nMaxDelay = options.nRetryMaxDelay;
+            this->RetryPolicy.SetPatterns(options.szRetryPatterns);
+        }
+        bool WaitForRetry(IWorkerContext* ctx, const CItemMetrics& metrics)
+        {
+            // backoff delay of a retried item, the batch can be stopped while waiting
+            while (metrics.RetryReady() == false)
+            {
+                if (ctx->bRunning == false)
+                    return false;
+
+                double fWait = (std::min)(metrics.RetryWait(), 50.0);
+                std::this_thread::sleep_for(std::chrono::milliseconds((int)fWait + 1));
+            }
+            return ctx->bRunning == true;
+        }
+        bool WaitWhilePaused(IWorkerContext* ctx)
+        {
+            // paused batch admits no new items, running tools are suspended by the cancellation monitor
+            while (ctx->bPaused == true)
+            {
+                if (ctx->bRunning == false)
+                    return false;
+
+                std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            }
+            return ctx->bRunning == true;
+        }
+        void OpenMemoryBudget(IWorkerContext* ctx)
+        {
+            if (this->bSharedLimits == true)
+                return;
+
+            int nMemoryBudget = ctx->pConfig->m_Options.nMemoryBudget;
+            if (nMemoryBudget <= 0 || ctx->nThreadCount <= 1)
+            {
+                this->MemoryBudget = nullptr;
+                return;
+            }
+
+            // measured history is kept between batches
+            if (this->MemoryBudget == nullptr)
+            {
+                this->MemoryBudget = std::make_shared<CMemoryBudget>();
+                this->MemoryBudget->pStatus = ctx->pFactory->CreateMemoryStatusPtr();
+            }
+
+            this->MemoryBudget->nBudget = (unsigned __int64)nMemoryBudget * 1024 * 1024;
+            this->MemoryBudget->nDefaultEstimate = this->MemoryBudget->nBudget / ctx->nThreadCount;
+        }
+        void StartLoadController(IWorkerContext* ctx)
+        {
+            auto& options = ctx->pConfig->m_Options;
+            if (this->bSharedLimits == true || options.bAdaptiveThreadCount == false || ctx->nThreadCount <= 1)
+            {
+                this->LoadController = nullptr;
+                return;
+            }
+
+            // thread count is the upper bound, controller decides how many slots take items, tuning is kept between batches
+            if (this->LoadController == nullptr)
+                this->LoadController = std::make_unique<CLoadController>();
+
+            this->LoadController->nMaxSlots = ctx->nThreadCount;
+            this->LoadController->nMinSlots = options.nMinThreadCount < 1 ? 1 : (std::min)(options.nMinThreadCount, ctx->nThreadCount);
+            this->LoadController->pLoad = ctx->pFactory->CreateSystemLoadPtr();
+            this->LoadController->Start(ctx);
+        }
+        void OpenSlotAffinity(IWorkerContext* ctx)
+        {
+            this->SlotAffinity.clear();
+            if (ctx->pConfig->m_Options.bPinWorkerSlots == false)
+                return;
+
+            auto topology = ctx->pFactory->CreateProcessorTopologyPtr();
+            CProcessorTopology info;
+            if (topology == nullptr || topology->Query(info) == false)
+                return;
+
+            this->SlotAffinity = info.SlotMasks(ctx->nThreadCount);
+        }
+        void OpenWatchdog(IWorkerContext* ctx)
+        {
+            auto config = ctx->pConfig;
+            bool bEnabled = config->m_Options.nStallTimeout > 0 || config->m_Options.nWallTimeout > 0;
+            for (auto& format : config->m_Formats)
+            {
+                if (format.nStallTimeout > 0 || format.nWallTimeout > 0)
+                    bEnabled = true;
+            }
+
+            if (bEnabled == false)
+                return;
+
+            this->Watchdog = std::make_unique<CWatchdog>();
+            this->Watchdog->Start(ctx);
+            ctx->pObserver = this->Watchdog.get();
+            this->ConnectConverters();
+        }
+        void CloseWatchdog(IWorkerContext* ctx)
+        {
+            if (this->Watchdog != nullptr)
+            {
+                ctx->pObserver = nullptr;
+                this->Watchdog->Stop();
+                this->Watchdog = nullptr;
+                this->ConnectConverters();
+            }
+        }
+        void OpenCancellation(IWorkerContext* ctx)
+        {
+            // running processes are killed as soon as the batch is stopped
+            this->Cancellation = std::make_unique<CCancellation>();
+            this->Cancellation->Start(ctx);
+            this->ConnectConverters();
+        }
+        void CloseCancellation()
+        {
+            if (this->Cancellation != nullptr)
+            {
+                this->Cancellation->Stop();
+                this->Cancellation = nullptr;
+                this->ConnectConverters();
+            }
+        }
+        void ConnectConverters()
+        {
+            if (this->ConsoleConverter != nullptr)
+            {
+                this->ConsoleConverter->watchdog = this->Watchdog.get();
+                this->ConsoleConverter->cancellation = this->Cancellation.get();
+            }
+            if (this->PipesConverter != nullptr)
+            {
+                this->PipesConverter->watchdog = this->Watchdog.get();
+                this->PipesConverter->cancellation = this->Cancellation.get();
+            }
+            if (this->PipesTranscoder != nullptr)
+            {
+                this->PipesTranscoder->watchdog = this->Watchdog.get();
+                this->PipesTranscoder->cancellation = this->Cancellation.get();
+            }
+        }
+        void StopLoadController()
+        {
+            if (this->LoadController != nullptr)
+                this->LoadController->Stop();
+        }
+        void CloseMetrics(IWorkerContext* ctx)
+        {
+            if (this->MetricsWriter != nullptr)
+            {
+                this->MetricsWriter->Close();
+                this->MetricsWriter = nullptr;
+            }
+
+            if (this->PrometheusExporter != nullptr)
+            {
+                this->PrometheusExporter->Write(ctx, true);
+                this->PrometheusExporter = nullptr;
+            }
+        }
         bool Convert(IWorkerContext* ctx, std::vector<int>& ids, std::mutex &m_dir, std::mutex &m_down)
         {
             auto config = ctx->pConfig;
             try
             {
-                for (int id : ids)
+                // retried items are appended to the list
+                for (size_t i = 0; i < ids.size(); i++)
                 {
+                    int id = ids[i];
                     if (ctx->bRunning == false)
                         return false;
 
-                    ctx->TotalProgress(id);
+                    if (this->WaitWhilePaused(ctx) == false)
+                        return false;
+
+                    auto& metrics = ctx->m_ItemMetrics[id];
+                    if (this->WaitForRetry(ctx, metrics) == false)
+                        return false;
 
-                    if (Convert(ctx, config->m_Items[id], m_dir, m_down) == true)
+                    if (metrics.nAttempts == 0)
+                        ctx->TotalProgress(id);
+
+                    if (ConvertItem(ctx, config->m_Items[id], m_dir, m_down) == true)
                     {
                         ctx->nProcessedFiles++;
                         ctx->TotalProgress(id);
                     }
+                    else if (metrics.bRetry == true)
+                    {
+                        ids.push_back(id);
+                    }
                     else
                     {
                         ctx->nProcessedFiles++;
@@ -974,30 +1616,72 @@ namespace worker
             }
             return true;
         }
-        bool Convert(IWorkerContext* ctx, std::queue<int>& queue, std::mutex& m_queue, std::mutex &m_dir, std::mutex &m_down)
+        bool Convert(IWorkerContext* ctx, std::queue<int>& queue, std::mutex& m_queue, std::mutex &m_dir, std::mutex &m_down, int nSlot)
         {
             auto config = ctx->pConfig;
             while (true)
             {
                 try
                 {
-                    m_queue.lock();
+                    if (this->LoadController != nullptr && this->LoadController->WaitForSlot(ctx, nSlot) == false)
+                        return false;
+
+                    if (this->WaitWhilePaused(ctx) == false)
+                        return false;
+
+                    TRACE_LOCK(m_queue, "m_queue");
                     if (!queue.empty())
                     {
-                        int id = queue.front();
-                        queue.pop();
+                        // retried items rotate to the back until their backoff delay has passed
+                        int id = -1;
+                        size_t nCount = queue.size();
+                        for (size_t i = 0; i < nCount; i++)
+                        {
+                            int next = queue.front();
+                            queue.pop();
+                            if (ctx->m_ItemMetrics[next].RetryReady() == true)
+                            {
+                                id = next;
+                                break;
+                            }
+                            queue.push(next);
+                        }
+
+                        if (id == -1)
+                        {
+                            double fWait = (std::min)(ctx->m_ItemMetrics[queue.front()].RetryWait(), 50.0);
+                            m_queue.unlock();
+
+                            if (ctx->bRunning == false)
+                                return false;
+
+                            std::this_thread::sleep_for(std::chrono::milliseconds((int)fWait + 1));
+                            continue;
+                        }
+
                         m_queue.unlock();
 
                         if (ctx->bRunning == false)
                             return false;
 
-                        ctx->TotalProgress(id);
+                        auto& metrics = ctx->m_ItemMetrics[id];
+                        if (metrics.nAttempts == 0)
+                            ctx->TotalProgress(id);
 
-                        if (Convert(ctx, config->m_Items[id], m_dir, m_down) == true)
+                        if (nSlot < (int)this->SlotAffinity.size())
+                            metrics.nAffinity = this->SlotAffinity[nSlot];
+
+                        if (ConvertItem(ctx, config->m_Items[id], m_dir, m_down) == true)
                         {
                             ctx->nProcessedFiles++;
                             ctx->TotalProgress(id);
                         }
+                        else if (metrics.bRetry == true)
+                        {
+                            TRACE_LOCK(m_queue, "m_queue");
+                            queue.push(id);
+                            m_queue.unlock();
+                        }
                         else
                         {
                             ctx->nProcessedFiles++;
@@ -1032,7 +1716,26 @@ namespace worker
             ctx->nTotalFiles = 1;
             ctx->TotalProgress(item.nId);
 
-            if (Convert(ctx, item, m_dir, m_down) == true)
+            if ((int)ctx->m_ItemMetrics.size() <= item.nId)
+                ctx->m_ItemMetrics.resize(item.nId + 1);
+            ctx->m_ItemMetrics[item.nId].Reset(item.nId);
+
+            // single items jump ahead of queued batch items without stopping running ones
+            if (this->Scheduler != nullptr)
+                this->Scheduler->Interactive(ctx);
+
+            this->OpenRetryPolicy(ctx);
+            this->OpenMetrics(ctx);
+            this->OpenWatchdog(ctx);
+            this->OpenCancellation(ctx);
+            this->OpenTrace(ctx);
+
+            auto& metrics = ctx->m_ItemMetrics[item.nId];
+            bool bResult = ConvertItem(ctx, item, m_dir, m_down);
+            while (bResult == false && metrics.bRetry == true && this->WaitForRetry(ctx, metrics) == true)
+                bResult = ConvertItem(ctx, item, m_dir, m_down);
+
+            if (bResult == true)
             {
                 ctx->nProcessedFiles = 1;
                 ctx->nErrors = 0;
@@ -1045,6 +1748,14 @@ namespace worker
                 ctx->TotalProgress(item.nId);
             }
 
+            TRACE_END();
+            this->CloseCancellation();
+            this->CloseWatchdog(ctx);
+            this->CloseMetrics(ctx);
+
+            if (this->Scheduler != nullptr)
+                this->Scheduler->Unregister(ctx);
+
             ctx->Stop();
             ctx->bDone = true;
         }
@@ -1058,17 +1769,31 @@ namespace worker
 
                 ctx->Start();
 
+                ctx->m_ItemMetrics.clear();
+                ctx->m_ItemMetrics.resize(items.size());
+
                 for (auto& item : items)
                 {
                     if (item.bChecked == true)
                     {
                         item.ResetProgress();
+                        ctx->m_ItemMetrics[item.nId].Reset(item.nId);
                         ids.emplace_back(item.nId);
                         ctx->nTotalFiles++;
                     }
                 }
 
+                this->OpenRetryPolicy(ctx);
+                this->OpenMetrics(ctx);
+                this->OpenMemoryBudget(ctx);
+                this->OpenWatchdog(ctx);
+                this->OpenCancellation(ctx);
+                this->OpenTrace(ctx);
                 this->Convert(ctx, ids, m_dir, m_down);
+                TRACE_END();
+                this->CloseCancellation();
+                this->CloseWatchdog(ctx);
+                this->CloseMetrics(ctx);
 
                 ctx->Stop();
                 ctx->bDone = true;
@@ -1082,22 +1807,39 @@ namespace worker
 
                 ctx->Start();
 
+                ctx->m_ItemMetrics.clear();
+                ctx->m_ItemMetrics.resize(items.size());
+
                 for (auto& item : items)
                 {
                     if (item.bChecked == true)
                     {
                         item.ResetProgress();
+                        ctx->m_ItemMetrics[item.nId].Reset(item.nId);
                         queue.push(item.nId);
                         ctx->nTotalFiles++;
                     }
                 }
 
-                auto convert = [&]() { this->Convert(ctx, queue, m_queue, m_dir, m_down); };
+                this->OpenRetryPolicy(ctx);
+                this->OpenMetrics(ctx);
+                this->OpenMemoryBudget(ctx);
+                this->OpenSlotAffinity(ctx);
+                this->OpenWatchdog(ctx);
+                this->OpenCancellation(ctx);
+                this->StartLoadController(ctx);
+                this->OpenTrace(ctx);
+
+                auto convert = [&](int nSlot)
+                {
+                    TRACE_THREAD_NAME("worker", nSlot);
+                    this->Convert(ctx, queue, m_queue, m_dir, m_down, nSlot);
+                };
                 auto threads = std::make_unique<std::thread[]>(ctx->nThreadCount);
 
                 for (int i = 0; i < ctx->nThreadCount; i++)
                 {
-                    threads[i] = std::thread(convert);
+                    threads[i] = std::thread(convert, i);
                 }
 
                 for (int i = 0; i < ctx->nThreadCount; i++)
@@ -1105,6 +1847,12 @@ namespace worker
                     threads[i].join();
                 }
 
+                this->StopLoadController();
+                TRACE_END();
+                this->CloseCancellation();
+                this->CloseWatchdog(ctx);
+                this->CloseMetrics(ctx);
+
                 ctx->Stop();
                 ctx->bDone = true;
             }
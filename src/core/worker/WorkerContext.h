@@ -6,7 +6,14 @@
 #include <string>
 #include <utility>
 #include <memory>
+#include <vector>
+#include <atomic>
 #include "config\Config.h"
+#include "ItemMetrics.h"
+#include "AsyncLog.h"
+#include "OutputTail.h"
+#include "Topology.h"
+#include "ProcessLimits.h"
 
 namespace worker
 {
@@ -32,6 +39,13 @@ namespace worker
         virtual bool Terminate(int code = 0) = 0;
         virtual bool Close() = 0;
         virtual bool Stop(bool bWait, int nExitCodeSucess) = 0;
+        virtual int ExitCode() = 0;
+        virtual CProcessUsage Usage() = 0;
+        virtual bool SetAffinity(unsigned __int64 nMask) = 0;
+        virtual bool SetLimits(const CProcessLimits& limits) = 0;
+        virtual unsigned __int64 IoBytes() = 0;
+        virtual bool Suspend() = 0;
+        virtual bool Resume() = 0;
     public:
         virtual void* StdinHandle() = 0;
         virtual void* StdoutHandle() = 0;
@@ -58,8 +72,11 @@ namespace worker
     public:
         std::wstring szFileName;
         int nIndex;
-        volatile bool bError;
-        volatile bool bFinished;
+        std::atomic<bool> bError;
+        std::atomic<bool> bFileError;
+        std::atomic<bool> bFinished;
+        unsigned __int64 nTotalBytes;
+        double fStallTime;
     public:
         virtual ~IFileReader() { };
         virtual bool ReadLoop(IWorkerContext* ctx, IPipe* Stdin) = 0;
@@ -70,8 +87,11 @@ namespace worker
     public:
         std::wstring szFileName;
         int nIndex;
-        volatile bool bError;
-        volatile bool bFinished;
+        std::atomic<bool> bError;
+        std::atomic<bool> bFileError;
+        std::atomic<bool> bFinished;
+        unsigned __int64 nTotalBytes;
+        double fStallTime;
     public:
         virtual ~IFileWriter() { };
         virtual bool WriteLoop(IWorkerContext* ctx, IPipe* Stdout) = 0;
@@ -83,6 +103,7 @@ namespace worker
         int nIndex;
         int nProgress;
         int nPreviousProgress;
+        CAsyncLog* log = nullptr;
     public:
         virtual ~IOutputParser() { }
         virtual bool Open(IWorkerContext* ctx, const std::wstring& szFunction) = 0;
@@ -93,11 +114,42 @@ namespace worker
     {
     public:
         int nIndex;
-        volatile bool bError;
-        volatile bool bFinished;
+        std::atomic<bool> bError;
+        std::atomic<bool> bFinished;
+        COutputTail* tail = nullptr;
     public:
         virtual ~IStringWriter() { };
         virtual bool WriteLoop(IWorkerContext* ctx, IPipe* Stdout, IOutputParser* parser) = 0;
+        virtual bool DrainLoop(IPipe* Stderr) = 0;
+    };
+
+    class IMemoryStatus
+    {
+    public:
+        virtual ~IMemoryStatus() { };
+        virtual unsigned __int64 AvailableMemory() = 0;
+    };
+
+    class CSystemLoad
+    {
+    public:
+        double fBusy = 0.0;
+        double fQueueLength = 0.0;
+        int nProcessors = 1;
+    };
+
+    class ISystemLoad
+    {
+    public:
+        virtual ~ISystemLoad() { };
+        virtual bool Sample(CSystemLoad& load) = 0;
+    };
+
+    class IProcessorTopology
+    {
+    public:
+        virtual ~IProcessorTopology() { };
+        virtual bool Query(CProcessorTopology& topology) = 0;
     };
 
     class IWorkerFactory
@@ -111,22 +163,53 @@ namespace worker
         virtual std::shared_ptr<IFileWriter> CreateFileWriterPtr() = 0;
         virtual std::shared_ptr<IOutputParser> CreateOutputParserPtr() = 0;
         virtual std::shared_ptr<IStringWriter> CreateStringWriterPtr() = 0;
+        virtual std::shared_ptr<IMemoryStatus> CreateMemoryStatusPtr() = 0;
+        virtual std::shared_ptr<ISystemLoad> CreateSystemLoadPtr() = 0;
+        virtual std::shared_ptr<IProcessorTopology> CreateProcessorTopologyPtr() = 0;
+    };
+
+    class IProgressObserver
+    {
+    public:
+        virtual ~IProgressObserver() { };
+        virtual void ItemProgress(int nItemId, int nProgress) = 0;
+    };
+
+    class CActiveProcesses
+    {
+        std::atomic<int>& nActive;
+        int nCount;
+    public:
+        CActiveProcesses(std::atomic<int>& nActive, int nCount) : nActive(nActive), nCount(nCount)
+        {
+            this->nActive += this->nCount;
+        }
+        ~CActiveProcesses()
+        {
+            this->nActive -= this->nCount;
+        }
     };
 
     class IWorkerContext
     {
     public:
-        volatile bool bRunning;
-        volatile bool bDone;
-        volatile int nTotalFiles;
-        volatile int nProcessedFiles;
-        volatile int nErrors;
-        volatile int nLastItemId;
+        std::atomic<bool> bRunning;
+        std::atomic<bool> bDone;
+        std::atomic<int> nTotalFiles;
+        std::atomic<int> nProcessedFiles;
+        std::atomic<int> nErrors;
+        std::atomic<int> nLastItemId;
+        std::atomic<int> nRunningFiles;
+        std::atomic<int> nActiveProcesses;
+        std::atomic<bool> bPaused { false };
     public:
         int nThreadCount;
         config::CConfig* pConfig;
     public:
         std::shared_ptr<IWorkerFactory> pFactory;
+        IProgressObserver* pObserver = nullptr;
+    public:
+        std::vector<CItemMetrics> m_ItemMetrics;
     public:
         virtual ~IWorkerContext() { }
         virtual std::wstring GetString(int nKey) = 0;
@@ -136,5 +219,31 @@ namespace worker
         virtual bool ItemProgress(int nItemId, int nProgress, bool bFinished, bool bError = false) = 0;
         virtual void ItemStatus(int nItemId, const std::wstring& szTime, const std::wstring& szStatus) = 0;
         virtual void TotalProgress(int nItemId) = 0;
+    public:
+        bool Progress(int nItemId, int nProgress)
+        {
+            // observers get progress of running tools first hand instead of reading item state
+            if (this->pObserver != nullptr)
+                this->pObserver->ItemProgress(nItemId, nProgress);
+            return this->ItemProgress(nItemId, nProgress, false);
+        }
+        void Pause()
+        {
+            // no new items are started and running tools are suspended until resumed
+            this->bPaused = true;
+        }
+        void Resume()
+        {
+            this->bPaused = false;
+        }
+        bool StopOnError(int nItemId)
+        {
+            // failed attempts that may still be retried do not stop the batch
+            if (this->pConfig->m_Options.bStopOnErrors == false)
+                return false;
+            if (nItemId >= 0 && nItemId < (int)this->m_ItemMetrics.size() && this->m_ItemMetrics[nItemId].bRetryable == true)
+                return false;
+            return true;
+        }
     };
 }
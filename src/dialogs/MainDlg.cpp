@@ -141,7 +141,7 @@ namespace dialogs
     class CMainDlgWorkerContext : public worker::IWorkerContext
     {
     private:
-        volatile bool bSafeCheck;
+        std::atomic<bool> bSafeCheck;
         CMainDlg *pDlg;
         util::CTimeCount timer;
     public:
@@ -168,6 +168,9 @@ namespace dialogs
             this->nProcessedFiles = 0;
             this->nErrors = 0;
             this->nLastItemId = -1;
+            this->nRunningFiles = 0;
+            this->nActiveProcesses = 0;
+            this->bPaused = false;
         }
         void Start()
         {
@@ -177,18 +180,21 @@ namespace dialogs
         void Stop()
         {
             this->timer.Stop();
+            int nProcessed = this->nProcessedFiles;
+            int nTotal = this->nTotalFiles;
+            int nErrors = this->nErrors;
             CString szFormat = pDlg->m_Config.GetString(0x00190004).c_str();
             CString szText;
             szText.Format(szFormat,
-                this->nProcessedFiles,
-                this->nTotalFiles,
-                this->nProcessedFiles - this->nErrors,
-                this->nErrors,
-                ((this->nErrors == 0) || (this->nErrors > 1)) ?
+                nProcessed,
+                nTotal,
+                nProcessed - nErrors,
+                nErrors,
+                ((nErrors == 0) || (nErrors > 1)) ?
                 pDlg->m_Config.GetString(0x00190002).c_str() : pDlg->m_Config.GetString(0x00190001).c_str(),
                 util::CTimeCount::Format(this->timer.ElapsedTime()).c_str());
             pDlg->m_StatusBar.SetText(szText, 1, 0);
-            int nPos = (int)(100.0 * ((double)this->nProcessedFiles / (double)this->nTotalFiles));
+            int nPos = (int)(100.0 * ((double)nProcessed / (double)nTotal));
             pDlg->m_Progress.SetPos(nPos);
             pDlg->FinishConvert();
             this->pConfig = nullptr;
@@ -200,7 +206,7 @@ namespace dialogs
             {
                 config::CItem &item = pDlg->m_Config.m_Items[nItemId];
                 item.bFinished = true;
-                if (pDlg->m_Config.m_Options.bStopOnErrors == true)
+                if (this->StopOnError(nItemId) == true)
                 {
                     pDlg->m_Progress.SetPos(0);
                     this->bRunning = false;
@@ -229,7 +235,7 @@ namespace dialogs
                     {
                         if (nItemProgress > 0 && nItemProgress < 100 && nItemProgress > nItemPreviousProgress)
                         {
-                            item.szStatus = std::to_wstring(nItemProgress) + L"%";
+                            item.SetProgressStatus(nItemProgress);
                             item.nPreviousProgress = nItemProgress;
                             pDlg->RedrawItem(nItemId);
                         }
@@ -240,9 +246,8 @@ namespace dialogs
                     }
                 }
 
-                if (this->bSafeCheck == false)
+                if (this->bSafeCheck.exchange(true) == false)
                 {
-                    this->bSafeCheck = true;
                     if (nItemId > this->nLastItemId)
                     {
                         this->nLastItemId = nItemId;
@@ -259,9 +264,8 @@ namespace dialogs
             config::CItem &item = pDlg->m_Config.m_Items[nItemId];
             item.szTime = szTime;
             item.szStatus = szStatus;
-            if (this->bSafeCheck == false)
+            if (this->bSafeCheck.exchange(true) == false)
             {
-                this->bSafeCheck = true;
                 if (nItemId > this->nLastItemId)
                 {
                     this->nLastItemId = nItemId;
@@ -274,14 +278,17 @@ namespace dialogs
         }
         void TotalProgress(int nItemId)
         {
+            int nProcessed = this->nProcessedFiles;
+            int nTotal = this->nTotalFiles;
+            int nErrors = this->nErrors;
             CString szFormat = pDlg->m_Config.GetString(0x00190003).c_str();
             CString szText;
             szText.Format(szFormat,
-                this->nProcessedFiles,
-                this->nTotalFiles,
-                this->nProcessedFiles - this->nErrors,
-                this->nErrors,
-                ((this->nErrors == 0) || (this->nErrors > 1)) ?
+                nProcessed,
+                nTotal,
+                nProcessed - nErrors,
+                nErrors,
+                ((nErrors == 0) || (nErrors > 1)) ?
                 pDlg->m_Config.GetString(0x00190002).c_str() : pDlg->m_Config.GetString(0x00190001).c_str());
             pDlg->m_StatusBar.SetText(szText, 1, 0);
 
@@ -292,7 +299,7 @@ namespace dialogs
                     pDlg->MakeItemVisible(nItemId);
             }
 
-            int nPos = (int)(100.0f * ((double)this->nProcessedFiles / (double)this->nTotalFiles));
+            int nPos = (int)(100.0f * ((double)nProcessed / (double)nTotal));
             pDlg->m_Progress.SetPos(nPos);
         }
     };
@@ -2548,9 +2555,9 @@ namespace dialogs
             this->ctx->nThreadCount = this->m_Config.m_Options.nThreadCount;
             if (this->ctx->nThreadCount < 1)
             {
-                util::LogicalProcessorInformation info;
-                if (util::GetLogicalProcessorInformation(&info) == 0)
-                    this->ctx->nThreadCount = info.processorCoreCount;
+                worker::CProcessorTopology topology;
+                if (this->ctx->pFactory->CreateProcessorTopologyPtr()->Query(topology) == true)
+                    this->ctx->nThreadCount = topology.DefaultThreadCount();
                 else
                     this->ctx->nThreadCount = 1;
             }
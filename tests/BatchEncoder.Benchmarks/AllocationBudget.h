@@ -0,0 +1,186 @@
+﻿// Copyright (c) Wiesław Šoltés. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#pragma once
+
+#include <string>
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include "config\Config.h"
+#include "worker\Worker.h"
+#include "worker\Win32.h"
+#include "BenchmarkContext.h"
+#include "MicroBenchmark.h"
+#include "ThroughputBenchmark.h"
+
+class CItemAllocations
+{
+public:
+    unsigned __int64 nStartCount = 0;
+    unsigned __int64 nStartBytes = 0;
+    unsigned __int64 nCount = 0;
+    unsigned __int64 nBytes = 0;
+    unsigned __int64 nFirstEventCount = 0;
+    unsigned __int64 nFirstEventBytes = 0;
+    unsigned __int64 nEventCount = 0;
+    unsigned __int64 nEventBytes = 0;
+    int nEvents = 0;
+    int nCalls = 0;
+public:
+    double EventAllocations() const
+    {
+        // steady state cost between first and last progress event
+        return this->nEvents > 1 ? (double)this->nEventCount / (this->nEvents - 1) : 0.0;
+    }
+    double EventBytes() const
+    {
+        return this->nEvents > 1 ? (double)this->nEventBytes / (this->nEvents - 1) : 0.0;
+    }
+};
+
+// items run on a single thread so every allocation belongs to the current item
+class CAllocationWorkerContext : public CBenchmarkWorkerContext
+{
+public:
+    std::vector<CItemAllocations> m_Allocations;
+public:
+    bool ItemProgress(int nItemId, int nProgress, bool bFinished, bool bError = false)
+    {
+        if (bFinished == false && bError == false)
+        {
+            auto& allocations = this->m_Allocations[nItemId];
+            unsigned __int64 nCount = CAllocationCounter::nCount;
+            unsigned __int64 nBytes = CAllocationCounter::nBytes;
+            if (allocations.nEvents == 0)
+            {
+                allocations.nFirstEventCount = nCount;
+                allocations.nFirstEventBytes = nBytes;
+            }
+            else
+            {
+                allocations.nEventCount = nCount - allocations.nFirstEventCount;
+                allocations.nEventBytes = nBytes - allocations.nFirstEventBytes;
+            }
+            allocations.nEvents++;
+        }
+        return CBenchmarkWorkerContext::ItemProgress(nItemId, nProgress, bFinished, bError);
+    }
+    void TotalProgress(int nItemId)
+    {
+        // called once before and once after each item
+        auto& allocations = this->m_Allocations[nItemId];
+        if (allocations.nCalls++ == 0)
+        {
+            allocations.nStartCount = CAllocationCounter::nCount;
+            allocations.nStartBytes = CAllocationCounter::nBytes;
+        }
+        else
+        {
+            allocations.nCount = CAllocationCounter::nCount - allocations.nStartCount;
+            allocations.nBytes = CAllocationCounter::nBytes - allocations.nStartBytes;
+        }
+        CBenchmarkWorkerContext::TotalProgress(nItemId);
+    }
+};
+
+class CAllocationBudget
+{
+public:
+    int nItems = 32;
+    int nSize = 4;
+    std::wstring szMode = L"console";
+    size_t nPreset = 0;
+    double fItemBudget = 2000.0;
+    double fEventBudget = 1.0;
+public:
+    CThroughputBenchmark m_Pipeline;
+public:
+    bool Run()
+    {
+        m_Pipeline.nItems = this->nItems;
+        m_Pipeline.nSize = this->nSize;
+        m_Pipeline.nPreset = this->nPreset;
+        if (m_Pipeline.Init() == false)
+            return false;
+
+        auto modes = CThroughputBenchmark::Modes();
+        auto mode = std::find_if(modes.begin(), modes.end(), [this](const CThroughputMode& m) { return m.szName == this->szMode; });
+        if (mode == modes.end())
+        {
+            fwprintf(stderr, L"[Error] Unknown mode: %s\n", this->szMode.c_str());
+            return false;
+        }
+
+        if (m_Pipeline.CreateInputs(mode->szInputExtension) == false)
+            return false;
+
+        m_Pipeline.CreateItems(*mode);
+
+        auto& m_Config = m_Pipeline.m_Config;
+
+        CAllocationWorkerContext ctx;
+        ctx.Init();
+        ctx.nThreadCount = 1;
+        ctx.pConfig = &m_Config;
+        ctx.m_Allocations.resize(m_Config.m_Items.size());
+
+        auto pWorker = std::make_unique<worker::CWorker>();
+        pWorker->ConsoleConverter = std::make_unique<worker::CConsoleConverter>();
+        pWorker->PipesConverter = std::make_unique<worker::CPipesConverter>();
+        pWorker->PipesTranscoder = std::make_unique<worker::CPipesTranscoder>();
+        pWorker->Convert(&ctx, m_Config.m_Items);
+
+        wprintf(L"%-16s %8s %12s %12s %8s %12s %12s %s\n",
+            L"item", L"result", L"allocs", L"bytes", L"events", L"allocs/event", L"bytes/event", L"status");
+
+        bool bPassed = true;
+        unsigned __int64 nTotalCount = 0;
+        unsigned __int64 nTotalBytes = 0;
+        unsigned __int64 nTotalEvents = 0;
+        unsigned __int64 nTotalEventCount = 0;
+        for (auto& item : m_Config.m_Items)
+        {
+            auto& allocations = ctx.m_Allocations[item.nId];
+            bool bItemOver = (double)allocations.nCount > this->fItemBudget;
+            bool bEventOver = allocations.EventAllocations() > this->fEventBudget;
+            const wchar_t* szStatus = bItemOver ? L"OVER (item)" : (bEventOver ? L"OVER (event)" : L"OK");
+            if (bItemOver || bEventOver)
+                bPassed = false;
+
+            wprintf(L"%-16s %8s %12llu %12llu %8d %12.2f %12.1f %s\n",
+                item.szName.c_str(),
+                ctx.m_ItemMetrics[item.nId].bSuccess ? L"done" : L"failed",
+                allocations.nCount,
+                allocations.nBytes,
+                allocations.nEvents,
+                allocations.EventAllocations(),
+                allocations.EventBytes(),
+                szStatus);
+
+            nTotalCount += allocations.nCount;
+            nTotalBytes += allocations.nBytes;
+            nTotalEvents += allocations.nEvents > 1 ? allocations.nEvents - 1 : 0;
+            nTotalEventCount += allocations.nEventCount;
+        }
+
+        size_t nCount = m_Config.m_Items.size();
+        wprintf(L"\nper item: %.1f allocs, %.0f bytes (budget %.0f allocs)\n",
+            nCount > 0 ? (double)nTotalCount / nCount : 0.0,
+            nCount > 0 ? (double)nTotalBytes / nCount : 0.0,
+            this->fItemBudget);
+        wprintf(L"per progress event: %.2f allocs (budget %.2f allocs)\n",
+            nTotalEvents > 0 ? (double)nTotalEventCount / nTotalEvents : 0.0,
+            this->fEventBudget);
+
+        if (ctx.nErrors > 0)
+        {
+            fwprintf(stderr, L"[Error] %d items failed to convert.\n", (int)ctx.nErrors);
+            bPassed = false;
+        }
+
+        m_Config.Log->Close();
+        return bPassed;
+    }
+};
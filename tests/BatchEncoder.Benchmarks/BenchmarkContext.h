@@ -0,0 +1,93 @@
+﻿// Copyright (c) Wiesław Šoltés. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#pragma once
+
+#include <string>
+#include <memory>
+#include "config\Config.h"
+#include "worker\WorkerContext.h"
+#include "worker\Win32.h"
+
+class CBenchmarkWorkerContext : public worker::IWorkerContext
+{
+public:
+    CBenchmarkWorkerContext()
+    {
+        this->bDone = true;
+        this->bRunning = false;
+        this->pConfig = nullptr;
+        this->pFactory = std::make_shared<worker::Win32WorkerFactory>();
+    }
+    virtual ~CBenchmarkWorkerContext() { }
+public:
+    std::wstring GetString(int nKey)
+    {
+        return this->pConfig->GetString(nKey);
+    }
+    void Init()
+    {
+        this->bRunning = true;
+        this->bDone = false;
+        this->nTotalFiles = 0;
+        this->nProcessedFiles = 0;
+        this->nErrors = 0;
+        this->nLastItemId = -1;
+        this->nRunningFiles = 0;
+        this->nActiveProcesses = 0;
+        this->bPaused = false;
+    }
+    void Start()
+    {
+    }
+    void Stop()
+    {
+        this->pConfig = nullptr;
+        this->bRunning = false;
+    }
+    bool ItemProgress(int nItemId, int nProgress, bool bFinished, bool bError = false)
+    {
+        if (bError == true)
+        {
+            config::CItem &item = this->pConfig->m_Items[nItemId];
+            item.bFinished = true;
+            if (this->StopOnError(nItemId) == true)
+                this->bRunning = false;
+            return this->bRunning;
+        }
+
+        if (bFinished == true)
+        {
+            config::CItem &item = this->pConfig->m_Items[nItemId];
+            item.bFinished = true;
+        }
+
+        // same per-event bookkeeping as the gui and console contexts
+        if ((bFinished == false) && (this->bRunning == true))
+        {
+            config::CItem &item = this->pConfig->m_Items[nItemId];
+            item.nProgress = nProgress;
+            if (item.nPreviousProgress > nProgress)
+                item.nPreviousProgress = nProgress;
+
+            if (item.bFinished == false && nProgress > 0 && nProgress < 100 && nProgress > item.nPreviousProgress)
+            {
+                item.SetProgressStatus(nProgress);
+                item.nPreviousProgress = nProgress;
+            }
+        }
+
+        return this->bRunning;
+    }
+    void ItemStatus(int nItemId, const std::wstring& szTime, const std::wstring& szStatus)
+    {
+        config::CItem &item = this->pConfig->m_Items[nItemId];
+        item.szTime = szTime;
+        item.szStatus = szStatus;
+    }
+    void TotalProgress(int nItemId)
+    {
+        if (nItemId > this->nLastItemId)
+            this->nLastItemId = nItemId;
+    }
+};
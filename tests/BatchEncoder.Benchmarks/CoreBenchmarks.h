@@ -0,0 +1,234 @@
+﻿// Copyright (c) Wiesław Šoltés. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#pragma once
+
+#include <string>
+#include <memory>
+#include <vector>
+#include "utilities\MemoryLog.h"
+#include "config\Config.h"
+#include "worker\CommandLine.h"
+#include "worker\InputPath.h"
+#include "worker\OutputPath.h"
+#include "worker\Win32.h"
+#include "BenchmarkContext.h"
+#include "MicroBenchmark.h"
+
+class CCoreBenchmarks
+{
+public:
+    int nMaxItems = 1000000;
+    std::wstring szWorkPath;
+public:
+    config::CConfig m_Config;
+    std::wstring szExePath;
+    std::wstring szInputFile;
+public:
+    bool Init()
+    {
+        m_Config.FileSystem = std::make_unique<worker::Win32FileSystem>();
+        m_Config.m_Settings.Init(m_Config.FileSystem.get());
+        m_Config.Log = std::make_unique<util::MemoryLog>();
+        m_Config.Log->Open();
+        m_Config.nLangId = -1;
+        m_Config.m_Options.Defaults();
+
+        this->szExePath = m_Config.FileSystem->GetFilePath(m_Config.FileSystem->GetExeFilePath());
+        m_Config.LoadFormats(m_Config.FileSystem->CombinePath(this->szExePath, L"formats"));
+        if (config::CFormat::GetFormatById(m_Config.m_Formats, L"LAME_MP3") == -1)
+        {
+            fwprintf(stderr, L"[Error] Missing LAME_MP3 format.\n");
+            return false;
+        }
+
+        if (this->szWorkPath.empty())
+            this->szWorkPath = m_Config.FileSystem->CombinePath(this->szExePath, L"benchmarks\\work");
+        m_Config.FileSystem->MakeFullPath(this->szWorkPath);
+
+        // existing file so AddItem measures the real size lookup
+        this->szInputFile = m_Config.FileSystem->GetExeFilePath();
+        return true;
+    }
+    static std::vector<config::CItem> CreateItems(int nCount)
+    {
+        std::vector<config::CItem> items;
+        items.reserve(nCount);
+        for (int i = 0; i < nCount; i++)
+        {
+            config::CItem item;
+            item.nId = i;
+            item.szName = L"Track " + std::to_wstring(i);
+            item.szExtension = L"WAV";
+            item.szFormatId = L"LAME_MP3";
+            item.nPreset = 10;
+            item.szOptions = L"";
+            item.bChecked = true;
+            item.nSize = 42000000;
+            item.m_Paths.emplace_back(config::CPath{ L"C:\\Music\\Artist\\Album\\Track " + std::to_wstring(i) + L".wav", 42000000 });
+            item.szTime = L"";
+            item.szStatus = L"";
+            item.ResetProgress();
+            items.emplace_back(std::move(item));
+        }
+        return items;
+    }
+    void Register(CMicroBenchmarkRunner& runner)
+    {
+        auto fs = m_Config.FileSystem.get();
+        auto& formats = m_Config.m_Formats;
+        int nLame = config::CFormat::GetFormatById(formats, L"LAME_MP3");
+
+        runner.Register(L"CCommandLine/Construct", [this, fs, nLame](CMicroState& state)
+        {
+            auto& format = m_Config.m_Formats[nLame];
+            std::wstring szInput = L"C:\\Music\\Artist\\Album\\01 - Track.wav";
+            std::wstring szOutput = L"C:\\Music\\Artist\\Album\\01 - Track.mp3";
+            while (state.KeepRunning())
+            {
+                worker::CCommandLine cl(fs, format, format.nDefaultPreset, 0, szInput, szOutput, L"");
+                DoNotOptimize(cl.szCommandLine);
+            }
+        });
+
+        runner.Register(L"COutputPath/CreateFilePath/Full", [fs](CMicroState& state)
+        {
+            worker::COutputPath output;
+            std::wstring szInput = L"C:\\Music\\Artist\\Album\\01 - Track.wav";
+            while (state.KeepRunning())
+            {
+                std::wstring szPath = output.CreateFilePath(fs, VAR_OUTPUT_FULL, szInput, L"01 - Track", L"mp3");
+                DoNotOptimize(szPath);
+            }
+        });
+
+        runner.Register(L"COutputPath/CreateFilePath/Folders", [fs](CMicroState& state)
+        {
+            worker::COutputPath output;
+            std::wstring szInput = L"C:\\Music\\Artist\\Album\\01 - Track.wav";
+            while (state.KeepRunning())
+            {
+                std::wstring szPath = output.CreateFilePath(fs, L"D:\\Encoded\\$InputFolder[1]$\\$InputFolder[2]$\\$Name$.$Ext$", szInput, L"01 - Track", L"mp3");
+                DoNotOptimize(szPath);
+            }
+        });
+
+        runner.Register(L"CInputPath/Split", [](CMicroState& state)
+        {
+            while (state.KeepRunning())
+            {
+                worker::CInputPath input(L"C:\\Music\\Artist\\Album\\01 - Track.wav");
+                DoNotOptimize(input.szSourceFolders);
+            }
+        });
+
+        runner.Register(L"CFormat/GetDecoderByExtensionAndFormat", [&formats, nLame](CMicroState& state)
+        {
+            auto& ef = formats[nLame];
+            while (state.KeepRunning())
+            {
+                int nDecoder = config::CFormat::GetDecoderByExtensionAndFormat(formats, L"FLAC", ef);
+                DoNotOptimize(nDecoder);
+            }
+        });
+
+        runner.Register(L"CConfig/GetString/Hit", [this](CMicroState& state)
+        {
+            while (state.KeepRunning())
+            {
+                std::wstring szValue = m_Config.GetString(0x00150001);
+                DoNotOptimize(szValue);
+            }
+        });
+
+        runner.Register(L"CConfig/GetString/Miss", [this](CMicroState& state)
+        {
+            while (state.KeepRunning())
+            {
+                std::wstring szValue = m_Config.GetString(0x7FFFFFFF);
+                DoNotOptimize(szValue);
+            }
+        });
+
+        runner.Register(L"CConfig/AddItem", [this](CMicroState& state)
+        {
+            // report cost per item, clear every 1000 items to keep list size bounded
+            state.nItemsPerIteration = 1000;
+            while (state.KeepRunning())
+            {
+                m_Config.m_Items.clear();
+                for (int i = 0; i < 1000; i++)
+                    m_Config.AddItem(this->szInputFile, 0, 0);
+            }
+            m_Config.m_Items.clear();
+        });
+
+        for (int nCount = 10000; nCount <= this->nMaxItems; nCount *= 10)
+        {
+            std::wstring szSuffix = std::to_wstring(nCount);
+            std::wstring szFile = m_Config.FileSystem->CombinePath(this->szWorkPath, L"items" + szSuffix + L".xml");
+
+            runner.Register(L"XmlConfig/SaveItems/" + szSuffix, [szFile, nCount](CMicroState& state)
+            {
+                auto items = CreateItems(nCount);
+                state.nItemsPerIteration = nCount;
+                while (state.KeepRunning())
+                {
+                    bool bResult = config::xml::XmlConfig::SaveItems(szFile, items);
+                    DoNotOptimize(bResult);
+                }
+            });
+
+            runner.Register(L"XmlConfig/LoadItems/" + szSuffix, [szFile, nCount](CMicroState& state)
+            {
+                auto items = CreateItems(nCount);
+                config::xml::XmlConfig::SaveItems(szFile, items);
+                items.clear();
+                items.shrink_to_fit();
+
+                state.nItemsPerIteration = nCount;
+                while (state.KeepRunning())
+                {
+                    std::vector<config::CItem> loaded;
+                    bool bResult = config::xml::XmlConfig::LoadItems(szFile, loaded);
+                    DoNotOptimize(bResult);
+                }
+            });
+        }
+
+        runner.Register(L"CLuaOutputParser/Parse", [this](CMicroState& state)
+        {
+            CBenchmarkWorkerContext ctx;
+            ctx.pConfig = &m_Config;
+            ctx.Init();
+
+            m_Config.m_Items = CreateItems(1);
+
+            worker::CLuaOutputParser parser;
+            parser.nIndex = 0;
+            parser.nProgress = 0;
+            parser.nPreviousProgress = 0;
+
+            std::wstring szFunction = m_Config.FileSystem->CombinePath(this->szExePath, L"progress\\GetProgress_LameEnc.lua");
+            if (parser.Open(&ctx, szFunction) == false)
+                return;
+
+            const char* szLines[] =
+            {
+                "  1792/8207   (22%)|    0:00/    0:02|    0:00/    0:02|   19.901x|    0:01 ",
+                "  4864/8207   (59%)|    0:00/    0:01|    0:00/    0:01|   20.156x|    0:00 ",
+                "Writing LAME Tag...done"
+            };
+
+            int i = 0;
+            while (state.KeepRunning())
+            {
+                bool bResult = parser.Parse(&ctx, szLines[i]);
+                DoNotOptimize(bResult);
+                i = (i + 1) % 3;
+            }
+
+            m_Config.m_Items.clear();
+        });
+    }
+};
@@ -0,0 +1,136 @@
+﻿// Copyright (c) Wiesław Šoltés. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+
+// counters are updated by global operator new in main.cpp
+class CAllocationCounter
+{
+public:
+    static inline std::atomic<unsigned __int64> nCount { 0 };
+    static inline std::atomic<unsigned __int64> nBytes { 0 };
+public:
+    static void Add(size_t nSize)
+    {
+        nCount.fetch_add(1, std::memory_order_relaxed);
+        nBytes.fetch_add(nSize, std::memory_order_relaxed);
+    }
+};
+
+class CMicroState
+{
+    unsigned __int64 nRemaining;
+public:
+    unsigned __int64 nIterations;
+    unsigned __int64 nItemsPerIteration;
+public:
+    CMicroState(unsigned __int64 nIterations) : nRemaining(nIterations), nIterations(nIterations), nItemsPerIteration(1)
+    {
+    }
+public:
+    bool KeepRunning()
+    {
+        if (this->nRemaining == 0)
+            return false;
+        this->nRemaining--;
+        return true;
+    }
+};
+
+template<typename T>
+inline void DoNotOptimize(const T& value)
+{
+    static volatile const void* pSink;
+    pSink = &value;
+}
+
+class CMicroResult
+{
+public:
+    std::wstring szName;
+    unsigned __int64 nIterations;
+    double fNanoseconds;
+    double fAllocations;
+    double fBytes;
+};
+
+class CMicroBenchmark
+{
+public:
+    std::wstring szName;
+    std::function<void(CMicroState&)> function;
+};
+
+class CMicroBenchmarkRunner
+{
+public:
+    std::vector<CMicroBenchmark> m_Benchmarks;
+    std::vector<CMicroResult> m_Results;
+    double fMinTime = 0.5;
+public:
+    void Register(const std::wstring& szName, std::function<void(CMicroState&)> function)
+    {
+        this->m_Benchmarks.emplace_back(CMicroBenchmark{ szName, function });
+    }
+    CMicroResult Run(CMicroBenchmark& benchmark)
+    {
+        unsigned __int64 nIterations = 1;
+        while (true)
+        {
+            CMicroState state(nIterations);
+
+            unsigned __int64 nCount = CAllocationCounter::nCount;
+            unsigned __int64 nBytes = CAllocationCounter::nBytes;
+            auto tStart = std::chrono::steady_clock::now();
+
+            benchmark.function(state);
+
+            double fElapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - tStart).count();
+            nCount = CAllocationCounter::nCount - nCount;
+            nBytes = CAllocationCounter::nBytes - nBytes;
+
+            // grow iteration count until run takes at least fMinTime
+            if (fElapsed >= this->fMinTime || nIterations >= 1000000000ULL)
+            {
+                double fOperations = (double)state.nIterations * state.nItemsPerIteration;
+                CMicroResult result;
+                result.szName = benchmark.szName;
+                result.nIterations = state.nIterations;
+                result.fNanoseconds = fElapsed * 1e9 / fOperations;
+                result.fAllocations = nCount / fOperations;
+                result.fBytes = nBytes / fOperations;
+                return result;
+            }
+
+            double fScale = fElapsed > 0.0 ? 1.4 * this->fMinTime / fElapsed : 10.0;
+            if (fScale > 10.0)
+                fScale = 10.0;
+            if (fScale < 2.0)
+                fScale = 2.0;
+            nIterations = (unsigned __int64)(nIterations * fScale);
+        }
+    }
+    void Run(const std::wstring& szFilter)
+    {
+        wprintf(L"%-48s %12s %14s %12s %12s\n", L"benchmark", L"iterations", L"ns/op", L"allocs/op", L"bytes/op");
+
+        for (auto& benchmark : this->m_Benchmarks)
+        {
+            if (szFilter.empty() == false && benchmark.szName.find(szFilter) == std::wstring::npos)
+                continue;
+
+            CMicroResult result = this->Run(benchmark);
+            wprintf(L"%-48s %12llu %14.1f %12.2f %12.1f\n",
+                result.szName.c_str(), result.nIterations, result.fNanoseconds, result.fAllocations, result.fBytes);
+
+            this->m_Results.emplace_back(result);
+        }
+    }
+};
@@ -0,0 +1,343 @@
+﻿// Copyright (c) Wiesław Šoltés. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#pragma once
+
+#include <string>
+#include <map>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include "utilities\String.h"
+#include "worker\Win32.h"
+#include "MicroBenchmark.h"
+#include "CoreBenchmarks.h"
+#include "ThroughputBenchmark.h"
+#include "ProgressReplay.h"
+
+class CPerfMetrics
+{
+public:
+    std::string szCommit;
+    std::string szTarget;
+    std::map<std::string, double> m_Values;
+public:
+    static std::string Target()
+    {
+        // timings of different builds are not comparable, so each has its own baseline
+#ifdef _DEBUG
+        std::string szConfiguration = "Debug";
+#else
+        std::string szConfiguration = "Release";
+#endif
+#ifdef _WIN64
+        return szConfiguration + "-x64";
+#else
+        return szConfiguration + "-Win32";
+#endif
+    }
+    static double Median(std::vector<double> values)
+    {
+        if (values.empty() == true)
+            return 0.0;
+
+        std::sort(values.begin(), values.end());
+        size_t nMiddle = values.size() / 2;
+        if (values.size() % 2 == 0)
+            return (values[nMiddle - 1] + values[nMiddle]) / 2.0;
+        return values[nMiddle];
+    }
+    static bool LowerIsBetter(const std::string& szName)
+    {
+        auto ends = [&szName](const char* szSuffix)
+        {
+            size_t nLength = strlen(szSuffix);
+            return szName.length() >= nLength && szName.compare(szName.length() - nLength, nLength, szSuffix) == 0;
+        };
+        return ends("/ns_per_op") || ends("/allocs_per_op");
+    }
+    static bool IsAllocation(const std::string& szName)
+    {
+        return szName.find("/allocs_per_op") != std::string::npos;
+    }
+public:
+    std::string ToJson() const
+    {
+        std::string szJson = "{\n  \"commit\": \"" + this->szCommit + "\",\n  \"target\": \"" + this->szTarget + "\",\n  \"metrics\": {";
+        bool bFirst = true;
+        for (auto& value : this->m_Values)
+        {
+            char szValue[64];
+            _snprintf_s(szValue, _TRUNCATE, "%.6g", value.second);
+            szJson += bFirst ? "\n" : ",\n";
+            szJson += "    \"" + value.first + "\": " + szValue;
+            bFirst = false;
+        }
+        szJson += "\n  }\n}\n";
+        return szJson;
+    }
+    bool FromJson(const std::string& szJson)
+    {
+        // reads the flat format written by ToJson
+        this->m_Values.clear();
+        this->szCommit = ReadString(szJson, "\"commit\"");
+        this->szTarget = ReadString(szJson, "\"target\"");
+
+        size_t nPos = szJson.find("\"metrics\"");
+        if (nPos == std::string::npos)
+            return false;
+
+        nPos = szJson.find('{', nPos);
+        if (nPos == std::string::npos)
+            return false;
+
+        nPos++;
+        while (true)
+        {
+            size_t nKey = szJson.find_first_of("\"}", nPos);
+            if (nKey == std::string::npos || szJson[nKey] == '}')
+                break;
+
+            size_t nKeyEnd = szJson.find('"', nKey + 1);
+            size_t nColon = szJson.find(':', nKeyEnd);
+            if (nKeyEnd == std::string::npos || nColon == std::string::npos)
+                return false;
+
+            char* pEnd = nullptr;
+            double fValue = strtod(szJson.c_str() + nColon + 1, &pEnd);
+            this->m_Values[szJson.substr(nKey + 1, nKeyEnd - nKey - 1)] = fValue;
+            nPos = (size_t)(pEnd - szJson.c_str());
+        }
+
+        return true;
+    }
+    static std::string ReadString(const std::string& szJson, const char* szKey)
+    {
+        size_t nKey = szJson.find(szKey);
+        if (nKey == std::string::npos)
+            return "";
+
+        size_t nStart = szJson.find('"', szJson.find(':', nKey));
+        size_t nEnd = nStart != std::string::npos ? szJson.find('"', nStart + 1) : std::string::npos;
+        if (nStart == std::string::npos || nEnd == std::string::npos)
+            return "";
+
+        return szJson.substr(nStart + 1, nEnd - nStart - 1);
+    }
+    bool Load(const std::wstring& szFileName)
+    {
+        std::string szJson;
+        if (CProgressReplay::ReadFile(szFileName, szJson) == false)
+            return false;
+        return this->FromJson(szJson);
+    }
+    bool Save(const std::wstring& szFileName) const
+    {
+        FILE *fs = nullptr;
+        if (_wfopen_s(&fs, szFileName.c_str(), L"wb") != 0 || fs == nullptr)
+            return false;
+
+        std::string szJson = this->ToJson();
+        bool bResult = fwrite(szJson.data(), 1, szJson.size(), fs) == szJson.size();
+        fclose(fs);
+        return bResult;
+    }
+};
+
+class CPerfGate
+{
+public:
+    std::wstring szCommit = L"local";
+    std::wstring szBaseline;
+    std::wstring szResultsPath;
+    double fTimeTolerance = 0.15;
+    double fAllocTolerance = 0.05;
+    int nSamples = 5;
+    bool bUpdateBaseline = false;
+public:
+    CPerfMetrics m_Current;
+    CPerfMetrics m_Baseline;
+public:
+    bool Collect(CPerfMetrics& metrics)
+    {
+        CCoreBenchmarks core;
+        core.nMaxItems = 100000;
+        CMicroBenchmarkRunner runner;
+        runner.fMinTime = 0.2;
+        if (core.Init() == true)
+        {
+            core.Register(runner);
+            runner.Run(L"");
+            for (auto& result : runner.m_Results)
+            {
+                std::string szName = "micro/" + util::string::Convert(result.szName);
+                metrics.m_Values[szName + "/ns_per_op"] = result.fNanoseconds;
+                metrics.m_Values[szName + "/allocs_per_op"] = result.fAllocations;
+            }
+        }
+
+        CThroughputBenchmark throughput;
+        throughput.nItems = 8;
+        throughput.nSize = 4;
+        if (throughput.Run() == true)
+        {
+            for (auto& result : throughput.m_Results)
+            {
+                std::string szName = "throughput/" + util::string::Convert(result.szMode) + "/" + std::to_string(result.nThreads);
+                metrics.m_Values[szName + "/items_per_s"] = result.ItemsPerSecond();
+            }
+        }
+
+        CProgressReplay replay;
+        replay.nRepeat = 5;
+        bool bReplayPassed = replay.Run();
+        for (auto& result : replay.m_Results)
+        {
+            double fLines = (double)result.nLines * result.nReplays;
+            metrics.m_Values["replay/" + util::string::Convert(result.szName) + "/lines_per_s"] = result.fSeconds > 0.0 ? fLines / result.fSeconds : 0.0;
+        }
+
+        // a broken progress script fails the gate whatever its speed
+        return bReplayPassed;
+    }
+    bool Compare()
+    {
+        bool bPassed = true;
+
+        wprintf(L"\n%-60s %14s %14s %9s %s\n", L"metric", L"baseline", L"current", L"change", L"status");
+
+        for (auto& current : m_Current.m_Values)
+        {
+            auto baseline = m_Baseline.m_Values.find(current.first);
+            std::wstring szName = util::string::Convert(current.first);
+            if (baseline == m_Baseline.m_Values.end())
+            {
+                wprintf(L"%-60s %14s %14.3f %9s %s\n", szName.c_str(), L"-", current.second, L"-", L"NEW");
+                continue;
+            }
+
+            double fBase = baseline->second;
+            double fChange = fBase != 0.0 ? (current.second - fBase) / fBase : (current.second != 0.0 ? 1.0 : 0.0);
+            bool bLower = CPerfMetrics::LowerIsBetter(current.first);
+            double fTolerance = CPerfMetrics::IsAllocation(current.first) ? this->fAllocTolerance : this->fTimeTolerance;
+
+            // positive regression means worse in the metric's direction
+            double fRegression = bLower ? fChange : -fChange;
+            const wchar_t* szStatus = L"OK";
+            if (fRegression > fTolerance)
+            {
+                szStatus = L"REGRESSED";
+                bPassed = false;
+            }
+            else if (fRegression < -fTolerance)
+            {
+                szStatus = L"IMPROVED";
+            }
+
+            wprintf(L"%-60s %14.3f %14.3f %+8.1f%% %s\n", szName.c_str(), fBase, current.second, fChange * 100.0, szStatus);
+        }
+
+        for (auto& baseline : m_Baseline.m_Values)
+        {
+            // a benchmark that stopped reporting is treated as a regression
+            if (m_Current.m_Values.count(baseline.first) == 0)
+            {
+                wprintf(L"%-60s %14.3f %14s %9s %s\n", util::string::Convert(baseline.first).c_str(), baseline.second, L"-", L"-", L"MISSING");
+                bPassed = false;
+            }
+        }
+
+        return bPassed;
+    }
+    bool Sample()
+    {
+        // median of repeated runs so one noisy pass neither fails the gate nor lands in the baseline
+        std::map<std::string, std::vector<double>> m_Samples;
+        bool bPassed = true;
+        for (int i = 0; i < (std::max)(1, this->nSamples); i++)
+        {
+            CPerfMetrics sample;
+            if (this->Collect(sample) == false)
+                bPassed = false;
+            for (auto& value : sample.m_Values)
+                m_Samples[value.first].emplace_back(value.second);
+        }
+
+        m_Current.m_Values.clear();
+        for (auto& values : m_Samples)
+            m_Current.m_Values[values.first] = CPerfMetrics::Median(values.second);
+
+        return bPassed;
+    }
+    bool Run()
+    {
+        worker::Win32FileSystem fs;
+        std::wstring szExePath = fs.GetFilePath(fs.GetExeFilePath());
+        std::wstring szTarget = util::string::Convert(CPerfMetrics::Target());
+
+        // exe is built to bin\<configuration>\<platform>, baselines are read from and written to the source tree
+        if (this->szBaseline.empty())
+            this->szBaseline = fs.GetFullPathName_(fs.CombinePath(szExePath, L"..\\..\\..\\baselines\\" + szTarget + L".json"));
+        if (this->szResultsPath.empty())
+            this->szResultsPath = fs.CombinePath(szExePath, L"benchmarks\\results");
+
+        m_Current.szCommit = util::string::Convert(this->szCommit);
+        m_Current.szTarget = CPerfMetrics::Target();
+        bool bReplayPassed = this->Sample();
+
+        // results are keyed by commit so runs can be compared later
+        fs.MakeFullPath(this->szResultsPath);
+        std::wstring szFile = fs.CombinePath(this->szResultsPath, this->szCommit + L".json");
+        if (m_Current.Save(szFile) == false)
+            fwprintf(stderr, L"[Error] Failed to save results: %s\n", szFile.c_str());
+        else
+            wprintf(L"[Info] Results saved: %s\n", szFile.c_str());
+
+        if (bReplayPassed == false)
+        {
+            fwprintf(stderr, L"[Error] Progress replay failed, see the replay table above\n");
+            return false;
+        }
+
+        if (this->bUpdateBaseline == true)
+        {
+            fs.MakeFullPath(fs.GetFilePath(this->szBaseline));
+            if (m_Current.Save(this->szBaseline) == false)
+            {
+                fwprintf(stderr, L"[Error] Failed to save baseline: %s\n", this->szBaseline.c_str());
+                return false;
+            }
+            wprintf(L"[Info] Baseline updated: %s\n", this->szBaseline.c_str());
+            return true;
+        }
+
+        if (m_Baseline.Load(this->szBaseline) == false)
+        {
+            fwprintf(stderr, L"[Error] Failed to load baseline: %s\n", this->szBaseline.c_str());
+            return false;
+        }
+
+        // an empty or foreign baseline would report every metric as new and always pass
+        if (m_Baseline.m_Values.empty() == true)
+        {
+            fwprintf(stderr, L"[Error] Baseline has no metrics, record it with --update-baseline: %s\n", this->szBaseline.c_str());
+            return false;
+        }
+
+        if (m_Baseline.szTarget != m_Current.szTarget)
+        {
+            fwprintf(stderr, L"[Error] Baseline was recorded for %s, current build is %s\n",
+                util::string::Convert(m_Baseline.szTarget).c_str(),
+                util::string::Convert(m_Current.szTarget).c_str());
+            return false;
+        }
+
+        bool bPassed = this->Compare();
+        wprintf(L"\n[%s] %s against baseline %s\n",
+            bPassed ? L"Info" : L"Error",
+            bPassed ? L"No regressions" : L"Regressions found",
+            util::string::Convert(m_Baseline.szCommit).c_str());
+        return bPassed;
+    }
+};
@@ -0,0 +1,369 @@
+﻿// Copyright (c) Wiesław Šoltés. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#pragma once
+
+#include <string>
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <cstdio>
+#include "utilities\MemoryLog.h"
+#include "utilities\String.h"
+#include "utilities\TimeCount.h"
+#include "config\Config.h"
+#include "worker\Worker.h"
+#include "worker\Win32.h"
+#include "BenchmarkContext.h"
+
+class CWavInfo
+{
+public:
+    // returns duration in seconds from the fmt and data chunks, 0 when not a wav file
+    static double Duration(const std::wstring& szFileName)
+    {
+        FILE *fs = nullptr;
+        if (_wfopen_s(&fs, szFileName.c_str(), L"rb") != 0 || fs == nullptr)
+            return 0.0;
+
+        double fDuration = 0.0;
+        unsigned char header[12];
+        if (fread(header, 1, 12, fs) == 12 && memcmp(header, "RIFF", 4) == 0 && memcmp(header + 8, "WAVE", 4) == 0)
+        {
+            unsigned int nByteRate = 0;
+            unsigned char chunk[8];
+            while (fread(chunk, 1, 8, fs) == 8)
+            {
+                unsigned int nSize = chunk[4] | (chunk[5] << 8) | (chunk[6] << 16) | ((unsigned int)chunk[7] << 24);
+                if (memcmp(chunk, "fmt ", 4) == 0 && nSize >= 16)
+                {
+                    unsigned char fmt[16];
+                    if (fread(fmt, 1, 16, fs) != 16)
+                        break;
+                    nByteRate = fmt[8] | (fmt[9] << 8) | (fmt[10] << 16) | ((unsigned int)fmt[11] << 24);
+                    nSize -= 16;
+                }
+                else if (memcmp(chunk, "data", 4) == 0)
+                {
+                    if (nByteRate > 0)
+                        fDuration = (double)nSize / nByteRate;
+                    break;
+                }
+
+                if (_fseeki64(fs, nSize + (nSize & 1), SEEK_CUR) != 0)
+                    break;
+            }
+        }
+
+        fclose(fs);
+        return fDuration;
+    }
+};
+
+class CSweepResult
+{
+public:
+    std::wstring szFormatId;
+    size_t nPreset;
+    std::wstring szPreset;
+    int nFiles = 0;
+    int nErrors = 0;
+    double fSeconds = 0.0;
+    double fDuration = 0.0;
+    double fCpuTime = 0.0;
+    unsigned __int64 nBytesIn = 0;
+    unsigned __int64 nBytesOut = 0;
+    unsigned __int64 nPeakMemory = 0;
+public:
+    double Realtime() const
+    {
+        return this->fSeconds > 0.0 ? this->fDuration / this->fSeconds : 0.0;
+    }
+    double Ratio() const
+    {
+        return this->nBytesOut > 0 ? (double)this->nBytesIn / this->nBytesOut : 0.0;
+    }
+};
+
+class CPresetSweep
+{
+public:
+    std::wstring szCorpus;
+    std::vector<std::wstring> m_FormatIds;
+    std::vector<size_t> m_Presets;
+    int nThreads = 0;
+    std::wstring szOutput;
+    std::wstring szWorkPath;
+public:
+    config::CConfig m_Config;
+    std::vector<CSweepResult> m_Results;
+public:
+    bool Init()
+    {
+        m_Config.FileSystem = std::make_unique<worker::Win32FileSystem>();
+        m_Config.m_Settings.Init(m_Config.FileSystem.get());
+        m_Config.Log = std::make_unique<util::MemoryLog>();
+        m_Config.Log->Open();
+        m_Config.nLangId = -1;
+
+        // real user tools and formats, same as the console program
+        m_Config.LoadTools(m_Config.m_Settings.szToolsPath);
+        m_Config.LoadFormats(m_Config.m_Settings.szFormatsPath);
+
+        for (auto& szFormatId : this->m_FormatIds)
+        {
+            if (config::CFormat::GetFormatById(m_Config.m_Formats, szFormatId) == -1)
+            {
+                fwprintf(stderr, L"[Error] Unknown format: %s\n", szFormatId.c_str());
+                return false;
+            }
+        }
+
+        if (this->szWorkPath.empty())
+        {
+            std::wstring szExePath = m_Config.FileSystem->GetFilePath(m_Config.FileSystem->GetExeFilePath());
+            this->szWorkPath = m_Config.FileSystem->CombinePath(szExePath, L"benchmarks\\sweep");
+        }
+
+        m_Config.m_Options.Defaults();
+        m_Config.m_Options.bTryToDownloadTools = false;
+        m_Config.m_Options.bOverwriteExistingFiles = true;
+        m_Config.m_Options.bDeleteSourceFiles = false;
+        m_Config.m_Options.bStopOnErrors = false;
+        m_Config.m_Options.bTryToFindDecoder = true;
+        m_Config.m_Options.szOutputPath = m_Config.FileSystem->CombinePath(this->szWorkPath, L"$Name$.$Ext$");
+
+        if (this->nThreads < 1)
+            this->nThreads = (int)std::thread::hardware_concurrency();
+        if (this->nThreads < 1)
+            this->nThreads = 1;
+
+        return true;
+    }
+    std::vector<std::wstring> FindCorpus()
+    {
+        std::vector<std::wstring> files;
+        m_Config.FileSystem->FindFiles(this->szCorpus, files, false);
+        std::sort(files.begin(), files.end());
+        return files;
+    }
+    std::vector<size_t> Presets(const config::CFormat& format) const
+    {
+        std::vector<size_t> presets;
+        for (size_t i = 0; i < format.m_Presets.size(); i++)
+        {
+            if (this->m_Presets.empty() || std::find(this->m_Presets.begin(), this->m_Presets.end(), i) != this->m_Presets.end())
+                presets.emplace_back(i);
+        }
+        return presets;
+    }
+    bool Run()
+    {
+        if (this->Init() == false)
+            return false;
+
+        auto files = this->FindCorpus();
+        if (files.empty())
+        {
+            fwprintf(stderr, L"[Error] No corpus files found in %s\n", this->szCorpus.c_str());
+            return false;
+        }
+
+        std::vector<double> durations;
+        for (auto& szFile : files)
+            durations.emplace_back(CWavInfo::Duration(szFile));
+
+        // one item per file, format and preset, all converted in a single batch
+        std::vector<int> m_ResultIndex;
+        std::vector<size_t> m_FileIndex;
+        m_Config.m_Items.clear();
+        for (auto& szFormatId : this->m_FormatIds)
+        {
+            auto& format = m_Config.m_Formats[config::CFormat::GetFormatById(m_Config.m_Formats, szFormatId)];
+            for (size_t nPreset : this->Presets(format))
+            {
+                CSweepResult result;
+                result.szFormatId = szFormatId;
+                result.nPreset = nPreset;
+                result.szPreset = format.m_Presets[nPreset].szName;
+                m_Results.emplace_back(result);
+
+                for (size_t i = 0; i < files.size(); i++)
+                {
+                    config::CItem item;
+                    item.nId = (int)m_Config.m_Items.size();
+                    item.szName = m_Config.FileSystem->GetOnlyFileName(files[i]) + L"." + szFormatId + L".p" + std::to_wstring(nPreset);
+                    item.szExtension = util::string::ToUpper(m_Config.FileSystem->GetFileExtension(files[i]));
+                    item.szFormatId = szFormatId;
+                    item.nPreset = nPreset;
+                    item.bChecked = true;
+
+                    config::CPath path;
+                    path.szPath = files[i];
+                    path.nSize = m_Config.FileSystem->GetFileSize64(files[i]);
+                    item.nSize = path.nSize;
+                    item.m_Paths.emplace_back(path);
+
+                    item.ResetProgress();
+                    m_Config.m_Items.emplace_back(item);
+                    m_ResultIndex.emplace_back((int)m_Results.size() - 1);
+                    m_FileIndex.emplace_back(i);
+                }
+            }
+        }
+
+        if (m_Config.m_Items.empty())
+        {
+            fwprintf(stderr, L"[Error] No presets selected.\n");
+            return false;
+        }
+
+        m_Config.FileSystem->MakeFullPath(this->szWorkPath);
+
+        CBenchmarkWorkerContext ctx;
+        ctx.Init();
+        ctx.nThreadCount = this->nThreads;
+        ctx.pConfig = &m_Config;
+
+        auto pWorker = std::make_unique<worker::CWorker>();
+        pWorker->ConsoleConverter = std::make_unique<worker::CConsoleConverter>();
+        pWorker->PipesConverter = std::make_unique<worker::CPipesConverter>();
+        pWorker->PipesTranscoder = std::make_unique<worker::CPipesTranscoder>();
+        pWorker->Convert(&ctx, m_Config.m_Items);
+
+        for (auto& item : m_Config.m_Items)
+        {
+            auto& result = m_Results[m_ResultIndex[item.nId]];
+            auto& metrics = ctx.m_ItemMetrics[item.nId];
+            result.nFiles++;
+            if (metrics.bSuccess == false)
+            {
+                result.nErrors++;
+                continue;
+            }
+
+            // summed per item so realtime factor is per encoder instance, not per batch
+            result.fSeconds += metrics.fTotalTime / 1000.0;
+            result.fDuration += durations[m_FileIndex[item.nId]];
+            result.fCpuTime += (metrics.fUserTime + metrics.fKernelTime) / 1000.0;
+            result.nBytesIn += item.nSize;
+            result.nBytesOut += this->OutputSize(item, metrics);
+            if (metrics.nPeakMemory > result.nPeakMemory)
+                result.nPeakMemory = metrics.nPeakMemory;
+        }
+
+        this->Print();
+
+        if (this->szOutput.empty() == false)
+        {
+            bool bJson = util::string::TowLower(m_Config.FileSystem->GetFileExtension(this->szOutput)) == L"json";
+            if ((bJson ? this->SaveJson(this->szOutput) : this->SaveCsv(this->szOutput)) == false)
+            {
+                fwprintf(stderr, L"[Error] Failed to save results: %s\n", this->szOutput.c_str());
+                m_Config.Log->Close();
+                return false;
+            }
+        }
+
+        m_Config.Log->Close();
+        return true;
+    }
+    unsigned __int64 OutputSize(const config::CItem& item, const worker::CItemMetrics& metrics)
+    {
+        if (metrics.nBytesOut > 0)
+            return metrics.nBytesOut;
+
+        // pipe outputs do not report size, read it back from the output file
+        int nFormat = config::CFormat::GetFormatById(m_Config.m_Formats, item.szFormatId);
+        worker::COutputPath output;
+        std::wstring szFile = output.CreateFilePath(m_Config.FileSystem.get(), m_Config.m_Options.szOutputPath, item.m_Paths[0].szPath, item.szName, m_Config.m_Formats[nFormat].szOutputExtension);
+        __int64 nSize = m_Config.FileSystem->FileExists(szFile) ? m_Config.FileSystem->GetFileSize64(szFile) : 0;
+        return nSize > 0 ? (unsigned __int64)nSize : 0;
+    }
+    void Print()
+    {
+        wprintf(L"%-16s %6s %-32s %6s %6s %10s %10s %10s %12s %8s %10s\n",
+            L"format", L"preset", L"name", L"files", L"errors", L"seconds", L"cpu", L"xrealtime", L"output MB", L"ratio", L"peak MB");
+
+        for (auto& result : m_Results)
+        {
+            wprintf(L"%-16s %6zu %-32s %6d %6d %10.3f %10.3f %10.1f %12.2f %8.2f %10.1f\n",
+                result.szFormatId.c_str(),
+                result.nPreset,
+                result.szPreset.substr(0, 32).c_str(),
+                result.nFiles,
+                result.nErrors,
+                result.fSeconds,
+                result.fCpuTime,
+                result.Realtime(),
+                result.nBytesOut / (1024.0 * 1024.0),
+                result.Ratio(),
+                result.nPeakMemory / (1024.0 * 1024.0));
+        }
+    }
+    bool SaveCsv(const std::wstring& szFileName)
+    {
+        FILE *fs = nullptr;
+        if (_wfopen_s(&fs, szFileName.c_str(), L"wb") != 0 || fs == nullptr)
+            return false;
+
+        fprintf(fs, "format,preset,name,files,errors,seconds,cpu_seconds,duration,realtime,bytes_in,bytes_out,ratio,peak_memory\n");
+        for (auto& result : m_Results)
+        {
+            std::string szName = util::string::Convert(result.szPreset);
+            std::replace(szName.begin(), szName.end(), '"', '\'');
+            fprintf(fs, "%s,%zu,\"%s\",%d,%d,%.3f,%.3f,%.3f,%.3f,%llu,%llu,%.4f,%llu\n",
+                util::string::Convert(result.szFormatId).c_str(),
+                result.nPreset,
+                szName.c_str(),
+                result.nFiles,
+                result.nErrors,
+                result.fSeconds,
+                result.fCpuTime,
+                result.fDuration,
+                result.Realtime(),
+                result.nBytesIn,
+                result.nBytesOut,
+                result.Ratio(),
+                result.nPeakMemory);
+        }
+
+        fclose(fs);
+        return true;
+    }
+    bool SaveJson(const std::wstring& szFileName)
+    {
+        FILE *fs = nullptr;
+        if (_wfopen_s(&fs, szFileName.c_str(), L"wb") != 0 || fs == nullptr)
+            return false;
+
+        fprintf(fs, "[\n");
+        for (size_t i = 0; i < m_Results.size(); i++)
+        {
+            auto& result = m_Results[i];
+            std::string szName = util::string::Convert(result.szPreset);
+            std::replace(szName.begin(), szName.end(), '"', '\'');
+            std::replace(szName.begin(), szName.end(), '\\', '/');
+            fprintf(fs, "  { \"format\": \"%s\", \"preset\": %zu, \"name\": \"%s\", \"files\": %d, \"errors\": %d, \"seconds\": %.3f, \"cpu_seconds\": %.3f, \"duration\": %.3f, \"realtime\": %.3f, \"bytes_in\": %llu, \"bytes_out\": %llu, \"ratio\": %.4f, \"peak_memory\": %llu }%s\n",
+                util::string::Convert(result.szFormatId).c_str(),
+                result.nPreset,
+                szName.c_str(),
+                result.nFiles,
+                result.nErrors,
+                result.fSeconds,
+                result.fCpuTime,
+                result.fDuration,
+                result.Realtime(),
+                result.nBytesIn,
+                result.nBytesOut,
+                result.Ratio(),
+                result.nPeakMemory,
+                i + 1 < m_Results.size() ? "," : "");
+        }
+        fprintf(fs, "]\n");
+
+        fclose(fs);
+        return true;
+    }
+};
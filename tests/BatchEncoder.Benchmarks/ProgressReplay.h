@@ -0,0 +1,281 @@
+﻿// Copyright (c) Wiesław Šoltés. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#pragma once
+
+#include <string>
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <cstdio>
+#include "utilities\MemoryLog.h"
+#include "utilities\TimeCount.h"
+#include "config\Config.h"
+#include "worker\Win32.h"
+#include "BenchmarkContext.h"
+
+// records every progress value reported by the wrapped lua parser
+class CRecordingParser : public worker::IOutputParser
+{
+public:
+    worker::CLuaOutputParser parser;
+    std::vector<int> m_Progress;
+    size_t nLines = 0;
+public:
+    bool Open(worker::IWorkerContext* ctx, const std::wstring& szFunction)
+    {
+        this->parser.nIndex = this->nIndex;
+        this->parser.nProgress = 0;
+        this->parser.nPreviousProgress = 0;
+        return this->parser.Open(ctx, szFunction);
+    }
+    bool Parse(worker::IWorkerContext* ctx, const char *szLine)
+    {
+        int nPrevious = this->parser.nProgress;
+        bool bResult = this->parser.Parse(ctx, szLine);
+        this->nLines++;
+        if (this->parser.nProgress != nPrevious)
+            this->m_Progress.emplace_back(this->parser.nProgress);
+        this->nProgress = this->parser.nProgress;
+        return bResult;
+    }
+};
+
+class CReplayResult
+{
+public:
+    std::wstring szName;
+    size_t nLines;
+    double fSeconds;
+    int nReplays;
+    int nFinal;
+    bool bMonotonic;
+    bool bHasProgress;
+    bool bNoProgress;
+    bool bReplayed;
+public:
+    bool Passed() const
+    {
+        if (this->bReplayed == false)
+            return false;
+        // only scripts known to have no line progress may report none
+        if (this->bHasProgress == false)
+            return this->bNoProgress;
+        return this->bMonotonic == true && this->nFinal == 100;
+    }
+    const wchar_t* Status() const
+    {
+        if (this->bReplayed == false)
+            return L"FAIL (replay)";
+        if (this->bHasProgress == false)
+            return this->bNoProgress ? L"NO-PROGRESS" : L"FAIL (no progress)";
+        if (this->bMonotonic == false)
+            return L"FAIL (monotonic)";
+        return this->nFinal == 100 ? L"OK" : L"FAIL (final)";
+    }
+};
+
+class CProgressReplay
+{
+public:
+    int nRepeat = 20;
+    std::wstring szFilter;
+public:
+    config::CConfig m_Config;
+    std::wstring szExePath;
+    std::vector<CReplayResult> m_Results;
+public:
+    static bool IsNoProgress(const std::wstring& szName)
+    {
+        // these tools print no usable progress, the worker uses pipe byte counts instead
+        static const wchar_t* szNames[] =
+        {
+            L"GetProgress_FFmpegDec",
+            L"GetProgress_FFmpegEnc",
+            L"GetProgress_NeroAacDec",
+            L"GetProgress_NeroAacEnc",
+            L"GetProgress_TakcDec",
+            L"GetProgress_TakcEnc",
+            L"GetProgress_ReturnAlwaysError",
+            L"GetProgress_ReturnAlwaysSuccess"
+        };
+
+        for (auto szNoProgress : szNames)
+        {
+            if (szName == szNoProgress)
+                return true;
+        }
+        return false;
+    }
+    bool Init()
+    {
+        m_Config.FileSystem = std::make_unique<worker::Win32FileSystem>();
+        m_Config.m_Settings.Init(m_Config.FileSystem.get());
+        m_Config.Log = std::make_unique<util::MemoryLog>();
+        m_Config.Log->Open();
+        m_Config.nLangId = -1;
+        m_Config.m_Options.Defaults();
+
+        config::CItem item;
+        item.nId = 0;
+        item.bChecked = true;
+        item.ResetProgress();
+        m_Config.m_Items.emplace_back(item);
+
+        this->szExePath = m_Config.FileSystem->GetFilePath(m_Config.FileSystem->GetExeFilePath());
+        if (this->nRepeat < 1)
+            this->nRepeat = 1;
+        return true;
+    }
+    static bool ReadFile(const std::wstring& szFileName, std::string& szData)
+    {
+        FILE *fs = nullptr;
+        if (_wfopen_s(&fs, szFileName.c_str(), L"rb") != 0 || fs == nullptr)
+            return false;
+
+        char szBuffer[4096];
+        size_t nRead;
+        while ((nRead = fread(szBuffer, 1, sizeof(szBuffer), fs)) > 0)
+            szData.append(szBuffer, nRead);
+
+        fclose(fs);
+        return true;
+    }
+    bool Replay(const std::wstring& szScript, const std::string& szData, CRecordingParser& parser)
+    {
+        CBenchmarkWorkerContext ctx;
+        ctx.pConfig = &m_Config;
+        ctx.Init();
+
+        parser.nIndex = 0;
+        if (parser.Open(&ctx, szScript) == false)
+            return false;
+
+        worker::Win32Pipe Stderr;
+        if (Stderr.Create() == false)
+            return false;
+
+        // feed transcript as fast as the pipe accepts it
+        std::thread feedThread([&Stderr, &szData]()
+        {
+            const char* pData = szData.data();
+            size_t nRemaining = szData.size();
+            while (nRemaining > 0)
+            {
+                DWORD dwWritten = 0;
+                DWORD dwChunk = nRemaining > 4096 ? 4096 : (DWORD)nRemaining;
+                if (::WriteFile(Stderr.WriteHandle(), pData, dwChunk, &dwWritten, nullptr) == FALSE)
+                    break;
+                pData += dwWritten;
+                nRemaining -= dwWritten;
+            }
+            Stderr.CloseWrite();
+        });
+
+        worker::CPipeToStringWriter writer;
+        writer.nIndex = 0;
+        bool bResult = writer.WriteLoop(&ctx, &Stderr, &parser);
+
+        feedThread.join();
+        Stderr.CloseRead();
+        return bResult;
+    }
+    bool Run(const std::wstring& szName, const std::wstring& szTranscript, CReplayResult& result)
+    {
+        std::string szData;
+        if (ReadFile(szTranscript, szData) == false)
+            return false;
+
+        std::wstring szScript = m_Config.FileSystem->CombinePath(this->szExePath, L"progress\\" + szName + L".lua");
+
+        result.szName = szName;
+        result.nReplays = this->nRepeat;
+        result.bNoProgress = IsNoProgress(szName);
+        result.bReplayed = true;
+
+        // first replay checks accuracy, all replays are timed
+        CRecordingParser first;
+        if (this->Replay(szScript, szData, first) == false)
+            return false;
+
+        result.nLines = first.nLines;
+        result.nFinal = first.m_Progress.empty() ? 0 : first.m_Progress.back();
+        result.bHasProgress = false;
+        result.bMonotonic = true;
+        for (size_t i = 0; i < first.m_Progress.size(); i++)
+        {
+            if (first.m_Progress[i] > 0)
+                result.bHasProgress = true;
+            if (i > 0 && first.m_Progress[i] < first.m_Progress[i - 1])
+                result.bMonotonic = false;
+        }
+
+        util::CTimeCount timer;
+        timer.Start();
+        for (int i = 0; i < this->nRepeat; i++)
+        {
+            CRecordingParser parser;
+            if (this->Replay(szScript, szData, parser) == false)
+                result.bReplayed = false;
+        }
+        timer.Stop();
+        result.fSeconds = timer.ElapsedTime();
+        return true;
+    }
+    bool Run()
+    {
+        if (this->Init() == false)
+            return false;
+
+        std::wstring szPath = m_Config.FileSystem->CombinePath(this->szExePath, L"benchmarks\\transcripts");
+        std::vector<std::wstring> files;
+        if (m_Config.FileSystem->FindFiles(szPath, files, false) == false || files.empty())
+        {
+            fwprintf(stderr, L"[Error] No transcripts found in %s\n", szPath.c_str());
+            return false;
+        }
+
+        std::sort(files.begin(), files.end());
+
+        wprintf(L"%-32s %7s %12s %10s %12s %6s %s\n",
+            L"script", L"lines", L"lines/s", L"us/line", L"ms/item", L"final", L"status");
+
+        bool bPassed = true;
+        for (auto& szFile : files)
+        {
+            if (util::string::TowLower(m_Config.FileSystem->GetFileExtension(szFile)) != L"stderr")
+                continue;
+
+            std::wstring szName = m_Config.FileSystem->GetOnlyFileName(szFile);
+            if (this->szFilter.empty() == false && szName.find(this->szFilter) == std::wstring::npos)
+                continue;
+
+            CReplayResult result;
+            if (this->Run(szName, szFile, result) == false)
+            {
+                wprintf(L"%-32s %7s %12s %10s %12s %6s %s\n", szName.c_str(), L"-", L"-", L"-", L"-", L"-", L"ERROR");
+                bPassed = false;
+                continue;
+            }
+
+            double fLines = (double)result.nLines * result.nReplays;
+
+            wprintf(L"%-32s %7zu %12.0f %10.2f %12.3f %6d %s\n",
+                result.szName.c_str(),
+                result.nLines,
+                result.fSeconds > 0.0 ? fLines / result.fSeconds : 0.0,
+                fLines > 0.0 ? result.fSeconds * 1e6 / fLines : 0.0,
+                result.fSeconds * 1e3 / result.nReplays,
+                result.nFinal,
+                result.Status());
+
+            if (result.Passed() == false)
+                bPassed = false;
+
+            m_Results.emplace_back(result);
+        }
+
+        return bPassed;
+    }
+};
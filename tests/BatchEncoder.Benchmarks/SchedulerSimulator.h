@@ -0,0 +1,775 @@
+﻿// Copyright (c) Wiesław Šoltés. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#pragma once
+
+#include <string>
+#include <memory>
+#include <vector>
+#include <set>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <random>
+#include <cmath>
+#include <cstdio>
+#include "utilities\MemoryLog.h"
+#include "utilities\TimeCount.h"
+#include "config\Config.h"
+#include "worker\Worker.h"
+#include "worker\Win32.h"
+
+// Runs the real CWorker scheduling code against fake processes that advance a virtual clock.
+// Only one worker thread runs at a time, the one with the earliest virtual wake time.
+// The clock advances only when every thread that can still do work is waiting on it,
+// so results depend on the cost model and not on host load.
+
+class CVirtualWaiter
+{
+public:
+    double fBase;
+    double fDuration;
+    int nItemId;
+};
+
+class CVirtualClock
+{
+    std::mutex m_Lock;
+    std::condition_variable m_Wake;
+    std::vector<CVirtualWaiter*> m_Waiters;
+    std::vector<std::pair<double, double>> m_Downloads;
+    double fNow;
+    int nThreads;
+    int nTotal;
+    int nStarted;
+    int nFinished;
+    bool bRunning;
+public:
+    double fBusy;
+    double fStall;
+public:
+    void Reset(int nThreads, int nTotal)
+    {
+        std::lock_guard<std::mutex> lock(this->m_Lock);
+        this->m_Waiters.clear();
+        this->m_Downloads.clear();
+        this->fNow = 0.0;
+        this->nThreads = nThreads;
+        this->nTotal = nTotal;
+        this->nStarted = 0;
+        this->nFinished = 0;
+        this->bRunning = true;
+        this->fBusy = 0.0;
+        this->fStall = 0.0;
+    }
+    double Now()
+    {
+        std::lock_guard<std::mutex> lock(this->m_Lock);
+        return this->fNow;
+    }
+    void Started()
+    {
+        std::lock_guard<std::mutex> lock(this->m_Lock);
+        this->nStarted++;
+        this->m_Wake.notify_all();
+    }
+    void Finished()
+    {
+        std::lock_guard<std::mutex> lock(this->m_Lock);
+        this->nFinished++;
+        this->m_Wake.notify_all();
+    }
+    void Stopped()
+    {
+        std::lock_guard<std::mutex> lock(this->m_Lock);
+        this->bRunning = false;
+        this->m_Wake.notify_all();
+    }
+    void Download(double fDuration)
+    {
+        // downloads hold m_down, so every process start inside the window waits for it
+        std::lock_guard<std::mutex> lock(this->m_Lock);
+        if (this->m_Downloads.empty() == false && this->fNow < this->m_Downloads.back().second)
+            this->m_Downloads.back().second += fDuration;
+        else
+            this->m_Downloads.emplace_back(this->fNow, this->fNow + fDuration);
+        this->fStall += fDuration;
+    }
+    void Advance(int nItemId, double fDuration)
+    {
+        std::unique_lock<std::mutex> lock(this->m_Lock);
+        CVirtualWaiter waiter { this->fNow, fDuration, nItemId };
+        this->m_Waiters.emplace_back(&waiter);
+        this->m_Wake.notify_all();
+        this->m_Wake.wait(lock, [this, &waiter]() { return this->Next() == &waiter; });
+
+        double fStart = this->Start(waiter.fBase);
+        this->fNow = fStart + waiter.fDuration;
+        this->fBusy += this->fNow - waiter.fBase;
+        this->m_Waiters.erase(std::find(this->m_Waiters.begin(), this->m_Waiters.end(), &waiter));
+        this->m_Wake.notify_all();
+    }
+private:
+    int Expected() const
+    {
+        int nRunning = this->nStarted - this->nFinished;
+        if (this->bRunning == false)
+            return nRunning;
+
+        int nIdle = this->nThreads - nRunning;
+        int nQueued = this->nTotal - this->nStarted;
+        return nRunning + (nIdle < nQueued ? nIdle : nQueued);
+    }
+    double Start(double fBase) const
+    {
+        double fStart = fBase;
+        for (auto& window : this->m_Downloads)
+        {
+            if (fStart >= window.first && fStart < window.second)
+                fStart = window.second;
+        }
+        return fStart;
+    }
+    CVirtualWaiter* Next() const
+    {
+        if ((int)this->m_Waiters.size() < this->Expected())
+            return nullptr;
+
+        CVirtualWaiter* pNext = nullptr;
+        double fNext = 0.0;
+        for (auto pWaiter : this->m_Waiters)
+        {
+            double fWake = this->Start(pWaiter->fBase) + pWaiter->fDuration;
+            if (pNext == nullptr || fWake < fNext || (fWake == fNext && pWaiter->nItemId < pNext->nItemId))
+            {
+                pNext = pWaiter;
+                fNext = fWake;
+            }
+        }
+        return pNext;
+    }
+};
+
+class CSimFormat
+{
+public:
+    std::wstring szId;
+    double fWeight;
+    double fRate;
+    double fSpawn;
+};
+
+class CSimItem
+{
+public:
+    unsigned __int64 nSize;
+    double fCost;
+    bool bFail;
+};
+
+class CSimModel
+{
+public:
+    CVirtualClock m_Clock;
+    std::vector<CSimItem> m_Items;
+    std::set<std::wstring> m_Missing;
+    std::mutex m_MissingLock;
+    double fDownloadStall = 0.0;
+};
+
+class CSimFileSystem : public worker::Win32FileSystem
+{
+public:
+    CSimModel* model;
+public:
+    bool FileExists(const std::wstring& szPath)
+    {
+        return true;
+    }
+    bool PathFileExists_(const std::wstring& szFilePath)
+    {
+        return true;
+    }
+    __int64 GetFileSize64(const std::wstring& szFileName)
+    {
+        return 0;
+    }
+    void DeleteFile_(const std::wstring& szFilePath)
+    {
+    }
+    bool CreateDirectory_(const std::wstring& szPath)
+    {
+        return true;
+    }
+    bool DirectoryExists(const std::wstring& szPath)
+    {
+        return true;
+    }
+    bool MakeFullPath(const std::wstring& szTargetPath)
+    {
+        return true;
+    }
+    void SetCurrentDirectory_(const std::wstring& szPath)
+    {
+    }
+};
+
+class CSimDownloader : public worker::IDownloader
+{
+public:
+    CSimModel* model;
+public:
+    bool Download(worker::IWorkerContext* ctx, config::CFormat& format, int nItemId)
+    {
+        std::lock_guard<std::mutex> lock(this->model->m_MissingLock);
+        if (this->model->m_Missing.erase(format.szPath) > 0)
+            this->model->m_Clock.Download(this->model->fDownloadStall);
+        return true;
+    }
+};
+
+class CSimProcess : public worker::IProcess
+{
+public:
+    CSimModel* model;
+    int nExitCode = 0;
+public:
+    void ConnectStdInput(void* hPipeStdin)
+    {
+    }
+    void ConnectStdOutput(void* hPipeStdout)
+    {
+    }
+    void ConnectStdError(void* hPipeStderr)
+    {
+    }
+    bool Start(const std::wstring& szCommandLine, bool bNoWindow)
+    {
+        std::lock_guard<std::mutex> lock(this->model->m_MissingLock);
+        for (auto& szPath : this->model->m_Missing)
+        {
+            if (szCommandLine.compare(0, szPath.length(), szPath) == 0)
+                return false;
+        }
+        return true;
+    }
+    bool Wait()
+    {
+        return true;
+    }
+    bool Wait(int milliseconds)
+    {
+        return true;
+    }
+    bool Terminate(int code = 0)
+    {
+        return true;
+    }
+    bool Close()
+    {
+        return true;
+    }
+    bool Stop(bool bWait, int nExitCodeSucess)
+    {
+        this->nExitCode = bWait == true ? nExitCodeSucess : nExitCodeSucess + 1;
+        return bWait;
+    }
+    int ExitCode()
+    {
+        return this->nExitCode;
+    }
+    worker::CProcessUsage Usage()
+    {
+        return worker::CProcessUsage();
+    }
+    bool SetAffinity(unsigned __int64 nMask)
+    {
+        return true;
+    }
+    bool SetLimits(const worker::CProcessLimits& limits)
+    {
+        return true;
+    }
+    unsigned __int64 IoBytes()
+    {
+        return 0;
+    }
+    bool Suspend()
+    {
+        return true;
+    }
+    bool Resume()
+    {
+        return true;
+    }
+public:
+    void* StdinHandle()
+    {
+        return nullptr;
+    }
+    void* StdoutHandle()
+    {
+        return nullptr;
+    }
+    void* StderrHandle()
+    {
+        return nullptr;
+    }
+};
+
+class CSimPipe : public worker::IPipe
+{
+public:
+    bool Create()
+    {
+        return true;
+    }
+    void CloseRead()
+    {
+    }
+    void CloseWrite()
+    {
+    }
+    bool InheritRead()
+    {
+        return true;
+    }
+    bool InheritWrite()
+    {
+        return true;
+    }
+    bool DuplicateRead()
+    {
+        return true;
+    }
+    bool DuplicateWrite()
+    {
+        return true;
+    }
+    void* ReadHandle()
+    {
+        return nullptr;
+    }
+    void* WriteHandle()
+    {
+        return nullptr;
+    }
+};
+
+class CSimFileReader : public worker::IFileReader
+{
+public:
+    bool ReadLoop(worker::IWorkerContext* ctx, worker::IPipe* Stdin)
+    {
+        this->bError = true;
+        this->bFinished = true;
+        return false;
+    }
+};
+
+class CSimFileWriter : public worker::IFileWriter
+{
+public:
+    bool WriteLoop(worker::IWorkerContext* ctx, worker::IPipe* Stdout)
+    {
+        this->bError = true;
+        this->bFinished = true;
+        return false;
+    }
+};
+
+class CSimOutputParser : public worker::IOutputParser
+{
+public:
+    bool Open(worker::IWorkerContext* ctx, const std::wstring& szFunction)
+    {
+        return true;
+    }
+    bool Parse(worker::IWorkerContext* ctx, const char *szLine)
+    {
+        return true;
+    }
+};
+
+class CSimStringWriter : public worker::IStringWriter
+{
+public:
+    CSimModel* model;
+public:
+    bool WriteLoop(worker::IWorkerContext* ctx, worker::IPipe* Stderr, worker::IOutputParser* parser)
+    {
+        // the tool runs while its output is read, failing tools stop half way
+        auto& item = this->model->m_Items[this->nIndex];
+        this->model->m_Clock.Advance(this->nIndex, item.bFail ? item.fCost / 2.0 : item.fCost);
+
+        if (parser != nullptr)
+            parser->nProgress = item.bFail ? 50 : 100;
+
+        this->bError = false;
+        this->bFinished = true;
+        return true;
+    }
+    bool DrainLoop(worker::IPipe* Stderr)
+    {
+        // simulated tools write nothing to captured stderr
+        this->bError = false;
+        this->bFinished = true;
+        return true;
+    }
+};
+
+class CSimWorkerFactory : public worker::IWorkerFactory
+{
+public:
+    CSimModel* model;
+public:
+    std::shared_ptr<worker::IDownloader> CreateDownloaderPtr()
+    {
+        auto downloader = std::make_shared<CSimDownloader>();
+        downloader->model = this->model;
+        return downloader;
+    }
+    std::shared_ptr<worker::IProcess> CreateProcessPtr()
+    {
+        auto process = std::make_shared<CSimProcess>();
+        process->model = this->model;
+        return process;
+    }
+    std::shared_ptr<worker::IPipe> CreatePipePtr()
+    {
+        return std::make_shared<CSimPipe>();
+    }
+    std::shared_ptr<worker::IFileReader> CreateFileReaderPtr()
+    {
+        return std::make_shared<CSimFileReader>();
+    }
+    std::shared_ptr<worker::IFileWriter> CreateFileWriterPtr()
+    {
+        return std::make_shared<CSimFileWriter>();
+    }
+    std::shared_ptr<worker::IOutputParser> CreateOutputParserPtr()
+    {
+        return std::make_shared<CSimOutputParser>();
+    }
+    std::shared_ptr<worker::IStringWriter> CreateStringWriterPtr()
+    {
+        auto writer = std::make_shared<CSimStringWriter>();
+        writer->model = this->model;
+        return writer;
+    }
+    std::shared_ptr<worker::IMemoryStatus> CreateMemoryStatusPtr()
+    {
+        // simulated tools do not use host memory
+        return nullptr;
+    }
+    std::shared_ptr<worker::ISystemLoad> CreateSystemLoadPtr()
+    {
+        return nullptr;
+    }
+    std::shared_ptr<worker::IProcessorTopology> CreateProcessorTopologyPtr()
+    {
+        return nullptr;
+    }
+};
+
+class CSimWorkerContext : public worker::IWorkerContext
+{
+    std::vector<char> m_Started;
+public:
+    CSimModel* model;
+public:
+    CSimWorkerContext(CSimModel* model) : model(model)
+    {
+        this->bDone = true;
+        this->bRunning = false;
+        this->pConfig = nullptr;
+        auto factory = std::make_shared<CSimWorkerFactory>();
+        factory->model = model;
+        this->pFactory = factory;
+    }
+    virtual ~CSimWorkerContext()
+    {
+    }
+public:
+    std::wstring GetString(int nKey)
+    {
+        return this->pConfig->GetString(nKey);
+    }
+    void Init()
+    {
+        this->bRunning = true;
+        this->bDone = false;
+        this->nTotalFiles = 0;
+        this->nProcessedFiles = 0;
+        this->nErrors = 0;
+        this->nLastItemId = -1;
+        this->nRunningFiles = 0;
+        this->nActiveProcesses = 0;
+        this->bPaused = false;
+        this->m_Started.assign(this->model->m_Items.size(), 0);
+        this->model->m_Clock.Reset(this->nThreadCount, (int)this->model->m_Items.size());
+    }
+    void Start()
+    {
+    }
+    void Stop()
+    {
+        this->bRunning = false;
+    }
+    bool ItemProgress(int nItemId, int nProgress, bool bFinished, bool bError = false)
+    {
+        if (bError == true && this->StopOnError(nItemId) == true)
+        {
+            this->bRunning = false;
+            this->model->m_Clock.Stopped();
+        }
+        return this->bRunning;
+    }
+    void ItemStatus(int nItemId, const std::wstring& szTime, const std::wstring& szStatus)
+    {
+    }
+    void TotalProgress(int nItemId)
+    {
+        // called once before and once after each item on the worker thread
+        if (this->m_Started[nItemId] == 0)
+        {
+            this->m_Started[nItemId] = 1;
+            this->model->m_Clock.Started();
+        }
+        else
+        {
+            this->model->m_Clock.Finished();
+        }
+
+        if (nItemId > this->nLastItemId)
+            this->nLastItemId = nItemId;
+    }
+};
+
+class CSimResult
+{
+public:
+    std::wstring szPolicy;
+    int nThreads;
+    int nItems;
+    int nErrors;
+    double fMakespan;
+    double fUtilization;
+    double fStall;
+    double fWallTime;
+};
+
+class CSchedulerSimulator
+{
+public:
+    int nItems = 100000;
+    int nMaxThreads = 16;
+    int nCores = 0;
+    unsigned int nSeed = 1;
+    double fFailureRate = 0.0;
+    double fDownloadStall = 0.0;
+    bool bStopOnErrors = false;
+    std::wstring szPolicy;
+public:
+    config::CConfig m_Config;
+    CSimModel m_Model;
+    std::vector<CSimResult> m_Results;
+public:
+    static std::vector<CSimFormat> Formats()
+    {
+        return
+        {
+            { L"SIM_MP3", 0.5, 25.0, 0.040 },
+            { L"SIM_FLAC", 0.3, 70.0, 0.030 },
+            { L"SIM_AAC", 0.2, 15.0, 0.050 }
+        };
+    }
+    static std::vector<std::wstring> Policies()
+    {
+        return { L"list", L"largest", L"smallest" };
+    }
+public:
+    void Init()
+    {
+        auto fs = std::make_unique<CSimFileSystem>();
+        fs->model = &this->m_Model;
+        m_Config.FileSystem = std::move(fs);
+        m_Config.Log = std::make_unique<util::MemoryLog>();
+        m_Config.nLangId = -1;
+
+        m_Config.m_Options.Defaults();
+        m_Config.m_Options.nThreadCount = 0;
+        m_Config.m_Options.bTryToDownloadTools = this->fDownloadStall > 0.0;
+        m_Config.m_Options.bOverwriteExistingFiles = true;
+        m_Config.m_Options.bDeleteSourceFiles = false;
+        m_Config.m_Options.bStopOnErrors = this->bStopOnErrors;
+        m_Config.m_Options.nRetryCount = 0;
+        m_Config.m_Options.szOutputPath = L"sim\\out\\$Name$.$Ext$";
+
+        m_Config.m_Formats.clear();
+        for (auto& sf : Formats())
+        {
+            config::CFormat format;
+            format.szId = sf.szId;
+            format.szName = sf.szId;
+            format.nType = config::FormatType::Encoder;
+            format.nPriority = 1;
+            format.szInputExtensions = L"WAV";
+            format.szOutputExtension = sf.szId.substr(4);
+            format.szTemplate = L"$EXE $OPTIONS $INFILE $OUTFILE";
+            format.bPipeInput = false;
+            format.bPipeOutput = false;
+            format.szFunction = L"";
+            format.szPath = L"sim\\" + sf.szId + L".exe";
+            format.nExitCodeSuccess = 0;
+            format.nDefaultPreset = 0;
+            format.m_Presets.emplace_back(config::CPreset{ L"Default", L"" });
+            m_Config.m_Formats.emplace_back(format);
+        }
+
+        if (this->nMaxThreads < 1)
+            this->nMaxThreads = 1;
+        if (this->nCores < 1)
+            this->nCores = (int)std::thread::hardware_concurrency();
+        if (this->nCores < 1)
+            this->nCores = 1;
+    }
+    void CreateItems(const std::wstring& szPolicy, int nThreads)
+    {
+        // same seed gives same batch for every policy and thread count
+        std::mt19937 rng(this->nSeed);
+        auto uniform = [&rng]() { return (double)(rng() >> 8) / (double)(1u << 24); };
+
+        auto formats = Formats();
+        const double fMegabyte = 1024.0 * 1024.0;
+
+        // oversubscribed cores slow every job down evenly
+        double fSlowdown = nThreads > this->nCores ? (double)nThreads / this->nCores : 1.0;
+
+        std::vector<std::pair<config::CItem, CSimItem>> items;
+        items.reserve(this->nItems);
+        for (int i = 0; i < this->nItems; i++)
+        {
+            // mostly tracks between 2 and 80 MB, a few long mixes up to 800 MB
+            double fSize = uniform() < 0.05 ? 200.0 * std::pow(4.0, uniform()) : 2.0 * std::pow(40.0, uniform());
+
+            double fPick = uniform();
+            size_t nFormat = 0;
+            while (nFormat + 1 < formats.size() && fPick >= formats[nFormat].fWeight)
+            {
+                fPick -= formats[nFormat].fWeight;
+                nFormat++;
+            }
+
+            CSimItem si;
+            si.nSize = (unsigned __int64)(fSize * fMegabyte);
+            si.fCost = formats[nFormat].fSpawn + fSlowdown * fSize / formats[nFormat].fRate;
+            si.bFail = uniform() < this->fFailureRate;
+
+            config::CItem item;
+            item.szName = L"item" + std::to_wstring(i);
+            item.szExtension = L"WAV";
+            item.szFormatId = formats[nFormat].szId;
+            item.nPreset = 0;
+            item.szOptions = L"";
+            item.bChecked = true;
+            item.nSize = si.nSize;
+            item.m_Paths.emplace_back(config::CPath{ L"sim\\in\\" + item.szName + L".wav", si.nSize });
+            item.ResetProgress();
+
+            items.emplace_back(item, si);
+        }
+
+        if (szPolicy == L"largest")
+        {
+            std::stable_sort(items.begin(), items.end(),
+                [](const std::pair<config::CItem, CSimItem>& a, const std::pair<config::CItem, CSimItem>& b) { return a.second.fCost > b.second.fCost; });
+        }
+        else if (szPolicy == L"smallest")
+        {
+            std::stable_sort(items.begin(), items.end(),
+                [](const std::pair<config::CItem, CSimItem>& a, const std::pair<config::CItem, CSimItem>& b) { return a.second.fCost < b.second.fCost; });
+        }
+
+        m_Config.m_Items.clear();
+        m_Model.m_Items.clear();
+        for (auto& item : items)
+        {
+            m_Config.m_Items.emplace_back(std::move(item.first));
+            m_Model.m_Items.emplace_back(item.second);
+        }
+        config::CItem::SetIds(m_Config.m_Items);
+
+        m_Model.fDownloadStall = this->fDownloadStall;
+        m_Model.m_Missing.clear();
+        if (this->fDownloadStall > 0.0)
+        {
+            for (auto& format : m_Config.m_Formats)
+                m_Model.m_Missing.insert(format.szPath);
+        }
+    }
+    CSimResult Run(const std::wstring& szPolicy, int nThreads)
+    {
+        this->CreateItems(szPolicy, nThreads);
+
+        CSimWorkerContext ctx(&this->m_Model);
+        ctx.nThreadCount = nThreads;
+        ctx.pConfig = &m_Config;
+        ctx.Init();
+
+        auto pWorker = std::make_unique<worker::CWorker>();
+        pWorker->ConsoleConverter = std::make_unique<worker::CConsoleConverter>();
+        pWorker->PipesConverter = std::make_unique<worker::CPipesConverter>();
+        pWorker->PipesTranscoder = std::make_unique<worker::CPipesTranscoder>();
+
+        util::CTimeCount timer;
+        timer.Start();
+        pWorker->Convert(&ctx, m_Config.m_Items);
+        timer.Stop();
+
+        CSimResult result;
+        result.szPolicy = szPolicy;
+        result.nThreads = nThreads;
+        result.nItems = ctx.nProcessedFiles;
+        result.nErrors = ctx.nErrors;
+        result.fMakespan = m_Model.m_Clock.Now();
+        result.fUtilization = result.fMakespan > 0.0 ? m_Model.m_Clock.fBusy / (nThreads * result.fMakespan) : 0.0;
+        result.fStall = m_Model.m_Clock.fStall;
+        result.fWallTime = timer.ElapsedTime();
+        return result;
+    }
+    std::vector<int> ThreadCounts() const
+    {
+        std::vector<int> counts;
+        for (int n = 1; n < this->nMaxThreads; n *= 2)
+            counts.emplace_back(n);
+        counts.emplace_back(this->nMaxThreads);
+        return counts;
+    }
+    bool Run()
+    {
+        this->Init();
+
+        wprintf(L"%-9s %7s %7s %6s %12s %11s %9s %9s\n",
+            L"policy", L"threads", L"items", L"errors", L"makespan(s)", L"utilization", L"stall(s)", L"wall(s)");
+
+        for (auto& szPolicy : Policies())
+        {
+            if (this->szPolicy.empty() == false && this->szPolicy != szPolicy)
+                continue;
+
+            for (int nThreads : this->ThreadCounts())
+            {
+                CSimResult result = this->Run(szPolicy, nThreads);
+
+                wprintf(L"%-9s %7d %7d %6d %12.1f %10.1f%% %9.1f %9.3f\n",
+                    result.szPolicy.c_str(), result.nThreads, result.nItems, result.nErrors,
+                    result.fMakespan, result.fUtilization * 100.0, result.fStall, result.fWallTime);
+
+                m_Results.emplace_back(result);
+            }
+        }
+
+        return true;
+    }
+};
@@ -0,0 +1,327 @@
+﻿// Copyright (c) Wiesław Šoltés. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#pragma once
+
+#include <string>
+#include <memory>
+#include <vector>
+#include <cstdio>
+#include "utilities\Log.h"
+#include "utilities\MemoryLog.h"
+#include "utilities\ConsoleLog.h"
+#include "utilities\TimeCount.h"
+#include "config\Config.h"
+#include "worker\Worker.h"
+#include "worker\Win32.h"
+#include "BenchmarkContext.h"
+
+class CThroughputMode
+{
+public:
+    std::wstring szName;
+    std::wstring szFormatId;
+    std::wstring szInputExtension;
+};
+
+// pipe outputs are drained in-process and never reach storage
+class CNullSinkWorkerFactory : public worker::Win32WorkerFactory
+{
+public:
+    std::shared_ptr<worker::IFileWriter> CreateFileWriterPtr()
+    {
+        return std::make_shared<worker::CPipeToNullWriter>();
+    }
+};
+
+// file outputs are deleted as soon as each item is done
+class CNullSinkWorkerContext : public CBenchmarkWorkerContext
+{
+public:
+    std::vector<std::wstring> m_OutputFiles;
+public:
+    CNullSinkWorkerContext()
+    {
+        this->pFactory = std::make_shared<CNullSinkWorkerFactory>();
+    }
+public:
+    void TotalProgress(int nItemId)
+    {
+        // called on the converting thread before and after each item
+        auto& szOutputFile = this->m_OutputFiles[nItemId];
+        if (this->pConfig->FileSystem->FileExists(szOutputFile) == true)
+            this->pConfig->FileSystem->DeleteFile_(szOutputFile);
+        CBenchmarkWorkerContext::TotalProgress(nItemId);
+    }
+};
+
+class CThroughputResult
+{
+public:
+    std::wstring szMode;
+    int nThreads;
+    int nItems;
+    int nErrors;
+    double fSeconds;
+    double fMegabytes;
+public:
+    double ItemsPerSecond() const
+    {
+        return this->fSeconds > 0.0 ? this->nItems / this->fSeconds : 0.0;
+    }
+    double MegabytesPerSecond() const
+    {
+        return this->fSeconds > 0.0 ? this->fMegabytes / this->fSeconds : 0.0;
+    }
+};
+
+class CThroughputBenchmark
+{
+public:
+    int nItems = 16;
+    int nSize = 16;
+    int nMaxThreads = 0;
+    size_t nPreset = 0;
+    std::wstring szMode;
+    std::wstring szWorkPath;
+    std::wstring szScratchPath;
+    bool bNullSink = false;
+    bool bVerbose = false;
+public:
+    config::CConfig m_Config;
+    std::vector<CThroughputResult> m_Results;
+public:
+    static std::vector<CThroughputMode> Modes()
+    {
+        return
+        {
+            { L"console", L"FAKE_CONSOLE", L"wav" },
+            { L"pipes", L"FAKE_PIPES", L"wav" },
+            { L"transcode", L"FAKE_PIPES", L"raw" }
+        };
+    }
+public:
+    bool Init()
+    {
+        m_Config.FileSystem = std::make_unique<worker::Win32FileSystem>();
+        m_Config.m_Settings.Init(m_Config.FileSystem.get());
+
+        if (this->bVerbose == true)
+            m_Config.Log = std::make_unique<util::ConsoleLog>();
+        else
+            m_Config.Log = std::make_unique<util::MemoryLog>();
+        m_Config.Log->Open();
+
+        std::wstring szExePath = m_Config.FileSystem->GetFilePath(m_Config.FileSystem->GetExeFilePath());
+
+        m_Config.nLangId = -1;
+        m_Config.LoadFormats(m_Config.FileSystem->CombinePath(szExePath, L"benchmarks\\formats"));
+        if (m_Config.m_Formats.empty())
+        {
+            fwprintf(stderr, L"[Error] No benchmark formats found.\n");
+            return false;
+        }
+
+        // benchmark formats always use fake encoder from exe directory
+        std::wstring szTool = m_Config.FileSystem->CombinePath(szExePath, L"BatchEncoder.FakeEncoder.exe");
+        if (m_Config.FileSystem->FileExists(szTool) == false)
+        {
+            fwprintf(stderr, L"[Error] Missing fake encoder: %s\n", szTool.c_str());
+            return false;
+        }
+
+        for (auto& format : m_Config.m_Formats)
+            format.szPath = szTool;
+
+        if (this->szWorkPath.empty())
+            this->szWorkPath = m_Config.FileSystem->CombinePath(szExePath, L"benchmarks\\work");
+
+        m_Config.m_Options.Defaults();
+        m_Config.m_Options.bTryToDownloadTools = false;
+        m_Config.m_Options.bOverwriteExistingFiles = true;
+        m_Config.m_Options.bDeleteSourceFiles = false;
+        m_Config.m_Options.bStopOnErrors = false;
+        m_Config.m_Options.bTryToFindDecoder = true;
+        m_Config.m_Options.szOutputPath = m_Config.FileSystem->CombinePath(this->szWorkPath, L"out\\$Name$.$Ext$");
+
+        if (this->bNullSink == true)
+        {
+            // point scratch at a ram disk to take storage out of the measurement
+            if (this->szScratchPath.empty())
+                this->szScratchPath = m_Config.FileSystem->CombinePath(this->szWorkPath, L"scratch");
+            m_Config.m_Options.szOutputPath = m_Config.FileSystem->CombinePath(this->szScratchPath, L"$Name$.$Ext$");
+        }
+
+        if (this->nMaxThreads < 1)
+            this->nMaxThreads = (int)std::thread::hardware_concurrency();
+        if (this->nMaxThreads < 1)
+            this->nMaxThreads = 1;
+
+        return true;
+    }
+    bool CreateInputs(const std::wstring& szExtension)
+    {
+        std::wstring szInputPath = m_Config.FileSystem->CombinePath(this->szWorkPath, L"in");
+        m_Config.FileSystem->MakeFullPath(szInputPath);
+        m_Config.FileSystem->MakeFullPath(m_Config.FileSystem->CombinePath(this->szWorkPath, L"out"));
+
+        std::vector<char> buffer(1024 * 1024);
+        for (size_t i = 0; i < buffer.size(); i++)
+            buffer[i] = (char)(i * 31);
+
+        for (int i = 0; i < this->nItems; i++)
+        {
+            std::wstring szFile = this->InputFile(i, szExtension);
+            unsigned __int64 nExpected = (unsigned __int64)this->nSize * buffer.size();
+            if (m_Config.FileSystem->FileExists(szFile) == true && (unsigned __int64)m_Config.FileSystem->GetFileSize64(szFile) == nExpected)
+                continue;
+
+            FILE *fs = nullptr;
+            if (_wfopen_s(&fs, szFile.c_str(), L"wb") != 0 || fs == nullptr)
+            {
+                fwprintf(stderr, L"[Error] Failed to create input: %s\n", szFile.c_str());
+                return false;
+            }
+
+            for (int n = 0; n < this->nSize; n++)
+                fwrite(buffer.data(), 1, buffer.size(), fs);
+
+            fclose(fs);
+        }
+
+        return true;
+    }
+    std::wstring InputFile(int nIndex, const std::wstring& szExtension)
+    {
+        wchar_t szName[32];
+        _snwprintf_s(szName, _countof(szName), _TRUNCATE, L"item%05d.%s", nIndex, szExtension.c_str());
+        return m_Config.FileSystem->CombinePath(m_Config.FileSystem->CombinePath(this->szWorkPath, L"in"), szName);
+    }
+    void CreateItems(const CThroughputMode& mode)
+    {
+        m_Config.m_Items.clear();
+        for (int i = 0; i < this->nItems; i++)
+        {
+            config::CItem item;
+            item.nId = i;
+            item.szName = m_Config.FileSystem->GetOnlyFileName(this->InputFile(i, mode.szInputExtension));
+            item.szExtension = mode.szInputExtension;
+            item.szFormatId = mode.szFormatId;
+            item.nPreset = this->nPreset;
+            item.bChecked = true;
+
+            config::CPath path;
+            path.szPath = this->InputFile(i, mode.szInputExtension);
+            path.nSize = m_Config.FileSystem->GetFileSize64(path.szPath);
+            item.nSize = path.nSize;
+            item.m_Paths.emplace_back(path);
+
+            item.ResetProgress();
+            m_Config.m_Items.emplace_back(item);
+        }
+    }
+    CThroughputResult Run(const CThroughputMode& mode, int nThreads)
+    {
+        this->CreateItems(mode);
+
+        std::unique_ptr<CBenchmarkWorkerContext> pContext;
+        if (this->bNullSink == true)
+        {
+            auto pNullContext = std::make_unique<CNullSinkWorkerContext>();
+            pNullContext->m_OutputFiles = this->OutputFiles(mode);
+            m_Config.FileSystem->MakeFullPath(this->szScratchPath);
+            pContext = std::move(pNullContext);
+        }
+        else
+        {
+            pContext = std::make_unique<CBenchmarkWorkerContext>();
+        }
+
+        auto& ctx = *pContext;
+        ctx.Init();
+        ctx.nThreadCount = nThreads;
+        ctx.pConfig = &m_Config;
+
+        auto pWorker = std::make_unique<worker::CWorker>();
+        pWorker->ConsoleConverter = std::make_unique<worker::CConsoleConverter>();
+        pWorker->PipesConverter = std::make_unique<worker::CPipesConverter>();
+        pWorker->PipesTranscoder = std::make_unique<worker::CPipesTranscoder>();
+
+        util::CTimeCount timer;
+        timer.Start();
+        pWorker->Convert(&ctx, m_Config.m_Items);
+        timer.Stop();
+
+        if (this->bNullSink == true)
+            ::RemoveDirectoryW(this->szScratchPath.c_str());
+
+        CThroughputResult result;
+        result.szMode = mode.szName;
+        result.nThreads = nThreads;
+        result.nItems = ctx.nProcessedFiles;
+        result.nErrors = ctx.nErrors;
+        result.fSeconds = timer.ElapsedTime();
+        result.fMegabytes = (double)this->nItems * this->nSize;
+        return result;
+    }
+    std::vector<std::wstring> OutputFiles(const CThroughputMode& mode)
+    {
+        std::vector<std::wstring> files;
+        int nFormat = config::CFormat::GetFormatById(m_Config.m_Formats, mode.szFormatId);
+        for (auto& item : m_Config.m_Items)
+        {
+            worker::COutputPath output;
+            files.emplace_back(output.CreateFilePath(m_Config.FileSystem.get(), m_Config.m_Options.szOutputPath, item.m_Paths[0].szPath, item.szName, m_Config.m_Formats[nFormat].szOutputExtension));
+        }
+        return files;
+    }
+    std::vector<int> ThreadCounts() const
+    {
+        // 1, 2, 4, ... up to and including nMaxThreads
+        std::vector<int> counts;
+        for (int n = 1; n < this->nMaxThreads; n *= 2)
+            counts.emplace_back(n);
+        counts.emplace_back(this->nMaxThreads);
+        return counts;
+    }
+    bool Run()
+    {
+        if (this->Init() == false)
+            return false;
+
+        if (this->bNullSink == true)
+            wprintf(L"[Info] Null sink: pipe outputs discarded, file outputs deleted from %s\n\n", this->szScratchPath.c_str());
+
+        wprintf(L"%-10s %7s %6s %6s %9s %9s %9s %8s %10s\n",
+            L"mode", L"threads", L"items", L"errors", L"seconds", L"items/s", L"MB/s", L"speedup", L"efficiency");
+
+        for (auto& mode : Modes())
+        {
+            if (this->szMode.empty() == false && this->szMode != mode.szName)
+                continue;
+
+            if (this->CreateInputs(mode.szInputExtension) == false)
+                return false;
+
+            double fBaseline = 0.0;
+            for (int nThreads : this->ThreadCounts())
+            {
+                CThroughputResult result = this->Run(mode, nThreads);
+                if (nThreads == 1)
+                    fBaseline = result.fSeconds;
+
+                double fSpeedup = result.fSeconds > 0.0 ? fBaseline / result.fSeconds : 0.0;
+                double fEfficiency = fSpeedup / nThreads;
+
+                wprintf(L"%-10s %7d %6d %6d %9.3f %9.2f %9.2f %8.2f %9.1f%%\n",
+                    result.szMode.c_str(), result.nThreads, result.nItems, result.nErrors, result.fSeconds,
+                    result.ItemsPerSecond(), result.MegabytesPerSecond(), fSpeedup, fEfficiency * 100.0);
+
+                m_Results.emplace_back(result);
+            }
+        }
+
+        m_Config.Log->Close();
+        return true;
+    }
+};
@@ -0,0 +1,39 @@
+﻿// Copyright (c) Wiesław Šoltés. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#pragma once
+
+#include <string>
+#include <utility>
+#include <memory>
+#include <array>
+#include <vector>
+#include <thread>
+#include <algorithm>
+
+#include "utilities\FileSystem.h"
+#include "utilities\Log.h"
+#include "utilities\MemoryLog.h"
+#include "utilities\ConsoleLog.h"
+#include "utilities\String.h"
+#include "utilities\TimeCount.h"
+#include "utilities\Utf8String.h"
+#include "utilities\Utilities.h"
+
+#include "config\Config.h"
+
+#include "worker\WorkerContext.h"
+#include "worker\OutputPath.h"
+#include "worker\ToolDownloader.h"
+#include "worker\Worker.h"
+#include "worker\Win32.h"
+
+#include "BenchmarkContext.h"
+#include "ThroughputBenchmark.h"
+#include "SchedulerSimulator.h"
+#include "MicroBenchmark.h"
+#include "CoreBenchmarks.h"
+#include "ProgressReplay.h"
+#include "PerfGate.h"
+#include "AllocationBudget.h"
+#include "PresetSweep.h"
@@ -0,0 +1,362 @@
+﻿// Copyright (c) Wiesław Šoltés. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#define WIN32_LEAN_AND_MEAN
+#include <SDKDDKVer.h>
+#include <Windows.h>
+#include <new>
+#include <cstdlib>
+#include "benchmarks.h"
+
+void* operator new(size_t nSize)
+{
+    CAllocationCounter::Add(nSize);
+    void* p = malloc(nSize > 0 ? nSize : 1);
+    if (p == nullptr)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+// Usage: BatchEncoder.Benchmarks.exe [throughput] [options]
+//   --items <n>        number of generated input files (default: 16)
+//   --size <MB>        size of each input file (default: 16)
+//   --threads <n>      maximum thread count, 0 is hardware concurrency (default: 0)
+//   --mode <name>      console, pipes or transcode, empty runs all (default: all)
+//   --preset <n>       fake encoder preset index (default: 0)
+//   --work <path>      directory for generated inputs and outputs
+//   --null-sink        discard pipe outputs and delete file outputs after each item
+//   --scratch <path>   directory for null sink file outputs, e.g. a ram disk
+//   --verbose          log worker output to console
+//
+// Usage: BatchEncoder.Benchmarks.exe simulate [options]
+//   --items <n>        number of simulated items (default: 100000)
+//   --threads <n>      maximum thread count (default: 16)
+//   --cores <n>        simulated cores, 0 is hardware concurrency (default: 0)
+//   --policy <name>    list, largest or smallest, empty runs all (default: all)
+//   --fail <rate>      fraction of items whose tool fails (default: 0)
+//   --stall <s>        tool download stall per format, 0 disables downloads (default: 0)
+//   --stop-on-errors   stop batch on first failed item
+//   --seed <n>         batch generator seed (default: 1)
+//
+// Usage: BatchEncoder.Benchmarks.exe micro [options]
+//   --filter <text>    run only benchmarks whose name contains text
+//   --min-time <s>     minimum measured time per benchmark (default: 0.5)
+//   --max-items <n>    largest item list for xml benchmarks (default: 1000000)
+//   --work <path>      directory for generated xml files
+//
+// Usage: BatchEncoder.Benchmarks.exe replay [options]
+//   --filter <text>    replay only transcripts whose name contains text
+//   --repeat <n>       timed replays per transcript (default: 20)
+//
+// Usage: BatchEncoder.Benchmarks.exe gate [options]
+//   --commit <id>      results are saved as <id>.json (default: local)
+//   --baseline <file>  checked-in baseline (default: baselines\<configuration>-<platform>.json in the source tree)
+//   --results <path>   directory for results (default: benchmarks\results)
+//   --tolerance <f>    allowed time or throughput regression (default: 0.15)
+//   --alloc-tolerance <f> allowed allocations per item increase (default: 0.05)
+//   --samples <n>      repeated runs, the median of each metric is compared (default: 5)
+//   --update-baseline  write current results to baseline instead of comparing
+//
+// Usage: BatchEncoder.Benchmarks.exe alloc [options]
+//   --items <n>        number of converted items (default: 32)
+//   --size <MB>        size of each input file (default: 4)
+//   --mode <name>      console, pipes or transcode (default: console)
+//   --preset <n>       fake encoder preset index (default: 0)
+//   --item-budget <n>  maximum allocations per item (default: 2000)
+//   --event-budget <n> maximum allocations per progress event (default: 1)
+//
+// Usage: BatchEncoder.Benchmarks.exe sweep --corpus <path> --format <id[,id]> [options]
+//   --corpus <path>    directory with input files, wav inputs also report realtime factor
+//   --format <ids>     comma separated format ids compared on the same inputs
+//   --presets <list>   comma separated preset indexes, empty runs all (default: all)
+//   --threads <n>      worker thread count, 0 is hardware concurrency (default: 0)
+//   --output <file>    save results as .csv or .json
+//   --work <path>      directory for encoded outputs
+
+std::vector<std::wstring> SplitList(const std::wstring& szList)
+{
+    std::vector<std::wstring> values;
+    size_t nStart = 0;
+    while (nStart <= szList.length())
+    {
+        size_t nEnd = szList.find(L',', nStart);
+        if (nEnd == std::wstring::npos)
+            nEnd = szList.length();
+        if (nEnd > nStart)
+            values.emplace_back(szList.substr(nStart, nEnd - nStart));
+        nStart = nEnd + 1;
+    }
+    return values;
+}
+
+int Throughput(int argc, wchar_t *argv[], int nFirst)
+{
+    CThroughputBenchmark benchmark;
+
+    for (int i = nFirst; i < argc; i++)
+    {
+        std::wstring szArg = argv[i];
+        bool bHasValue = i + 1 < argc;
+        if (szArg == L"--items" && bHasValue)
+            benchmark.nItems = _wtoi(argv[++i]);
+        else if (szArg == L"--size" && bHasValue)
+            benchmark.nSize = _wtoi(argv[++i]);
+        else if (szArg == L"--threads" && bHasValue)
+            benchmark.nMaxThreads = _wtoi(argv[++i]);
+        else if (szArg == L"--mode" && bHasValue)
+            benchmark.szMode = argv[++i];
+        else if (szArg == L"--preset" && bHasValue)
+            benchmark.nPreset = (size_t)_wtoi(argv[++i]);
+        else if (szArg == L"--work" && bHasValue)
+            benchmark.szWorkPath = argv[++i];
+        else if (szArg == L"--null-sink")
+            benchmark.bNullSink = true;
+        else if (szArg == L"--scratch" && bHasValue)
+            benchmark.szScratchPath = argv[++i];
+        else if (szArg == L"--verbose")
+            benchmark.bVerbose = true;
+        else
+        {
+            fwprintf(stderr, L"Usage: %s [throughput] [--items n] [--size MB] [--threads n] [--mode console|pipes|transcode] [--preset n] [--work path] [--null-sink] [--scratch path] [--verbose]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if (benchmark.nItems < 1 || benchmark.nSize < 1)
+    {
+        fwprintf(stderr, L"[Error] Invalid items or size.\n");
+        return 2;
+    }
+
+    return benchmark.Run() == true ? 0 : 1;
+}
+
+int Simulate(int argc, wchar_t *argv[], int nFirst)
+{
+    CSchedulerSimulator simulator;
+
+    for (int i = nFirst; i < argc; i++)
+    {
+        std::wstring szArg = argv[i];
+        bool bHasValue = i + 1 < argc;
+        if (szArg == L"--items" && bHasValue)
+            simulator.nItems = _wtoi(argv[++i]);
+        else if (szArg == L"--threads" && bHasValue)
+            simulator.nMaxThreads = _wtoi(argv[++i]);
+        else if (szArg == L"--cores" && bHasValue)
+            simulator.nCores = _wtoi(argv[++i]);
+        else if (szArg == L"--policy" && bHasValue)
+            simulator.szPolicy = argv[++i];
+        else if (szArg == L"--fail" && bHasValue)
+            simulator.fFailureRate = _wtof(argv[++i]);
+        else if (szArg == L"--stall" && bHasValue)
+            simulator.fDownloadStall = _wtof(argv[++i]);
+        else if (szArg == L"--stop-on-errors")
+            simulator.bStopOnErrors = true;
+        else if (szArg == L"--seed" && bHasValue)
+            simulator.nSeed = (unsigned int)_wtoi(argv[++i]);
+        else
+        {
+            fwprintf(stderr, L"Usage: %s simulate [--items n] [--threads n] [--cores n] [--policy list|largest|smallest] [--fail rate] [--stall s] [--stop-on-errors] [--seed n]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if (simulator.nItems < 1)
+    {
+        fwprintf(stderr, L"[Error] Invalid items.\n");
+        return 2;
+    }
+
+    return simulator.Run() == true ? 0 : 1;
+}
+
+int Micro(int argc, wchar_t *argv[], int nFirst)
+{
+    CCoreBenchmarks benchmarks;
+    CMicroBenchmarkRunner runner;
+    std::wstring szFilter;
+
+    for (int i = nFirst; i < argc; i++)
+    {
+        std::wstring szArg = argv[i];
+        bool bHasValue = i + 1 < argc;
+        if (szArg == L"--filter" && bHasValue)
+            szFilter = argv[++i];
+        else if (szArg == L"--min-time" && bHasValue)
+            runner.fMinTime = _wtof(argv[++i]);
+        else if (szArg == L"--max-items" && bHasValue)
+            benchmarks.nMaxItems = _wtoi(argv[++i]);
+        else if (szArg == L"--work" && bHasValue)
+            benchmarks.szWorkPath = argv[++i];
+        else
+        {
+            fwprintf(stderr, L"Usage: %s micro [--filter text] [--min-time s] [--max-items n] [--work path]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if (benchmarks.Init() == false)
+        return 1;
+
+    benchmarks.Register(runner);
+    runner.Run(szFilter);
+    return 0;
+}
+
+int Replay(int argc, wchar_t *argv[], int nFirst)
+{
+    CProgressReplay replay;
+
+    for (int i = nFirst; i < argc; i++)
+    {
+        std::wstring szArg = argv[i];
+        bool bHasValue = i + 1 < argc;
+        if (szArg == L"--filter" && bHasValue)
+            replay.szFilter = argv[++i];
+        else if (szArg == L"--repeat" && bHasValue)
+            replay.nRepeat = _wtoi(argv[++i]);
+        else
+        {
+            fwprintf(stderr, L"Usage: %s replay [--filter text] [--repeat n]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    return replay.Run() == true ? 0 : 1;
+}
+
+int Gate(int argc, wchar_t *argv[], int nFirst)
+{
+    CPerfGate gate;
+
+    for (int i = nFirst; i < argc; i++)
+    {
+        std::wstring szArg = argv[i];
+        bool bHasValue = i + 1 < argc;
+        if (szArg == L"--commit" && bHasValue)
+            gate.szCommit = argv[++i];
+        else if (szArg == L"--baseline" && bHasValue)
+            gate.szBaseline = argv[++i];
+        else if (szArg == L"--results" && bHasValue)
+            gate.szResultsPath = argv[++i];
+        else if (szArg == L"--tolerance" && bHasValue)
+            gate.fTimeTolerance = _wtof(argv[++i]);
+        else if (szArg == L"--alloc-tolerance" && bHasValue)
+            gate.fAllocTolerance = _wtof(argv[++i]);
+        else if (szArg == L"--samples" && bHasValue)
+            gate.nSamples = _wtoi(argv[++i]);
+        else if (szArg == L"--update-baseline")
+            gate.bUpdateBaseline = true;
+        else
+        {
+            fwprintf(stderr, L"Usage: %s gate [--commit id] [--baseline file] [--results path] [--tolerance f] [--alloc-tolerance f] [--samples n] [--update-baseline]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    return gate.Run() == true ? 0 : 1;
+}
+
+int Alloc(int argc, wchar_t *argv[], int nFirst)
+{
+    CAllocationBudget budget;
+
+    for (int i = nFirst; i < argc; i++)
+    {
+        std::wstring szArg = argv[i];
+        bool bHasValue = i + 1 < argc;
+        if (szArg == L"--items" && bHasValue)
+            budget.nItems = _wtoi(argv[++i]);
+        else if (szArg == L"--size" && bHasValue)
+            budget.nSize = _wtoi(argv[++i]);
+        else if (szArg == L"--mode" && bHasValue)
+            budget.szMode = argv[++i];
+        else if (szArg == L"--preset" && bHasValue)
+            budget.nPreset = (size_t)_wtoi(argv[++i]);
+        else if (szArg == L"--item-budget" && bHasValue)
+            budget.fItemBudget = _wtof(argv[++i]);
+        else if (szArg == L"--event-budget" && bHasValue)
+            budget.fEventBudget = _wtof(argv[++i]);
+        else
+        {
+            fwprintf(stderr, L"Usage: %s alloc [--items n] [--size MB] [--mode console|pipes|transcode] [--preset n] [--item-budget n] [--event-budget n]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if (budget.nItems < 1 || budget.nSize < 1)
+    {
+        fwprintf(stderr, L"[Error] Invalid items or size.\n");
+        return 2;
+    }
+
+    return budget.Run() == true ? 0 : 1;
+}
+
+int Sweep(int argc, wchar_t *argv[], int nFirst)
+{
+    CPresetSweep sweep;
+
+    for (int i = nFirst; i < argc; i++)
+    {
+        std::wstring szArg = argv[i];
+        bool bHasValue = i + 1 < argc;
+        if (szArg == L"--corpus" && bHasValue)
+            sweep.szCorpus = argv[++i];
+        else if (szArg == L"--format" && bHasValue)
+        {
+            for (auto& szFormatId : SplitList(argv[++i]))
+                sweep.m_FormatIds.emplace_back(szFormatId);
+        }
+        else if (szArg == L"--presets" && bHasValue)
+        {
+            for (auto& szPreset : SplitList(argv[++i]))
+                sweep.m_Presets.emplace_back((size_t)_wtoi(szPreset.c_str()));
+        }
+        else if (szArg == L"--threads" && bHasValue)
+            sweep.nThreads = _wtoi(argv[++i]);
+        else if (szArg == L"--output" && bHasValue)
+            sweep.szOutput = argv[++i];
+        else if (szArg == L"--work" && bHasValue)
+            sweep.szWorkPath = argv[++i];
+        else
+        {
+            fwprintf(stderr, L"Usage: %s sweep --corpus path --format id[,id] [--presets n[,n]] [--threads n] [--output file.csv|file.json] [--work path]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if (sweep.szCorpus.empty() || sweep.m_FormatIds.empty())
+    {
+        fwprintf(stderr, L"[Error] Missing corpus or format.\n");
+        return 2;
+    }
+
+    return sweep.Run() == true ? 0 : 1;
+}
+
+int wmain(int argc, wchar_t *argv[])
+{
+    std::wstring szCommand = argc > 1 ? argv[1] : L"";
+    if (szCommand == L"simulate")
+        return Simulate(argc, argv, 2);
+    if (szCommand == L"micro")
+        return Micro(argc, argv, 2);
+    if (szCommand == L"replay")
+        return Replay(argc, argv, 2);
+    if (szCommand == L"sweep")
+        return Sweep(argc, argv, 2);
+    if (szCommand == L"alloc")
+        return Alloc(argc, argv, 2);
+    if (szCommand == L"gate")
+        return Gate(argc, argv, 2);
+    if (szCommand == L"throughput")
+        return Throughput(argc, argv, 2);
+    return Throughput(argc, argv, 1);
+}
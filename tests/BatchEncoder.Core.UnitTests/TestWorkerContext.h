@@ -52,6 +52,34 @@ namespace BatchEncoderCoreUnitTests
         {
             return true;
         }
+        int ExitCode()
+        {
+            return 0;
+        }
+        CProcessUsage Usage()
+        {
+            return CProcessUsage();
+        }
+        bool SetAffinity(unsigned __int64 nMask)
+        {
+            return true;
+        }
+        bool SetLimits(const CProcessLimits& limits)
+        {
+            return true;
+        }
+        unsigned __int64 IoBytes()
+        {
+            return 0;
+        }
+        bool Suspend()
+        {
+            return true;
+        }
+        bool Resume()
+        {
+            return true;
+        }
     public:
         void* StdinHandle()
         {
@@ -144,6 +172,10 @@ namespace BatchEncoderCoreUnitTests
         {
             return true;
         }
+        bool DrainLoop(IPipe* Stderr)
+        {
+            return true;
+        }
     };
 
     class TestFileSystem : public util::IFileSystem
@@ -239,6 +271,41 @@ namespace BatchEncoderCoreUnitTests
         }
     };
 
+    class TestMemoryStatus : public IMemoryStatus
+    {
+    public:
+        unsigned __int64 nAvailable = (unsigned __int64)-1;
+    public:
+        unsigned __int64 AvailableMemory()
+        {
+            return this->nAvailable;
+        }
+    };
+
+    class TestSystemLoad : public ISystemLoad
+    {
+    public:
+        CSystemLoad load;
+    public:
+        bool Sample(CSystemLoad& load)
+        {
+            load = this->load;
+            return true;
+        }
+    };
+
+    class TestProcessorTopology : public IProcessorTopology
+    {
+    public:
+        CProcessorTopology topology;
+    public:
+        bool Query(CProcessorTopology& topology)
+        {
+            topology = this->topology;
+            return topology.Cores() > 0;
+        }
+    };
+
     class TestWorkerFactory : public IWorkerFactory
     {
     public:
@@ -270,6 +337,18 @@ namespace BatchEncoderCoreUnitTests
         {
             return std::make_shared<TestPipeToStringWriter>();
         }
+        std::shared_ptr<IMemoryStatus> CreateMemoryStatusPtr()
+        {
+            return std::make_shared<TestMemoryStatus>();
+        }
+        std::shared_ptr<ISystemLoad> CreateSystemLoadPtr()
+        {
+            return std::make_shared<TestSystemLoad>();
+        }
+        std::shared_ptr<IProcessorTopology> CreateProcessorTopologyPtr()
+        {
+            return std::make_shared<TestProcessorTopology>();
+        }
     };
 
     class TestWorkerContext : public IWorkerContext
@@ -296,6 +375,9 @@ namespace BatchEncoderCoreUnitTests
             this->nProcessedFiles = 0;
             this->nErrors = 0;
             this->nLastItemId = -1;
+            this->nRunningFiles = 0;
+            this->nActiveProcesses = 0;
+            this->bPaused = false;
         }
         void Start()
         {
@@ -309,7 +391,7 @@ namespace BatchEncoderCoreUnitTests
         {
             if (bError == true)
             {
-                if (this->pConfig->m_Options.bStopOnErrors == true)
+                if (this->StopOnError(nItemId) == true)
                 {
                     this->bRunning = false;
                 }
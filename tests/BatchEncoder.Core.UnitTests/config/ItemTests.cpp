@@ -39,6 +39,25 @@ namespace BatchEncoderCoreUnitTests
             }
         }
 
+        TEST_METHOD(CItem_SetProgressStatus)
+        {
+            config::CItem item { -1, L"", L"", L"", 0, L"", true, 0, { { L"" } }, L"", L"Encoding with a long status text...", false, 0, 0 };
+
+            const wchar_t* pBuffer = item.szStatus.data();
+
+            item.SetProgressStatus(5);
+            Assert::AreEqual(std::wstring(L"5%"), item.szStatus);
+
+            item.SetProgressStatus(99);
+            Assert::AreEqual(std::wstring(L"99%"), item.szStatus);
+
+            item.SetProgressStatus(100);
+            Assert::AreEqual(std::wstring(L"100%"), item.szStatus);
+
+            // existing buffer is reused instead of reallocated
+            Assert::IsTrue(pBuffer == item.szStatus.data());
+        }
+
         TEST_METHOD(CItem_SetIds)
         {
             std::vector<config::CItem> items
@@ -0,0 +1,130 @@
+﻿// Copyright (c) Wiesław Šoltés. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include "utilities\MemoryLog.h"
+#include "worker\AsyncLog.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace BatchEncoderCoreUnitTests
+{
+    class RecordingLog : public util::ILog
+    {
+    public:
+        std::vector<std::wstring>* pMessages;
+    public:
+        RecordingLog(std::vector<std::wstring>* pMessages) : pMessages(pMessages)
+        {
+        }
+        bool Open()
+        {
+            return true;
+        }
+        void Close()
+        {
+        }
+        void Log(const std::wstring& szMessage, bool bNewLine = true)
+        {
+            this->pMessages->emplace_back(szMessage);
+        }
+    };
+
+    TEST_CLASS(CAsyncLog_Tests)
+    {
+    public:
+        TEST_METHOD(CAsyncLog_Constructor)
+        {
+            worker::CAsyncLog m_Log(std::make_unique<util::MemoryLog>(), 100);
+
+            Assert::IsTrue(m_Log.Capacity() == 128);
+            Assert::IsTrue(m_Log.Dropped() == 0);
+        }
+
+        TEST_METHOD(CAsyncLog_Log_Flush)
+        {
+            worker::CAsyncLog m_Log(std::make_unique<util::MemoryLog>(), 16);
+
+            Assert::IsTrue(m_Log.Log(1, L"wide"));
+            Assert::IsTrue(m_Log.Log(2, "ansi"));
+            m_Log.Log(L"untagged");
+
+            Assert::IsTrue(m_Log.Flush() == 3);
+            Assert::IsTrue(m_Log.Flush() == 0);
+        }
+
+        TEST_METHOD(CAsyncLog_Log_Long)
+        {
+            std::vector<std::wstring> m_Messages;
+            worker::CAsyncLog m_Log(std::make_unique<RecordingLog>(&m_Messages), 16);
+
+            // long messages are written in full instead of being cut at the record size
+            std::wstring szWide(1000, L'w');
+            std::string szAnsi(600, 'a');
+            Assert::IsTrue(m_Log.Log(1, szWide.c_str()));
+            Assert::IsTrue(m_Log.Log(2, szAnsi.c_str()));
+            Assert::IsTrue(m_Log.Log(3, L"short"));
+
+            Assert::IsTrue(m_Log.Flush() == 3);
+            Assert::IsTrue(m_Messages.size() == 3);
+            Assert::AreEqual(L"[Item 1] " + szWide, m_Messages[0]);
+            Assert::AreEqual(L"[Item 2] " + std::wstring(600, L'a'), m_Messages[1]);
+            Assert::AreEqual(std::wstring(L"[Item 3] short"), m_Messages[2]);
+        }
+
+        TEST_METHOD(CAsyncLog_Log_After_Close)
+        {
+            std::vector<std::wstring> m_Messages;
+            worker::CAsyncLog m_Log(std::make_unique<RecordingLog>(&m_Messages), 16);
+
+            Assert::IsTrue(m_Log.Open());
+            Assert::IsTrue(m_Log.Log(1, L"open"));
+            m_Log.Close();
+            Assert::IsTrue(m_Messages.size() == 1);
+
+            // records after close are written by the producer right away
+            Assert::IsTrue(m_Log.Log(2, L"closed"));
+            Assert::IsTrue(m_Messages.size() == 2);
+            Assert::AreEqual(std::wstring(L"[Item 2] closed"), m_Messages[1]);
+            Assert::IsTrue(m_Log.Flush() == 0);
+        }
+
+        TEST_METHOD(CAsyncLog_Log_Drop)
+        {
+            worker::CAsyncLog m_Log(std::make_unique<util::MemoryLog>(), 4);
+
+            for (int i = 0; i < 4; i++)
+                Assert::IsTrue(m_Log.Log(i, L"record"));
+
+            Assert::IsFalse(m_Log.Log(4, L"record"));
+            Assert::IsTrue(m_Log.Dropped() == 1);
+
+            Assert::IsTrue(m_Log.Flush() == 4);
+            Assert::IsTrue(m_Log.Dropped() == 0);
+            Assert::IsTrue(m_Log.Log(5, L"record"));
+        }
+
+        TEST_METHOD(CAsyncLog_Log_Threads)
+        {
+            worker::CAsyncLog m_Log(std::make_unique<util::MemoryLog>(), 4096);
+            const int nThreads = 4;
+            const int nRecords = 1000;
+
+            std::vector<std::thread> threads;
+            for (int t = 0; t < nThreads; t++)
+            {
+                threads.emplace_back([&m_Log, t]()
+                {
+                    for (int i = 0; i < nRecords; i++)
+                        m_Log.Log(t, "record");
+                });
+            }
+
+            for (auto& thread : threads)
+                thread.join();
+
+            Assert::IsTrue(m_Log.Flush() == nThreads * nRecords);
+        }
+    };
+}
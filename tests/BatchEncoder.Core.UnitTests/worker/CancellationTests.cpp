@@ -0,0 +1,171 @@
+﻿// Copyright (c) Wiesław Šoltés. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include "worker\Cancellation.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace BatchEncoderCoreUnitTests
+{
+    class TestCancelledProcess : public TestProcess
+    {
+    public:
+        std::atomic<int> nTerminated = 0;
+        std::atomic<int> nSuspended = 0;
+    public:
+        bool Terminate(int code = 0)
+        {
+            this->nTerminated++;
+            return true;
+        }
+        bool Suspend()
+        {
+            this->nSuspended++;
+            return true;
+        }
+        bool Resume()
+        {
+            this->nSuspended--;
+            return true;
+        }
+    };
+
+    TEST_CLASS(CCancellation_Tests)
+    {
+    public:
+        TEST_METHOD(CCancellation_Constructor)
+        {
+            worker::CCancellation m_Cancellation;
+
+            Assert::IsFalse(m_Cancellation.Cancelled());
+            Assert::AreEqual(0, m_Cancellation.Count());
+            Assert::AreEqual(50, m_Cancellation.nInterval);
+        }
+
+        TEST_METHOD(CCancellation_Register)
+        {
+            worker::CCancellation m_Cancellation;
+            auto process = std::make_shared<TestCancelledProcess>();
+
+            {
+                worker::CCancelRegistration registration(&m_Cancellation, process);
+                Assert::AreEqual(1, m_Cancellation.Count());
+            }
+
+            Assert::AreEqual(0, m_Cancellation.Count());
+            Assert::AreEqual(0, (int)process->nTerminated);
+
+            // no token is a no-op
+            worker::CCancelRegistration registration(nullptr, process);
+        }
+
+        TEST_METHOD(CCancellation_Cancel)
+        {
+            worker::CCancellation m_Cancellation;
+            auto first = std::make_shared<TestCancelledProcess>();
+            auto second = std::make_shared<TestCancelledProcess>();
+
+            m_Cancellation.Register(first);
+            m_Cancellation.Register(second);
+            m_Cancellation.Cancel();
+
+            Assert::IsTrue(m_Cancellation.Cancelled());
+            Assert::AreEqual(1, (int)first->nTerminated);
+            Assert::AreEqual(1, (int)second->nTerminated);
+
+            // started after cancel is killed right away
+            auto third = std::make_shared<TestCancelledProcess>();
+            m_Cancellation.Register(third);
+            Assert::AreEqual(1, (int)third->nTerminated);
+        }
+
+        TEST_METHOD(CCancellation_Stop_Latency)
+        {
+            TestWorkerContext ctx;
+            ctx.Init();
+
+            worker::CCancellation m_Cancellation;
+            std::vector<std::shared_ptr<TestCancelledProcess>> processes;
+            for (int i = 0; i < 64; i++)
+            {
+                processes.emplace_back(std::make_shared<TestCancelledProcess>());
+                m_Cancellation.Register(processes.back());
+            }
+
+            m_Cancellation.Start(&ctx);
+            std::this_thread::sleep_for(std::chrono::milliseconds(120));
+            Assert::IsFalse(m_Cancellation.Cancelled());
+
+            worker::CMetricsTimer timer;
+            ctx.bRunning = false;
+            while (m_Cancellation.Cancelled() == false && timer.ElapsedMilliseconds() < 1000.0)
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+            Assert::IsTrue(timer.ElapsedMilliseconds() < 200.0);
+            for (auto& process : processes)
+                Assert::AreEqual(1, (int)process->nTerminated);
+
+            m_Cancellation.Stop();
+        }
+
+        TEST_METHOD(CCancellation_Suspend)
+        {
+            worker::CCancellation m_Cancellation;
+            auto first = std::make_shared<TestCancelledProcess>();
+            m_Cancellation.Register(first);
+
+            m_Cancellation.Suspend();
+            m_Cancellation.Suspend();
+            Assert::IsTrue(m_Cancellation.Suspended());
+            Assert::AreEqual(1, (int)first->nSuspended);
+
+            // started while paused is suspended right away
+            auto second = std::make_shared<TestCancelledProcess>();
+            m_Cancellation.Register(second);
+            Assert::AreEqual(1, (int)second->nSuspended);
+
+            m_Cancellation.Resume();
+            m_Cancellation.Resume();
+            Assert::IsFalse(m_Cancellation.Suspended());
+            Assert::AreEqual(0, (int)first->nSuspended);
+            Assert::AreEqual(0, (int)second->nSuspended);
+            Assert::AreEqual(0, (int)first->nTerminated);
+        }
+
+        TEST_METHOD(CCancellation_Pause_Monitor)
+        {
+            TestWorkerContext ctx;
+            ctx.Init();
+
+            worker::CCancellation m_Cancellation;
+            auto process = std::make_shared<TestCancelledProcess>();
+            m_Cancellation.Register(process);
+            m_Cancellation.Start(&ctx);
+
+            ctx.Pause();
+            worker::CMetricsTimer timer;
+            while (process->nSuspended == 0 && timer.ElapsedMilliseconds() < 1000.0)
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            Assert::AreEqual(1, (int)process->nSuspended);
+
+            ctx.Resume();
+            timer.Start();
+            while (process->nSuspended == 1 && timer.ElapsedMilliseconds() < 1000.0)
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            Assert::AreEqual(0, (int)process->nSuspended);
+
+            // stop while paused still kills the suspended tools
+            ctx.Pause();
+            std::this_thread::sleep_for(std::chrono::milliseconds(120));
+            ctx.bRunning = false;
+            timer.Start();
+            while (m_Cancellation.Cancelled() == false && timer.ElapsedMilliseconds() < 1000.0)
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            Assert::AreEqual(1, (int)process->nTerminated);
+
+            m_Cancellation.Stop();
+        }
+    };
+}
@@ -0,0 +1,353 @@
+﻿// Copyright (c) Wiesław Šoltés. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include "worker\Daemon.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace BatchEncoderCoreUnitTests
+{
+    TEST_CLASS(CDaemon_Tests)
+    {
+        config::CFormat m_Format
+        {
+            L"TEST_ID",
+            L"Name",
+            config::FormatType::Encoder,
+            0,
+            L"WAV",
+            L"MP3",
+            L"$EXE $OPTIONS $INFILE $OUTFILE",
+            false,
+            false,
+            L"script.lua",
+            L"program.exe",
+            0,
+            1,
+            {
+                { L"Default1", L"--option 1" },
+                { L"Default2", L"--option 2" }
+            }
+        };
+    public:
+        void Init(config::CConfig& m_Config, worker::CDaemon& m_Daemon)
+        {
+            m_Config.FileSystem = std::make_unique<TestFileSystem>();
+            m_Config.Log = std::make_unique<util::MemoryLog>();
+            m_Config.Log->Open();
+            m_Config.m_Options.Defaults();
+            m_Config.m_Options.szMetricsFile = L"C:\\Metrics\\metrics.json";
+            m_Config.m_Options.szTraceFile = L"C:\\Metrics\\trace.json";
+            m_Config.m_Formats.emplace_back(m_Format);
+
+            m_Daemon.pConfig = &m_Config;
+            m_Daemon.pFactory = std::make_shared<TestWorkerFactory>();
+            m_Daemon.CreateFileSystem = []() { return std::make_unique<TestFileSystem>(); };
+            m_Daemon.nThreadCount = 4;
+        }
+
+        TEST_METHOD(CJobRequest_Split)
+        {
+            auto fields = worker::CJobRequest::Split("submit\tTEST_ID\t-\tC:\\Output Files\\$Name$.$Ext$\tC:\\My Music\\a.wav");
+            Assert::AreEqual(size_t(5), fields.size());
+            Assert::AreEqual(std::string("C:\\Output Files\\$Name$.$Ext$"), fields[3]);
+            Assert::AreEqual(std::string("C:\\My Music\\a.wav"), fields[4]);
+
+            fields = worker::CJobRequest::Split("status  12");
+            Assert::AreEqual(size_t(2), fields.size());
+            Assert::AreEqual(std::string("status"), fields[0]);
+            Assert::AreEqual(std::string("12"), fields[1]);
+
+            Assert::AreEqual(size_t(0), worker::CJobRequest::Split("").size());
+        }
+
+        TEST_METHOD(CJobRequest_Parse)
+        {
+            worker::CJobRequest request;
+
+            Assert::IsTrue(worker::CJobRequest::Parse(worker::CJobRequest::Split("submit\tTEST_ID\t1\t-\ta.wav\t\tb.wav"), request));
+            Assert::AreEqual(std::wstring(L"TEST_ID"), request.szFormatId);
+            Assert::AreEqual(1, request.nPreset);
+            Assert::IsTrue(request.szOutputPath.empty());
+            Assert::AreEqual(size_t(2), request.m_Files.size());
+            Assert::AreEqual(std::wstring(L"b.wav"), request.m_Files[1]);
+
+            Assert::IsTrue(worker::CJobRequest::Parse(worker::CJobRequest::Split("submit\tTEST_ID\t-\tC:\\Out\\$Name$.$Ext$\ta.wav"), request));
+            Assert::AreEqual(-1, request.nPreset);
+            Assert::AreEqual(std::wstring(L"C:\\Out\\$Name$.$Ext$"), request.szOutputPath);
+
+            Assert::IsFalse(worker::CJobRequest::Parse(worker::CJobRequest::Split("submit\tTEST_ID\tfast\t-\ta.wav"), request));
+            Assert::IsFalse(worker::CJobRequest::Parse(worker::CJobRequest::Split("submit\tTEST_ID\t0\t-\t"), request));
+            Assert::IsFalse(worker::CJobRequest::Parse(worker::CJobRequest::Split("submit\t\t0\t-\ta.wav"), request));
+            Assert::IsFalse(worker::CJobRequest::Parse(worker::CJobRequest::Split("status\t1"), request));
+        }
+
+        TEST_METHOD(CJobRequest_Parse_Options)
+        {
+            worker::CJobRequest request;
+
+            Assert::IsTrue(worker::CJobRequest::Parse(worker::CJobRequest::Split("submit\t--priority=5\t--weight=3\t--deadline=60\t--submitter=ui\t--interactive\tTEST_ID\t-\t-\ta.wav"), request));
+            Assert::AreEqual(5, request.nPriority);
+            Assert::AreEqual(3, request.nWeight);
+            Assert::AreEqual(60, request.nDeadline);
+            Assert::AreEqual(std::wstring(L"ui"), request.szSubmitter);
+            Assert::IsTrue(request.bInteractive);
+            Assert::AreEqual(std::wstring(L"TEST_ID"), request.szFormatId);
+            Assert::AreEqual(size_t(1), request.m_Files.size());
+
+            Assert::IsTrue(worker::CJobRequest::Parse(worker::CJobRequest::Split("submit\tTEST_ID\t-\t-\ta.wav"), request));
+            Assert::AreEqual(0, request.nPriority);
+            Assert::AreEqual(1, request.nWeight);
+            Assert::IsFalse(request.bInteractive);
+
+            Assert::IsFalse(worker::CJobRequest::Parse(worker::CJobRequest::Split("submit\t--weight=0\tTEST_ID\t-\t-\ta.wav"), request));
+            Assert::IsFalse(worker::CJobRequest::Parse(worker::CJobRequest::Split("submit\t--priority=high\tTEST_ID\t-\t-\ta.wav"), request));
+            Assert::IsFalse(worker::CJobRequest::Parse(worker::CJobRequest::Split("submit\t--unknown=1\tTEST_ID\t-\t-\ta.wav"), request));
+            Assert::IsFalse(worker::CJobRequest::Parse(worker::CJobRequest::Split("submit\t--priority=1\tTEST_ID\t-\t-"), request));
+        }
+
+        TEST_METHOD(CDaemon_JobFile)
+        {
+            Assert::AreEqual(std::wstring(L""), worker::CDaemon::JobFile(L"", 3));
+            Assert::AreEqual(std::wstring(L"C:\\Metrics\\metrics-job3.json"), worker::CDaemon::JobFile(L"C:\\Metrics\\metrics.json", 3));
+            Assert::AreEqual(std::wstring(L"C:\\Metrics.d\\metrics-job3"), worker::CDaemon::JobFile(L"C:\\Metrics.d\\metrics", 3));
+        }
+
+        TEST_METHOD(CDaemon_Create)
+        {
+            config::CConfig m_Config;
+            worker::CDaemon m_Daemon;
+            Init(m_Config, m_Daemon);
+
+            worker::CJobRequest request;
+            request.szFormatId = L"test_id";
+            request.szOutputPath = L"C:\\Output\\$Name$.$Ext$";
+            request.m_Files = { L"C:\\Input\\File1.WAV", L"C:\\Input\\File2.WAV" };
+
+            std::wstring szError;
+            auto job = m_Daemon.Create(request, szError);
+            Assert::IsTrue(job != nullptr);
+            Assert::AreEqual(1, job->nJobId);
+            Assert::IsTrue(job->pConfig == &job->m_Config);
+            Assert::IsTrue(job->bRunning == true);
+            Assert::AreEqual(2, job->nThreadCount);
+            Assert::AreEqual(std::string("queued"), std::string(job->State()));
+
+            auto& config = job->m_Config;
+            Assert::AreEqual(size_t(1), config.m_Formats.size());
+            Assert::AreEqual(size_t(2), config.m_Items.size());
+            Assert::AreEqual(1, config.m_Items[1].nId);
+            Assert::AreEqual(std::wstring(L"TEST_ID"), config.m_Items[1].szFormatId);
+            Assert::AreEqual(size_t(1), config.m_Items[1].nPreset);
+            Assert::AreEqual(std::wstring(L"C:\\Output\\$Name$.$Ext$"), config.m_Options.szOutputPath);
+            Assert::AreEqual(std::wstring(L"C:\\Metrics\\metrics-job1.json"), config.m_Options.szMetricsFile);
+            Assert::IsTrue(config.m_Options.szTraceFile.empty());
+            Assert::AreEqual(size_t(0), m_Config.m_Items.size());
+
+            request.nPreset = 0;
+            auto next = m_Daemon.Create(request, szError);
+            Assert::AreEqual(2, next->nJobId);
+            Assert::AreEqual(size_t(0), next->m_Config.m_Items[0].nPreset);
+        }
+
+        TEST_METHOD(CDaemon_Create_Errors)
+        {
+            config::CConfig m_Config;
+            worker::CDaemon m_Daemon;
+            Init(m_Config, m_Daemon);
+
+            worker::CJobRequest request;
+            request.szFormatId = L"UNKNOWN";
+            request.m_Files = { L"C:\\Input\\File1.WAV" };
+
+            std::wstring szError;
+            Assert::IsTrue(m_Daemon.Create(request, szError) == nullptr);
+            Assert::AreEqual(std::wstring(L"Unknown format: UNKNOWN"), szError);
+
+            request.szFormatId = L"TEST_ID";
+            request.nPreset = 2;
+            Assert::IsTrue(m_Daemon.Create(request, szError) == nullptr);
+            Assert::AreEqual(std::wstring(L"Invalid preset: 2"), szError);
+
+            request.nPreset = 0;
+            request.bInteractive = true;
+            request.m_Files.push_back(L"C:\\Input\\File2.WAV");
+            Assert::IsTrue(m_Daemon.Create(request, szError) == nullptr);
+            Assert::AreEqual(std::wstring(L"Interactive jobs convert one file."), szError);
+
+            request.bInteractive = false;
+            request.m_Files.clear();
+            Assert::IsTrue(m_Daemon.Create(request, szError) == nullptr);
+        }
+
+        TEST_METHOD(CDaemon_Create_Share)
+        {
+            config::CConfig m_Config;
+            worker::CDaemon m_Daemon;
+            Init(m_Config, m_Daemon);
+
+            worker::CJobRequest request;
+            request.szFormatId = L"TEST_ID";
+            request.m_Files = { L"C:\\Input\\File1.WAV" };
+            request.szSubmitter = L"ui";
+            request.nPriority = 2;
+            request.nWeight = 4;
+            request.nDeadline = 60;
+            request.bInteractive = true;
+
+            std::wstring szError;
+            auto job = m_Daemon.Create(request, szError);
+            Assert::AreEqual(std::wstring(L"ui"), job->share.szSubmitter);
+            Assert::AreEqual(2, job->share.nPriority);
+            Assert::AreEqual(4, job->share.nWeight);
+            Assert::IsTrue(job->share.fDeadline >= 60000.0);
+            Assert::IsTrue(job->share.bInteractive);
+
+            request.nDeadline = 0;
+            Assert::AreEqual(0.0, m_Daemon.Create(request, szError)->share.fDeadline);
+        }
+
+        TEST_METHOD(CDaemon_Start_Shared)
+        {
+            config::CConfig m_Config;
+            worker::CDaemon m_Daemon;
+            Init(m_Config, m_Daemon);
+            m_Config.m_Options.nMemoryBudget = 64;
+            m_Config.m_Options.bAdaptiveThreadCount = true;
+            m_Config.m_Options.nMinThreadCount = 2;
+
+            // every runner uses the same memory budget and load controller
+            Assert::IsTrue(m_Daemon.Start(2));
+            Assert::IsTrue(m_Daemon.MemoryBudget != nullptr);
+            Assert::IsTrue(m_Daemon.MemoryBudget->nBudget == 64 * 1024 * 1024);
+            Assert::IsTrue(m_Daemon.MemoryBudget->nDefaultEstimate == 16 * 1024 * 1024);
+            Assert::IsTrue(m_Daemon.LoadController != nullptr);
+            Assert::AreEqual(4, m_Daemon.LoadController->nMaxSlots);
+            Assert::AreEqual(2, m_Daemon.LoadController->nMinSlots);
+            Assert::AreEqual(4, m_Daemon.Scheduler.nSlots);
+
+            m_Daemon.Stop();
+            Assert::IsTrue(m_Daemon.LoadController == nullptr);
+        }
+
+        TEST_METHOD(CDaemon_Execute)
+        {
+            config::CConfig m_Config;
+            worker::CDaemon m_Daemon;
+            Init(m_Config, m_Daemon);
+
+            std::shared_ptr<worker::CJobContext> stream;
+            std::shared_ptr<worker::CJobSubscriber> subscriber;
+            Assert::AreEqual(std::string("queued\t1\t1\n"), m_Daemon.Execute("submit\tTEST_ID\t-\t-\tC:\\Input\\File1.WAV", stream, subscriber));
+            Assert::IsTrue(stream != nullptr);
+            Assert::IsTrue(subscriber != nullptr);
+            Assert::AreEqual(size_t(1), m_Daemon.Queued());
+
+            std::shared_ptr<worker::CJobContext> none;
+            std::shared_ptr<worker::CJobSubscriber> nobody;
+            Assert::AreEqual(std::string("job\t1\tqueued\t0\t1\t0\n"), m_Daemon.Execute("status 1", none, nobody));
+            Assert::AreEqual(std::string("job\t1\tpaused\t0\t1\t0\n"), m_Daemon.Execute("pause 1", none, nobody));
+            Assert::AreEqual(std::string("job\t1\tqueued\t0\t1\t0\n"), m_Daemon.Execute("resume 1", none, nobody));
+            Assert::AreEqual(std::string("job\t1\tstopped\t0\t1\t0\n"), m_Daemon.Execute("stop 1", none, nobody));
+            Assert::IsTrue(none == nullptr);
+            Assert::IsTrue(nobody == nullptr);
+            Assert::AreEqual(size_t(0), m_Daemon.Queued());
+
+            // submitter receives the final job status and then the stream ends
+            std::string szEvent;
+            Assert::IsTrue(stream->Next(subscriber, szEvent, 0));
+            Assert::AreEqual(std::string("job\t1\tstopped\t0\t1\t0\n"), szEvent);
+            Assert::IsFalse(stream->Next(subscriber, szEvent, 0));
+
+            Assert::AreEqual(std::string("job\t1\tstopped\t0\t1\t0\nend\n"), m_Daemon.Execute("jobs", none, nobody));
+            Assert::AreEqual(std::string("error\tUnknown job.\n"), m_Daemon.Execute("status 2", none, nobody));
+            Assert::AreEqual(std::string("error\tMissing job id.\n"), m_Daemon.Execute("stop", none, nobody));
+            Assert::AreEqual(std::string("error\tInvalid submit command.\n"), m_Daemon.Execute("submit\tTEST_ID", none, nobody));
+            Assert::AreEqual(std::string("error\tUnknown format: MP3\n"), m_Daemon.Execute("submit\tMP3\t-\t-\ta.wav", none, nobody));
+        }
+
+        TEST_METHOD(CJobContext_Events)
+        {
+            config::CConfig m_Config;
+            worker::CDaemon m_Daemon;
+            Init(m_Config, m_Daemon);
+
+            worker::CJobRequest request;
+            request.szFormatId = L"TEST_ID";
+            request.m_Files = { L"C:\\Input\\File1.WAV" };
+
+            std::wstring szError;
+            auto job = m_Daemon.Create(request, szError);
+
+            // events are dropped while no client is attached
+            std::string szEvent;
+            job->ItemStatus(0, L"00:00:01", L"Done");
+            auto subscriber = job->Attach();
+            Assert::IsTrue(job->Next(subscriber, szEvent, 0));
+            Assert::IsTrue(szEvent.empty());
+
+            job->ItemStatus(0, L"00:00:02", L"Done");
+            job->nTotalFiles = 1;
+            job->TotalProgress(0);
+            job->nProcessedFiles = 1;
+            job->TotalProgress(0);
+            job->TotalProgress(0);
+
+            Assert::IsTrue(job->Next(subscriber, szEvent, 0));
+            Assert::AreEqual(std::string("item\t1\t0\tFile1\t00:00:02\tDone\n"), szEvent);
+            Assert::IsTrue(job->Next(subscriber, szEvent, 0));
+            Assert::AreEqual(std::string("progress\t1\t1\t1\n"), szEvent);
+            Assert::IsTrue(job->Next(subscriber, szEvent, 0));
+            Assert::IsTrue(szEvent.empty());
+
+            job->Finish(worker::JobState::Done);
+            Assert::IsTrue(job->Next(subscriber, szEvent, 0));
+            Assert::AreEqual(std::string("job\t1\tdone\t1\t1\t0\n"), szEvent);
+            Assert::IsFalse(job->Next(subscriber, szEvent, 0));
+            Assert::IsTrue(job->bDone == true);
+        }
+
+        TEST_METHOD(CJobContext_Subscribers)
+        {
+            config::CConfig m_Config;
+            worker::CDaemon m_Daemon;
+            Init(m_Config, m_Daemon);
+
+            worker::CJobRequest request;
+            request.szFormatId = L"TEST_ID";
+            request.m_Files = { L"C:\\Input\\File1.WAV" };
+
+            std::wstring szError;
+            auto job = m_Daemon.Create(request, szError);
+
+            // every client reads its own copy of the events
+            auto first = job->Attach();
+            auto second = job->Attach();
+            Assert::AreEqual(size_t(2), job->Subscribers());
+
+            std::string szEvent;
+            job->ItemStatus(0, L"00:00:01", L"Done");
+            Assert::IsTrue(job->Next(first, szEvent, 0));
+            Assert::AreEqual(std::string("item\t1\t0\tFile1\t00:00:01\tDone\n"), szEvent);
+            Assert::IsTrue(job->Next(second, szEvent, 0));
+            Assert::AreEqual(std::string("item\t1\t0\tFile1\t00:00:01\tDone\n"), szEvent);
+
+            // a leaving client does not stop or clear the events of the others
+            job->ItemStatus(0, L"00:00:02", L"Done");
+            job->Detach(first);
+            Assert::AreEqual(size_t(1), job->Subscribers());
+            Assert::IsTrue(job->Next(first, szEvent, 0));
+            Assert::IsTrue(szEvent.empty());
+            job->ItemStatus(0, L"00:00:03", L"Done");
+            Assert::IsTrue(job->Next(second, szEvent, 0));
+            Assert::AreEqual(std::string("item\t1\t0\tFile1\t00:00:02\tDone\n"), szEvent);
+            Assert::IsTrue(job->Next(second, szEvent, 0));
+            Assert::AreEqual(std::string("item\t1\t0\tFile1\t00:00:03\tDone\n"), szEvent);
+
+            job->Detach(second);
+            Assert::AreEqual(size_t(0), job->Subscribers());
+        }
+    };
+}
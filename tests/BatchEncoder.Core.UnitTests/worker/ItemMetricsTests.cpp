@@ -0,0 +1,217 @@
+﻿// Copyright (c) Wiesław Šoltés. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include "worker\ItemMetrics.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace BatchEncoderCoreUnitTests
+{
+    TEST_CLASS(CItemMetrics_Tests)
+    {
+    public:
+        TEST_METHOD(CItemMetrics_Constructor)
+        {
+            worker::CItemMetrics m_Metrics;
+
+            Assert::AreEqual(-1, m_Metrics.nItemId);
+            Assert::AreEqual(-1, m_Metrics.nExitCode);
+            Assert::IsFalse(m_Metrics.bSuccess);
+            Assert::IsTrue(m_Metrics.nBytesIn == 0);
+            Assert::IsTrue(m_Metrics.nBytesOut == 0);
+            Assert::AreEqual(0.0, m_Metrics.fUserTime);
+            Assert::IsTrue(m_Metrics.nPeakMemory == 0);
+        }
+
+        TEST_METHOD(CItemMetrics_Reset)
+        {
+            worker::CItemMetrics m_Metrics;
+            m_Metrics.szFormatId = L"LAME_MP3";
+            m_Metrics.fEncodeTime = 10.0;
+            m_Metrics.nBytesOut = 1024;
+            m_Metrics.bSuccess = true;
+            m_Metrics.fUserTime = 5.0;
+            m_Metrics.nPeakMemory = 4096;
+
+            m_Metrics.Reset(5);
+
+            Assert::AreEqual(5, m_Metrics.nItemId);
+            Assert::AreEqual(L"", m_Metrics.szFormatId.c_str());
+            Assert::AreEqual(0.0, m_Metrics.fEncodeTime);
+            Assert::IsTrue(m_Metrics.nBytesOut == 0);
+            Assert::IsFalse(m_Metrics.bSuccess);
+            Assert::AreEqual(0.0, m_Metrics.fUserTime);
+            Assert::IsTrue(m_Metrics.nPeakMemory == 0);
+        }
+
+        TEST_METHOD(CItemMetrics_AddUsage)
+        {
+            worker::CProcessUsage decoder;
+            decoder.fUserTime = 100.0;
+            decoder.fKernelTime = 10.0;
+            decoder.nPeakMemory = 300;
+            decoder.nReadBytes = 1000;
+            decoder.nWriteBytes = 2000;
+
+            worker::CProcessUsage encoder;
+            encoder.fUserTime = 200.0;
+            encoder.fKernelTime = 20.0;
+            encoder.nPeakMemory = 500;
+            encoder.nReadBytes = 2000;
+            encoder.nWriteBytes = 400;
+
+            // sequential processes keep the largest peak
+            worker::CItemMetrics m_Metrics;
+            m_Metrics.AddUsage(decoder);
+            m_Metrics.AddUsage(encoder);
+
+            Assert::AreEqual(300.0, m_Metrics.fUserTime);
+            Assert::AreEqual(30.0, m_Metrics.fKernelTime);
+            Assert::IsTrue(m_Metrics.nPeakMemory == 500);
+            Assert::IsTrue(m_Metrics.nReadBytes == 3000);
+            Assert::IsTrue(m_Metrics.nWriteBytes == 2400);
+
+            // concurrent processes add up their peaks
+            worker::CProcessUsage usage = decoder;
+            usage.Combine(encoder);
+
+            Assert::AreEqual(300.0, usage.fUserTime);
+            Assert::IsTrue(usage.nPeakMemory == 800);
+        }
+
+        TEST_METHOD(CItemMetrics_Escape)
+        {
+            Assert::AreEqual("C:\\\\Music\\\\\\\"A\\\".wav", worker::CItemMetrics::Escape(L"C:\\Music\\\"A\".wav").c_str());
+            Assert::AreEqual("a\\u0009b", worker::CItemMetrics::Escape(L"a\tb").c_str());
+        }
+
+        TEST_METHOD(CItemMetrics_ToJson)
+        {
+            worker::CItemMetrics m_Metrics;
+            m_Metrics.Reset(3);
+            m_Metrics.szFormatId = L"FLAC_FLAC";
+            m_Metrics.szMode = L"encode";
+            m_Metrics.fEncodeTime = 1.5;
+            m_Metrics.nBytesIn = 4096;
+            m_Metrics.nBytesOut = 2048;
+            m_Metrics.nExitCode = 0;
+            m_Metrics.bSuccess = true;
+            m_Metrics.fUserTime = 2.25;
+            m_Metrics.nPeakMemory = 8192;
+            m_Metrics.nWriteBytes = 512;
+
+            std::string szJson = m_Metrics.ToJson();
+
+            Assert::IsTrue(szJson.front() == '{');
+            Assert::IsTrue(szJson.back() == '}');
+            Assert::IsTrue(szJson.find("\"item\":3") != std::string::npos);
+            Assert::IsTrue(szJson.find("\"format\":\"FLAC_FLAC\"") != std::string::npos);
+            Assert::IsTrue(szJson.find("\"mode\":\"encode\"") != std::string::npos);
+            Assert::IsTrue(szJson.find("\"success\":true") != std::string::npos);
+            Assert::IsTrue(szJson.find("\"exit_code\":0") != std::string::npos);
+            Assert::IsTrue(szJson.find("\"encode_ms\":1.500") != std::string::npos);
+            Assert::IsTrue(szJson.find("\"bytes_in\":4096") != std::string::npos);
+            Assert::IsTrue(szJson.find("\"bytes_out\":2048") != std::string::npos);
+            Assert::IsTrue(szJson.find("\"user_ms\":2.250") != std::string::npos);
+            Assert::IsTrue(szJson.find("\"peak_memory\":8192") != std::string::npos);
+            Assert::IsTrue(szJson.find("\"io_write_bytes\":512") != std::string::npos);
+        }
+
+        TEST_METHOD(CItemMetrics_ToJson_StderrTail)
+        {
+            worker::CItemMetrics m_Metrics;
+            m_Metrics.Reset(4);
+
+            Assert::IsTrue(m_Metrics.ToJson().find("stderr_tail") == std::string::npos);
+
+            m_Metrics.szStderrTail = L"error 1\nerror 2";
+            std::string szJson = m_Metrics.ToJson();
+
+            Assert::IsTrue(szJson.back() == '}');
+            Assert::IsTrue(szJson.find("\"stderr_tail\":\"error 1\\u000aerror 2\"}") != std::string::npos);
+        }
+
+        TEST_METHOD(CItemMetrics_ToJson_Timeout)
+        {
+            worker::CItemMetrics m_Metrics;
+            m_Metrics.Reset(5);
+
+            Assert::IsTrue(m_Metrics.ToJson().find("timeout") == std::string::npos);
+
+            m_Metrics.szTimeout = L"stall";
+            std::string szJson = m_Metrics.ToJson();
+
+            Assert::IsTrue(szJson.back() == '}');
+            Assert::IsTrue(szJson.find("\"timeout\":\"stall\"}") != std::string::npos);
+        }
+
+        TEST_METHOD(CItemMetrics_ToJson_Long)
+        {
+            worker::CItemMetrics m_Metrics;
+            m_Metrics.Reset(6);
+            m_Metrics.szFormatId = std::wstring(600, L'"');
+            m_Metrics.szMode = L"encode";
+            m_Metrics.szTimeout = L"wall";
+
+            std::string szJson = m_Metrics.ToJson();
+            std::string szEscaped;
+            for (int i = 0; i < 600; i++)
+                szEscaped += "\\\"";
+
+            // escaped id alone is longer than the old fixed buffer
+            Assert::IsTrue(szJson.back() == '}');
+            Assert::IsTrue(szJson.find("\"format\":\"" + szEscaped + "\",\"mode\":\"encode\"") != std::string::npos);
+            Assert::IsTrue(szJson.find("\"io_write_bytes\":0,\"timeout\":\"wall\"}") != std::string::npos);
+        }
+
+        TEST_METHOD(CItemMetrics_BeginAttempt)
+        {
+            worker::CItemMetrics m_Metrics;
+            m_Metrics.Reset(5);
+            m_Metrics.BeginAttempt(true);
+            m_Metrics.nExitCode = (int)0xC0000005;
+            m_Metrics.fTotalTime = 100.0;
+            m_Metrics.bIoFailed = true;
+            m_Metrics.szFailure = L"crash";
+            m_Metrics.bRetry = true;
+            m_Metrics.fRetryDelay = 60000.0;
+            m_Metrics.queueTimer.Start();
+
+            Assert::IsFalse(m_Metrics.RetryReady());
+            Assert::IsTrue(m_Metrics.RetryWait() > 0.0);
+
+            std::string szJson = m_Metrics.ToJson();
+            Assert::IsTrue(szJson.find("\"attempt\":1,") != std::string::npos);
+            Assert::IsTrue(szJson.find("\"failure\":\"crash\",\"retry\":true}") != std::string::npos);
+
+            m_Metrics.BeginAttempt(false);
+            Assert::AreEqual(2, m_Metrics.nAttempts);
+            Assert::AreEqual(-1, m_Metrics.nExitCode);
+            Assert::AreEqual(100.0, m_Metrics.fTotalTime);
+            Assert::IsFalse(m_Metrics.bIoFailed);
+            Assert::IsFalse(m_Metrics.bRetryable);
+            Assert::IsTrue(m_Metrics.RetryReady());
+            Assert::IsTrue(m_Metrics.ToJson().find("failure") == std::string::npos);
+        }
+    };
+
+    TEST_CLASS(CItemMetricsWriter_Tests)
+    {
+    public:
+        TEST_METHOD(CItemMetricsWriter_Constructor)
+        {
+            worker::CItemMetricsWriter m_Writer;
+            Assert::IsFalse(m_Writer.IsOpen());
+        }
+
+        TEST_METHOD(CItemMetricsWriter_Write_Closed)
+        {
+            worker::CItemMetricsWriter m_Writer;
+            worker::CItemMetrics m_Metrics;
+            m_Writer.Write(m_Metrics);
+            Assert::IsFalse(m_Writer.IsOpen());
+        }
+    };
+}
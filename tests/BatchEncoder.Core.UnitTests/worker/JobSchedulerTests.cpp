@@ -0,0 +1,263 @@
+﻿// Copyright (c) Wiesław Šoltés. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include "worker\JobScheduler.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace BatchEncoderCoreUnitTests
+{
+    TEST_CLASS(CJobScheduler_Tests)
+    {
+    public:
+        static void WaitForWaiting(worker::CJobScheduler& m_Scheduler, int nWaiting)
+        {
+            for (int i = 0; i < 200 && m_Scheduler.Waiting() != nWaiting; i++)
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            Assert::AreEqual(nWaiting, m_Scheduler.Waiting());
+        }
+
+        TEST_METHOD(CJobScheduler_Constructor)
+        {
+            worker::CJobScheduler m_Scheduler;
+
+            Assert::AreEqual(1, m_Scheduler.nSlots);
+            Assert::AreEqual(1, m_Scheduler.nInteractiveSlots);
+            Assert::AreEqual(50, m_Scheduler.nInterval);
+            Assert::AreEqual(0, m_Scheduler.Running());
+            Assert::AreEqual(0, m_Scheduler.Waiting());
+        }
+
+        TEST_METHOD(CJobScheduler_Before)
+        {
+            worker::CJobShare normal;
+            worker::CJobShare interactive;
+            interactive.bInteractive = true;
+            worker::CJobShare urgent;
+            urgent.nPriority = 5;
+            worker::CJobShare soon;
+            soon.fDeadline = 1000.0;
+            worker::CJobShare later;
+            later.fDeadline = 2000.0;
+
+            Assert::IsTrue(worker::CJobScheduler::Before(interactive, urgent));
+            Assert::IsTrue(worker::CJobScheduler::Before(urgent, soon));
+            Assert::IsTrue(worker::CJobScheduler::Before(soon, later));
+            Assert::IsTrue(worker::CJobScheduler::Before(later, normal));
+            Assert::IsFalse(worker::CJobScheduler::Before(normal, later));
+            Assert::IsFalse(worker::CJobScheduler::Before(normal, normal));
+        }
+
+        TEST_METHOD(CJobScheduler_Usage)
+        {
+            worker::CJobScheduler m_Scheduler;
+            m_Scheduler.nSlots = 4;
+            TestWorkerContext a;
+            TestWorkerContext b;
+            TestWorkerContext c;
+            a.Init();
+            b.Init();
+            c.Init();
+
+            worker::CJobShare share;
+            share.szSubmitter = L"import";
+            share.nWeight = 2;
+            m_Scheduler.Register(&a, share);
+
+            for (int i = 0; i < 4; i++)
+            {
+                Assert::IsTrue(m_Scheduler.Acquire(&a));
+                m_Scheduler.Release(&a);
+            }
+            Assert::AreEqual(2.0, m_Scheduler.Usage(&a));
+            Assert::AreEqual(2.0, m_Scheduler.Usage(L"import"));
+            Assert::AreEqual(0, m_Scheduler.Running());
+
+            // newcomers start level with active peers
+            m_Scheduler.Register(&b, share);
+            Assert::AreEqual(2.0, m_Scheduler.Usage(&b));
+
+            worker::CJobShare other;
+            other.szSubmitter = L"user";
+            m_Scheduler.Register(&c, other);
+            Assert::AreEqual(2.0, m_Scheduler.Usage(L"user"));
+
+            m_Scheduler.Unregister(&a);
+            m_Scheduler.Unregister(&b);
+            Assert::AreEqual(0.0, m_Scheduler.Usage(L"import"));
+            Assert::AreEqual(0.0, m_Scheduler.Usage(&a));
+        }
+
+        TEST_METHOD(CJobScheduler_Acquire_Slots)
+        {
+            worker::CJobScheduler m_Scheduler;
+            TestWorkerContext a;
+            TestWorkerContext b;
+            a.Init();
+            b.Init();
+
+            Assert::IsTrue(m_Scheduler.Acquire(&a));
+            Assert::AreEqual(1, m_Scheduler.Running());
+
+            std::atomic<bool> bAcquired = false;
+            std::thread waiter([&]() { bAcquired = m_Scheduler.Acquire(&b); });
+            WaitForWaiting(m_Scheduler, 1);
+            Assert::IsFalse(bAcquired == true);
+
+            m_Scheduler.Release(&a);
+            waiter.join();
+            Assert::IsTrue(bAcquired == true);
+            Assert::AreEqual(1, m_Scheduler.Running());
+
+            m_Scheduler.Release(&b);
+            Assert::AreEqual(0, m_Scheduler.Running());
+        }
+
+        TEST_METHOD(CJobScheduler_Acquire_Priority)
+        {
+            worker::CJobScheduler m_Scheduler;
+            TestWorkerContext running;
+            TestWorkerContext low;
+            TestWorkerContext high;
+            running.Init();
+            low.Init();
+            high.Init();
+
+            worker::CJobShare share;
+            share.nPriority = 5;
+            m_Scheduler.Register(&high, share);
+
+            Assert::IsTrue(m_Scheduler.Acquire(&running));
+
+            std::mutex m_Order;
+            std::vector<worker::IWorkerContext*> order;
+            auto acquire = [&](worker::IWorkerContext* ctx)
+            {
+                m_Scheduler.Acquire(ctx);
+                std::lock_guard<std::mutex> lock(m_Order);
+                order.push_back(ctx);
+                m_Scheduler.Release(ctx);
+            };
+
+            // batch that waited longer still yields to higher priority at the item boundary
+            std::thread t1(acquire, &low);
+            WaitForWaiting(m_Scheduler, 1);
+            std::thread t2(acquire, &high);
+            WaitForWaiting(m_Scheduler, 2);
+
+            m_Scheduler.Release(&running);
+            t1.join();
+            t2.join();
+
+            Assert::AreEqual(size_t(2), order.size());
+            Assert::IsTrue(order[0] == &high);
+            Assert::IsTrue(order[1] == &low);
+        }
+
+        TEST_METHOD(CJobScheduler_Acquire_FairShare)
+        {
+            worker::CJobScheduler m_Scheduler;
+            m_Scheduler.nSlots = 2;
+            TestWorkerContext big;
+            TestWorkerContext small;
+            TestWorkerContext running;
+            big.Init();
+            small.Init();
+            running.Init();
+
+            worker::CJobShare import;
+            import.szSubmitter = L"import";
+            m_Scheduler.Register(&big, import);
+            for (int i = 0; i < 10; i++)
+            {
+                m_Scheduler.Acquire(&big);
+                m_Scheduler.Release(&big);
+            }
+
+            worker::CJobShare user;
+            user.szSubmitter = L"user";
+            m_Scheduler.Register(&small, user);
+            Assert::IsTrue(m_Scheduler.Acquire(&small));
+            Assert::IsTrue(m_Scheduler.Acquire(&running));
+
+            std::mutex m_Order;
+            std::vector<worker::IWorkerContext*> order;
+            auto acquire = [&](worker::IWorkerContext* ctx)
+            {
+                m_Scheduler.Acquire(ctx);
+                std::lock_guard<std::mutex> lock(m_Order);
+                order.push_back(ctx);
+                m_Scheduler.Release(ctx);
+            };
+
+            std::thread t1(acquire, &big);
+            WaitForWaiting(m_Scheduler, 1);
+            m_Scheduler.Release(&small);
+            t1.join();
+            Assert::IsTrue(order[0] == &big);
+
+            // submitter that used fewer slots goes first
+            m_Scheduler.Acquire(&big);
+            std::thread t2(acquire, &big);
+            WaitForWaiting(m_Scheduler, 1);
+            std::thread t3(acquire, &small);
+            WaitForWaiting(m_Scheduler, 2);
+            m_Scheduler.Release(&big);
+            t2.join();
+            t3.join();
+
+            Assert::AreEqual(size_t(3), order.size());
+            Assert::IsTrue(order[1] == &small);
+            Assert::IsTrue(order[2] == &big);
+            m_Scheduler.Release(&running);
+        }
+
+        TEST_METHOD(CJobScheduler_Interactive)
+        {
+            worker::CJobScheduler m_Scheduler;
+            TestWorkerContext batch;
+            TestWorkerContext item;
+            batch.Init();
+            item.Init();
+
+            Assert::IsTrue(m_Scheduler.Acquire(&batch));
+
+            // single item uses the reserved slot instead of waiting for the running batch item
+            m_Scheduler.Interactive(&item);
+            Assert::IsTrue(m_Scheduler.Acquire(&item));
+            Assert::AreEqual(2, m_Scheduler.Running());
+
+            m_Scheduler.Release(&item);
+            m_Scheduler.Unregister(&item);
+            m_Scheduler.Release(&batch);
+            Assert::AreEqual(0, m_Scheduler.Running());
+        }
+
+        TEST_METHOD(CJobScheduler_Acquire_Stopped)
+        {
+            worker::CJobScheduler m_Scheduler;
+            m_Scheduler.nInterval = 10;
+            TestWorkerContext a;
+            TestWorkerContext b;
+            a.Init();
+            b.Init();
+
+            Assert::IsTrue(m_Scheduler.Acquire(&a));
+
+            std::atomic<bool> bAcquired = true;
+            std::thread waiter([&]() { bAcquired = m_Scheduler.Acquire(&b); });
+            WaitForWaiting(m_Scheduler, 1);
+
+            b.bRunning = false;
+            waiter.join();
+            Assert::IsFalse(bAcquired == true);
+            Assert::AreEqual(0, m_Scheduler.Waiting());
+            Assert::AreEqual(1, m_Scheduler.Running());
+
+            m_Scheduler.Release(&a);
+            Assert::AreEqual(0, m_Scheduler.Running());
+        }
+    };
+}
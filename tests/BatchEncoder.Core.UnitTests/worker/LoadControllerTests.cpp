@@ -0,0 +1,107 @@
+﻿// Copyright (c) Wiesław Šoltés. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include "worker\LoadController.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace BatchEncoderCoreUnitTests
+{
+    TEST_CLASS(CLoadController_Tests)
+    {
+        static worker::CSystemLoad Load(double fBusy, double fQueueLength, int nProcessors)
+        {
+            worker::CSystemLoad load;
+            load.fBusy = fBusy;
+            load.fQueueLength = fQueueLength;
+            load.nProcessors = nProcessors;
+            return load;
+        }
+    public:
+        TEST_METHOD(CLoadController_Constructor)
+        {
+            worker::CLoadController m_Controller;
+
+            Assert::AreEqual(1, m_Controller.nMinSlots);
+            Assert::AreEqual(1, m_Controller.nMaxSlots);
+            Assert::AreEqual(1, (int)m_Controller.nActiveSlots);
+            Assert::IsTrue(m_Controller.pLoad == nullptr);
+        }
+
+        TEST_METHOD(CLoadController_Next_Shrink)
+        {
+            worker::CLoadController m_Controller;
+            m_Controller.nMinSlots = 2;
+            m_Controller.nMaxSlots = 8;
+
+            Assert::AreEqual(5, m_Controller.Next(6, Load(1.0, 24.0, 8), 100));
+            Assert::AreEqual(2, m_Controller.Next(2, Load(1.0, 24.0, 8), 100));
+        }
+
+        TEST_METHOD(CLoadController_Next_Grow)
+        {
+            worker::CLoadController m_Controller;
+            m_Controller.nMinSlots = 2;
+            m_Controller.nMaxSlots = 8;
+
+            Assert::AreEqual(5, m_Controller.Next(4, Load(0.5, 1.0, 8), 100));
+            Assert::AreEqual(8, m_Controller.Next(8, Load(0.5, 1.0, 8), 100));
+
+            // no point in more slots than remaining items
+            Assert::AreEqual(4, m_Controller.Next(4, Load(0.5, 1.0, 8), 4));
+        }
+
+        TEST_METHOD(CLoadController_Next_Steady)
+        {
+            worker::CLoadController m_Controller;
+            m_Controller.nMinSlots = 1;
+            m_Controller.nMaxSlots = 8;
+
+            // busy host with a short run queue keeps current slots
+            Assert::AreEqual(6, m_Controller.Next(6, Load(0.9, 4.0, 8), 100));
+        }
+
+        TEST_METHOD(CLoadController_WaitForSlot)
+        {
+            config::CConfig m_Config;
+            TestWorkerContext ctx;
+            ctx.Init();
+            ctx.pConfig = &m_Config;
+            ctx.nTotalFiles = 10;
+
+            worker::CLoadController m_Controller;
+            m_Controller.nMaxSlots = 4;
+            m_Controller.Update(2);
+
+            Assert::IsTrue(m_Controller.WaitForSlot(&ctx, 1));
+
+            // parked slot leaves when every item was taken
+            ctx.nProcessedFiles = 8;
+            ctx.nRunningFiles = 2;
+            Assert::IsTrue(m_Controller.WaitForSlot(&ctx, 3));
+
+            // parked slot leaves when batch is stopped
+            ctx.nProcessedFiles = 0;
+            ctx.nRunningFiles = 0;
+            ctx.bRunning = false;
+            Assert::IsFalse(m_Controller.WaitForSlot(&ctx, 3));
+        }
+
+        TEST_METHOD(CLoadController_Scheduler)
+        {
+            worker::CJobScheduler m_Scheduler;
+            worker::CLoadController m_Controller;
+            m_Controller.nMaxSlots = 4;
+            m_Controller.Scheduler = &m_Scheduler;
+
+            // shared controller sizes the slots of every batch in the scheduler
+            m_Controller.Start(nullptr);
+            Assert::AreEqual(4, m_Scheduler.nSlots);
+            m_Controller.Update(2);
+            Assert::AreEqual(2, m_Scheduler.nSlots);
+            m_Controller.Stop();
+        }
+    };
+}
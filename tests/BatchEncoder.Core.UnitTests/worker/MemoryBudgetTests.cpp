@@ -0,0 +1,112 @@
+﻿// Copyright (c) Wiesław Šoltés. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include "worker\MemoryBudget.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace BatchEncoderCoreUnitTests
+{
+    TEST_CLASS(CMemoryBudget_Tests)
+    {
+    public:
+        TEST_METHOD(CMemoryBudget_Constructor)
+        {
+            worker::CMemoryBudget m_Budget;
+
+            Assert::IsTrue(m_Budget.Reserved() == 0);
+            Assert::AreEqual(0, m_Budget.Admitted());
+            Assert::IsTrue(m_Budget.pStatus == nullptr);
+        }
+
+        TEST_METHOD(CMemoryBudget_Estimate)
+        {
+            worker::CMemoryBudget m_Budget;
+            m_Budget.nDefaultEstimate = 100;
+
+            // unknown format uses default, format estimate wins until measured peak is larger
+            Assert::IsTrue(m_Budget.Estimate(L"FLAC", 0) == 100);
+            Assert::IsTrue(m_Budget.Estimate(L"FLAC", 40) == 40);
+
+            TestWorkerContext ctx;
+            ctx.Init();
+            m_Budget.nBudget = 1000;
+
+            unsigned __int64 nReserved = 0;
+            Assert::IsTrue(m_Budget.Acquire(&ctx, L"FLAC", 40, nReserved));
+            m_Budget.Release(L"FLAC", nReserved, 250);
+
+            Assert::IsTrue(m_Budget.Estimate(L"FLAC", 40) == 250);
+            Assert::IsTrue(m_Budget.Estimate(L"FLAC", 300) == 300);
+            Assert::IsTrue(m_Budget.Estimate(L"LAME", 0) == 100);
+        }
+
+        TEST_METHOD(CMemoryBudget_Acquire_Budget)
+        {
+            worker::CMemoryBudget m_Budget;
+            m_Budget.nBudget = 100;
+
+            TestWorkerContext ctx;
+            ctx.Init();
+
+            unsigned __int64 nFirst = 0;
+            unsigned __int64 nSecond = 0;
+            Assert::IsTrue(m_Budget.Acquire(&ctx, L"EAC3TO", 60, nFirst));
+            Assert::IsTrue(nFirst == 60);
+            Assert::IsTrue(m_Budget.Reserved() == 60);
+
+            // would exceed budget, stopped context returns instead of waiting
+            ctx.bRunning = false;
+            Assert::IsFalse(m_Budget.Acquire(&ctx, L"EAC3TO", 60, nSecond));
+            Assert::AreEqual(1, m_Budget.Admitted());
+
+            m_Budget.Release(L"EAC3TO", nFirst, 0);
+            Assert::IsTrue(m_Budget.Reserved() == 0);
+
+            Assert::IsTrue(m_Budget.Acquire(&ctx, L"EAC3TO", 60, nSecond));
+            Assert::AreEqual(1, m_Budget.Admitted());
+        }
+
+        TEST_METHOD(CMemoryBudget_Acquire_Oversized)
+        {
+            worker::CMemoryBudget m_Budget;
+            m_Budget.nBudget = 100;
+
+            TestWorkerContext ctx;
+            ctx.Init();
+            ctx.bRunning = false;
+
+            // single item larger than budget still runs alone
+            unsigned __int64 nReserved = 0;
+            Assert::IsTrue(m_Budget.Acquire(&ctx, L"FFMPEG", 500, nReserved));
+            Assert::IsTrue(m_Budget.Reserved() == 500);
+        }
+
+        TEST_METHOD(CMemoryBudget_Acquire_Pressure)
+        {
+            auto status = std::make_shared<TestMemoryStatus>();
+            status->nAvailable = 50;
+
+            worker::CMemoryBudget m_Budget;
+            m_Budget.nBudget = 1000;
+            m_Budget.pStatus = status;
+
+            TestWorkerContext ctx;
+            ctx.Init();
+            ctx.bRunning = false;
+
+            unsigned __int64 nFirst = 0;
+            unsigned __int64 nSecond = 0;
+            Assert::IsTrue(m_Budget.Acquire(&ctx, L"FLAC", 60, nFirst));
+
+            // within budget but not enough available memory
+            Assert::IsFalse(m_Budget.Acquire(&ctx, L"FLAC", 60, nSecond));
+
+            status->nAvailable = 500;
+            Assert::IsTrue(m_Budget.Acquire(&ctx, L"FLAC", 60, nSecond));
+            Assert::AreEqual(2, m_Budget.Admitted());
+        }
+    };
+}
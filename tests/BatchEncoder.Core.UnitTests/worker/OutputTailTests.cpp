@@ -0,0 +1,108 @@
+﻿// Copyright (c) Wiesław Šoltés. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include "worker\OutputTail.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace BatchEncoderCoreUnitTests
+{
+    TEST_CLASS(COutputTail_Tests)
+    {
+    public:
+        TEST_METHOD(COutputTail_Constructor)
+        {
+            worker::COutputTail m_Tail;
+
+            Assert::IsTrue(m_Tail.Capacity() == 0);
+            Assert::IsTrue(m_Tail.Length() == 0);
+            Assert::AreEqual("", m_Tail.ToString().c_str());
+        }
+
+        TEST_METHOD(COutputTail_Append_Disabled)
+        {
+            worker::COutputTail m_Tail;
+
+            m_Tail.AppendLine("error");
+
+            Assert::IsTrue(m_Tail.Length() == 0);
+        }
+
+        TEST_METHOD(COutputTail_AppendLine)
+        {
+            worker::COutputTail m_Tail;
+            m_Tail.Resize(64);
+
+            m_Tail.AppendLine("first");
+            m_Tail.AppendLine("second");
+
+            Assert::AreEqual("first\nsecond", m_Tail.ToString().c_str());
+            Assert::AreEqual("second", m_Tail.LastLine().c_str());
+        }
+
+        TEST_METHOD(COutputTail_Wrap)
+        {
+            worker::COutputTail m_Tail;
+            m_Tail.Resize(16);
+
+            m_Tail.AppendLine("line 1");
+            m_Tail.AppendLine("line 2");
+            m_Tail.AppendLine("line 3");
+
+            Assert::IsTrue(m_Tail.Length() == 16);
+            Assert::AreEqual("line 2\nline 3", m_Tail.ToString().c_str());
+            Assert::AreEqual("line 3", m_Tail.LastLine().c_str());
+        }
+
+        TEST_METHOD(COutputTail_Append_Large)
+        {
+            worker::COutputTail m_Tail;
+            m_Tail.Resize(8);
+
+            m_Tail.Append("0123456789abcdef", 16);
+
+            Assert::AreEqual("89abcdef", m_Tail.ToString().c_str());
+        }
+
+        TEST_METHOD(COutputTail_Write)
+        {
+            worker::COutputTail m_Tail;
+            m_Tail.Resize(64);
+
+            m_Tail.Write("first\r\nsec", 10);
+            m_Tail.Write("ond\t\b\r", 6);
+            m_Tail.Write("last", 4);
+            m_Tail.EndLine();
+
+            Assert::AreEqual("first\nsecond\nlast", m_Tail.ToString().c_str());
+        }
+
+        TEST_METHOD(COutputTail_Write_Long)
+        {
+            worker::COutputTail m_Tail;
+            m_Tail.Resize(16384);
+
+            std::string szLong(10000, 'x');
+            m_Tail.Write(szLong.c_str(), 3000);
+            m_Tail.Write(szLong.c_str() + 3000, 7000);
+            m_Tail.Write("\n", 1);
+
+            std::string szExpected = std::string(4096, 'x') + "\n" + std::string(4096, 'x') + "\n" + std::string(1808, 'x');
+            Assert::AreEqual(szExpected.c_str(), m_Tail.ToString().c_str());
+        }
+
+        TEST_METHOD(COutputTail_Resize)
+        {
+            worker::COutputTail m_Tail;
+            m_Tail.Resize(32);
+            m_Tail.AppendLine("error");
+
+            m_Tail.Resize(32);
+
+            Assert::IsTrue(m_Tail.Capacity() == 32);
+            Assert::IsTrue(m_Tail.Length() == 0);
+        }
+    };
+}
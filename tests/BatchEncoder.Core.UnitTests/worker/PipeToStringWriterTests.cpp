@@ -21,5 +21,36 @@ namespace BatchEncoderCoreUnitTests
         TEST_METHOD(CPipeToStringWriter_WriteLoop)
         {
         }
+
+        TEST_METHOD(CPipeToStringWriter_DrainLoop_Long)
+        {
+            worker::Win32Pipe m_Pipe;
+            worker::CPipeToStringWriter m_Writer;
+            worker::COutputTail m_Tail;
+            m_Tail.Resize(16384);
+            m_Writer.nIndex = 0;
+            m_Writer.tail = &m_Tail;
+
+            Assert::IsTrue(m_Pipe.Create());
+
+            std::string szLong(10000, 'x');
+            std::string szOutput = szLong + "\r\nlast line\r\n";
+            std::thread writeThread([&]()
+            {
+                DWORD dwWriteBytes = 0L;
+                ::WriteFile(m_Pipe.WriteHandle(), szOutput.c_str(), (DWORD)szOutput.length(), &dwWriteBytes, 0);
+                m_Pipe.CloseWrite();
+            });
+
+            Assert::IsTrue(m_Writer.DrainLoop(&m_Pipe));
+            writeThread.join();
+            m_Pipe.CloseRead();
+
+            std::string szExpected = std::string(4096, 'x') + "\n" + std::string(4096, 'x') + "\n" + std::string(1808, 'x') + "\nlast line";
+            Assert::IsTrue(m_Writer.bFinished == true);
+            Assert::IsTrue(m_Writer.bError == false);
+            Assert::AreEqual(szExpected.c_str(), m_Tail.ToString().c_str());
+            Assert::AreEqual("last line", m_Tail.LastLine().c_str());
+        }
     };
 }
@@ -0,0 +1,118 @@
+﻿// Copyright (c) Wiesław Šoltés. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include "worker\ProcessLimits.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace BatchEncoderCoreUnitTests
+{
+    TEST_CLASS(CProcessLimits_Tests)
+    {
+    public:
+        TEST_METHOD(CProcessLimits_Constructor)
+        {
+            worker::CProcessLimits m_Limits;
+
+            Assert::AreEqual(0, m_Limits.nNice);
+            Assert::AreEqual(0, m_Limits.nIoClass);
+            Assert::IsTrue(m_Limits.nMemoryLimit == 0);
+            Assert::IsTrue(m_Limits.nWorkingSetLimit == 0);
+            Assert::AreEqual(0, m_Limits.nWallTime);
+            Assert::IsFalse(m_Limits.HasMemoryLimits());
+            Assert::AreEqual(0, m_Limits.PriorityLevel());
+        }
+
+        TEST_METHOD(CProcessLimits_PriorityLevel)
+        {
+            worker::CProcessLimits m_Limits;
+
+            m_Limits.nNice = 19;
+            Assert::AreEqual(-2, m_Limits.PriorityLevel());
+            m_Limits.nNice = 15;
+            Assert::AreEqual(-2, m_Limits.PriorityLevel());
+            m_Limits.nNice = 10;
+            Assert::AreEqual(-1, m_Limits.PriorityLevel());
+            m_Limits.nNice = 1;
+            Assert::AreEqual(-1, m_Limits.PriorityLevel());
+            m_Limits.nNice = -5;
+            Assert::AreEqual(1, m_Limits.PriorityLevel());
+            m_Limits.nNice = -10;
+            Assert::AreEqual(2, m_Limits.PriorityLevel());
+            m_Limits.nNice = -20;
+            Assert::AreEqual(2, m_Limits.PriorityLevel());
+        }
+
+        TEST_METHOD(CProcessLimits_Get_Global)
+        {
+            config::COptions m_Options;
+            config::CFormat m_Format;
+            m_Options.Defaults();
+            m_Options.nProcessNice = 10;
+            m_Options.nProcessIoClass = 1;
+            m_Options.nProcessMemoryLimit = 512;
+            m_Options.nProcessWallTime = 60;
+
+            auto limits = worker::CProcessLimits::Get(m_Options, m_Format);
+
+            Assert::AreEqual(10, limits.nNice);
+            Assert::AreEqual(1, limits.nIoClass);
+            Assert::IsTrue(limits.nMemoryLimit == 512ULL * 1024 * 1024);
+            Assert::IsTrue(limits.nWorkingSetLimit == 0);
+            Assert::AreEqual(60, limits.nWallTime);
+            Assert::IsTrue(limits.HasMemoryLimits());
+        }
+
+        TEST_METHOD(CProcessLimits_Get_FormatOverrides)
+        {
+            config::COptions m_Options;
+            config::CFormat m_Format;
+            m_Options.Defaults();
+            m_Options.nProcessNice = 10;
+            m_Options.nProcessWallTime = 60;
+            m_Format.nNice = 19;
+            m_Format.nIoClass = 2;
+            m_Format.nWorkingSetLimit = 256;
+
+            auto limits = worker::CProcessLimits::Get(m_Options, m_Format);
+
+            Assert::AreEqual(19, limits.nNice);
+            Assert::AreEqual(2, limits.nIoClass);
+            Assert::IsTrue(limits.nMemoryLimit == 0);
+            Assert::IsTrue(limits.nWorkingSetLimit == 256ULL * 1024 * 1024);
+            Assert::AreEqual(60, limits.nWallTime);
+        }
+
+        TEST_METHOD(CProcessLimits_Get_FormatResets)
+        {
+            config::COptions m_Options;
+            config::CFormat m_Format;
+            m_Options.Defaults();
+            m_Options.nProcessNice = 10;
+            m_Options.nProcessIoClass = 2;
+            m_Options.nProcessMemoryLimit = 512;
+            m_Options.nProcessWallTime = 60;
+            m_Format.nNice = 0;
+            m_Format.nIoClass = 0;
+            m_Format.nMemoryLimit = 0;
+            m_Format.nWallTime = 0;
+
+            auto limits = worker::CProcessLimits::Get(m_Options, m_Format);
+
+            Assert::AreEqual(0, limits.nNice);
+            Assert::AreEqual(0, limits.nIoClass);
+            Assert::IsTrue(limits.nMemoryLimit == 0);
+            Assert::AreEqual(0, limits.nWallTime);
+            Assert::IsFalse(limits.HasMemoryLimits());
+        }
+
+        TEST_METHOD(CProcessLimits_Select)
+        {
+            Assert::AreEqual(10, worker::CProcessLimits::Select(config::CFormat::nInherit, 10));
+            Assert::AreEqual(0, worker::CProcessLimits::Select(0, 10));
+            Assert::AreEqual(-1, worker::CProcessLimits::Select(-1, 10));
+        }
+    };
+}
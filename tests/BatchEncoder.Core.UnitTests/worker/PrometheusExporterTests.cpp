@@ -0,0 +1,100 @@
+﻿// Copyright (c) Wiesław Šoltés. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include "worker\PrometheusExporter.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace BatchEncoderCoreUnitTests
+{
+    TEST_CLASS(CPrometheusExporter_Tests)
+    {
+    public:
+        TEST_METHOD(CPrometheusExporter_Constructor)
+        {
+            worker::CPrometheusExporter m_Exporter;
+
+            Assert::AreEqual(1000.0, m_Exporter.fInterval);
+        }
+
+        TEST_METHOD(CPrometheusExporter_ToText_Counters)
+        {
+            worker::CPrometheusExporter m_Exporter;
+            TestWorkerContext ctx;
+            ctx.Init();
+            ctx.nThreadCount = 4;
+            ctx.nTotalFiles = 10;
+            ctx.nProcessedFiles = 5;
+            ctx.nErrors = 1;
+            ctx.nRunningFiles = 3;
+            ctx.nActiveProcesses = 2;
+
+            std::string szText = m_Exporter.ToText(&ctx);
+            Assert::IsTrue(szText.find("batchencoder_items_total 10\n") != std::string::npos);
+            Assert::IsTrue(szText.find("batchencoder_items_queued 2\n") != std::string::npos);
+            Assert::IsTrue(szText.find("batchencoder_items_running 3\n") != std::string::npos);
+            Assert::IsTrue(szText.find("batchencoder_items_done_total 4\n") != std::string::npos);
+            Assert::IsTrue(szText.find("batchencoder_items_failed_total 1\n") != std::string::npos);
+            Assert::IsTrue(szText.find("batchencoder_progress_percent 50\n") != std::string::npos);
+            Assert::IsTrue(szText.find("batchencoder_processes_active 2\n") != std::string::npos);
+            Assert::IsTrue(szText.find("batchencoder_slots_total 4\n") != std::string::npos);
+            Assert::IsTrue(szText.find("# TYPE batchencoder_items_failed_total counter\n") != std::string::npos);
+        }
+
+        TEST_METHOD(CPrometheusExporter_Finished)
+        {
+            worker::CPrometheusExporter m_Exporter;
+            TestWorkerContext ctx;
+            ctx.Init();
+            ctx.nThreadCount = 1;
+
+            worker::CItemMetrics metrics;
+            metrics.Reset(0);
+            metrics.szFormatId = L"LAME_MP3";
+            metrics.nBytesIn = 4000;
+            metrics.nBytesOut = 1000;
+            metrics.fTotalTime = 2000.0;
+            metrics.fUserTime = 1200.0;
+            metrics.fKernelTime = 300.0;
+            metrics.nPeakMemory = 65536;
+            metrics.bSuccess = false;
+            m_Exporter.Finished(metrics);
+
+            std::string szText = m_Exporter.ToText(&ctx);
+            Assert::IsTrue(szText.find("batchencoder_bytes_in_total 4000\n") != std::string::npos);
+            Assert::IsTrue(szText.find("batchencoder_bytes_out_total 1000\n") != std::string::npos);
+            Assert::IsTrue(szText.find("batchencoder_format_items_total{format=\"LAME_MP3\"} 1\n") != std::string::npos);
+            Assert::IsTrue(szText.find("batchencoder_format_failed_total{format=\"LAME_MP3\"} 1\n") != std::string::npos);
+            Assert::IsTrue(szText.find("batchencoder_format_seconds_total{format=\"LAME_MP3\"} 2\n") != std::string::npos);
+            Assert::IsTrue(szText.find("batchencoder_format_throughput_bytes_per_second{format=\"LAME_MP3\"} 2000\n") != std::string::npos);
+            Assert::IsTrue(szText.find("batchencoder_format_cpu_seconds_total{format=\"LAME_MP3\"} 1.5\n") != std::string::npos);
+            Assert::IsTrue(szText.find("batchencoder_format_peak_memory_bytes{format=\"LAME_MP3\"} 65536\n") != std::string::npos);
+        }
+
+        TEST_METHOD(CPrometheusExporter_Retried)
+        {
+            worker::CPrometheusExporter m_Exporter;
+            TestWorkerContext ctx;
+            ctx.Init();
+            ctx.nThreadCount = 1;
+
+            worker::CItemMetrics metrics;
+            metrics.Reset(0);
+            metrics.szFormatId = L"LAME_MP3";
+            metrics.szFailure = L"crash";
+            m_Exporter.Retried(metrics);
+            m_Exporter.Retried(metrics);
+            metrics.szFailure = L"exit";
+            m_Exporter.Finished(metrics);
+
+            std::string szText = m_Exporter.ToText(&ctx);
+            Assert::IsTrue(szText.find("batchencoder_retries_total 2\n") != std::string::npos);
+            Assert::IsTrue(szText.find("# TYPE batchencoder_failures_total counter\n") != std::string::npos);
+            Assert::IsTrue(szText.find("batchencoder_failures_total{class=\"crash\"} 2\n") != std::string::npos);
+            Assert::IsTrue(szText.find("batchencoder_failures_total{class=\"exit\"} 1\n") != std::string::npos);
+            Assert::IsTrue(szText.find("batchencoder_format_items_total{format=\"LAME_MP3\"} 1\n") != std::string::npos);
+        }
+    };
+}
@@ -0,0 +1,157 @@
+﻿// Copyright (c) Wiesław Šoltés. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include "worker\Retry.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace BatchEncoderCoreUnitTests
+{
+    TEST_CLASS(CRetryPolicy_Tests)
+    {
+    public:
+        TEST_METHOD(CRetryPolicy_Constructor)
+        {
+            worker::CRetryPolicy m_Policy;
+
+            Assert::AreEqual(1, m_Policy.nMaxAttempts);
+            Assert::AreEqual(1000, m_Policy.nBaseDelay);
+            Assert::AreEqual(30000, m_Policy.nMaxDelay);
+            Assert::IsTrue(m_Policy.Patterns() == 0);
+            Assert::IsFalse(m_Policy.ShouldRetry(worker::FailureClass::Crash, 1));
+        }
+
+        TEST_METHOD(CRetryPolicy_SetPatterns)
+        {
+            worker::CRetryPolicy m_Policy;
+            m_Policy.SetPatterns(L"Network||Sharing Violation|");
+
+            Assert::IsTrue(m_Policy.Patterns() == 2);
+            Assert::IsTrue(m_Policy.Matches(L"The specified NETWORK name is no longer available."));
+            Assert::IsTrue(m_Policy.Matches(L"error: sharing violation"));
+            Assert::IsFalse(m_Policy.Matches(L"Unsupported sample rate"));
+            Assert::IsFalse(m_Policy.Matches(L""));
+        }
+
+        TEST_METHOD(CRetryPolicy_IsCrash)
+        {
+            Assert::IsTrue(worker::CRetryPolicy::IsCrash((int)0xC0000017));
+            Assert::IsTrue(worker::CRetryPolicy::IsCrash((int)0xC0000142));
+            Assert::IsFalse(worker::CRetryPolicy::IsCrash((int)0xC0000005));
+            Assert::IsFalse(worker::CRetryPolicy::IsCrash((int)0xC00000FD));
+            Assert::IsFalse(worker::CRetryPolicy::IsCrash((int)0xC000013A));
+            Assert::IsFalse(worker::CRetryPolicy::IsCrash(-1));
+            Assert::IsFalse(worker::CRetryPolicy::IsCrash(0));
+            Assert::IsFalse(worker::CRetryPolicy::IsCrash(1));
+        }
+
+        TEST_METHOD(CRetryPolicy_IsFault)
+        {
+            Assert::IsTrue(worker::CRetryPolicy::IsFault((int)0xC0000005));
+            Assert::IsTrue(worker::CRetryPolicy::IsFault((int)0xC00000FD));
+            Assert::IsFalse(worker::CRetryPolicy::IsFault(-1));
+            Assert::IsFalse(worker::CRetryPolicy::IsFault(1));
+            Assert::IsTrue(worker::CRetryPolicy::IsInterrupt((int)0xC000013A));
+            Assert::IsFalse(worker::CRetryPolicy::IsInterrupt((int)0xC0000005));
+        }
+
+        TEST_METHOD(CRetryPolicy_Classify)
+        {
+            worker::CRetryPolicy m_Policy;
+            m_Policy.SetPatterns(L"i/o error");
+            worker::CItemMetrics metrics;
+            metrics.Reset(0);
+
+            metrics.bSuccess = true;
+            Assert::IsTrue(m_Policy.Classify(metrics, false) == worker::FailureClass::None);
+
+            metrics.bSuccess = false;
+            Assert::IsTrue(m_Policy.Classify(metrics, false) == worker::FailureClass::Error);
+            Assert::IsTrue(m_Policy.Classify(metrics, true) == worker::FailureClass::Cancelled);
+
+            metrics.nExitCode = 1;
+            Assert::IsTrue(m_Policy.Classify(metrics, false) == worker::FailureClass::Exit);
+
+            metrics.szStderrTail = L"read failed: I/O error";
+            Assert::IsTrue(m_Policy.Classify(metrics, false) == worker::FailureClass::Stderr);
+
+            metrics.bIoFailed = true;
+            Assert::IsTrue(m_Policy.Classify(metrics, false) == worker::FailureClass::Io);
+
+            metrics.nExitCode = (int)0xC0000005;
+            Assert::IsTrue(m_Policy.Classify(metrics, false) == worker::FailureClass::Fault);
+
+            metrics.nExitCode = (int)0xC0000017;
+            Assert::IsTrue(m_Policy.Classify(metrics, false) == worker::FailureClass::Crash);
+
+            metrics.nExitCode = (int)0xC000013A;
+            Assert::IsTrue(m_Policy.Classify(metrics, false) == worker::FailureClass::Cancelled);
+
+            metrics.bStartFailed = true;
+            Assert::IsTrue(m_Policy.Classify(metrics, false) == worker::FailureClass::Start);
+
+            metrics.szTimeout = L"stall";
+            Assert::IsTrue(m_Policy.Classify(metrics, false) == worker::FailureClass::Stall);
+
+            metrics.szTimeout = L"wall";
+            Assert::IsTrue(m_Policy.Classify(metrics, false) == worker::FailureClass::WallTime);
+        }
+
+        TEST_METHOD(CRetryPolicy_IsTransient)
+        {
+            Assert::IsTrue(worker::CRetryPolicy::IsTransient(worker::FailureClass::Crash));
+            Assert::IsTrue(worker::CRetryPolicy::IsTransient(worker::FailureClass::Io));
+            Assert::IsTrue(worker::CRetryPolicy::IsTransient(worker::FailureClass::Stderr));
+            Assert::IsTrue(worker::CRetryPolicy::IsTransient(worker::FailureClass::Stall));
+            Assert::IsFalse(worker::CRetryPolicy::IsTransient(worker::FailureClass::None));
+            Assert::IsFalse(worker::CRetryPolicy::IsTransient(worker::FailureClass::Cancelled));
+            Assert::IsFalse(worker::CRetryPolicy::IsTransient(worker::FailureClass::Fault));
+            Assert::IsFalse(worker::CRetryPolicy::IsTransient(worker::FailureClass::Start));
+            Assert::IsFalse(worker::CRetryPolicy::IsTransient(worker::FailureClass::Exit));
+            Assert::IsFalse(worker::CRetryPolicy::IsTransient(worker::FailureClass::WallTime));
+            Assert::IsFalse(worker::CRetryPolicy::IsTransient(worker::FailureClass::Error));
+        }
+
+        TEST_METHOD(CRetryPolicy_ShouldRetry)
+        {
+            worker::CRetryPolicy m_Policy;
+            m_Policy.nMaxAttempts = 3;
+
+            Assert::IsTrue(m_Policy.ShouldRetry(worker::FailureClass::Crash, 1));
+            Assert::IsTrue(m_Policy.ShouldRetry(worker::FailureClass::Io, 2));
+            Assert::IsFalse(m_Policy.ShouldRetry(worker::FailureClass::Io, 3));
+            Assert::IsFalse(m_Policy.ShouldRetry(worker::FailureClass::Exit, 1));
+            Assert::IsFalse(m_Policy.ShouldRetry(worker::FailureClass::Start, 1));
+        }
+
+        TEST_METHOD(CRetryPolicy_Delay)
+        {
+            worker::CRetryPolicy m_Policy;
+            m_Policy.nBaseDelay = 500;
+            m_Policy.nMaxDelay = 3000;
+
+            Assert::AreEqual(500, m_Policy.Delay(1));
+            Assert::AreEqual(1000, m_Policy.Delay(2));
+            Assert::AreEqual(2000, m_Policy.Delay(3));
+            Assert::AreEqual(3000, m_Policy.Delay(4));
+            Assert::AreEqual(3000, m_Policy.Delay(100));
+
+            m_Policy.nMaxDelay = 0;
+            Assert::AreEqual(0x7FFFFFFF, m_Policy.Delay(100));
+
+            m_Policy.nBaseDelay = 0;
+            Assert::AreEqual(0, m_Policy.Delay(3));
+        }
+
+        TEST_METHOD(CRetryPolicy_ToString)
+        {
+            Assert::AreEqual(L"crash", worker::CRetryPolicy::ToString(worker::FailureClass::Crash));
+            Assert::AreEqual(L"fault", worker::CRetryPolicy::ToString(worker::FailureClass::Fault));
+            Assert::AreEqual(L"stderr", worker::CRetryPolicy::ToString(worker::FailureClass::Stderr));
+            Assert::AreEqual(L"walltime", worker::CRetryPolicy::ToString(worker::FailureClass::WallTime));
+            Assert::AreEqual(L"", worker::CRetryPolicy::ToString(worker::FailureClass::None));
+        }
+    };
+}
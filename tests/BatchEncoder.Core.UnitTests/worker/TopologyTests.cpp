@@ -0,0 +1,99 @@
+﻿// Copyright (c) Wiesław Šoltés. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include "worker\Topology.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace BatchEncoderCoreUnitTests
+{
+    TEST_CLASS(CProcessorTopology_Tests)
+    {
+        static worker::CProcessorTopology Topology(int nNodes, int nCoresPerNode, int nThreadsPerCore)
+        {
+            worker::CProcessorTopology topology;
+            int nProcessor = 0;
+            for (int n = 0; n < nNodes; n++)
+            {
+                for (int c = 0; c < nCoresPerNode; c++)
+                {
+                    worker::CProcessorCore core;
+                    core.nNode = n;
+                    for (int t = 0; t < nThreadsPerCore; t++)
+                        core.nMask |= 1ULL << nProcessor++;
+                    topology.m_Cores.push_back(core);
+                }
+            }
+            return topology;
+        }
+    public:
+        TEST_METHOD(CProcessorTopology_DefaultThreadCount)
+        {
+            worker::CProcessorTopology m_Topology = Topology(2, 4, 2);
+
+            Assert::AreEqual(8, m_Topology.Cores());
+            Assert::AreEqual(8, m_Topology.DefaultThreadCount());
+
+            m_Topology.nQuota = 3;
+            Assert::AreEqual(3, m_Topology.DefaultThreadCount());
+
+            m_Topology.nQuota = 32;
+            Assert::AreEqual(8, m_Topology.DefaultThreadCount());
+        }
+
+        TEST_METHOD(CProcessorTopology_DefaultThreadCount_Empty)
+        {
+            worker::CProcessorTopology m_Topology;
+
+            Assert::AreEqual(0, m_Topology.Cores());
+            Assert::AreEqual(1, m_Topology.DefaultThreadCount());
+            Assert::AreEqual((size_t)0, m_Topology.SlotMasks(4).size());
+        }
+
+        TEST_METHOD(CProcessorTopology_SlotMasks_OneNodePerSlot)
+        {
+            worker::CProcessorTopology m_Topology = Topology(2, 4, 2);
+
+            auto masks = m_Topology.SlotMasks(2);
+            Assert::AreEqual((size_t)2, masks.size());
+            Assert::IsTrue(masks[0] == 0x00FFULL);
+            Assert::IsTrue(masks[1] == 0xFF00ULL);
+        }
+
+        TEST_METHOD(CProcessorTopology_SlotMasks_Contiguous)
+        {
+            worker::CProcessorTopology m_Topology = Topology(2, 4, 2);
+
+            auto masks = m_Topology.SlotMasks(3);
+            Assert::AreEqual((size_t)3, masks.size());
+            Assert::IsTrue(masks[0] == 0x000FULL);
+            Assert::IsTrue(masks[1] == 0x00F0ULL);
+            Assert::IsTrue(masks[2] == 0x0F00ULL);
+        }
+
+        TEST_METHOD(CProcessorTopology_SlotMasks_NoCrossNode)
+        {
+            worker::CProcessorTopology m_Topology = Topology(2, 3, 1);
+
+            auto masks = m_Topology.SlotMasks(3);
+            Assert::AreEqual((size_t)3, masks.size());
+            Assert::IsTrue(masks[0] == 0x03ULL);
+            Assert::IsTrue(masks[1] == 0x18ULL);
+            Assert::IsTrue(masks[2] == 0x04ULL);
+        }
+
+        TEST_METHOD(CProcessorTopology_SlotMasks_MoreSlotsThanCores)
+        {
+            worker::CProcessorTopology m_Topology = Topology(2, 2, 2);
+
+            auto masks = m_Topology.SlotMasks(6);
+            Assert::AreEqual((size_t)6, masks.size());
+            Assert::IsTrue(masks[0] == 0x03ULL);
+            Assert::IsTrue(masks[3] == 0xC0ULL);
+            Assert::IsTrue(masks[4] == masks[0]);
+            Assert::IsTrue(masks[5] == masks[1]);
+        }
+    };
+}
@@ -0,0 +1,127 @@
+﻿// Copyright (c) Wiesław Šoltés. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include "worker\Tracer.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace BatchEncoderCoreUnitTests
+{
+    TEST_CLASS(CTracer_Tests)
+    {
+    public:
+        TEST_METHOD(CTracer_Constructor)
+        {
+            worker::CTracer m_Tracer;
+
+            Assert::IsFalse(m_Tracer.IsEnabled());
+            Assert::IsTrue(m_Tracer.Count() == 0);
+        }
+
+        TEST_METHOD(CTracer_Start_Empty)
+        {
+            worker::CTracer m_Tracer;
+
+            m_Tracer.Start(L"");
+
+            Assert::IsFalse(m_Tracer.IsEnabled());
+            Assert::IsFalse(m_Tracer.Stop());
+        }
+
+        TEST_METHOD(CTracer_Add)
+        {
+            worker::CTracer m_Tracer;
+
+            m_Tracer.Add("worker", "Convert", 0, 10, 25);
+            m_Tracer.Add("lock", "m_down", -1, 12, 14);
+
+            Assert::IsTrue(m_Tracer.Count() == 2);
+        }
+
+        TEST_METHOD(CTracer_Add_New_Instance)
+        {
+            // tracer constructed at the address of a destroyed one gets its own buffers
+            for (int i = 0; i < 2; i++)
+            {
+                worker::CTracer m_Tracer;
+                m_Tracer.Add("worker", "Convert", i, 10, 25);
+                Assert::IsTrue(m_Tracer.Count() == 1);
+            }
+        }
+
+        TEST_METHOD(CTracer_Add_After_Start)
+        {
+            worker::CTracer m_Tracer;
+
+            m_Tracer.Add("worker", "Convert", 0, 10, 25);
+            m_Tracer.Start(L"trace.json");
+            Assert::IsTrue(m_Tracer.Count() == 0);
+
+            m_Tracer.Add("worker", "Convert", 1, 30, 45);
+            Assert::IsTrue(m_Tracer.Count() == 1);
+        }
+
+        TEST_METHOD(CTracer_ToJson)
+        {
+            worker::CTracer m_Tracer;
+
+            m_Tracer.Add("worker", "Encode", 3, 100, 250);
+
+            std::string szJson = m_Tracer.ToJson();
+            Assert::IsTrue(szJson.find("\"traceEvents\":[") != std::string::npos);
+            Assert::IsTrue(szJson.find("\"name\":\"Encode\"") != std::string::npos);
+            Assert::IsTrue(szJson.find("\"cat\":\"worker\"") != std::string::npos);
+            Assert::IsTrue(szJson.find("\"ph\":\"X\"") != std::string::npos);
+            Assert::IsTrue(szJson.find("\"ts\":100,\"dur\":150") != std::string::npos);
+            Assert::IsTrue(szJson.find("\"args\":{\"item\":3}") != std::string::npos);
+        }
+
+        TEST_METHOD(CTracer_ToJson_Empty)
+        {
+            worker::CTracer m_Tracer;
+
+            std::string szJson = m_Tracer.ToJson();
+            Assert::AreEqual("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[]}\n", szJson.c_str());
+        }
+
+        TEST_METHOD(CTracer_Macros)
+        {
+            // the unit test project is built with BATCHENCODER_TRACE
+            Assert::IsTrue(worker::CTracer::IsCompiled());
+
+            wchar_t szTempPath[MAX_PATH];
+            ::GetTempPathW(MAX_PATH, szTempPath);
+            std::wstring szFileName = std::wstring(szTempPath) + L"BatchEncoder.TracerTests.json";
+            std::mutex m_Lock;
+
+            TRACE_BEGIN(szFileName);
+            Assert::IsTrue(worker::CTracer::Instance().IsEnabled());
+            {
+                TRACE_THREAD_NAME("worker", 2);
+                TRACE_SPAN_ITEM("worker", "Convert", 7);
+                TRACE_LOCK(m_Lock, "m_Lock");
+                m_Lock.unlock();
+            }
+            Assert::IsTrue(worker::CTracer::Instance().Count() == 2);
+            TRACE_END();
+            Assert::IsFalse(worker::CTracer::Instance().IsEnabled());
+
+            std::string szJson;
+            FILE *fs = nullptr;
+            Assert::IsTrue(_wfopen_s(&fs, szFileName.c_str(), L"rb") == 0 && fs != nullptr);
+            char szBuffer[4096];
+            size_t nRead;
+            while ((nRead = fread(szBuffer, 1, sizeof(szBuffer), fs)) > 0)
+                szJson.append(szBuffer, nRead);
+            fclose(fs);
+            ::DeleteFileW(szFileName.c_str());
+
+            Assert::IsTrue(szJson.find("\"args\":{\"name\":\"worker 2\"}") != std::string::npos);
+            Assert::IsTrue(szJson.find("\"name\":\"Convert\",\"cat\":\"worker\"") != std::string::npos);
+            Assert::IsTrue(szJson.find("\"args\":{\"item\":7}") != std::string::npos);
+            Assert::IsTrue(szJson.find("\"name\":\"m_Lock\",\"cat\":\"lock\"") != std::string::npos);
+        }
+    };
+}
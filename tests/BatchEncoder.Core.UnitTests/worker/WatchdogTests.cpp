@@ -0,0 +1,237 @@
+﻿// Copyright (c) Wiesław Šoltés. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include "stdafx.h"
+#include "CppUnitTest.h"
+#include "worker\Watchdog.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace BatchEncoderCoreUnitTests
+{
+    class TestStalledProcess : public TestProcess
+    {
+    public:
+        unsigned __int64 nBytes = 0;
+        int nTerminated = 0;
+    public:
+        bool Terminate(int code = 0)
+        {
+            this->nTerminated++;
+            return true;
+        }
+        unsigned __int64 IoBytes()
+        {
+            return this->nBytes;
+        }
+    };
+
+    TEST_CLASS(CWatchdog_Tests)
+    {
+    public:
+        TEST_METHOD(CWatchdogJob_Check_Stall)
+        {
+            worker::CWatchdogJob m_Job;
+            m_Job.fStallTimeout = 1000.0;
+
+            Assert::IsTrue(m_Job.Check(500.0, 0, 10) == worker::WatchdogReason::None);
+            Assert::IsTrue(m_Job.Check(1400.0, 0, 10) == worker::WatchdogReason::None);
+            Assert::IsTrue(m_Job.Check(1500.0, 0, 10) == worker::WatchdogReason::Stall);
+        }
+
+        TEST_METHOD(CWatchdogJob_Check_Progress)
+        {
+            worker::CWatchdogJob m_Job;
+            m_Job.fStallTimeout = 1000.0;
+
+            // progress without i/o is activity
+            Assert::IsTrue(m_Job.Check(900.0, 5, 0) == worker::WatchdogReason::None);
+            Assert::IsTrue(m_Job.Check(1800.0, 10, 0) == worker::WatchdogReason::None);
+            Assert::IsTrue(m_Job.Check(2700.0, 10, 0) == worker::WatchdogReason::None);
+            Assert::IsTrue(m_Job.Check(2800.0, 10, 0) == worker::WatchdogReason::Stall);
+        }
+
+        TEST_METHOD(CWatchdogJob_Check_WallTime)
+        {
+            worker::CWatchdogJob m_Job;
+            m_Job.fStallTimeout = 1000.0;
+            m_Job.fWallTimeout = 2000.0;
+
+            Assert::IsTrue(m_Job.Check(900.0, 0, 100) == worker::WatchdogReason::None);
+            Assert::IsTrue(m_Job.Check(1800.0, 0, 200) == worker::WatchdogReason::None);
+            Assert::IsTrue(m_Job.Check(2000.0, 0, 300) == worker::WatchdogReason::WallTime);
+        }
+
+        TEST_METHOD(CWatchdogJob_Check_Disabled)
+        {
+            worker::CWatchdogJob m_Job;
+
+            Assert::IsTrue(m_Job.Check(1000000.0, 0, 0) == worker::WatchdogReason::None);
+        }
+
+        TEST_METHOD(CWatchdogJob_Resume)
+        {
+            worker::CWatchdogJob m_Job;
+            m_Job.fStallTimeout = 1000.0;
+            m_Job.fWallTimeout = 2000.0;
+            m_Job.fStart = 0.0;
+            m_Job.fLastActivity = 500.0;
+
+            // paused from 800 ms to 10800 ms
+            m_Job.Resume(800.0, 10800.0);
+            Assert::AreEqual(10000.0, m_Job.fStart);
+            Assert::AreEqual(10500.0, m_Job.fLastActivity);
+            Assert::IsTrue(m_Job.Check(11000.0, 0, 0) == worker::WatchdogReason::None);
+            Assert::IsTrue(m_Job.Check(11500.0, 0, 0) == worker::WatchdogReason::Stall);
+
+            // started while paused
+            worker::CWatchdogJob m_Late;
+            m_Late.fStart = 900.0;
+            m_Late.fLastActivity = 900.0;
+            m_Late.Resume(800.0, 1500.0);
+            Assert::AreEqual(1500.0, m_Late.fStart);
+            Assert::AreEqual(1500.0, m_Late.fLastActivity);
+        }
+
+        TEST_METHOD(CWatchdog_End)
+        {
+            worker::CWatchdog m_Watchdog;
+
+            Assert::IsTrue(m_Watchdog.End(0) == worker::WatchdogReason::None);
+
+            m_Watchdog.Begin(0, 10, 0);
+            Assert::IsTrue(m_Watchdog.End(0) == worker::WatchdogReason::None);
+        }
+
+        TEST_METHOD(CWatchdog_Poll_Kills_Stalled)
+        {
+            config::CConfig m_Config;
+            config::CItem m_Item;
+            m_Item.ResetProgress();
+            m_Config.m_Items.emplace_back(m_Item);
+
+            TestWorkerContext ctx;
+            ctx.Init();
+            ctx.pConfig = &m_Config;
+
+            auto process = std::make_shared<TestStalledProcess>();
+            worker::CWatchdog m_Watchdog;
+
+            // zero timeouts disable the watchdog for the item
+            m_Watchdog.Begin(0, 0, 0);
+            m_Watchdog.Attach(0, process);
+            m_Watchdog.Poll(&ctx);
+            Assert::AreEqual(0, process->nTerminated);
+            Assert::IsTrue(m_Watchdog.End(0) == worker::WatchdogReason::None);
+
+            m_Watchdog.Begin(0, 1, 0);
+            m_Watchdog.Attach(0, process);
+            m_Watchdog.Poll(&ctx);
+            Assert::AreEqual(0, process->nTerminated);
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+            m_Watchdog.Poll(&ctx);
+            Assert::AreEqual(1, process->nTerminated);
+
+            // killed job is not killed again
+            m_Watchdog.Poll(&ctx);
+            Assert::AreEqual(1, process->nTerminated);
+            Assert::IsTrue(m_Watchdog.End(0) == worker::WatchdogReason::Stall);
+        }
+
+        TEST_METHOD(CWatchdog_Poll_Activity)
+        {
+            config::CConfig m_Config;
+            config::CItem m_Item;
+            m_Item.ResetProgress();
+            m_Config.m_Items.emplace_back(m_Item);
+
+            TestWorkerContext ctx;
+            ctx.Init();
+            ctx.pConfig = &m_Config;
+
+            auto process = std::make_shared<TestStalledProcess>();
+            worker::CWatchdog m_Watchdog;
+            m_Watchdog.Begin(0, 1, 0);
+            m_Watchdog.Attach(0, process);
+
+            for (int i = 0; i < 3; i++)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(600));
+                process->nBytes += 4096;
+                m_Watchdog.Poll(&ctx);
+            }
+
+            Assert::AreEqual(0, process->nTerminated);
+            Assert::IsTrue(m_Watchdog.End(0) == worker::WatchdogReason::None);
+        }
+
+        TEST_METHOD(CWatchdog_Poll_Progress)
+        {
+            config::CConfig m_Config;
+            config::CItem m_Item;
+            m_Item.ResetProgress();
+            m_Config.m_Items.emplace_back(m_Item);
+
+            TestWorkerContext ctx;
+            ctx.Init();
+            ctx.pConfig = &m_Config;
+
+            auto process = std::make_shared<TestStalledProcess>();
+            worker::CWatchdog m_Watchdog;
+            m_Watchdog.Open(m_Config.m_Items.size());
+            ctx.pObserver = &m_Watchdog;
+            m_Watchdog.Begin(0, 1, 0);
+            m_Watchdog.Attach(0, process);
+
+            // progress is recorded by the watchdog when reported, not read back from the item
+            for (int i = 1; i <= 3; i++)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(600));
+                Assert::IsTrue(ctx.Progress(0, i * 10));
+                Assert::AreEqual(i * 10, m_Watchdog.Progress(0));
+                m_Watchdog.Poll(&ctx);
+            }
+
+            Assert::AreEqual(0, process->nTerminated);
+            Assert::IsTrue(m_Watchdog.End(0) == worker::WatchdogReason::None);
+
+            // a retried item starts from zero progress
+            m_Watchdog.Begin(0, 1, 0);
+            Assert::AreEqual(0, m_Watchdog.Progress(0));
+            m_Watchdog.ItemProgress(5, 50);
+            Assert::AreEqual(0, m_Watchdog.Progress(5));
+        }
+
+        TEST_METHOD(CWatchdog_Poll_Paused)
+        {
+            config::CConfig m_Config;
+            config::CItem m_Item;
+            m_Item.ResetProgress();
+            m_Config.m_Items.emplace_back(m_Item);
+
+            TestWorkerContext ctx;
+            ctx.Init();
+            ctx.pConfig = &m_Config;
+
+            auto process = std::make_shared<TestStalledProcess>();
+            worker::CWatchdog m_Watchdog;
+            m_Watchdog.Begin(0, 1, 0);
+            m_Watchdog.Attach(0, process);
+
+            ctx.Pause();
+            m_Watchdog.Poll(&ctx);
+            Assert::IsTrue(m_Watchdog.Paused());
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+            m_Watchdog.Poll(&ctx);
+            Assert::AreEqual(0, process->nTerminated);
+
+            ctx.Resume();
+            m_Watchdog.Poll(&ctx);
+            Assert::IsFalse(m_Watchdog.Paused());
+            Assert::AreEqual(0, process->nTerminated);
+            Assert::IsTrue(m_Watchdog.End(0) == worker::WatchdogReason::None);
+        }
+    };
+}
@@ -0,0 +1,402 @@
+﻿// Copyright (c) Wiesław Šoltés. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include "stdafx.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace BatchEncoderCoreUnitTests
+{
+    class StressFileSystem : public TestFileSystem
+    {
+    public:
+        __int64 GetFileSize64(const std::wstring& szFileName)
+        {
+            return 1024;
+        }
+        bool FileExists(const std::wstring& szPath)
+        {
+            return true;
+        }
+        void DeleteFile_(const std::wstring& szFilePath)
+        {
+        }
+        void SetCurrentDirectory_(const std::wstring& szPath)
+        {
+        }
+        bool DirectoryExists(const std::wstring& szPath)
+        {
+            return true;
+        }
+    };
+
+    class StressConverter : public IConverter
+    {
+    public:
+        std::vector<bool> m_Failures;
+        std::unique_ptr<std::atomic<int>[]> m_Runs;
+        std::atomic<int> nSucceeded;
+        std::atomic<int> nFailed;
+    public:
+        StressConverter(const std::vector<bool>& failures) : m_Failures(failures), m_Runs(new std::atomic<int>[failures.size()]), nSucceeded(0), nFailed(0)
+        {
+            for (size_t i = 0; i < failures.size(); i++)
+                this->m_Runs[i] = 0;
+        }
+    public:
+        bool Run(IWorkerContext* ctx, CCommandLine& cl, std::mutex& m_down)
+        {
+            this->m_Runs[cl.nItemId]++;
+
+            for (int nProgress = 25; nProgress <= 100; nProgress += 25)
+            {
+                if (ctx->ItemProgress(cl.nItemId, nProgress, false) == false)
+                    break;
+                std::this_thread::yield();
+            }
+
+            if (this->m_Failures[cl.nItemId] == true)
+            {
+                this->nFailed++;
+                ctx->ItemProgress(cl.nItemId, -1, true, true);
+                return false;
+            }
+
+            this->nSucceeded++;
+            ctx->ItemProgress(cl.nItemId, 100, true);
+            return true;
+        }
+    };
+
+    class HoldConverter : public StressConverter
+    {
+    public:
+        std::atomic<int> nEntered;
+        std::atomic<bool> bRelease;
+    public:
+        HoldConverter(const std::vector<bool>& failures) : StressConverter(failures), nEntered(0), bRelease(false)
+        {
+        }
+    public:
+        bool Run(IWorkerContext* ctx, CCommandLine& cl, std::mutex& m_down)
+        {
+            // items stay in their slots until released so the batch outlives the load changes
+            this->nEntered++;
+            while (this->bRelease == false && ctx->bRunning == true)
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            return StressConverter::Run(ctx, cl, m_down);
+        }
+    };
+
+    class StressSystemLoad : public ISystemLoad
+    {
+        std::mutex m_Lock;
+        CSystemLoad load;
+    public:
+        void Set(double fBusy, double fQueueLength)
+        {
+            std::lock_guard<std::mutex> lock(this->m_Lock);
+            this->load.fBusy = fBusy;
+            this->load.fQueueLength = fQueueLength;
+            this->load.nProcessors = 1;
+        }
+        bool Sample(CSystemLoad& load)
+        {
+            std::lock_guard<std::mutex> lock(this->m_Lock);
+            load = this->load;
+            return true;
+        }
+    };
+
+    class StressWorkerFactory : public TestWorkerFactory
+    {
+    public:
+        std::shared_ptr<StressSystemLoad> load = std::make_shared<StressSystemLoad>();
+    public:
+        std::shared_ptr<ISystemLoad> CreateSystemLoadPtr()
+        {
+            return this->load;
+        }
+    };
+
+    class StressWorkerContext : public TestWorkerContext
+    {
+    public:
+        std::unique_ptr<std::atomic<int>[]> m_Calls;
+        std::atomic<int> nTotalProgressCalls;
+        std::atomic<int> nStarted;
+        int nCancelAfter = -1;
+    public:
+        StressWorkerContext(int nCount) : m_Calls(new std::atomic<int>[nCount]), nTotalProgressCalls(0), nStarted(0)
+        {
+            for (int i = 0; i < nCount; i++)
+                this->m_Calls[i] = 0;
+        }
+    public:
+        void TotalProgress(int nItemId)
+        {
+            this->nTotalProgressCalls++;
+
+            // first call for an item is made before conversion starts
+            if (this->m_Calls[nItemId]++ == 0 && this->nCancelAfter >= 0)
+            {
+                if (++this->nStarted > this->nCancelAfter)
+                    this->bRunning = false;
+            }
+
+            TestWorkerContext::TotalProgress(nItemId);
+        }
+    };
+
+    TEST_CLASS(CWorker_Stress_Tests)
+    {
+        const int nItems = 10000;
+        const int nThreadCounts[4] = { 2, 8, 32, 64 };
+
+        config::CFormat m_Format
+        {
+            L"TEST_ID",
+            L"Name",
+            config::FormatType::Encoder,
+            0,
+            L"WAV",
+            L"MP3",
+            L"$EXE $OPTIONS $INFILE $OUTFILE",
+            false,
+            false,
+            L"script.lua",
+            L"program.exe",
+            0,
+            0,
+            {
+                { L"Default1", L"--option 1" },
+                { L"Default2", L"--option 2" }
+            }
+        };
+    public:
+        void Init(config::CConfig& m_Config, int nCount)
+        {
+            m_Config.FileSystem = std::make_unique<StressFileSystem>();
+            m_Config.Log = std::make_unique<util::MemoryLog>();
+            m_Config.Log->Open();
+            m_Config.m_Options.Defaults();
+            m_Config.m_Options.szOutputPath = L"C:\\Output\\$Name$.$Ext$";
+            m_Config.m_Formats.emplace_back(m_Format);
+
+            for (int i = 0; i < nCount; i++)
+            {
+                config::CItem item
+                {
+                    i,
+                    L"File" + std::to_wstring(i),
+                    L"WAV",
+                    L"TEST_ID",
+                    0,
+                    L"",
+                    true,
+                    1024,
+                    {
+                        { L"C:\\Input\\File" + std::to_wstring(i) + L".WAV" }
+                    },
+                    L"", L"", false, 0, 0
+                };
+                m_Config.m_Items.emplace_back(item);
+            }
+        }
+        static std::vector<bool> CreateFailures(int nCount, double fRate, unsigned int nSeed)
+        {
+            std::mt19937 rng(nSeed);
+            std::bernoulli_distribution fail(fRate);
+            std::vector<bool> failures(nCount);
+            for (int i = 0; i < nCount; i++)
+                failures[i] = fail(rng);
+            return failures;
+        }
+        static StressConverter* Run(std::unique_ptr<worker::CWorker>& pWorker, StressWorkerContext& ctx, config::CConfig& m_Config, const std::vector<bool>& failures, int nThreadCount)
+        {
+            ctx.Init();
+            ctx.nThreadCount = nThreadCount;
+            ctx.pConfig = &m_Config;
+
+            auto converter = std::make_unique<StressConverter>(failures);
+            auto pConverter = converter.get();
+
+            pWorker = std::make_unique<worker::CWorker>();
+            pWorker->ConsoleConverter = std::move(converter);
+            pWorker->PipesConverter = std::make_unique<worker::CPipesConverter>();
+            pWorker->PipesTranscoder = std::make_unique<worker::CPipesTranscoder>();
+            pWorker->Convert(&ctx, m_Config.m_Items);
+            return pConverter;
+        }
+        static bool WaitFor(const std::function<bool()>& condition)
+        {
+            for (int i = 0; i < 10000; i++)
+            {
+                if (condition() == true)
+                    return true;
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            return condition();
+        }
+    public:
+        TEST_METHOD(CWorker_Stress_Convert_Counters_Exact)
+        {
+            for (int nThreadCount : nThreadCounts)
+            {
+                config::CConfig m_Config;
+                Init(m_Config, nItems);
+
+                auto failures = CreateFailures(nItems, 0.1, (unsigned int)nThreadCount);
+                int nExpectedErrors = (int)std::count(failures.begin(), failures.end(), true);
+
+                std::unique_ptr<worker::CWorker> pWorker;
+                StressWorkerContext ctx(nItems);
+                auto& converter = *Run(pWorker, ctx, m_Config, failures, nThreadCount);
+                m_Config.Log->Close();
+
+                Assert::IsTrue(ctx.bDone);
+                Assert::AreEqual(nItems, (int)ctx.nTotalFiles);
+                Assert::AreEqual(nItems, (int)ctx.nProcessedFiles);
+                Assert::AreEqual(nExpectedErrors, (int)ctx.nErrors);
+                Assert::AreEqual(nExpectedErrors, (int)converter.nFailed);
+                Assert::AreEqual(nItems - nExpectedErrors, (int)converter.nSucceeded);
+                Assert::AreEqual(2 * nItems, (int)ctx.nTotalProgressCalls);
+                Assert::AreEqual(0, (int)ctx.nRunningFiles);
+
+                for (int i = 0; i < nItems; i++)
+                    Assert::AreEqual(1, (int)converter.m_Runs[i]);
+            }
+        }
+
+        TEST_METHOD(CWorker_Stress_Convert_Cancel)
+        {
+            for (int nThreadCount : nThreadCounts)
+            {
+                config::CConfig m_Config;
+                Init(m_Config, nItems);
+
+                std::unique_ptr<worker::CWorker> pWorker;
+                StressWorkerContext ctx(nItems);
+                ctx.nCancelAfter = nItems / 5;
+                auto& converter = *Run(pWorker, ctx, m_Config, CreateFailures(nItems, 0.1, (unsigned int)nThreadCount), nThreadCount);
+                m_Config.Log->Close();
+
+                // every dequeued item is counted once, cancelled items count as errors
+                int nProcessed = ctx.nProcessedFiles;
+                Assert::IsTrue(ctx.bDone);
+                Assert::IsFalse(ctx.bRunning);
+                Assert::AreEqual(nItems, (int)ctx.nTotalFiles);
+                Assert::IsTrue(nProcessed < nItems);
+                Assert::IsTrue(nProcessed <= ctx.nCancelAfter + nThreadCount);
+                Assert::AreEqual(2 * nProcessed, (int)ctx.nTotalProgressCalls);
+                Assert::AreEqual(nProcessed - (int)ctx.nErrors, (int)converter.nSucceeded);
+                Assert::AreEqual(0, (int)ctx.nRunningFiles);
+
+                for (int i = 0; i < nItems; i++)
+                    Assert::IsTrue(converter.m_Runs[i] <= 1);
+            }
+        }
+
+        TEST_METHOD(CWorker_Stress_Convert_Adaptive)
+        {
+            for (int nThreadCount : nThreadCounts)
+            {
+                config::CConfig m_Config;
+                Init(m_Config, nItems);
+                m_Config.m_Options.bAdaptiveThreadCount = true;
+                m_Config.m_Options.nMinThreadCount = 1;
+
+                auto factory = std::make_shared<StressWorkerFactory>();
+                StressWorkerContext ctx(nItems);
+                ctx.Init();
+                ctx.nThreadCount = nThreadCount;
+                ctx.pConfig = &m_Config;
+                ctx.pFactory = factory;
+
+                auto converter = std::make_unique<HoldConverter>(CreateFailures(nItems, 0.0, (unsigned int)nThreadCount));
+                auto& hold = *converter;
+
+                // short sampling interval, the worker keeps the tuning of an existing controller
+                auto pWorker = std::make_unique<worker::CWorker>();
+                pWorker->ConsoleConverter = std::move(converter);
+                pWorker->PipesConverter = std::make_unique<worker::CPipesConverter>();
+                pWorker->PipesTranscoder = std::make_unique<worker::CPipesTranscoder>();
+                pWorker->LoadController = std::make_unique<worker::CLoadController>();
+                pWorker->LoadController->nInterval = 5;
+                auto& controller = *pWorker->LoadController;
+
+                std::thread batch([&]() { pWorker->Convert(&ctx, m_Config.m_Items); });
+                bool bStarted = WaitFor([&]() { return hold.nEntered > 0; });
+                int nStartSlots = controller.nActiveSlots;
+
+                // long run queue on a busy host sheds slots down to the minimum
+                factory->load->Set(1.0, 4.0);
+                bool bShrunk = WaitFor([&]() { return controller.nActiveSlots < nThreadCount; });
+                bool bMinimum = WaitFor([&]() { return controller.nActiveSlots == 1; });
+
+                // idle host gives the slots back
+                factory->load->Set(0.1, 0.0);
+                bool bGrown = WaitFor([&]() { return controller.nActiveSlots > 1; });
+                bool bMaximum = WaitFor([&]() { return controller.nActiveSlots == nThreadCount; });
+
+                // held items are released before asserting so a failure never leaves the batch running
+                hold.bRelease = true;
+                batch.join();
+                m_Config.Log->Close();
+
+                Assert::IsTrue(bStarted);
+                Assert::AreEqual(nThreadCount, controller.nMaxSlots);
+                Assert::AreEqual(nThreadCount, nStartSlots);
+                Assert::IsTrue(bShrunk);
+                Assert::IsTrue(bMinimum);
+                Assert::IsTrue(bGrown);
+                Assert::IsTrue(bMaximum);
+
+                // slots still convert every item exactly once
+                Assert::IsTrue(ctx.bDone);
+                Assert::AreEqual(nItems, (int)ctx.nProcessedFiles);
+                Assert::AreEqual(0, (int)ctx.nErrors);
+                Assert::AreEqual(nItems, (int)hold.nSucceeded);
+                Assert::AreEqual(0, (int)ctx.nRunningFiles);
+                Assert::IsTrue(pWorker->LoadController.get() == &controller);
+
+                for (int i = 0; i < nItems; i++)
+                    Assert::AreEqual(1, (int)hold.m_Runs[i]);
+            }
+        }
+
+        TEST_METHOD(CWorker_Stress_Convert_StopOnErrors)
+        {
+            for (int nThreadCount : nThreadCounts)
+            {
+                config::CConfig m_Config;
+                Init(m_Config, nItems);
+                m_Config.m_Options.bStopOnErrors = true;
+
+                std::unique_ptr<worker::CWorker> pWorker;
+                StressWorkerContext ctx(nItems);
+                auto& converter = *Run(pWorker, ctx, m_Config, CreateFailures(nItems, 0.01, (unsigned int)nThreadCount), nThreadCount);
+                m_Config.Log->Close();
+
+                int nProcessed = ctx.nProcessedFiles;
+                Assert::IsTrue(ctx.bDone);
+                Assert::IsTrue(ctx.nErrors >= 1);
+                Assert::IsTrue(converter.nFailed >= 1);
+                Assert::AreEqual(2 * nProcessed, (int)ctx.nTotalProgressCalls);
+                Assert::AreEqual(nProcessed - (int)ctx.nErrors, (int)converter.nSucceeded);
+                Assert::AreEqual(0, (int)ctx.nRunningFiles);
+
+                for (int i = 0; i < nItems; i++)
+                    Assert::IsTrue(converter.m_Runs[i] <= 1);
+            }
+        }
+    };
+}
@@ -0,0 +1,229 @@
+﻿// Copyright (c) Wiesław Šoltés. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#define WIN32_LEAN_AND_MEAN
+#include <SDKDDKVer.h>
+#include <Windows.h>
+#include <io.h>
+#include <fcntl.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cwchar>
+#include <string>
+#include <chrono>
+#include <thread>
+
+// Stand-in for encoder and decoder tools used by benchmarks.
+// Usage: BatchEncoder.FakeEncoder.exe [options] <input|-> <output|->
+//   --style lame|flac|ffmpeg   stderr progress format (default: lame)
+//   --rate <MB/s>              input read rate limit, 0 is unlimited (default: 0)
+//   --cpu <ms>                 cpu time burned per MB of input (default: 0)
+//   --size <bytes>             expected input size when reading stdin (default: 0)
+//   --exit <code>              process exit code (default: 0)
+
+enum class ProgressStyle { Lame, Flac, FFmpeg };
+
+class CFakeEncoderOptions
+{
+public:
+    ProgressStyle nStyle = ProgressStyle::Lame;
+    double fRate = 0.0;
+    double fCpu = 0.0;
+    unsigned __int64 nSize = 0;
+    int nExitCode = 0;
+    std::wstring szInput;
+    std::wstring szOutput;
+public:
+    bool Parse(int argc, wchar_t *argv[])
+    {
+        int nFiles = 0;
+        for (int i = 1; i < argc; i++)
+        {
+            std::wstring szArg = argv[i];
+            bool bHasValue = i + 1 < argc;
+            if (szArg == L"--style" && bHasValue)
+            {
+                std::wstring szStyle = argv[++i];
+                if (szStyle == L"lame")
+                    this->nStyle = ProgressStyle::Lame;
+                else if (szStyle == L"flac")
+                    this->nStyle = ProgressStyle::Flac;
+                else if (szStyle == L"ffmpeg")
+                    this->nStyle = ProgressStyle::FFmpeg;
+                else
+                    return false;
+            }
+            else if (szArg == L"--rate" && bHasValue)
+                this->fRate = _wtof(argv[++i]);
+            else if (szArg == L"--cpu" && bHasValue)
+                this->fCpu = _wtof(argv[++i]);
+            else if (szArg == L"--size" && bHasValue)
+                this->nSize = _wcstoui64(argv[++i], nullptr, 10);
+            else if (szArg == L"--exit" && bHasValue)
+                this->nExitCode = _wtoi(argv[++i]);
+            else if (nFiles == 0)
+            {
+                this->szInput = szArg;
+                nFiles++;
+            }
+            else if (nFiles == 1)
+            {
+                this->szOutput = szArg;
+                nFiles++;
+            }
+            else
+                return false;
+        }
+        return nFiles == 2;
+    }
+};
+
+class CFakeEncoder
+{
+    CFakeEncoderOptions& options;
+    unsigned __int64 nTotal;
+    unsigned __int64 nProcessed;
+    int nLastPercent;
+public:
+    CFakeEncoder(CFakeEncoderOptions& options) : options(options)
+    {
+        this->nTotal = 0;
+        this->nProcessed = 0;
+        this->nLastPercent = -1;
+    }
+public:
+    void BurnCpu(double fMilliseconds)
+    {
+        auto tEnd = std::chrono::steady_clock::now() + std::chrono::duration<double, std::milli>(fMilliseconds);
+        volatile unsigned int nValue = 1;
+        while (std::chrono::steady_clock::now() < tEnd)
+        {
+            for (int i = 0; i < 1000; i++)
+                nValue = nValue * 1664525u + 1013904223u;
+        }
+    }
+    void Progress(bool bDone)
+    {
+        int nPercent = this->nTotal > 0 ? (int)((100 * this->nProcessed) / this->nTotal) : 0;
+        if (bDone == false && nPercent == this->nLastPercent)
+            return;
+
+        this->nLastPercent = nPercent;
+
+        unsigned __int64 nFrames = this->nProcessed / 4608;
+        unsigned __int64 nTotalFrames = this->nTotal / 4608;
+        switch (this->options.nStyle)
+        {
+        case ProgressStyle::Lame:
+            fprintf(stderr, "\r%8llu/%-8llu(%3d%%)|    0:00/    0:00|    0:00/    0:00|   0.0000x|    0:00 ",
+                nFrames, nTotalFrames, nPercent);
+            if (bDone == true)
+                fprintf(stderr, "\r\n");
+            break;
+        case ProgressStyle::Flac:
+            if (bDone == true)
+                fprintf(stderr, "\rinput.wav: wrote %llu bytes, ratio=1.000\r\n", this->nProcessed);
+            else
+                fprintf(stderr, "\rinput.wav: %d%% complete, ratio=1.000", nPercent);
+            break;
+        case ProgressStyle::FFmpeg:
+            fprintf(stderr, "size=%8llukB time=00:00:00.00 bitrate=   0.0kbits/s speed=1.00x\r", this->nProcessed / 1024);
+            if (bDone == true)
+                fprintf(stderr, "\n");
+            break;
+        }
+        fflush(stderr);
+    }
+    int Run()
+    {
+        FILE *fin = stdin;
+        FILE *fout = stdout;
+
+        if (this->options.szInput == L"-")
+        {
+            _setmode(_fileno(stdin), _O_BINARY);
+            this->nTotal = this->options.nSize;
+        }
+        else
+        {
+            if (_wfopen_s(&fin, this->options.szInput.c_str(), L"rb") != 0 || fin == nullptr)
+            {
+                fprintf(stderr, "Error: failed to open input file.\r\n");
+                return 1;
+            }
+            _fseeki64(fin, 0, SEEK_END);
+            this->nTotal = (unsigned __int64)_ftelli64(fin);
+            _fseeki64(fin, 0, SEEK_SET);
+        }
+
+        if (this->options.szOutput == L"-")
+        {
+            _setmode(_fileno(stdout), _O_BINARY);
+        }
+        else
+        {
+            if (_wfopen_s(&fout, this->options.szOutput.c_str(), L"wb") != 0 || fout == nullptr)
+            {
+                fprintf(stderr, "Error: failed to open output file.\r\n");
+                if (fin != stdin)
+                    fclose(fin);
+                return 1;
+            }
+        }
+
+        const size_t nBuffSize = 64 * 1024;
+        static char pBuffer[nBuffSize];
+        const double fMegabyte = 1024.0 * 1024.0;
+        auto tStart = std::chrono::steady_clock::now();
+
+        while (true)
+        {
+            size_t nRead = fread(pBuffer, 1, nBuffSize, fin);
+            if (nRead == 0)
+                break;
+
+            this->nProcessed += nRead;
+
+            if (this->options.fCpu > 0.0)
+                this->BurnCpu(this->options.fCpu * (double)nRead / fMegabyte);
+
+            if (this->options.fRate > 0.0)
+            {
+                auto tTarget = tStart + std::chrono::duration<double>((double)this->nProcessed / (this->options.fRate * fMegabyte));
+                std::this_thread::sleep_until(tTarget);
+            }
+
+            if (fwrite(pBuffer, 1, nRead, fout) != nRead)
+            {
+                fprintf(stderr, "\r\nError: failed to write output.\r\n");
+                break;
+            }
+
+            this->Progress(false);
+        }
+
+        this->Progress(true);
+
+        fflush(fout);
+        if (fin != stdin)
+            fclose(fin);
+        if (fout != stdout)
+            fclose(fout);
+
+        return this->options.nExitCode;
+    }
+};
+
+int wmain(int argc, wchar_t *argv[])
+{
+    CFakeEncoderOptions options;
+    if (options.Parse(argc, argv) == false)
+    {
+        fwprintf(stderr, L"Usage: %s [--style lame|flac|ffmpeg] [--rate MB/s] [--cpu ms-per-MB] [--size bytes] [--exit code] <input|-> <output|->\r\n", argv[0]);
+        return 2;
+    }
+
+    CFakeEncoder encoder(options);
+    return encoder.Run();
+}